@@ -0,0 +1,96 @@
+#include <catch2/catch.hpp>
+#include "BenchUtil.h"
+#include "AllocatorHeap.h"
+
+using namespace wirefox::detail;
+
+namespace {
+
+    // every call into the system heap made by this process, whether directly or via an allocator
+    std::atomic<uint64_t> g_heapCalls {0};
+
+    // one message worth of short-lived objects: build a payload, queue it for sending, and parse it back out
+    void SimulateMessage(Peer& peer, PeerID recipient, std::unique_ptr<Packet>& received) {
+        BinaryStream payload;
+        payload.WriteInt32(42);
+        payload.WriteZeroes(60);
+
+        Packet packet(PacketCommand::USER_PACKET, std::move(payload));
+        peer.Send(packet, recipient, PacketOptions::RELIABLE, PacketPriority::MEDIUM, Channel());
+        bench::ClearOutboxes(peer);
+
+        BinaryStream datagram;
+        packet.ToDatagram(datagram);
+        datagram.SeekToBegin();
+        received = Packet::Factory::Create(Packet::FromDatagram(recipient, datagram, datagram.GetLength()));
+    }
+
+}
+
+void* operator new(size_t size) {
+    g_heapCalls.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+TEST_CASE("Heap calls per message", "[Allocator]") {
+    Peer peer(1);
+    const auto ids = bench::ConnectDummyRemotes(peer);
+    std::unique_ptr<Packet> received;
+
+    // warm up the pools and the outbox, so only the steady state is measured
+    for (int i = 0; i < 1000; i++)
+        SimulateMessage(peer, ids[0], received);
+
+    constexpr int messages = 100000;
+    const auto statsBefore = cfg::DefaultAllocator::GetStats();
+    const auto heapBefore = g_heapCalls.load();
+
+    for (int i = 0; i < messages; i++)
+        SimulateMessage(peer, ids[0], received);
+
+    const auto statsAfter = cfg::DefaultAllocator::GetStats();
+    const auto heapAfter = g_heapCalls.load();
+
+    const double requests = double(statsAfter.allocations - statsBefore.allocations) / messages;
+    const double heapCalls = double(heapAfter - heapBefore) / messages;
+    std::cout << "Allocator requests per message: " << requests << std::endl;
+    std::cout << "System heap calls per message:  " << heapCalls << std::endl;
+    CHECK(heapCalls < 0.01);
+
+    BENCHMARK("Build, send and receive one message") {
+        SimulateMessage(peer, ids[0], received);
+    }
+}
+
+TEST_CASE("Allocate and free 1000 blocks", "[Allocator]") {
+    std::vector<void*> blocks(1000);
+
+    for (size_t size : {64, 1024}) {
+        const auto suffix = ", " + std::to_string(size) + " bytes";
+
+        BENCHMARK("AllocatorHeap" + suffix) {
+            for (auto& block : blocks)
+                block = AllocatorHeap::Allocate(size);
+            for (auto* block : blocks)
+                AllocatorHeap::Deallocate(block, size);
+        }
+
+        BENCHMARK("AllocatorSlab" + suffix) {
+            for (auto& block : blocks)
+                block = AllocatorSlab::Allocate(size);
+            for (auto* block : blocks)
+                AllocatorSlab::Deallocate(block, size);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "PCH.h"
+#include "Peer.h"
+#include "RemotePeer.h"
+
+namespace bench {
+
+    /// Marks the first \p count slots of a Peer as connected, without doing any network I/O, and returns their PeerIDs.
+    /// The slots have no socket, so anything queued for them stays in their outbox until ClearOutboxes() is called.
+    inline std::vector<PeerID> ConnectDummyRemotes(wirefox::detail::Peer& peer, size_t count) {
+        std::vector<PeerID> ids;
+        for (size_t i = 1; i <= count; i++) {
+            auto& remote = peer.GetRemoteByIndex(i);
+            peer.ReserveRemote(remote, wirefox::ConnectionOrigin::INVALID);
+            remote.id = static_cast<PeerID>(i);
+            remote.active = true;
+            ids.push_back(remote.id);
+        }
+        return ids;
+    }
+
+    /// Marks every slot of a Peer as connected, without doing any network I/O, and returns their PeerIDs.
+    inline std::vector<PeerID> ConnectDummyRemotes(wirefox::detail::Peer& peer) {
+        return ConnectDummyRemotes(peer, peer.GetMaximumPeers());
+    }
+
+    /// Gives every slot of a Peer a distinct loopback address, as if each remote were a separate client, and returns them in slot order.
+    inline std::vector<wirefox::detail::RemoteAddress> AssignDummyAddresses(wirefox::detail::Peer& peer) {
+        auto socket = wirefox::cfg::DefaultSocket::Create();
+        socket->Bind(wirefox::SocketProtocol::IPv4, 0);
+
+        std::vector<wirefox::detail::RemoteAddress> addrs;
+        for (size_t i = 1; i <= peer.GetMaximumPeers(); i++) {
+            wirefox::detail::RemoteAddress addr;
+            socket->Resolve("127.0.0.1", static_cast<uint16_t>(10000 + i), addr);
+            peer.SetRemoteAddress(peer.GetRemoteByIndex(i), addr);
+            addrs.push_back(addr);
+        }
+        return addrs;
+    }
+
+    /// Waits up to \p seconds for a client to post one of two notifications. Returns the one it posted, or USER_PACKET on timeout.
+    inline wirefox::PacketCommand WaitFor(wirefox::IPeer& client, wirefox::PacketCommand a, wirefox::PacketCommand b, int seconds, PeerID& sender) {
+        const auto timeout = wirefox::Time::Now() + wirefox::Time::FromSeconds(seconds);
+        while (!wirefox::Time::Elapsed(timeout)) {
+            while (auto packet = client.Receive()) {
+                if (packet->GetCommand() == a || packet->GetCommand() == b) {
+                    sender = packet->GetSender();
+                    return packet->GetCommand();
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return wirefox::PacketCommand::USER_PACKET;
+    }
+
+    /// Discards all packets that were queued for the remotes of a Peer.
+    inline void ClearOutboxes(wirefox::detail::Peer& peer) {
+        for (size_t i = 1; i <= peer.GetMaximumPeers(); i++) {
+            auto& remote = peer.GetRemoteByIndex(i);
+            WIREFOX_LOCK_GUARD(remote.lock);
+            remote.outbox.clear();
+        }
+    }
+
+}
@@ -0,0 +1,156 @@
+#include <catch2/catch.hpp>
+#include "BenchUtil.h"
+#include "ChannelBuffer.h"
+#include "PacketHeader.h"
+#include "ReassemblyBuffer.h"
+#include "ReceiptTracker.h"
+
+using namespace wirefox::detail;
+
+namespace {
+
+    constexpr size_t SEGMENT_SIZE = 1100;
+
+    /// Splits a packet into segments the way DatagramBuilder does, and returns their headers and the serialized packet.
+    std::vector<PacketHeader> SplitPacket(const Packet& packet, PacketID container, BinaryStream& serialized) {
+        serialized.Clear();
+        packet.ToDatagram(serialized);
+
+        std::vector<PacketHeader> segments;
+        for (size_t offset = 0; offset < serialized.GetLength(); offset += SEGMENT_SIZE) {
+            PacketHeader header;
+            header.id = static_cast<PacketID>(container + segments.size() + 1);
+            header.options = PacketOptions::RELIABLE;
+            header.offset = static_cast<uint32_t>(offset);
+            header.length = static_cast<uint32_t>(std::min(SEGMENT_SIZE, serialized.GetLength() - offset));
+            header.splitContainer = container;
+            header.splitIndex = static_cast<uint32_t>(segments.size());
+            header.flag_segment = offset + SEGMENT_SIZE < serialized.GetLength();
+            segments.push_back(header);
+        }
+
+        return segments;
+    }
+
+}
+
+TEST_CASE("Channel buffer", "[Buffers]") {
+    constexpr size_t burst = 256;
+
+    for (auto mode : {ChannelMode::ORDERED, ChannelMode::SEQUENCED}) {
+        Peer peer(1);
+        const auto channel = peer.MakeChannel(mode);
+        ChannelBuffer buffer(&peer, channel.id);
+
+        // recycle the packets, so only the buffer itself is measured
+        std::vector<std::unique_ptr<Packet>> packets;
+        for (size_t i = 0; i < burst; i++)
+            packets.push_back(std::make_unique<Packet>(PacketCommand::USER_PACKET, nullptr, 0));
+
+        // arrival order within each burst: in order, or every pair swapped, as a reordering network would do
+        for (bool reordered : {false, true}) {
+            std::vector<size_t> order(burst);
+            for (size_t i = 0; i < burst; i++)
+                order[i] = reordered ? i ^ 1 : i;
+
+            const auto suffix = std::string(mode == ChannelMode::ORDERED ? ", ordered" : ", sequenced")
+                + (reordered ? ", pairs swapped" : ", in order");
+            SequenceID base = 0;
+            size_t delivered = 0;
+
+            BENCHMARK("Enqueue and dequeue " + std::to_string(burst) + " packets" + suffix) {
+                for (size_t i = 0; i < burst; i++) {
+                    buffer.Enqueue(static_cast<SequenceID>(base + order[i]), std::move(packets[i]));
+                    while (auto packet = buffer.Dequeue()) {
+                        packets[delivered++ % burst] = std::move(packet);
+                    }
+                }
+
+                // sequenced channels discard what arrives late, so give the buffer new packets for those
+                for (auto& packet : packets)
+                    if (!packet)
+                        packet = std::make_unique<Packet>(PacketCommand::USER_PACKET, nullptr, 0);
+
+                base = static_cast<SequenceID>(base + burst);
+                delivered = 0;
+            }
+
+            CHECK(buffer.Dequeue() == nullptr);
+        }
+    }
+}
+
+TEST_CASE("Reassembly buffer", "[Buffers]") {
+    RemotePeer remote;
+    ReassemblyBuffer assembly(&remote);
+    BinaryStream serialized;
+
+    for (size_t size : {4096, 65536, 1024 * 1024}) {
+        BinaryStream payload;
+        payload.WriteZeroes(size);
+        const Packet packet(PacketCommand::USER_PACKET, std::move(payload));
+
+        PacketID container = 1;
+        const auto segments = SplitPacket(packet, container, serialized);
+
+        // insert segments in order, and try to reassemble after each one, like PacketQueue does
+        const auto reassemble = [&]() {
+            std::unique_ptr<Packet> result;
+            for (auto header : segments) {
+                header.splitContainer = container;
+                serialized.Seek(header.offset);
+                assembly.Insert(header, serialized);
+                result = assembly.Reassemble(container);
+            }
+
+            container++;
+            return result;
+        };
+
+        auto result = reassemble();
+        REQUIRE(result);
+        CHECK(result->GetLength() == size);
+
+        BENCHMARK("Reassemble " + std::to_string(size) + " bytes from " + std::to_string(segments.size()) + " segments") {
+            result = reassemble();
+        }
+    }
+}
+
+TEST_CASE("Receipt tracker", "[Buffers]") {
+    constexpr size_t segments = 15;
+
+    for (size_t pending : {0, 64, 1024}) {
+        Peer peer(1);
+        const auto ids = bench::ConnectDummyRemotes(peer, 1);
+        auto& remote = *peer.GetRemoteByID(ids[0]);
+        ReceiptTracker tracker(&peer, remote);
+
+        // split packets whose segments are still on their way, which every ack has to be checked against
+        PacketID next = 1;
+        for (size_t i = 0; i < pending; i++) {
+            std::set<PacketID> group;
+            for (size_t j = 0; j < segments; j++)
+                group.insert(next + 1 + static_cast<PacketID>(j));
+            tracker.RegisterSplitPacket(next, std::move(group));
+            next += segments + 1;
+        }
+
+        BENCHMARK("Track and ack a split packet of " + std::to_string(segments) + " segments, "
+            + std::to_string(pending) + " others pending") {
+            const PacketID container = next;
+            std::set<PacketID> group;
+            for (size_t j = 0; j < segments; j++)
+                group.insert(container + 1 + static_cast<PacketID>(j));
+
+            tracker.Track(container);
+            tracker.RegisterSplitPacket(container, std::move(group));
+            for (size_t j = 0; j < segments; j++)
+                tracker.Acknowledge(container + 1 + static_cast<PacketID>(j));
+            next += segments + 1;
+
+            // the receipt ends up in the inbox, which would otherwise keep growing
+            peer.Receive();
+        }
+    }
+}
@@ -0,0 +1,157 @@
+#include <catch2/catch.hpp>
+#include "BenchUtil.h"
+
+#ifdef WIREFOX_ENABLE_ENCRYPTION
+#include "EncryptionLayerSodium.h"
+#include "WorkerPool.h"
+
+using namespace wirefox::detail;
+
+namespace {
+
+    using Cipher = EncryptionLayerSodium::Cipher;
+
+    /// Completes a key exchange between two layers, restricted to a single cipher. Returns false if it is unavailable.
+    bool ConnectLayers(EncryptionLayerSodium& client, EncryptionLayerSodium& server, Cipher cipher) {
+        const auto mask = static_cast<uint8_t>(cipher);
+        if (!client.NegotiateCipher(mask & server.GetSupportedCiphers())) return false;
+        if (!server.NegotiateCipher(mask & client.GetSupportedCiphers())) return false;
+
+        auto clientKey = client.GetEphemeralPublicKey();
+        auto serverKey = server.GetEphemeralPublicKey();
+        return client.HandleKeyExchange(ConnectionOrigin::SELF, serverKey)
+            && server.HandleKeyExchange(ConnectionOrigin::REMOTE, clientKey);
+    }
+
+    /// Lays out a datagram the way DatagramBuilder does: headroom, plaintext, and capacity for the tailroom.
+    void PrepareDatagram(BinaryStream& datagram, size_t size) {
+        datagram.Clear();
+        datagram.WriteZeroes(EncryptionLayerSodium::GetHeadroom() + size);
+    }
+
+    /// One connection's worth of state for the worker pool benchmark. Only ever touched by the worker its key maps to.
+    struct Connection {
+        EncryptionLayerSodium   client;
+        EncryptionLayerSodium   server;
+        BinaryStream            datagram {EncryptionLayerSodium::GetHeadroom() + 1260 + EncryptionLayerSodium::GetTailroom()};
+        BinaryStream            plaintext {0};
+        uint32_t                sent = 0;
+        uint32_t                received = 0;
+        bool                    ordered = true;
+    };
+
+    /// Encrypts a datagram on one end, and decrypts it on the other. Returns false if it was rejected.
+    bool RoundTrip(EncryptionLayerSodium& client, EncryptionLayerSodium& server, BinaryStream& datagram, BinaryStream& plaintext) {
+        const size_t unused = client.EncryptInPlace(datagram, 0);
+        return server.DecryptInPlace(datagram.GetWritableBuffer() + unused, datagram.GetLength() - unused, plaintext);
+    }
+
+}
+
+TEST_CASE("Encrypt and decrypt one datagram", "[Crypto]") {
+    const std::pair<Cipher, const char*> ciphers[] = {
+        {Cipher::XCHACHA20_POLY1305, "XChaCha20-Poly1305, random nonce"},
+        {Cipher::CHACHA20_POLY1305, "ChaCha20-Poly1305, counter nonce"},
+        {Cipher::AES256_GCM, "AES-256-GCM, counter nonce"},
+    };
+
+    // printed at the end, so it doesn't get mixed up with the benchmark table
+    std::ostringstream rates;
+
+    for (const auto& entry : ciphers) {
+        EncryptionLayerSodium client, server;
+        if (!ConnectLayers(client, server, entry.first)) {
+            WARN(entry.second << " is not available on this machine");
+            continue;
+        }
+
+        for (size_t size : {64, 1024, 1260}) {
+            const auto suffix = std::string(", ") + entry.second + ", " + std::to_string(size) + " bytes";
+            BinaryStream datagram(EncryptionLayerSodium::GetHeadroom() + size + EncryptionLayerSodium::GetTailroom());
+            BinaryStream plaintext(0);
+
+            // the whole round trip should happen inside the datagram buffer
+            const auto statsBefore = cfg::DefaultAllocator::GetStats();
+            PrepareDatagram(datagram, size);
+            REQUIRE(RoundTrip(client, server, datagram, plaintext));
+            const auto statsAfter = cfg::DefaultAllocator::GetStats();
+            CHECK(plaintext.GetLength() == size);
+            CHECK(statsAfter.allocations == statsBefore.allocations);
+
+            // measure a steady stream of datagrams on a single thread
+            constexpr int datagrams = 100000;
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < datagrams; i++) {
+                PrepareDatagram(datagram, size);
+                RoundTrip(client, server, datagram, plaintext);
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            REQUIRE_FALSE(server.GetNeedsToBail());
+            rates << "Datagrams per second per core" << suffix << ": " << uint64_t(datagrams / elapsed.count()) << std::endl;
+
+            BENCHMARK("Encrypt and decrypt in place" + suffix) {
+                PrepareDatagram(datagram, size);
+                RoundTrip(client, server, datagram, plaintext);
+            }
+        }
+    }
+
+    std::cout << rates.str();
+}
+
+TEST_CASE("Encrypt and decrypt on a worker pool", "[Crypto]") {
+    constexpr size_t connections = 64;
+    constexpr size_t datagramsPerConnection = 2000;
+    constexpr size_t size = 1260;
+
+    std::vector<std::unique_ptr<Connection>> conns;
+    for (size_t i = 0; i < connections; i++) {
+        auto conn = std::make_unique<Connection>();
+        REQUIRE(conn->client.NegotiateCipher(conn->server.GetSupportedCiphers()));
+        REQUIRE(conn->server.NegotiateCipher(conn->client.GetSupportedCiphers()));
+        REQUIRE(ConnectLayers(conn->client, conn->server, conn->client.GetCipher()));
+        conns.push_back(std::move(conn));
+    }
+
+    std::cout << "Hardware threads available: " << std::thread::hardware_concurrency() << std::endl;
+
+    for (size_t threads : {1, 2, 4, 8}) {
+        WorkerPool pool(threads);
+        std::atomic<size_t> done {0};
+
+        // post datagrams round-robin, the way a server with many busy connections would see them arrive; every
+        // datagram carries a sequence number, which the receiving end checks to confirm nothing overtook it
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t n = 0; n < datagramsPerConnection; n++) {
+            for (size_t key = 0; key < connections; key++) {
+                pool.Post(key, [&conns, &done, key]() {
+                    auto& conn = *conns[key];
+                    PrepareDatagram(conn.datagram, size);
+                    conn.datagram.Seek(EncryptionLayerSodium::GetHeadroom());
+                    conn.datagram.WriteInt32(conn.sent++);
+                    conn.datagram.SeekToEnd();
+
+                    if (RoundTrip(conn.client, conn.server, conn.datagram, conn.plaintext))
+                        conn.ordered &= conn.plaintext.ReadUInt32() == conn.received++;
+                    else
+                        conn.ordered = false;
+
+                    done.fetch_add(1, std::memory_order_release);
+                });
+            }
+        }
+
+        const size_t total = connections * datagramsPerConnection;
+        while (done.load(std::memory_order_acquire) < total)
+            std::this_thread::yield();
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Datagrams per second on " << threads << " worker thread(s), " << size << " bytes: "
+            << uint64_t(total / elapsed.count()) << std::endl;
+
+        for (const auto& conn : conns)
+            CHECK(conn->ordered);
+    }
+}
+
+#endif
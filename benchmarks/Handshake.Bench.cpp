@@ -0,0 +1,393 @@
+#include <catch2/catch.hpp>
+#include "BenchUtil.h"
+#include "DatagramHeader.h"
+#include "PacketHeader.h"
+#include "Handshaker.h"
+#include "EncryptionLayer.h"
+
+using namespace wirefox::detail;
+using asio::ip::udp;
+
+namespace {
+
+    constexpr uint16_t SERVER_PORT = 41300;
+
+    /// Wraps a handshake message the way PacketQueue wraps out-of-band packets, and encrypts it if \p crypto is established.
+    /// Returns the datagram, along with the number of bytes at its start that should not be sent.
+    std::pair<BinaryStream, size_t> WrapHandshakePart(BinaryStream&& part, EncryptionLayer* crypto = nullptr) {
+        const Packet packet(PacketCommand::CONNECT_ATTEMPT, std::move(part));
+        BinaryStream payload;
+        PacketHeader header;
+        header.length = static_cast<uint32_t>(packet.GetDatagramLength());
+        header.Serialize(payload);
+        packet.ToDatagram(payload);
+
+        const bool encrypt = crypto && crypto->GetCryptoEstablished();
+        BinaryStream datagram;
+        if (encrypt)
+            datagram.WriteZeroes(cfg::DefaultEncryption::GetHeadroom());
+
+        DatagramHeader datagramHeader;
+        datagramHeader.flag_data = true;
+        datagramHeader.dataLength = payload.GetLength();
+        datagramHeader.Serialize(datagram);
+        datagram.WriteBytes(payload);
+
+        const size_t skip = encrypt ? crypto->EncryptInPlace(datagram, 0) : 0;
+        return std::make_pair(std::move(datagram), skip);
+    }
+
+    /// Returns the first datagram a client with the PeerID of \p client sends when it starts connecting.
+    BinaryStream MakeConnectRequest(Peer& client) {
+        // let a real Handshaker write the request, so it matches whatever the current protocol looks like
+        BinaryStream request;
+        RemotePeer dummy;
+        dummy.Setup(&client, ConnectionOrigin::SELF);
+        dummy.handshake->SetReplyHandler([&request](BinaryStream&& outstream) { request = std::move(outstream); });
+        dummy.handshake->Begin();
+
+        return WrapHandshakePart(std::move(request)).first;
+    }
+
+    /// Sends connection requests from many loopback addresses that never answer, like an attacker spoofing its source.
+    class Flood {
+    public:
+        Flood(size_t addresses, size_t perSecond)
+            : m_abort(false) {
+            // every 127.x.y.z address routes to loopback on Linux, which gives plenty of distinct senders
+            for (size_t i = 0; i < addresses; i++) {
+                Peer spoofed(1);
+                m_requests.push_back(MakeConnectRequest(spoofed));
+
+                const auto ip = asio::ip::make_address_v4(0x7F000002 + static_cast<uint32_t>(i));
+                m_sockets.emplace_back(m_context, udp::endpoint(ip, 0));
+            }
+
+            m_thread = std::thread([this, perSecond]() {
+                const udp::endpoint server(asio::ip::make_address_v4("127.0.0.1"), SERVER_PORT);
+                constexpr size_t ticksPerSecond = 100;
+                size_t next = 0;
+
+                while (!m_abort) {
+                    for (size_t i = 0; i < perSecond / ticksPerSecond; i++, next++) {
+                        const auto& request = m_requests[next % m_requests.size()];
+                        asio::error_code ec;
+                        m_sockets[next % m_sockets.size()].send_to(asio::buffer(request.GetBuffer(), request.GetLength()), server, 0, ec);
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1000 / ticksPerSecond));
+                }
+            });
+        }
+
+        ~Flood() {
+            m_abort = true;
+            m_thread.join();
+        }
+
+    private:
+        asio::io_context        m_context;
+        std::vector<udp::socket> m_sockets;
+        std::vector<BinaryStream> m_requests;
+        std::thread             m_thread;
+        std::atomic_bool        m_abort;
+    };
+
+    /// Connects a client to the server and hangs up again. Returns how long connecting took in milliseconds, or -1 if it failed.
+    double ConnectOnce(IPeer& client) {
+        const auto start = std::chrono::steady_clock::now();
+        REQUIRE(client.Connect("127.0.0.1", SERVER_PORT) == ConnectAttemptResult::OK);
+
+        PeerID server;
+        const auto result = bench::WaitFor(client, PacketCommand::NOTIFY_CONNECT_SUCCESS, PacketCommand::NOTIFY_CONNECT_FAILED, 10, server);
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (result != PacketCommand::NOTIFY_CONNECT_SUCCESS)
+            return -1;
+
+        // hang up properly, so the slot is free for the next client
+        client.Disconnect(server);
+        bench::WaitFor(client, PacketCommand::NOTIFY_DISCONNECTED, PacketCommand::NOTIFY_CONNECTION_LOST, 5, server);
+        return elapsed.count();
+    }
+
+    /// Connects a fresh client to the server, and returns how long that took in milliseconds, or -1 if it failed.
+    double ConnectOnce(bool encrypted = false) {
+        auto client = IPeer::Factory::Create(1);
+        client->SetEncryptionEnabled(encrypted);
+        REQUIRE(client->Bind(SocketProtocol::IPv4, 0));
+        return ConnectOnce(*client);
+    }
+
+    /// Counts the slots of a Peer that are reserved for a remote.
+    size_t CountActiveRemotes(Peer& peer) {
+        size_t count = 0;
+        for (size_t i = 1; i <= peer.GetMaximumPeers(); i++)
+            if (peer.GetRemoteByIndex(i).active)
+                count++;
+        return count;
+    }
+
+    /// Runs the client side of a real handshake over a plain socket, so that every client can have its own source address.
+    class RawClient {
+    public:
+        RawClient(asio::io_context& context, const asio::ip::address_v4& ip)
+            : m_identity(1)
+            , m_socket(context, udp::endpoint(ip, 0))
+            , m_server(asio::ip::make_address_v4("127.0.0.1"), SERVER_PORT) {
+            // only the PeerID and keys of this Peer are used, it never sends anything itself
+            m_identity.SetHandshakeThreads(0);
+            m_identity.SetEncryptionEnabled(true);
+            m_socket.non_blocking(true);
+
+            m_remote.Setup(&m_identity, ConnectionOrigin::SELF);
+            m_remote.handshake->SetReplyHandler([this](BinaryStream&& outstream) {
+                const auto datagram = WrapHandshakePart(std::move(outstream), m_remote.crypto.get());
+                asio::error_code ec;
+                m_socket.send_to(asio::buffer(datagram.first.GetBuffer() + datagram.second, datagram.first.GetLength() - datagram.second), m_server, 0, ec);
+            });
+        }
+
+        void Begin() {
+            m_remote.handshake->Begin();
+        }
+
+        /// Feeds any replies from the server to the handshake, and resends lost messages. Returns true once the handshake is over.
+        bool Update() {
+            std::array<uint8_t, 1500> buffer;
+            asio::error_code ec;
+            udp::endpoint sender;
+            size_t length;
+            while (!m_remote.handshake->IsDone() && (length = m_socket.receive_from(asio::buffer(buffer), sender, 0, ec), !ec)) {
+                // once the handshake is done, the server only sends encrypted datagrams, which we don't need to read
+                BinaryStream datagram(buffer.data(), length, BinaryStream::WrapMode::READONLY);
+                DatagramHeader datagramHeader;
+                PacketHeader header;
+                if (datagramHeader.Deserialize(datagram) && !datagramHeader.flag_link && header.Deserialize(datagram))
+                    m_remote.handshake->Handle(Packet::FromDatagram(0, datagram, header.length));
+            }
+
+            m_remote.handshake->Update();
+            return m_remote.handshake->IsDone();
+        }
+
+        ConnectResult GetResult() const {
+            return m_remote.handshake->GetResult();
+        }
+
+    private:
+        Peer                    m_identity;
+        RemotePeer              m_remote;
+        udp::socket             m_socket;
+        udp::endpoint           m_server;
+    };
+
+    /// Measures the round trip time of small packets echoed by the server, like a game client sending inputs.
+    class Player {
+    public:
+        explicit Player(Peer& server)
+            : m_client(IPeer::Factory::Create(1))
+            , m_abort(false) {
+            m_client->SetEncryptionEnabled(true);
+            REQUIRE(m_client->Bind(SocketProtocol::IPv4, 0));
+            REQUIRE(m_client->Connect("127.0.0.1", SERVER_PORT) == ConnectAttemptResult::OK);
+            REQUIRE(bench::WaitFor(*m_client, PacketCommand::NOTIFY_CONNECT_SUCCESS, PacketCommand::NOTIFY_CONNECT_FAILED, 10, m_server) == PacketCommand::NOTIFY_CONNECT_SUCCESS);
+
+            // the server echoes everything it gets, on a thread of its own, as a game server's main loop would
+            m_echo = std::thread([this, &server]() {
+                while (!m_abort) {
+                    while (auto packet = server.Receive())
+                        if (packet->GetCommand() == PacketCommand::USER_PACKET)
+                            server.Send(*packet, packet->GetSender(), PacketOptions::UNRELIABLE, PacketPriority::MEDIUM, Channel());
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+            });
+        }
+
+        ~Player() {
+            m_abort = true;
+            m_echo.join();
+        }
+
+        /// Sends a packet every few milliseconds until \p done returns true, and returns the sorted round trip times in milliseconds.
+        template<typename Fn>
+        std::vector<double> Measure(Fn&& done) {
+            std::vector<double> rtts;
+            auto nextSend = Time::Now();
+            while (!done()) {
+                if (Time::Elapsed(nextSend)) {
+                    BinaryStream payload;
+                    payload.WriteInt64(static_cast<uint64_t>(Time::Now()));
+                    m_client->Send(Packet(PacketCommand::USER_PACKET, std::move(payload)), m_server, PacketOptions::UNRELIABLE);
+                    nextSend = Time::Now() + Time::FromMilliseconds(5);
+                }
+
+                while (auto packet = m_client->Receive()) {
+                    if (packet->GetCommand() != PacketCommand::USER_PACKET) continue;
+                    const auto sent = packet->GetStream().ReadUInt64();
+                    rtts.push_back(static_cast<double>(static_cast<uint64_t>(Time::Now()) - sent) / 1e6);
+                }
+
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+
+            std::sort(rtts.begin(), rtts.end());
+            return rtts;
+        }
+
+    private:
+        std::unique_ptr<IPeer>  m_client;
+        PeerID                  m_server;
+        std::thread             m_echo;
+        std::atomic_bool        m_abort;
+    };
+
+    /// Returns the value below which a fraction \p p of the sorted samples fall.
+    double Percentile(const std::vector<double>& sorted, double p) {
+        return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))];
+    }
+
+}
+
+TEST_CASE("Connect during a flood of spoofed connection requests", "[Handshake]") {
+    constexpr size_t attempts = 10;
+    constexpr size_t slots = 32;
+
+    Peer server(slots);
+    server.SetMaximumIncomingPeers(slots);
+    REQUIRE(server.Bind(SocketProtocol::IPv4, SERVER_PORT));
+
+    // printed at the end, so it doesn't get mixed up with the output of the peers
+    std::ostringstream results;
+
+    for (size_t perSecond : {0, 1000, 10000}) {
+        std::unique_ptr<Flood> flood;
+        if (perSecond > 0)
+            flood = std::make_unique<Flood>(256, perSecond);
+
+        std::vector<double> latencies;
+        for (size_t i = 0; i < attempts; i++) {
+            // all clients share one address, so pace them to stay under the server's per-address rate limit
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            const double latency = ConnectOnce();
+            if (latency >= 0)
+                latencies.push_back(latency);
+        }
+
+        const size_t reserved = CountActiveRemotes(server);
+        flood.reset();
+
+        std::sort(latencies.begin(), latencies.end());
+        results << "Spoofed requests per second: " << perSecond
+            << ", connected " << latencies.size() << "/" << attempts
+            << ", median " << (latencies.empty() ? 0 : latencies[latencies.size() / 2]) << " ms"
+            << ", worst " << (latencies.empty() ? 0 : latencies.back()) << " ms"
+            << ", slots reserved " << reserved << "/" << slots << std::endl;
+
+
+        // wait for the slots handed to spoofed senders (if any) to time out, so the next round starts with an empty server
+        const auto timeout = Time::Now() + Time::FromSeconds(30);
+        while (CountActiveRemotes(server) > 0 && !Time::Elapsed(timeout)) {
+            while (server.Receive()) {}
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+
+    std::cout << results.str();
+}
+
+#ifdef WIREFOX_ENABLE_ENCRYPTION
+TEST_CASE("Reconnect with a session ticket", "[Handshake]") {
+    constexpr size_t attempts = 10;
+
+    auto server = IPeer::Factory::Create(4);
+    server->SetMaximumIncomingPeers(4);
+    server->SetEncryptionEnabled(true);
+    REQUIRE(server->Bind(SocketProtocol::IPv4, SERVER_PORT));
+
+    // this client keeps the ticket from each connection, so every connection after the first is resumed
+    auto returning = IPeer::Factory::Create(1);
+    returning->SetEncryptionEnabled(true);
+    REQUIRE(returning->Bind(SocketProtocol::IPv4, 0));
+    REQUIRE(ConnectOnce(*returning) >= 0);
+
+    std::vector<double> full, resumed;
+    for (size_t i = 0; i < attempts; i++) {
+        // pace the clients to stay under the server's per-address rate limit, as above
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        full.push_back(ConnectOnce(true));
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        resumed.push_back(ConnectOnce(*returning));
+    }
+
+    std::sort(full.begin(), full.end());
+    std::sort(resumed.begin(), resumed.end());
+    std::cout << "Encrypted connect, median of " << attempts
+        << ": full handshake " << full[attempts / 2] << " ms"
+        << ", resumed " << resumed[attempts / 2] << " ms" << std::endl;
+
+    CHECK(full.front() >= 0);
+    CHECK(resumed.front() >= 0);
+    CHECK(resumed[attempts / 2] < full[attempts / 2]);
+}
+#endif
+
+TEST_CASE("Data latency during a reconnect storm", "[Handshake]") {
+    constexpr size_t storm = 500;
+
+    // printed at the end, so it doesn't get mixed up with the output of the peers
+    std::ostringstream results;
+
+    for (size_t threads : {0, 1}) {
+        Peer server(storm + 1);
+        server.SetMaximumIncomingPeers(storm + 1);
+        server.SetEncryptionEnabled(true);
+        server.SetHandshakeThreads(threads);
+        REQUIRE(server.Bind(SocketProtocol::IPv4, SERVER_PORT));
+
+        // one player is already connected, and keeps sending while everyone else reconnects
+        Player player(server);
+        const auto idleEnd = Time::Now() + Time::FromMilliseconds(500);
+        const auto idle = player.Measure([&]() { return Time::Elapsed(idleEnd); });
+
+        // every reconnecting client has its own address, as it would after a server restart, so no rate limit applies
+        asio::io_context context;
+        std::vector<std::unique_ptr<RawClient>> clients;
+        for (size_t i = 0; i < storm; i++)
+            clients.push_back(std::make_unique<RawClient>(context, asio::ip::make_address_v4(0x7F010001 + static_cast<uint32_t>(i))));
+
+        std::atomic_bool stormDone(false);
+        const auto start = std::chrono::steady_clock::now();
+        std::thread driver([&]() {
+            for (auto& client : clients)
+                client->Begin();
+
+            bool done = false;
+            while (!done) {
+                done = true;
+                for (auto& client : clients)
+                    done &= client->Update();
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            stormDone = true;
+        });
+
+        const auto busy = player.Measure([&]() { return stormDone.load(); });
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        driver.join();
+
+        const auto connected = std::count_if(clients.begin(), clients.end(),
+            [](const std::unique_ptr<RawClient>& client) { return client->GetResult() == ConnectResult::OK; });
+
+        results << "Handshake threads: " << threads
+            << ", idle rtt median " << Percentile(idle, 0.5) << " ms, p99 " << Percentile(idle, 0.99) << " ms"
+            << "; during storm median " << Percentile(busy, 0.5) << " ms, p99 " << Percentile(busy, 0.99) << " ms"
+            << ", worst " << Percentile(busy, 1) << " ms"
+            << "; " << connected << "/" << storm << " reconnected in " << elapsed.count() << " ms" << std::endl;
+
+        CHECK(!busy.empty());
+        CHECK(connected > 0);
+    }
+
+    std::cout << results.str();
+}
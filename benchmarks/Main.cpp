@@ -0,0 +1,16 @@
+#define CATCH_CONFIG_RUNNER
+#include <catch2/catch.hpp>
+
+int main(int argc, char* argv[]) {
+    Catch::Session session;
+
+    // By default, Catch stops a benchmark as soon as it runs for 100x the clock resolution, which is far too short to get
+    // stable numbers out of anything that takes a lock. This can still be overridden with --benchmark-resolution-multiple.
+    session.configData().benchmarkResolutionMultiple = 1000000;
+
+    const int result = session.applyCommandLine(argc, argv);
+    if (result != 0)
+        return result;
+
+    return session.run();
+}
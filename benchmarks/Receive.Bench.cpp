@@ -0,0 +1,41 @@
+#include <catch2/catch.hpp>
+#include "BenchUtil.h"
+
+using namespace wirefox::detail;
+
+TEST_CASE("Look up the sender of a datagram", "[Receive]") {
+    for (size_t slots : {16, 256, 4096}) {
+        Peer peer(slots);
+        bench::ConnectDummyRemotes(peer);
+        const auto addrs = bench::AssignDummyAddresses(peer);
+        const auto suffix = ", " + std::to_string(slots) + " slots";
+
+        // the address of a remote in the last slot, and of a stranger, were the worst cases for a scan through all slots
+        const auto& known = addrs.back();
+        RemoteAddress unknown;
+        REQUIRE(peer.GetRemoteByAddress(known) == &peer.GetRemoteByIndex(slots));
+        REQUIRE(peer.GetRemoteByAddress(unknown) == nullptr);
+
+        // connected remotes prefix their datagrams with the connection ID we gave them, which skips the address lookup
+        auto& last = peer.GetRemoteByIndex(slots);
+        const ConnectionID connectionID = peer.MakeConnectionID(last);
+        last.localConnectionID = connectionID;
+        REQUIRE(peer.GetRemoteByConnectionID(connectionID) == &last);
+        REQUIRE(peer.GetRemoteByConnectionID(connectionID ^ 1) == nullptr);
+
+        size_t found = 0;
+        BENCHMARK("GetRemoteByConnectionID() for a connected sender" + suffix) {
+            found += peer.GetRemoteByConnectionID(connectionID) != nullptr;
+        }
+
+        BENCHMARK("GetRemoteByAddress() for a connected sender" + suffix) {
+            found += peer.GetRemoteByAddress(known) != nullptr;
+        }
+
+        BENCHMARK("GetRemoteByAddress() for an unknown sender" + suffix) {
+            found += peer.GetRemoteByAddress(unknown) != nullptr;
+        }
+
+        CHECK(found > 0);
+    }
+}
@@ -0,0 +1,63 @@
+#include <catch2/catch.hpp>
+#include "BenchUtil.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using namespace wirefox::detail;
+
+namespace {
+
+    constexpr size_t CONNECTED = 100;
+
+    /// Returns the number of bytes currently allocated from the heap, or zero if that can't be found out.
+    size_t GetHeapInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+        const auto info = mallinfo2();
+        return info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+        const auto info = mallinfo();
+        return static_cast<size_t>(info.uordblks) + static_cast<size_t>(info.hblkhd);
+#else
+        return 0;
+#endif
+    }
+
+}
+
+TEST_CASE("Memory per slot", "[Scale]") {
+    if (GetHeapInUse() == 0) return;
+
+    for (size_t slots : {1000, 10000, 50000}) {
+        const size_t before = GetHeapInUse();
+        Peer peer(slots);
+        const size_t idle = GetHeapInUse();
+
+        for (size_t i = 1; i <= CONNECTED; i++) {
+            auto& remote = peer.GetRemoteByIndex(i);
+            peer.ReserveRemote(remote, ConnectionOrigin::REMOTE);
+            remote.id = static_cast<PeerID>(i);
+            remote.active = true;
+        }
+        const size_t connected = GetHeapInUse();
+
+        std::cout << slots << " slots: " << (idle - before) / slots << " bytes per idle slot, "
+            << (connected - idle) / CONNECTED << " bytes per connection" << std::endl;
+    }
+}
+
+TEST_CASE("Packet queue tick", "[Scale]") {
+    for (size_t slots : {1000, 10000, 50000}) {
+        Peer peer(slots);
+        bench::ConnectDummyRemotes(peer, CONNECTED);
+
+        // a queue of our own, whose worker thread is stopped so only the ticks below touch the remotes
+        auto queue = std::make_shared<PacketQueue>(&peer);
+        queue->Stop();
+
+        BENCHMARK("Update() with " + std::to_string(CONNECTED) + " of " + std::to_string(slots) + " slots connected") {
+            queue->Update();
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#include <catch2/catch.hpp>
+#include "BenchUtil.h"
+
+using namespace wirefox::detail;
+
+TEST_CASE("Broadcast to many recipients", "[Send]") {
+    // a typical world state update: too big to be merged with much else, too small to be segmented
+    BinaryStream payload(256);
+    payload.WriteZeroes(256);
+    const Packet packet(PacketCommand::USER_PACKET, std::move(payload));
+
+    for (size_t recipients : {10, 100, 1000}) {
+        Peer peer(recipients);
+        const auto ids = bench::ConnectDummyRemotes(peer);
+        const auto suffix = ", " + std::to_string(recipients) + " recipients";
+
+        BENCHMARK("Send() per recipient" + suffix) {
+            for (auto id : ids)
+                peer.Send(packet, id, PacketOptions::RELIABLE, PacketPriority::MEDIUM, Channel());
+            bench::ClearOutboxes(peer);
+        }
+
+        BENCHMARK("Send() to recipient list" + suffix) {
+            peer.Send(packet, ids, PacketOptions::RELIABLE, PacketPriority::MEDIUM, Channel());
+            bench::ClearOutboxes(peer);
+        }
+    }
+}
@@ -0,0 +1,166 @@
+#include <catch2/catch.hpp>
+#include "BenchUtil.h"
+#include "DatagramHeader.h"
+#include "PacketHeader.h"
+
+using namespace wirefox::detail;
+
+namespace {
+
+    /// Writes what a typical game state update looks like: a few flags, some ids and coordinates, and a name.
+    void WriteEntity(BinaryStream& stream, uint32_t id) {
+        stream.WriteBool(true);
+        stream.WriteBool(false);
+        stream.WriteBool(id % 2 == 0);
+        stream.WriteInt32(id);
+        stream.WriteInt16(static_cast<uint16_t>(id));
+        stream.WriteInt64(0x0123456789ABCDEFull);
+        stream.Write7BitEncodedInt(static_cast<int>(id));
+        stream.WriteString("entity");
+    }
+
+    /// Reads back what WriteEntity() wrote. Returns the id, so the reads can't be optimized away.
+    uint32_t ReadEntity(BinaryStream& stream) {
+        uint32_t id = stream.ReadBool() + stream.ReadBool() + stream.ReadBool();
+        id += stream.ReadUInt32();
+        id += stream.ReadUInt16();
+        id += static_cast<uint32_t>(stream.ReadUInt64());
+        id += static_cast<uint32_t>(stream.Read7BitEncodedInt());
+        id += static_cast<uint32_t>(stream.ReadString().size());
+        return id;
+    }
+
+    /// Returns a header like the one in front of a datagram during a bulk transfer in both directions.
+    DatagramHeader MakeDatagramHeader(size_t acks, size_t nacks) {
+        DatagramHeader header;
+        header.flag_data = true;
+        header.flag_link = true;
+        header.datagramID = 123456;
+        header.dataLength = 1200;
+
+        // acks mostly come in runs of consecutive ids
+        for (size_t i = 0; i < acks; i++)
+            header.acks.push_back(static_cast<DatagramID>(1000 + i));
+        for (size_t i = 0; i < nacks; i++)
+            header.nacks.push_back(static_cast<DatagramID>(900 + i * 3));
+
+        return header;
+    }
+
+    /// Returns a header like the one in front of one segment of a split packet.
+    PacketHeader MakePacketHeader(bool segment) {
+        PacketHeader header;
+        header.id = 4242;
+        header.options = PacketOptions::RELIABLE;
+        header.channel = 1;
+        header.sequence = 77;
+        header.length = segment ? 1100 : 64;
+        if (segment) {
+            header.flag_segment = true;
+            header.offset = 11000;
+            header.splitContainer = 4200;
+            header.splitIndex = 10;
+        }
+
+        return header;
+    }
+
+}
+
+TEST_CASE("BinaryStream reads and writes", "[Serialize]") {
+    // a datagram's worth of entity updates
+    constexpr uint32_t entities = 40;
+
+    BinaryStream stream;
+    for (uint32_t i = 0; i < entities; i++)
+        WriteEntity(stream, i);
+    const size_t length = stream.GetLength();
+    std::cout << entities << " entities take " << length << " bytes" << std::endl;
+
+    BENCHMARK("Write " + std::to_string(entities) + " entities") {
+        stream.Clear();
+        for (uint32_t i = 0; i < entities; i++)
+            WriteEntity(stream, i);
+    }
+
+    uint32_t sum = 0;
+    BENCHMARK("Read " + std::to_string(entities) + " entities") {
+        stream.SeekToBegin();
+        for (uint32_t i = 0; i < entities; i++)
+            sum += ReadEntity(stream);
+    }
+    CHECK(sum != 0);
+
+    for (size_t size : {64, 1200, 16384}) {
+        const std::vector<uint8_t> bytes(size, 0xAB);
+        std::vector<uint8_t> out(size);
+
+        BENCHMARK("Write and read " + std::to_string(size) + " bytes at once") {
+            stream.Clear();
+            stream.WriteBytes(bytes.data(), bytes.size());
+            stream.SeekToBegin();
+            stream.ReadBytes(out.data(), out.size());
+        }
+    }
+
+    BENCHMARK("Write 1200 bytes one at a time") {
+        stream.Clear();
+        for (int i = 0; i < 1200; i++)
+            stream.WriteByte(static_cast<uint8_t>(i));
+    }
+}
+
+TEST_CASE("Datagram header codec", "[Serialize]") {
+    const std::pair<size_t, size_t> ackCounts[] = {{0, 0}, {4, 0}, {32, 4}, {DatagramHeader::MAX_ACKS, 16}};
+
+    BinaryStream stream;
+    for (const auto& counts : ackCounts) {
+        const auto header = MakeDatagramHeader(counts.first, counts.second);
+        const auto suffix = ", " + std::to_string(counts.first) + " acks and " + std::to_string(counts.second) + " nacks";
+
+        // Deserialize() only succeeds once the payload is there as well
+        BinaryStream datagram;
+        header.Serialize(datagram);
+        datagram.WriteZeroes(header.dataLength);
+        datagram.SeekToBegin();
+        DatagramHeader parsed;
+        REQUIRE(parsed.Deserialize(datagram));
+        REQUIRE(parsed.acks == header.acks);
+        REQUIRE(parsed.nacks == header.nacks);
+
+        BENCHMARK("DatagramHeader::Serialize" + suffix) {
+            stream.Clear();
+            header.Serialize(stream);
+        }
+
+        BENCHMARK("DatagramHeader::Deserialize" + suffix) {
+            datagram.SeekToBegin();
+            parsed.Deserialize(datagram);
+        }
+    }
+}
+
+TEST_CASE("Packet header codec", "[Serialize]") {
+    BinaryStream stream;
+    for (bool segment : {false, true}) {
+        const auto header = MakePacketHeader(segment);
+        const std::string suffix = segment ? ", segment of a split packet" : ", whole packet";
+
+        stream.Clear();
+        header.Serialize(stream);
+        stream.SeekToBegin();
+        PacketHeader parsed;
+        REQUIRE(parsed.Deserialize(stream));
+        REQUIRE(parsed.splitIndex == header.splitIndex);
+
+        BENCHMARK("PacketHeader::Serialize" + suffix) {
+            stream.Clear();
+            header.Serialize(stream);
+        }
+
+        BENCHMARK("PacketHeader::Deserialize" + suffix) {
+            stream.SeekToBegin();
+            parsed.Deserialize(stream);
+        }
+    }
+}
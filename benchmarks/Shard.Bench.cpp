@@ -0,0 +1,88 @@
+#include <catch2/catch.hpp>
+#include "BenchUtil.h"
+
+using namespace wirefox;
+
+namespace {
+
+    constexpr size_t CLIENTS = 16;
+    constexpr uint16_t PORT = 41320;
+
+    /// Connects \p count clients to a server on localhost, returns false if not all of them got in.
+    bool ConnectClients(IPeer& server, uint16_t port, std::vector<std::unique_ptr<IPeer>>& clients, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            clients.push_back(IPeer::Factory::Create(1));
+            if (!clients.back()->Bind(SocketProtocol::IPv4, 0)) return false;
+            if (clients.back()->Connect("127.0.0.1", port) != ConnectAttemptResult::OK) return false;
+        }
+
+        const auto timeout = Time::Now() + Time::FromSeconds(5);
+        size_t connected = 0;
+        while (connected < count && !Time::Elapsed(timeout)) {
+            while (server.Receive()) {}
+            for (auto& client : clients) {
+                if (auto packet = client->Receive())
+                    if (packet->GetCommand() == PacketCommand::NOTIFY_CONNECT_SUCCESS)
+                        connected++;
+            }
+            std::this_thread::yield();
+        }
+
+        return connected == count;
+    }
+
+}
+
+TEST_CASE("Aggregate datagram rate", "[Shard]") {
+    for (size_t shards : {1, 2, 4, 8}) {
+        const uint16_t port = static_cast<uint16_t>(PORT + shards);
+        auto server = IPeer::Factory::CreateSharded(CLIENTS, shards);
+        REQUIRE(server->Bind(SocketProtocol::IPv4, port));
+        server->SetMaximumIncomingPeers(CLIENTS);
+
+        std::vector<std::unique_ptr<IPeer>> clients;
+        REQUIRE(ConnectClients(*server, port, clients, CLIENTS));
+
+        // drain the server on a thread of its own, like an application's network thread would
+        std::atomic_bool done(false);
+        std::atomic<size_t> received(0);
+        std::thread drain([&] {
+            while (!done) {
+                if (auto packet = server->Receive()) {
+                    if (packet->GetCommand() == PacketCommand::USER_PACKET)
+                        received++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        uint8_t payload[64] = {};
+        Packet message(PacketCommand::USER_PACKET, payload, sizeof payload);
+        const auto start = std::chrono::steady_clock::now();
+        const auto finish = Time::Now() + Time::FromSeconds(1);
+        size_t sent = 0;
+        while (!Time::Elapsed(finish)) {
+            for (auto& client : clients) {
+                client->Send(message, server->GetMyPeerID(), PacketOptions::UNRELIABLE);
+                sent++;
+            }
+            std::this_thread::yield();
+        }
+
+        // give the last datagrams a moment to arrive
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        const size_t total = received;
+        std::cout << shards << " shard(s): " << static_cast<size_t>(total / seconds.count()) << " packets/s received, "
+            << total << " of " << sent << " sent" << std::endl;
+
+        // silence the clients before the server forgets them, so it isn't flooded with datagrams it can't place
+        for (auto& client : clients)
+            client->Stop();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        done = true;
+        drain.join();
+        server->Stop();
+    }
+}
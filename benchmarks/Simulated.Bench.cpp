@@ -0,0 +1,169 @@
+#include <catch2/catch.hpp>
+#include "BenchUtil.h"
+#include "SimulatedNetwork.h"
+#include "SocketSimulated.h"
+
+using namespace wirefox;
+using namespace wirefox::detail;
+
+namespace {
+
+    constexpr uint16_t SERVER_PORT = 41400;
+    constexpr uint64_t SEED = 0x5EED;
+    constexpr size_t PACKET_SIZE = 4000;
+    constexpr size_t PACKET_COUNT = 100;
+
+    /// Ping-pongs datagrams between two sockets on a network with a manual clock, and returns the time and sender of
+    /// every delivery, in order.
+    std::vector<std::pair<Timestamp, RemoteAddress>> RecordTrace(uint64_t seed, const SimulatedNetwork::LinkConditions& conditions,
+        SimulatedNetwork::LinkStats& stats) {
+        auto network = std::make_shared<SimulatedNetwork>(seed, true);
+        network->SetDefaultConditions(conditions);
+
+        auto a = SocketSimulated::Create(network);
+        auto b = SocketSimulated::Create(network);
+        REQUIRE(a->Bind(SocketProtocol::IPv4, SERVER_PORT));
+        REQUIRE(b->Bind(SocketProtocol::IPv4, 0));
+
+        RemoteAddress toA, toB;
+        REQUIRE(a->Resolve("127.0.0.1", b->GetLocalPort(), toB));
+        REQUIRE(b->Resolve("127.0.0.1", SERVER_PORT, toA));
+
+        // every delivery is answered right away, so later sends depend on what happened to earlier ones
+        std::vector<std::pair<Timestamp, RemoteAddress>> trace;
+        uint8_t payload[512] = {};
+        const auto echo = [&](Socket* socket, const RemoteAddress& to) {
+            return [&, socket, to](bool, RemoteAddress sender, BufferPool::Handle, size_t) {
+                trace.emplace_back(network->Now(), sender);
+                socket->BeginWrite(to, payload, sizeof payload, [](bool, size_t) {});
+            };
+        };
+        a->BeginRead(echo(a.get(), toB));
+        b->BeginRead(echo(b.get(), toA));
+        network->Advance(0);
+
+        for (int i = 0; i < 1000; i++) {
+            b->BeginWrite(toA, payload, sizeof payload, [](bool, size_t) {});
+            network->Advance(Time::FromMilliseconds(1));
+        }
+        network->Advance(Time::FromSeconds(1));
+
+        stats = network->GetReceiveStats(SERVER_PORT);
+        return trace;
+    }
+
+    /// Sends reliable packets from one peer to another, and returns how many arrived within 30 seconds.
+    size_t Transfer(IPeer& sender, PeerID recipient, IPeer& receiver, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            BinaryStream payload;
+            payload.WriteZeroes(PACKET_SIZE);
+            sender.Send(Packet(PacketCommand::USER_PACKET, std::move(payload)), recipient, PacketOptions::RELIABLE);
+        }
+
+        size_t received = 0;
+        const auto timeout = Time::Now() + Time::FromSeconds(30);
+        while (received < count && !Time::Elapsed(timeout)) {
+            while (auto packet = receiver.Receive())
+                received += packet->GetCommand() == PacketCommand::USER_PACKET;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return received;
+    }
+
+}
+
+TEST_CASE("Simulated network is reproducible", "[Simulated]") {
+    SimulatedNetwork::LinkConditions conditions;
+    conditions.bandwidth = 1024 * 1024;
+    conditions.queueLimit = 16 * 1024;
+    conditions.delay = Time::FromMilliseconds(20);
+    conditions.jitter = Time::FromMilliseconds(5);
+    conditions.loss = 0.02;
+    conditions.burstStart = 0.01;
+    conditions.burstEnd = 0.3;
+    conditions.reorder = 0.05;
+    conditions.reorderDelay = Time::FromMilliseconds(10);
+
+    SimulatedNetwork::LinkStats first, second, other;
+    const auto traceFirst = RecordTrace(SEED, conditions, first);
+    const auto traceSecond = RecordTrace(SEED, conditions, second);
+    const auto traceOther = RecordTrace(SEED + 1, conditions, other);
+
+    std::cout << "Simulated link into the server: " << first.sent << " sent, " << first.delivered << " delivered, "
+        << first.lost << " lost, " << first.queueDrops << " dropped by the queue, " << first.reordered << " reordered; "
+        << traceFirst.size() << " deliveries in total" << std::endl;
+
+    CHECK(traceFirst == traceSecond);
+    CHECK(traceFirst != traceOther);
+    CHECK(first.lost > 0);
+    CHECK(first.reordered > 0);
+}
+
+TEST_CASE("Reliable transfer over simulated links", "[Simulated]") {
+    struct Profile {
+        const char* name;
+        SimulatedNetwork::LinkConditions conditions;
+    };
+
+    std::vector<Profile> profiles(5);
+    profiles[0].name = "clean";
+    profiles[0].conditions.bandwidth = 10 * 1024 * 1024;
+    profiles[0].conditions.delay = Time::FromMilliseconds(10);
+
+    profiles[1].name = "2% loss, jitter";
+    profiles[1].conditions = profiles[0].conditions;
+    profiles[1].conditions.loss = 0.02;
+    profiles[1].conditions.jitter = Time::FromMilliseconds(5);
+
+    profiles[2].name = "loss bursts";
+    profiles[2].conditions = profiles[0].conditions;
+    profiles[2].conditions.burstStart = 0.01;
+    profiles[2].conditions.burstEnd = 0.5;
+
+    profiles[3].name = "5% reordered";
+    profiles[3].conditions = profiles[0].conditions;
+    profiles[3].conditions.reorder = 0.05;
+    profiles[3].conditions.reorderDelay = Time::FromMilliseconds(15);
+
+    profiles[4].name = "small queue";
+    profiles[4].conditions = profiles[0].conditions;
+    profiles[4].conditions.queueLimit = 32 * 1024;
+
+    // printed at the end, so it doesn't get mixed up with the output of the peers
+    std::ostringstream results;
+
+    for (const auto& profile : profiles) {
+        auto network = std::make_shared<SimulatedNetwork>(SEED);
+        network->SetDefaultConditions(profile.conditions);
+
+        Peer server(1, SocketSimulated::Create(network));
+        auto clientSocket = SocketSimulated::Create(network);
+        Peer client(1, clientSocket);
+        server.SetMaximumIncomingPeers(1);
+        REQUIRE(server.Bind(SocketProtocol::IPv4, SERVER_PORT));
+        REQUIRE(client.Bind(SocketProtocol::IPv4, 0));
+        REQUIRE(static_cast<IPeer&>(client).Connect("127.0.0.1", SERVER_PORT) == ConnectAttemptResult::OK);
+
+        PeerID serverID = 0;
+        REQUIRE(bench::WaitFor(client, PacketCommand::NOTIFY_CONNECT_SUCCESS, PacketCommand::NOTIFY_CONNECT_FAILED, 10, serverID) == PacketCommand::NOTIFY_CONNECT_SUCCESS);
+
+        const auto before = network->GetLinkStats(clientSocket->GetLocalPort(), SERVER_PORT);
+        const auto start = std::chrono::steady_clock::now();
+        const size_t received = Transfer(client, serverID, server, PACKET_COUNT);
+
+        const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        const auto* stats = client.GetStats(serverID);
+        REQUIRE(stats != nullptr);
+        const auto link = network->GetLinkStats(clientSocket->GetLocalPort(), SERVER_PORT);
+        results << "Simulated " << profile.name << ": " << received << "/" << PACKET_COUNT << " packets in "
+            << seconds.count() * 1000 << " ms, " << PACKET_COUNT * PACKET_SIZE / seconds.count() / (1024 * 1024) << " MB/s goodput, "
+            << stats->Get(PeerStatID::PACKETS_LOST) << " packets deemed lost; link lost " << link.lost - before.lost
+            << ", dropped " << link.queueDrops - before.queueDrops << " and reordered " << link.reordered - before.reordered
+            << " of " << link.sent - before.sent << " datagrams" << std::endl;
+
+        CHECK(received == PACKET_COUNT);
+    }
+
+    std::cout << results.str();
+}
@@ -0,0 +1,197 @@
+#include <catch2/catch.hpp>
+#include "BenchUtil.h"
+#include "SocketIoUring.h"
+#include "SocketSharedMemory.h"
+#include "AwaitableEvent.h"
+
+using namespace wirefox;
+using namespace wirefox::detail;
+
+namespace {
+
+    constexpr uint16_t PORT = 41340;
+    constexpr size_t SENDERS = 4;
+    constexpr size_t WINDOW = 64;
+    constexpr size_t ROUND_TRIPS = 20000;
+
+    /// Blasts datagrams from several threads at a socket of the same kind for a second, and prints the rates.
+    void MeasureDatagramRate(const char* name, const std::function<std::shared_ptr<Socket>()>& create, uint16_t port) {
+        auto receiver = create();
+        auto sender = create();
+        REQUIRE(receiver->Bind(SocketProtocol::IPv4, port));
+        REQUIRE(sender->Bind(SocketProtocol::IPv4, 0));
+
+        std::atomic<size_t> received(0);
+        receiver->BeginRead([&](bool error, RemoteAddress, BufferPool::Handle, size_t) {
+            if (!error) received++;
+        });
+
+        RemoteAddress addr;
+        REQUIRE(sender->Resolve("127.0.0.1", port, addr));
+
+        // each thread keeps a limited number of writes in flight, like PacketQueue does per remote
+        uint8_t payload[64] = {};
+        std::atomic_bool done(false);
+        std::atomic<size_t> sent(0);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < SENDERS; i++) {
+            threads.emplace_back([&] {
+                std::atomic<size_t> inflight(0);
+                while (!done) {
+                    if (inflight >= WINDOW) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    inflight++;
+                    sender->BeginWrite(addr, payload, sizeof payload, [&](bool error, size_t) {
+                        if (!error) sent++;
+                        inflight--;
+                    });
+                }
+
+                while (inflight > 0)
+                    std::this_thread::yield();
+            });
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        done = true;
+        for (auto& thread : threads)
+            thread.join();
+
+        // give the last datagrams a moment to arrive
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        const size_t total = received;
+        std::cout << name << ": " << static_cast<size_t>(total / seconds.count()) << " datagrams/s received, "
+            << total << " of " << sent.load() << " sent, " << receiver->GetReceiveDrops() << " dropped by the receiver, "
+            << sender->GetSendBlocked() << " sends blocked" << std::endl;
+
+        sender->Unbind();
+        receiver->Unbind();
+    }
+
+    /// Streams MTU-sized datagrams in batches, like PacketQueue does during a bulk transfer, and prints the throughput
+    /// and how much CPU time it took.
+    void MeasureBulkRate(const char* name, const std::function<std::shared_ptr<Socket>()>& create, size_t batch, uint16_t port) {
+        auto receiver = create();
+        auto sender = create();
+        REQUIRE(receiver->Bind(SocketProtocol::IPv4, port));
+        REQUIRE(sender->Bind(SocketProtocol::IPv4, 0));
+
+        std::atomic<size_t> received(0);
+        receiver->BeginRead([&](bool error, RemoteAddress, BufferPool::Handle, size_t transferred) {
+            if (!error) received += transferred;
+        });
+
+        RemoteAddress addr;
+        REQUIRE(sender->Resolve("127.0.0.1", port, addr));
+
+        std::vector<uint8_t> payload(cfg::MTU * batch);
+        std::vector<Socket::WriteBuffer> datagrams;
+        for (size_t i = 0; i < batch; i++)
+            datagrams.push_back({ payload.data() + i * cfg::MTU, cfg::MTU });
+
+        // one batch in flight at a time, like for a single remote
+        const auto start = std::chrono::steady_clock::now();
+        const auto cpuStart = std::clock();
+        AwaitableEvent written;
+        while (std::chrono::steady_clock::now() - start < std::chrono::seconds(1)) {
+            sender->BeginWriteBatch(addr, datagrams, [&](bool, size_t) {
+                written.Signal();
+            });
+            written.Wait();
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const double cpu = static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        const double megabytes = received.load() / 1e6;
+        const std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << static_cast<size_t>(megabytes / seconds.count()) << " MB/s received, "
+            << static_cast<size_t>(cpu * 1e6 / std::max(megabytes, 1.0)) << " us of CPU time per MB" << std::endl;
+
+        sender->Unbind();
+        receiver->Unbind();
+    }
+
+    /// Bounces a small datagram back and forth between two sockets of the same kind, and prints the average round trip.
+    void MeasureRoundTrip(const char* name, const std::function<std::shared_ptr<Socket>()>& create, uint16_t port) {
+        auto client = create();
+        auto server = create();
+        REQUIRE(client->Bind(SocketProtocol::IPv4, port));
+        REQUIRE(server->Bind(SocketProtocol::IPv4, port + 1));
+
+        // the server echoes every datagram from the buffer it arrived in, which must stay alive until it's written
+        server->BeginRead([&](bool error, RemoteAddress sender, BufferPool::Handle buffer, size_t transferred) {
+            if (error) return;
+            server->BeginWrite(sender, buffer.get(), transferred, [buffer](bool, size_t) {});
+        });
+
+        AwaitableEvent replied;
+        client->BeginRead([&](bool error, RemoteAddress, BufferPool::Handle, size_t) {
+            if (!error) replied.Signal();
+        });
+
+        RemoteAddress addr;
+        REQUIRE(client->Resolve("127.0.0.1", port + 1, addr));
+
+        uint8_t payload[64] = {};
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < ROUND_TRIPS; i++) {
+            client->BeginWrite(addr, payload, sizeof payload, [](bool, size_t) {});
+            replied.Wait();
+        }
+
+        const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << elapsed.count() / ROUND_TRIPS << " us per round trip" << std::endl;
+
+        client->Unbind();
+        server->Unbind();
+    }
+
+}
+
+TEST_CASE("Socket datagram rate", "[Socket]") {
+    MeasureDatagramRate("asio", [] { return SocketUDP::Create(); }, PORT);
+
+#ifdef WIREFOX_ENABLE_IO_URING
+    if (SocketIoUring::Create()) {
+        MeasureDatagramRate("io_uring", [] { return SocketIoUring::Create(); }, PORT + 1);
+    } else {
+        WARN("io_uring is not available on this system");
+    }
+#endif
+
+#ifdef WIREFOX_ENABLE_SHARED_MEMORY
+    MeasureDatagramRate("shared memory", [] { return SocketSharedMemory::Create(); }, PORT + 4);
+#endif
+}
+
+TEST_CASE("Socket bulk transfer rate", "[Socket]") {
+    // on Linux, batches are segmented and coalesced by the kernel
+    MeasureBulkRate("one by one", [] { return SocketUDP::Create(); }, 1, PORT + 2);
+    MeasureBulkRate("batched", [] { return SocketUDP::Create(); }, cfg::SEND_BATCH_DATAGRAMS, PORT + 3);
+
+#ifdef WIREFOX_ENABLE_SHARED_MEMORY
+    // shared memory skips the kernel altogether, so this is what same-host peers would get instead of loopback UDP
+    MeasureBulkRate("shared memory batched", [] { return SocketSharedMemory::Create(); }, cfg::SEND_BATCH_DATAGRAMS, PORT + 3);
+#endif
+}
+
+TEST_CASE("Socket round trip latency", "[Socket]") {
+    MeasureRoundTrip("asio", [] { return SocketUDP::Create(); }, PORT + 5);
+
+#ifdef WIREFOX_ENABLE_IO_URING
+    if (SocketIoUring::Create()) {
+        MeasureRoundTrip("io_uring", [] { return SocketIoUring::Create(); }, PORT + 7);
+    } else {
+        WARN("io_uring is not available on this system");
+    }
+#endif
+
+#ifdef WIREFOX_ENABLE_SHARED_MEMORY
+    MeasureRoundTrip("shared memory", [] { return SocketSharedMemory::Create(); }, PORT + 9);
+#endif
+}
@@ -0,0 +1,323 @@
+#include <Wirefox.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+using namespace wirefox;
+
+namespace {
+
+    constexpr size_t HEADER_SIZE = sizeof(uint64_t) + sizeof(uint32_t);
+    constexpr int CONNECT_TIMEOUT = 10;
+    constexpr int DRAIN_TIMEOUT = 5;
+
+    struct Options {
+        size_t          receivers = 1;
+        size_t          size = 64;
+        size_t          rate = 0;           // messages per second to each receiver, or zero for as fast as the queue drains
+        size_t          window = 64;        // without a rate, how many messages may be on their way to a receiver
+        double          seconds = 5;
+        bool            reliable = true;
+        ChannelMode     channel = ChannelMode::UNORDERED;
+        bool            encrypt = false;
+        SocketBackend   backend = SocketBackend::DEFAULT;
+        uint16_t        port = 41500;
+    };
+
+    /// What the receiving side saw, filled in by the receiver thread.
+    struct Results {
+        explicit Results(size_t receivers)
+            : next(receivers) {
+            for (auto& n : next)
+                n = 0;
+        }
+
+        std::atomic<size_t>     received{0};
+        std::vector<std::atomic<size_t>> next;  // per receiver, one past the highest sequence number that arrived
+        std::vector<uint64_t>   latencies;  // one-way, in nanoseconds
+        size_t                  bytes = 0;
+        Timestamp               last;
+    };
+
+    void PrintUsage() {
+        std::cerr << "Usage: wirefox-bench [options]" << std::endl
+            << "  -receivers <n>     number of Peers the sender sends every message to (default 1)" << std::endl
+            << "  -size <bytes>      payload size of each message, at least " << HEADER_SIZE << " (default 64)" << std::endl
+            << "  -rate <n>          messages per second to each receiver, 0 to send as fast as possible (default 0)" << std::endl
+            << "  -window <n>        without a rate, messages that may be on their way to a receiver at once (default 64)" << std::endl
+            << "  -seconds <s>       how long to send for (default 5)" << std::endl
+            << "  -unreliable        send unreliable messages instead of reliable ones" << std::endl
+            << "  -channel <mode>    unordered, ordered or sequenced (default unordered)" << std::endl
+            << "  -encrypt           enable encryption, if the library was built with it" << std::endl
+            << "  -backend <name>    default, io_uring or shared_memory (default default)" << std::endl
+            << "  -port <port>       port the sender listens on (default 41500)" << std::endl
+            << "Prints a single JSON object with the results to stdout." << std::endl;
+    }
+
+    const char* ToString(ChannelMode mode) {
+        switch (mode) {
+        case ChannelMode::ORDERED: return "ordered";
+        case ChannelMode::SEQUENCED: return "sequenced";
+        default: return "unordered";
+        }
+    }
+
+    const char* ToString(SocketBackend backend) {
+        switch (backend) {
+        case SocketBackend::IO_URING: return "io_uring";
+        case SocketBackend::SHARED_MEMORY: return "shared_memory";
+        default: return "default";
+        }
+    }
+
+    bool ParseOptions(int argc, const char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            const bool hasValue = i + 1 < argc;
+            if (strcmp(argv[i], "-unreliable") == 0) {
+                options.reliable = false;
+            } else if (strcmp(argv[i], "-encrypt") == 0) {
+                options.encrypt = true;
+            } else if (!hasValue) {
+                std::cerr << "Error: unknown option or missing argument: " << argv[i] << std::endl;
+                return false;
+            } else if (strcmp(argv[i], "-receivers") == 0) {
+                options.receivers = static_cast<size_t>(atoll(argv[++i]));
+            } else if (strcmp(argv[i], "-size") == 0) {
+                options.size = static_cast<size_t>(atoll(argv[++i]));
+            } else if (strcmp(argv[i], "-rate") == 0) {
+                options.rate = static_cast<size_t>(atoll(argv[++i]));
+            } else if (strcmp(argv[i], "-window") == 0) {
+                options.window = static_cast<size_t>(atoll(argv[++i]));
+            } else if (strcmp(argv[i], "-seconds") == 0) {
+                options.seconds = atof(argv[++i]);
+            } else if (strcmp(argv[i], "-port") == 0) {
+                options.port = static_cast<uint16_t>(atoi(argv[++i]));
+            } else if (strcmp(argv[i], "-channel") == 0) {
+                const std::string mode = argv[++i];
+                if (mode == "unordered") options.channel = ChannelMode::UNORDERED;
+                else if (mode == "ordered") options.channel = ChannelMode::ORDERED;
+                else if (mode == "sequenced") options.channel = ChannelMode::SEQUENCED;
+                else {
+                    std::cerr << "Error: unknown channel mode: " << mode << std::endl;
+                    return false;
+                }
+            } else if (strcmp(argv[i], "-backend") == 0) {
+                const std::string backend = argv[++i];
+                if (backend == "default") options.backend = SocketBackend::DEFAULT;
+                else if (backend == "io_uring") options.backend = SocketBackend::IO_URING;
+                else if (backend == "shared_memory") options.backend = SocketBackend::SHARED_MEMORY;
+                else {
+                    std::cerr << "Error: unknown socket backend: " << backend << std::endl;
+                    return false;
+                }
+            } else {
+                std::cerr << "Error: unknown option: " << argv[i] << std::endl;
+                return false;
+            }
+        }
+
+        if (options.receivers == 0 || options.size < HEADER_SIZE || options.seconds <= 0 || options.window == 0) {
+            std::cerr << "Error: -receivers, -seconds and -window must be positive, and -size at least " << HEADER_SIZE << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    /// Returns the latency below which the given fraction of all samples lie, in microseconds. Sorts the samples.
+    double Percentile(std::vector<uint64_t>& samples, double fraction) {
+        if (samples.empty()) return 0;
+
+        const auto index = std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()));
+        std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+        return samples[index] / 1000.0;
+    }
+
+    /// Waits until every receiver has connected to the sender, and returns the PeerIDs the sender knows them by.
+    bool ConnectAll(IPeer& sender, uint16_t port, std::vector<std::unique_ptr<IPeer>>& receivers, std::vector<PeerID>& ids) {
+        for (auto& receiver : receivers) {
+            if (receiver->Connect("127.0.0.1", port) != ConnectAttemptResult::OK)
+                return false;
+        }
+
+        size_t connected = 0;
+        const auto timeout = Time::Now() + Time::FromSeconds(CONNECT_TIMEOUT);
+        while ((connected < receivers.size() || ids.size() < receivers.size()) && !Time::Elapsed(timeout)) {
+            for (auto& receiver : receivers) {
+                while (auto packet = receiver->Receive()) {
+                    if (packet->GetCommand() == PacketCommand::NOTIFY_CONNECT_SUCCESS)
+                        connected++;
+                    else if (packet->GetCommand() == PacketCommand::NOTIFY_CONNECT_FAILED)
+                        return false;
+                }
+            }
+
+            while (auto packet = sender.Receive()) {
+                if (packet->GetCommand() == PacketCommand::NOTIFY_CONNECTION_INCOMING)
+                    ids.push_back(packet->GetSender());
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return connected == receivers.size() && ids.size() == receivers.size();
+    }
+
+}
+
+int main(int argc, const char** argv) {
+    if (argc > 1 && strcmp(argv[1], "-help") == 0) {
+        PrintUsage();
+        return EXIT_SUCCESS;
+    }
+
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    // one sender fans out to all receivers; with a single receiver, that's a plain pair
+    auto sender = IPeer::Factory::Create(options.receivers, options.backend);
+    sender->SetMaximumIncomingPeers(options.receivers);
+    sender->SetEncryptionEnabled(options.encrypt);
+    if (options.encrypt && !sender->GetEncryptionEnabled()) {
+        std::cerr << "Error: this build of Wirefox does not support encryption" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (!sender->Bind(SocketProtocol::IPv4, options.port)) {
+        std::cerr << "Error: failed to bind port " << options.port << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::unique_ptr<IPeer>> receivers;
+    for (size_t i = 0; i < options.receivers; i++) {
+        receivers.push_back(IPeer::Factory::Create(1, options.backend));
+        receivers.back()->SetEncryptionEnabled(options.encrypt);
+        if (!receivers.back()->Bind(SocketProtocol::IPv4, 0)) {
+            std::cerr << "Error: failed to bind a receiver" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // channel modes are a local setting, so both sides must create the same channels in the same order
+    Channel channel;
+    if (options.channel != ChannelMode::UNORDERED) {
+        channel = sender->MakeChannel(options.channel);
+        for (auto& receiver : receivers)
+            receiver->MakeChannel(options.channel);
+    }
+
+    std::vector<PeerID> recipients;
+    if (!ConnectAll(*sender, options.port, receivers, recipients)) {
+        std::cerr << "Error: not all receivers could connect" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // every message carries the time it was sent, which the receivers compare against the same steady clock
+    Results results(receivers.size());
+    results.latencies.reserve(options.rate > 0
+        ? static_cast<size_t>(options.rate * options.seconds * options.receivers) : 1024 * 1024);
+    std::atomic_bool stop(false);
+    std::thread receiverThread([&]() {
+        while (!stop) {
+            bool idle = true;
+            for (size_t i = 0; i < receivers.size(); i++) {
+                while (auto packet = receivers[i]->Receive()) {
+                    if (packet->GetCommand() != PacketCommand::USER_PACKET) continue;
+
+                    const auto now = Time::Now();
+                    auto instream = packet->GetStream();
+                    const uint64_t sent = instream.ReadUInt64();
+                    const size_t sequence = instream.ReadUInt32();
+                    results.latencies.push_back(Time::Between(Timestamp(sent), now));
+                    results.next[i] = std::max<size_t>(results.next[i], sequence + 1);
+                    results.bytes += packet->GetLength();
+                    results.last = now;
+                    results.received++;
+                    idle = false;
+                }
+            }
+
+            if (idle)
+                std::this_thread::yield();
+        }
+    });
+
+    const PacketOptions reliability = options.reliable ? PacketOptions::RELIABLE : PacketOptions::UNRELIABLE;
+    const auto start = Time::Now();
+    const auto end = start + static_cast<Timespan>(options.seconds * 1e9);
+    size_t sent = 0;
+    while (!Time::Elapsed(end)) {
+        if (options.rate > 0) {
+            // pace messages evenly, and catch up after a hiccup rather than skipping any
+            const auto due = start + static_cast<Timespan>(sent * 1e9 / options.rate);
+            if (!Time::Elapsed(due)) {
+                std::this_thread::yield();
+                continue;
+            }
+        } else {
+            // the slowest receiver holds everyone back, so messages don't pile up in queues. going by the highest sequence
+            // number that arrived, rather than a count, means messages that were dropped don't take up the window forever
+            size_t arrived = sent;
+            for (const auto& next : results.next)
+                arrived = std::min<size_t>(arrived, next);
+            if (sent - arrived >= options.window) {
+                std::this_thread::yield();
+                continue;
+            }
+        }
+
+        BinaryStream payload(options.size);
+        payload.WriteInt64(static_cast<uint64_t>(Time::Now()));
+        payload.WriteInt32(static_cast<uint32_t>(sent));
+        payload.WriteZeroes(options.size - HEADER_SIZE);
+        sender->Send(Packet(PacketCommand::USER_PACKET, std::move(payload)), recipients, reliability, PacketPriority::MEDIUM, channel);
+        sent++;
+
+        // notifications aren't needed, but shouldn't pile up either
+        while (sender->Receive()) {}
+    }
+
+    // give messages still on their way a chance to arrive
+    const size_t expected = sent * options.receivers;
+    const auto drain = Time::Now() + Time::FromSeconds(DRAIN_TIMEOUT);
+    while (results.received < expected && !Time::Elapsed(drain))
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    stop = true;
+    receiverThread.join();
+
+    const double seconds = results.last.IsValid() ? Time::Between(start, results.last) / 1e9 : options.seconds;
+    const size_t received = results.received;
+
+    std::cout << std::fixed << std::setprecision(3)
+        << "{\"receivers\":" << options.receivers
+        << ",\"size\":" << options.size
+        << ",\"rate\":" << options.rate
+        << ",\"seconds\":" << options.seconds
+        << ",\"reliable\":" << (options.reliable ? "true" : "false")
+        << ",\"channel\":\"" << ToString(options.channel) << "\""
+        << ",\"encrypt\":" << (options.encrypt ? "true" : "false")
+        << ",\"backend\":\"" << ToString(options.backend) << "\""
+        << ",\"sent\":" << expected
+        << ",\"received\":" << received
+        << ",\"msgs_per_sec\":" << received / seconds
+        << ",\"mb_per_sec\":" << results.bytes / seconds / (1024 * 1024)
+        << ",\"latency_us\":{\"p50\":" << Percentile(results.latencies, 0.5)
+        << ",\"p99\":" << Percentile(results.latencies, 0.99)
+        << ",\"p999\":" << Percentile(results.latencies, 0.999)
+        << ",\"max\":" << Percentile(results.latencies, 1)
+        << "}}" << std::endl;
+
+    sender->Stop();
+    for (auto& receiver : receivers)
+        receiver->Stop();
+
+    return received > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,599 @@
+#include "PCH.h"
+#include "Peer.h"
+#include "SocketUDP.h"
+#include "UpdateThread.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace wirefox;
+using namespace wirefox::detail;
+
+namespace {
+
+    constexpr size_t HEADER_SIZE = sizeof(uint64_t) + sizeof(uint32_t);
+    constexpr int CONNECT_TIMEOUT = 60;
+    constexpr int SETTLE_MILLISECONDS = 1000;
+    constexpr int DRAIN_MILLISECONDS = 2000;
+
+    /// The traffic the clients and the server exchange during a phase.
+    enum class Pattern {
+        /// Nothing but what the library sends to keep connections alive.
+        IDLE,
+        /// Every client sends a message every interval, and the server sends it straight back.
+        ECHO_REPLY,
+        /// The server sends one message to every client every interval, like a game state update.
+        BROADCAST
+    };
+
+    struct Options {
+        size_t          clients = 1000;
+        std::vector<Pattern> script{Pattern::IDLE, Pattern::ECHO_REPLY, Pattern::BROADCAST};
+        unsigned        interval = 100;     // milliseconds between messages from each client, or from the server
+        size_t          size = 32;
+        double          seconds = 10;       // per phase
+        size_t          connectWindow = 128; // handshakes in progress at once
+        bool            encrypt = false;
+        uint16_t        port = 41600;
+    };
+
+    /// What the server process reports about itself when asked.
+    struct ServerSample {
+        uint64_t        cpu = 0;            // user and system time, in microseconds
+        uint64_t        rss = 0;            // resident memory, in bytes
+        uint64_t        connected = 0;
+        uint64_t        sent = 0;           // messages broadcast to clients so far
+    };
+
+    /// Commands the client process sends to the server process.
+    enum ServerCommand : char {
+        COMMAND_SAMPLE = 's',
+        COMMAND_START_BROADCAST = 'b',
+        COMMAND_STOP_BROADCAST = 'e',
+        COMMAND_QUIT = 'q'
+    };
+
+    /// What the clients saw during one phase of the script.
+    struct PhaseResults {
+        Pattern         pattern = Pattern::IDLE;
+        double          seconds = 0;
+        size_t          sent = 0;
+        size_t          received = 0;
+        size_t          lost = 0;           // connections that dropped
+        std::vector<uint64_t> latencies;    // in nanoseconds
+        ServerSample    before;
+        ServerSample    after;
+        uint64_t        clientCpu = 0;
+    };
+
+    void PrintUsage() {
+        std::cerr << "Usage: wirefox-soak [options]" << std::endl
+            << "  -clients <n>       number of client Peers to connect to the server (default 1000)" << std::endl
+            << "  -script <phases>   comma-separated list of idle, echo and broadcast (default idle,echo,broadcast)" << std::endl
+            << "  -interval <ms>     time between messages from each client, or from the server (default 100)" << std::endl
+            << "  -size <bytes>      payload size of each message, at least " << HEADER_SIZE << " (default 32)" << std::endl
+            << "  -seconds <s>       how long each phase lasts (default 10)" << std::endl
+            << "  -connect-window <n> handshakes that may be in progress at once (default 128)" << std::endl
+            << "  -encrypt           enable encryption, if the library was built with it" << std::endl
+            << "  -port <port>       port the server listens on (default 41600)" << std::endl
+            << "The server runs in a child process, so its CPU time and memory can be measured on their own." << std::endl
+            << "Prints a single JSON object with the results to stdout." << std::endl;
+    }
+
+    const char* ToString(Pattern pattern) {
+        switch (pattern) {
+        case Pattern::ECHO_REPLY: return "echo";
+        case Pattern::BROADCAST: return "broadcast";
+        default: return "idle";
+        }
+    }
+
+    bool ParsePattern(const std::string& name, Pattern& pattern) {
+        if (name == "idle") pattern = Pattern::IDLE;
+        else if (name == "echo") pattern = Pattern::ECHO_REPLY;
+        else if (name == "broadcast") pattern = Pattern::BROADCAST;
+        else return false;
+
+        return true;
+    }
+
+    bool ParseOptions(int argc, const char** argv, Options& options) {
+        for (int i = 1; i < argc; i++) {
+            const bool hasValue = i + 1 < argc;
+            if (strcmp(argv[i], "-encrypt") == 0) {
+                options.encrypt = true;
+            } else if (!hasValue) {
+                std::cerr << "Error: unknown option or missing argument: " << argv[i] << std::endl;
+                return false;
+            } else if (strcmp(argv[i], "-clients") == 0) {
+                options.clients = static_cast<size_t>(atoll(argv[++i]));
+            } else if (strcmp(argv[i], "-interval") == 0) {
+                options.interval = static_cast<unsigned>(atoi(argv[++i]));
+            } else if (strcmp(argv[i], "-size") == 0) {
+                options.size = static_cast<size_t>(atoll(argv[++i]));
+            } else if (strcmp(argv[i], "-seconds") == 0) {
+                options.seconds = atof(argv[++i]);
+            } else if (strcmp(argv[i], "-connect-window") == 0) {
+                options.connectWindow = static_cast<size_t>(atoll(argv[++i]));
+            } else if (strcmp(argv[i], "-port") == 0) {
+                options.port = static_cast<uint16_t>(atoi(argv[++i]));
+            } else if (strcmp(argv[i], "-script") == 0) {
+                options.script.clear();
+                std::istringstream phases(argv[++i]);
+                std::string name;
+                while (std::getline(phases, name, ',')) {
+                    Pattern pattern;
+                    if (!ParsePattern(name, pattern)) {
+                        std::cerr << "Error: unknown traffic pattern: " << name << std::endl;
+                        return false;
+                    }
+                    options.script.push_back(pattern);
+                }
+            } else {
+                std::cerr << "Error: unknown option: " << argv[i] << std::endl;
+                return false;
+            }
+        }
+
+        if (options.clients == 0 || options.script.empty() || options.interval == 0 || options.seconds <= 0
+            || options.connectWindow == 0 || options.size < HEADER_SIZE) {
+            std::cerr << "Error: -clients, -script, -interval, -seconds and -connect-window must be positive, and -size at least "
+                << HEADER_SIZE << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    /// Returns the sample below which the given fraction of all samples lie, in microseconds. Sorts the samples.
+    double Percentile(std::vector<uint64_t>& samples, double fraction) {
+        if (samples.empty()) return 0;
+
+        const auto index = std::min(samples.size() - 1, static_cast<size_t>(fraction * samples.size()));
+        std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+        return samples[index] / 1000.0;
+    }
+
+    /// Returns the user and system time this process has used so far, in microseconds.
+    uint64_t GetProcessCpu() {
+        rusage usage = {};
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<uint64_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+            + static_cast<uint64_t>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+    }
+
+    /// Returns how much memory this process currently has resident, or its peak if the system doesn't say.
+    uint64_t GetProcessMemory() {
+        std::ifstream statm("/proc/self/statm");
+        uint64_t size = 0, resident = 0;
+        if (statm >> size >> resident)
+            return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+        rusage usage = {};
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+    }
+
+    /// Writes a message with the current time and a sequence number in front.
+    Packet MakeMessage(size_t size, uint32_t sequence) {
+        BinaryStream payload(size);
+        payload.WriteInt64(static_cast<uint64_t>(Time::Now()));
+        payload.WriteInt32(sequence);
+        payload.WriteZeroes(size - HEADER_SIZE);
+        return Packet(PacketCommand::USER_PACKET, std::move(payload));
+    }
+
+    /// Runs the server until told to quit. Reads commands from \p commands, and answers samples on \p replies.
+    int RunServer(const Options& options, int commands, int replies) {
+        Peer server(options.clients);
+        IPeer& peer = server;
+        peer.SetMaximumIncomingPeers(options.clients);
+        peer.SetEncryptionEnabled(options.encrypt);
+
+        // every client comes from the same loopback address, which would normally be taken for a flood
+        server.SetConnectRateLimit(1000000, 1000000);
+
+        const char ready = peer.Bind(SocketProtocol::IPv4, options.port) ? 1 : 0;
+        if (write(replies, &ready, sizeof ready) != sizeof ready || !ready)
+            return EXIT_FAILURE;
+
+        std::vector<PeerID> clients;
+        bool broadcast = false;
+        uint64_t sent = 0;
+        uint32_t sequence = 0;
+        Timestamp nextBroadcast = Time::Now();
+        pollfd command = {commands, POLLIN, 0};
+
+        while (true) {
+            bool idle = true;
+            while (auto packet = peer.Receive()) {
+                idle = false;
+                switch (packet->GetCommand()) {
+                case PacketCommand::NOTIFY_CONNECTION_INCOMING:
+                    clients.push_back(packet->GetSender());
+                    break;
+                case PacketCommand::NOTIFY_CONNECTION_LOST:
+                case PacketCommand::NOTIFY_DISCONNECTED:
+                    clients.erase(std::remove(clients.begin(), clients.end(), packet->GetSender()), clients.end());
+                    break;
+                case PacketCommand::USER_PACKET:
+                    // clients only send during an echo phase. the message keeps their timestamp, so they measure the round trip
+                    peer.Send(*packet, packet->GetSender(), PacketOptions::RELIABLE);
+                    break;
+                default:
+                    break;
+                }
+            }
+
+            if (broadcast && Time::Elapsed(nextBroadcast)) {
+                nextBroadcast = nextBroadcast + Time::FromMilliseconds(options.interval);
+                sent += peer.Send(MakeMessage(options.size, sequence++), clients, PacketOptions::RELIABLE);
+                idle = false;
+            }
+
+            // a game server would sleep until its next frame as well, so that shows up in the baseline
+            if (poll(&command, 1, idle ? 1 : 0) <= 0)
+                continue;
+
+            char cmd;
+            if (read(commands, &cmd, sizeof cmd) != sizeof cmd || cmd == COMMAND_QUIT)
+                break;
+
+            switch (cmd) {
+            case COMMAND_START_BROADCAST:
+                broadcast = true;
+                nextBroadcast = Time::Now();
+                break;
+            case COMMAND_STOP_BROADCAST:
+                broadcast = false;
+                break;
+            case COMMAND_SAMPLE: {
+                ServerSample sample;
+                sample.cpu = GetProcessCpu();
+                sample.rss = GetProcessMemory();
+                sample.connected = clients.size();
+                sample.sent = sent;
+                if (write(replies, &sample, sizeof sample) != sizeof sample)
+                    return EXIT_FAILURE;
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        peer.Stop();
+        return EXIT_SUCCESS;
+    }
+
+    /// Talks to the server process.
+    class ServerProcess {
+    public:
+        ServerProcess(pid_t pid, int commands, int replies)
+            : m_pid(pid)
+            , m_commands(commands)
+            , m_replies(replies) {}
+
+        ~ServerProcess() {
+            Send(COMMAND_QUIT);
+            close(m_commands);
+            close(m_replies);
+
+            int status = 0;
+            waitpid(m_pid, &status, 0);
+            if (WIFSIGNALED(status))
+                std::cerr << "Error: the server process was killed by signal " << WTERMSIG(status) << std::endl;
+        }
+
+        bool Send(ServerCommand command) {
+            const char cmd = command;
+            return write(m_commands, &cmd, sizeof cmd) == sizeof cmd;
+        }
+
+        bool WaitReady() {
+            char ready = 0;
+            return read(m_replies, &ready, sizeof ready) == sizeof ready && ready;
+        }
+
+        ServerSample Sample() {
+            ServerSample sample;
+            if (!Send(COMMAND_SAMPLE) || read(m_replies, &sample, sizeof sample) != sizeof sample)
+                std::cerr << "Error: the server process stopped responding" << std::endl;
+            return sample;
+        }
+
+    private:
+        pid_t   m_pid;
+        int     m_commands;
+        int     m_replies;
+    };
+
+    /// The clients, and the two threads they all share: one runs their sockets, the other their periodic updates. That way
+    /// thousands of clients don't need thousands of threads.
+    struct ClientEngine {
+        ClientEngine()
+            : context(std::make_shared<asio::io_context>())
+            , work(asio::make_work_guard(*context))
+            , updater(std::make_shared<UpdateThread>()) {
+            thread = std::thread([this] { context->run(); });
+        }
+
+        ~ClientEngine() {
+            // the clients' sockets wait for the context to finish their handlers, so it must keep running until they're gone
+            clients.clear();
+            updater.reset();
+            work.reset();
+            thread.join();
+        }
+
+        std::shared_ptr<asio::io_context> context;
+        asio::executor_work_guard<asio::io_context::executor_type> work;
+        std::shared_ptr<UpdateThread> updater;
+        std::thread thread;
+        std::vector<std::unique_ptr<Peer>> clients;
+    };
+
+    /// Connects every client to the server, no more than a window at a time. Returns each client's PeerID for the
+    /// server, or 0 if it failed, and the time each handshake took.
+    std::vector<PeerID> ConnectAll(std::vector<std::unique_ptr<Peer>>& clients, const Options& options,
+        std::vector<uint64_t>& durations) {
+        std::vector<PeerID> servers(clients.size(), 0);
+        std::vector<Timestamp> started(clients.size());
+        size_t next = 0, done = 0;
+
+        const auto timeout = Time::Now() + Time::FromSeconds(CONNECT_TIMEOUT);
+        while (done < clients.size() && !Time::Elapsed(timeout)) {
+            while (next < clients.size() && next - done < options.connectWindow) {
+                started[next] = Time::Now();
+                if (static_cast<IPeer&>(*clients[next]).Connect("127.0.0.1", options.port) != ConnectAttemptResult::OK)
+                    done++;
+                next++;
+            }
+
+            for (size_t i = 0; i < next; i++) {
+                while (auto packet = clients[i]->Receive()) {
+                    if (packet->GetCommand() == PacketCommand::NOTIFY_CONNECT_SUCCESS) {
+                        durations.push_back(Time::Between(started[i], Time::Now()));
+                        servers[i] = packet->GetSender();
+                        done++;
+                    } else if (packet->GetCommand() == PacketCommand::NOTIFY_CONNECT_FAILED) {
+                        done++;
+                    }
+                }
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return servers;
+    }
+
+    /// Runs one phase of the script on the client side, and measures what the clients and the server do meanwhile.
+    PhaseResults RunPhase(Pattern pattern, std::vector<std::unique_ptr<Peer>>& clients, std::vector<PeerID>& servers,
+        ServerProcess& server, const Options& options) {
+        PhaseResults results;
+        results.pattern = pattern;
+
+        const auto receive = [&](size_t i) {
+            while (auto packet = clients[i]->Receive()) {
+                switch (packet->GetCommand()) {
+                case PacketCommand::USER_PACKET: {
+                    const auto now = Time::Now();
+                    auto instream = packet->GetStream();
+                    results.latencies.push_back(Time::Between(Timestamp(instream.ReadUInt64()), now));
+                    results.received++;
+                    break;
+                }
+                case PacketCommand::NOTIFY_CONNECTION_LOST:
+                case PacketCommand::NOTIFY_DISCONNECTED:
+                    servers[i] = 0;
+                    results.lost++;
+                    break;
+                default:
+                    break;
+                }
+            }
+        };
+
+        results.before = server.Sample();
+        if (pattern == Pattern::BROADCAST)
+            server.Send(COMMAND_START_BROADCAST);
+
+        // spread the clients' messages evenly across the interval, as real clients wouldn't all send at once
+        const Timespan interval = Time::FromMilliseconds(options.interval);
+        std::vector<Timestamp> due(clients.size());
+        const auto start = Time::Now();
+        for (size_t i = 0; i < clients.size(); i++)
+            due[i] = start + interval * i / clients.size();
+
+        const uint64_t clientCpu = GetProcessCpu();
+        const auto end = start + static_cast<Timespan>(options.seconds * 1e9);
+        uint32_t sequence = 0;
+
+        while (!Time::Elapsed(end)) {
+            for (size_t i = 0; i < clients.size(); i++) {
+                if (servers[i] == 0) continue;
+
+                if (pattern == Pattern::ECHO_REPLY && Time::Elapsed(due[i])) {
+                    due[i] = due[i] + interval;
+                    static_cast<IPeer&>(*clients[i]).Send(MakeMessage(options.size, sequence++), servers[i], PacketOptions::RELIABLE);
+                    results.sent++;
+                }
+
+                receive(i);
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        if (pattern == Pattern::BROADCAST)
+            server.Send(COMMAND_STOP_BROADCAST);
+        results.after = server.Sample();
+        results.clientCpu = GetProcessCpu() - clientCpu;
+        results.seconds = Time::Between(start, Time::Now()) / 1e9;
+
+        // what the server sent is counted on its side
+        if (pattern == Pattern::BROADCAST)
+            results.sent = results.after.sent - results.before.sent;
+
+        // messages still on their way belong to this phase, not the next
+        const auto drain = Time::Now() + Time::FromMilliseconds(DRAIN_MILLISECONDS);
+        while (results.received < results.sent && !Time::Elapsed(drain)) {
+            for (size_t i = 0; i < clients.size(); i++)
+                receive(i);
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return results;
+    }
+
+}
+
+int main(int argc, const char** argv) {
+    if (argc > 1 && strcmp(argv[1], "-help") == 0) {
+        PrintUsage();
+        return EXIT_SUCCESS;
+    }
+
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return EXIT_FAILURE;
+    }
+
+    // every client has a socket of its own
+    rlimit files = {};
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    // if the server process dies, say so rather than being killed by the next command sent to it
+    signal(SIGPIPE, SIG_IGN);
+
+    // fork before any threads are started, so the server process starts out clean
+    int commands[2], replies[2];
+    if (pipe(commands) != 0 || pipe(replies) != 0) {
+        std::cerr << "Error: failed to create pipes" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const pid_t pid = fork();
+    if (pid < 0) {
+        std::cerr << "Error: failed to start the server process" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (pid == 0) {
+        close(commands[1]);
+        close(replies[0]);
+        _exit(RunServer(options, commands[0], replies[1]));
+    }
+
+    close(commands[0]);
+    close(replies[1]);
+    ServerProcess server(pid, commands[1], replies[0]);
+    if (!server.WaitReady()) {
+        std::cerr << "Error: the server failed to bind port " << options.port << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // the server's cost of doing nothing, which is subtracted before dividing the rest among the clients
+    const auto baselineStart = server.Sample();
+    std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_MILLISECONDS));
+    const auto baseline = server.Sample();
+    const double baselineCpu = static_cast<double>(baseline.cpu - baselineStart.cpu) / (SETTLE_MILLISECONDS * 1000);
+
+    ClientEngine engine;
+    auto& clients = engine.clients;
+    const uint64_t clientMemoryBefore = GetProcessMemory();
+    clients.reserve(options.clients);
+    for (size_t i = 0; i < options.clients; i++) {
+        auto client = std::make_unique<Peer>(1, SocketUDP::Create(engine.context), engine.updater);
+        client->SetHandshakeThreads(0);
+        client->SetEncryptionEnabled(options.encrypt);
+        if (options.encrypt && !client->GetEncryptionEnabled()) {
+            std::cerr << "Error: this build of Wirefox does not support encryption" << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        if (!client->Bind(SocketProtocol::IPv4, 0)) {
+            std::cerr << "Error: failed to bind client " << i << std::endl;
+            return EXIT_FAILURE;
+        }
+        clients.push_back(std::move(client));
+    }
+
+    std::vector<uint64_t> connectDurations;
+    connectDurations.reserve(options.clients);
+    const auto connectStart = Time::Now();
+    auto servers = ConnectAll(clients, options, connectDurations);
+    const double connectSeconds = Time::Between(connectStart, Time::Now()) / 1e9;
+    const size_t connected = connectDurations.size();
+    const uint64_t clientMemoryAfter = GetProcessMemory();
+
+    // let handshake leftovers settle before measuring what the connections themselves take up
+    std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_MILLISECONDS));
+    const auto afterConnect = server.Sample();
+
+    std::vector<PhaseResults> phases;
+    for (auto pattern : options.script)
+        phases.push_back(RunPhase(pattern, clients, servers, server, options));
+
+    const double perClient = connected > 0 ? 1.0 / connected : 0;
+    std::cout << std::fixed << std::setprecision(3)
+        << "{\"clients\":" << options.clients
+        << ",\"interval_ms\":" << options.interval
+        << ",\"size\":" << options.size
+        << ",\"seconds\":" << options.seconds
+        << ",\"encrypt\":" << (options.encrypt ? "true" : "false")
+        << ",\"connect\":{\"connected\":" << connected
+        << ",\"failed\":" << options.clients - connected
+        << ",\"seconds\":" << connectSeconds
+        << ",\"per_sec\":" << connected / connectSeconds
+        << ",\"ms\":{\"p50\":" << Percentile(connectDurations, 0.5) / 1000
+        << ",\"p99\":" << Percentile(connectDurations, 0.99) / 1000
+        << ",\"max\":" << Percentile(connectDurations, 1) / 1000
+        << "}}"
+        << ",\"server\":{\"baseline_rss_mb\":" << baseline.rss / (1024.0 * 1024)
+        << ",\"baseline_cpu_percent\":" << baselineCpu * 100
+        << ",\"connected\":" << afterConnect.connected
+        << ",\"rss_per_client_kb\":" << (static_cast<double>(afterConnect.rss) - baseline.rss) * perClient / 1024
+        << "}"
+        << ",\"client_rss_per_client_kb\":" << (static_cast<double>(clientMemoryAfter) - clientMemoryBefore) / options.clients / 1024
+        << ",\"phases\":[";
+
+    for (size_t i = 0; i < phases.size(); i++) {
+        auto& phase = phases[i];
+        const double serverCpu = static_cast<double>(phase.after.cpu - phase.before.cpu) / (phase.seconds * 1e6);
+        std::cout << (i > 0 ? "," : "")
+            << "{\"pattern\":\"" << ToString(phase.pattern) << "\""
+            << ",\"sent\":" << phase.sent
+            << ",\"received\":" << phase.received
+            << ",\"lost_connections\":" << phase.lost
+            << ",\"server_cpu_percent\":" << serverCpu * 100
+            << ",\"server_cpu_us_per_client_per_sec\":" << std::max(0.0, serverCpu - baselineCpu) * 1e6 * perClient
+            << ",\"server_rss_per_client_kb\":" << (static_cast<double>(phase.after.rss) - baseline.rss) * perClient / 1024
+            << ",\"client_cpu_percent\":" << phase.clientCpu / (phase.seconds * 1e4)
+            << ",\"latency\":\"" << (phase.pattern == Pattern::ECHO_REPLY ? "round_trip" : phase.pattern == Pattern::BROADCAST ? "one_way" : "none") << "\""
+            << ",\"latency_us\":{\"p50\":" << Percentile(phase.latencies, 0.5)
+            << ",\"p99\":" << Percentile(phase.latencies, 0.99)
+            << ",\"p999\":" << Percentile(phase.latencies, 0.999)
+            << ",\"max\":" << Percentile(phase.latencies, 1)
+            << "}}";
+    }
+    std::cout << "]}" << std::endl;
+
+    return connected == options.clients ? EXIT_SUCCESS : EXIT_FAILURE;
+}
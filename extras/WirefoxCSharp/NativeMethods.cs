@@ -44,6 +44,9 @@ namespace Iridinite.Wirefox {
         [DllImport(LIBRARY_NAME, CallingConvention = LIBRARY_CALL)]
         public static extern TPacketID wirefox_peer_send(IntPtr handle, IntPtr packet, TPeerID recipient, PacketOptions options, PacketPriority priority, TChannelIndex channelIndex);
 
+        [DllImport(LIBRARY_NAME, CallingConvention = LIBRARY_CALL)]
+        public static extern UIntPtr wirefox_peer_send_many(IntPtr handle, IntPtr packet, TPeerID[] recipients, [MarshalAs(UnmanagedType.SysUInt)] UIntPtr count, PacketOptions options, PacketPriority priority, TChannelIndex channelIndex);
+
         [DllImport(LIBRARY_NAME, CallingConvention = LIBRARY_CALL)]
         public static extern void wirefox_peer_send_loopback(IntPtr handle, IntPtr packet);
 
@@ -113,6 +116,19 @@ namespace Iridinite.Wirefox {
         [DllImport(LIBRARY_NAME, CallingConvention = LIBRARY_CALL)]
         public static extern void wirefox_peer_generate_crypto_identity(IntPtr handle, IntPtr key_secret, IntPtr key_public);
 
+        [DllImport(LIBRARY_NAME, CallingConvention = LIBRARY_CALL)]
+        [return: MarshalAs(UnmanagedType.SysUInt)]
+        public static extern UIntPtr wirefox_peer_get_worker_threads(IntPtr handle);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = LIBRARY_CALL)]
+        public static extern void wirefox_peer_set_worker_threads(IntPtr handle, [MarshalAs(UnmanagedType.SysUInt)] UIntPtr count);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = LIBRARY_CALL)]
+        public static extern void wirefox_peer_set_socket_buffer_sizes(IntPtr handle, [MarshalAs(UnmanagedType.SysUInt)] UIntPtr receive, [MarshalAs(UnmanagedType.SysUInt)] UIntPtr send);
+
+        [DllImport(LIBRARY_NAME, CallingConvention = LIBRARY_CALL)]
+        public static extern void wirefox_peer_get_socket_buffer_sizes(IntPtr handle, out UIntPtr receive, out UIntPtr send);
+
         [DllImport(LIBRARY_NAME, CallingConvention = LIBRARY_CALL)]
         public static extern IntPtr wirefox_packet_create(byte command, IntPtr data, [MarshalAs(UnmanagedType.SysUInt)] UIntPtr len);
 
@@ -80,6 +80,14 @@ namespace Iridinite.Wirefox {
             return NativeMethods.wirefox_peer_send(m_handle, packet.GetHandle(), recipient, options, priority, 0);
         }
 
+        public int Send(Packet packet, PeerID[] recipients, PacketOptions options, PacketPriority priority = PacketPriority.MEDIUM) {
+            var ids = new ulong[recipients.Length];
+            for (var i = 0; i < recipients.Length; i++)
+                ids[i] = recipients[i];
+
+            return (int) NativeMethods.wirefox_peer_send_many(m_handle, packet.GetHandle(), ids, new UIntPtr((uint) ids.Length), options, priority, 0);
+        }
+
         public void SendLoopback(Packet packet) {
             NativeMethods.wirefox_peer_send_loopback(m_handle, packet.GetHandle());
         }
@@ -213,6 +221,25 @@ namespace Iridinite.Wirefox {
             }
         }
 
+        public int GetWorkerThreads() {
+            return (int) NativeMethods.wirefox_peer_get_worker_threads(m_handle);
+        }
+
+        public void SetWorkerThreads(int count) {
+            NativeMethods.wirefox_peer_set_worker_threads(m_handle, (UIntPtr) count);
+        }
+
+        public void SetSocketBufferSizes(int receive, int send) {
+            NativeMethods.wirefox_peer_set_socket_buffer_sizes(m_handle, (UIntPtr) receive, (UIntPtr) send);
+        }
+
+        public void GetSocketBufferSizes(out int receive, out int send) {
+            UIntPtr r, s;
+            NativeMethods.wirefox_peer_get_socket_buffer_sizes(m_handle, out r, out s);
+            receive = (int) r;
+            send = (int) s;
+        }
+
         public static string ConnectResultToString(ConnectResult cr) {
             switch (cr) {
                 case ConnectResult.OK:
@@ -23,6 +23,7 @@
 #include <thread>
 #include <mutex>
 #include <functional>
+#include <memory>
 #include <random>
 
 #include <wirefox/WirefoxConfig.h>
@@ -36,6 +36,17 @@ namespace wirefox {
      */
     class WIREFOX_API BinaryStream {
     public:
+        /// Frees a buffer that was yielded by ReleaseAllocatedBuffer(), by returning it to the allocator it came from.
+        struct WIREFOX_API BufferDeleter {
+            size_t capacity = 0;    ///< The size of the allocation, in bytes.
+
+            /// Frees \p buffer.
+            void operator()(uint8_t* buffer) const noexcept;
+        };
+
+        /// Represents an owning pointer to a buffer yielded by ReleaseAllocatedBuffer().
+        using BufferPtr = std::unique_ptr<uint8_t[], BufferDeleter>;
+
         /// Specifies how a BinaryStream should wrap a user data buffer.
         enum class WrapMode {
             COPY,           ///< The user buffer should be copied, so it becomes writable.
@@ -138,6 +149,17 @@ namespace wirefox {
          */
         std::unique_ptr<uint8_t[]> ReleaseBuffer(size_t* length = nullptr) noexcept;
 
+        /**
+         * \internal
+         * \brief Yield ownership of the internal buffer, without copying it out of the Wirefox allocator.
+         * 
+         * Works like ReleaseBuffer(), except the buffer must be freed through the returned pointer's deleter, not with
+         * \p delete[]. ReleaseBuffer() copies the buffer onto the heap to allow for the latter.
+         * 
+         * \param[out]  length      If not \p nullptr, the buffer's length in bytes will be written here
+         */
+        BufferPtr       ReleaseAllocatedBuffer(size_t* length = nullptr) noexcept;
+
         /**
          * \brief Checks if the end of the stream has been reached.
          * 
@@ -148,7 +170,7 @@ namespace wirefox {
          * 
          * \param[in]   read    The number of bytes you intend to read from the current position onward
          */
-        bool            IsEOF(const size_t read = 1) const noexcept { return m_position > (m_length - read); }
+        bool            IsEOF(const size_t read = 1) const noexcept { return read > m_length || m_position > (m_length - read); }
 
         /**
          * \brief Checks whether this stream is read-only.
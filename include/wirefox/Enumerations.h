@@ -73,6 +73,16 @@ namespace wirefox {
         IPv6
     };
 
+    /// Selects the implementation a peer uses to send and receive datagrams.
+    enum class SocketBackend {
+        /// The portable socket implementation for the platform.
+        DEFAULT,
+        /// Linux io_uring. Falls back to DEFAULT if the library or the running kernel doesn't support it.
+        IO_URING,
+        /// Ring buffers in shared memory, which only reach peers on the same host that use this backend as well. Falls back to DEFAULT if the library doesn't support it.
+        SHARED_MEMORY
+    };
+
     /// Indicates which party initiated a handshake (or connection).
     enum class ConnectionOrigin {
         INVALID,    ///< Invalid setting. Used by Remote #0 to indicate no handshake.
@@ -20,6 +20,9 @@ namespace wirefox {
      * 
      * This object contains a message (datagram) that can be sent over or received from the network. Aside from raw data,
      * it also contains a PacketCommand, which describes the intended function of this packet.
+     * 
+     * The payload of a Packet is immutable once constructed, and is shared by reference count between copies of the same
+     * Packet. Copying a Packet, or queueing it for sending, therefore never duplicates the payload.
      */
     class Packet {
     public:
@@ -27,7 +30,7 @@ namespace wirefox {
         /// Note that it is fine to create Packets on the stack; this Factory is simply recommended when allocating on the heap.
         typedef detail::Factory<Packet> Factory;
 
-        /// Copy constructor. Creates a Packet that is a full copy of another Packet.
+        /// Copy constructor. Creates a Packet that shares the payload of another Packet.
         WIREFOX_API Packet(const Packet& other);
 
         /// Move constructor. Creates a Packet that takes ownership of another Packet's contents.
@@ -50,6 +53,11 @@ namespace wirefox {
         /// Move assignment operator.
         WIREFOX_API Packet&             operator=(Packet&& rhs) noexcept;
 
+        /// Allocates memory for a Packet from the Wirefox allocator, so the Factory doesn't need to hit the system heap.
+        WIREFOX_API static void*        operator new(size_t size);
+        /// Returns the memory of a Packet to the Wirefox allocator.
+        WIREFOX_API static void         operator delete(void* ptr, size_t size) noexcept;
+
         /// Returns the PacketCommand that was specified when this Packet was created.
         WIREFOX_API PacketCommand       GetCommand() const noexcept { return m_command; }
 
@@ -77,19 +85,51 @@ namespace wirefox {
         /// Sets the PeerID of the sender associated with this Packet.
         WIREFOX_API void                SetSender(PeerID sender) noexcept { m_sender = sender; }
 
+        /// [Internal use only.] Returns the reference-counted handle to the payload buffer.
+        const std::shared_ptr<const uint8_t>& GetSharedBuffer() const noexcept { return m_data; }
+
         /// [Internal use only.] Serializes this Packet to a BinaryStream.
         void                            ToDatagram(BinaryStream& outstream) const;
 
+        /**
+         * \brief [Internal use only.] Serializes a slice of this Packet, without copying the payload.
+         * 
+         * Writes the bytes in the range [\p offset, \p offset + \p length) of the serialized Packet (see ToDatagram()) that
+         * are not part of the payload to \p outstream. The remainder of the range is a slice of GetBuffer(), which is
+         * described by the return value and \p payloadOffset.
+         * 
+         * \param[out]  outstream       The stream that receives any leading non-payload bytes.
+         * \param[in]   offset          The offset into the serialized Packet at which the slice begins.
+         * \param[in]   length          The length of the slice, in bytes.
+         * \param[out]  payloadOffset   The offset into GetBuffer() at which the payload part of the slice begins.
+         * \returns     The number of payload bytes in the slice.
+         */
+        size_t                          ToDatagramSlice(BinaryStream& outstream, size_t offset, size_t length, size_t& payloadOffset) const;
+
         /// [Internal use only.] Deserializes and returns a new Packet from a BinaryStream.
         static Packet                   FromDatagram(PeerID sender, BinaryStream& instream, size_t len);
 
+        /**
+         * \brief [Internal use only.] Deserializes and returns a new Packet that references a slice of a shared buffer.
+         * 
+         * Unlike the other overload, the payload is not copied: the returned Packet points directly into the buffer
+         * wrapped by \p instream, and keeps \p backing alive for as long as the Packet (or any copy of it) exists.
+         * 
+         * \param[in]   sender      The PeerID of the remote that sent this Packet.
+         * \param[in]   instream    A stream positioned at the start of a serialized Packet. Must wrap the buffer owned by \p backing.
+         * \param[in]   len         The length of the serialized Packet, in bytes.
+         * \param[in]   backing     The reference-counted buffer that contains the bytes of \p instream.
+         */
+        static Packet                   FromDatagram(PeerID sender, BinaryStream& instream, size_t len, const std::shared_ptr<const uint8_t>& backing);
+
     private:
         Packet(PeerID sender, BinaryStream& instream, size_t len);
+        Packet(PeerID sender, BinaryStream& instream, size_t len, const std::shared_ptr<const uint8_t>& backing);
 
-        PeerID                      m_sender;
-        PacketCommand               m_command;
-        size_t                      m_length;
-        std::unique_ptr<uint8_t[]>  m_data;
+        PeerID                          m_sender;
+        PacketCommand                   m_command;
+        size_t                          m_length;
+        std::shared_ptr<const uint8_t>  m_data;
     };
 
 }
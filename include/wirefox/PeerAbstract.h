@@ -42,6 +42,31 @@ namespace wirefox {
             Factory() = delete;
             /// Creates a new instance of the IPeer interface.
             static std::unique_ptr<IPeer> Create(size_t maxPeers = 1);
+
+            /**
+             * \brief Creates a new instance of the IPeer interface that uses a specific socket implementation.
+             *
+             * If \p backend is not available on this system, the peer uses SocketBackend::DEFAULT instead.
+             *
+             * \param[in]   maxPeers    The maximum number of remotes.
+             * \param[in]   backend     The socket implementation to use.
+             */
+            static std::unique_ptr<IPeer> Create(size_t maxPeers, SocketBackend backend);
+
+            /**
+             * \brief Creates an IPeer that spreads its connections across several sockets and threads, for busy servers.
+             *
+             * Every shard is a socket of its own, bound to the same port, with its own threads. The operating system
+             * assigns each remote endpoint to one shard by address, so a server can use more than one CPU core for network
+             * work. The IPeer itself behaves as a single peer.
+             *
+             * A sharded peer only accepts connections; Connect() returns ConnectAttemptResult::INVALID_STATE. Sharing a
+             * port requires SO_REUSEPORT (e.g. Linux), elsewhere Bind() fails if \p shards is more than one.
+             *
+             * \param[in]   maxPeers    The maximum number of remotes, across all shards.
+             * \param[in]   shards      The number of sockets to open.
+             */
+            static std::unique_ptr<IPeer> CreateSharded(size_t maxPeers, size_t shards);
         };
 
     protected:
@@ -126,7 +151,7 @@ namespace wirefox {
          * This function fails silently if \p recipient is unknown or if \p packet exceeds the length limit
          * (cfg::PACKET_MAX_LENGTH). In either case, no send is queued.
          * 
-         * \param[in]   packet      The data you'd like to send. The data will be \b copied to an internal buffer.
+         * \param[in]   packet      The data you'd like to send. The payload is shared with \p packet by reference, not copied.
          * \param[in]   recipient   The remote peer who this data is addressed to.
          * \param[in]   options     A bitfield with reliability settings.
          * \param[in]   priority    Optional. Custom priority setting. Meaning is relative to other packets.
@@ -138,13 +163,33 @@ namespace wirefox {
                                              PacketPriority priority = PacketPriority::MEDIUM,
                                              const Channel& channel = Channel()) = 0;
 
+        /**
+         * \brief Send the same data to multiple remote hosts.
+         * 
+         * \returns The number of recipients the packet was queued for.
+         * 
+         * This is equivalent to calling Send() once for every recipient, but the packet is segmented only once, and all
+         * recipients share the same payload buffer. Prefer this function for broadcasting e.g. world state updates.
+         * Recipients that are unknown are skipped silently. Every recipient assigns its own PacketID, so if you need
+         * receipts (see PacketOptions::WITH_RECEIPT), use the single-recipient overload instead.
+         * 
+         * \param[in]   packet      The data you'd like to send. The payload is shared with \p packet by reference, not copied.
+         * \param[in]   recipients  The remote peers who this data is addressed to.
+         * \param[in]   options     A bitfield with reliability settings.
+         * \param[in]   priority    Optional. Custom priority setting. Meaning is relative to other packets.
+         * \param[in]   channel     Optional. Ordered and sequenced packets only wait for packets in the same channel.
+         */
+        virtual size_t                  Send(const Packet& packet, const std::vector<PeerID>& recipients, PacketOptions options,
+                                             PacketPriority priority = PacketPriority::MEDIUM,
+                                             const Channel& channel = Channel()) = 0;
+
         /**
          * \brief Add a Packet onto the incoming queue.
          * 
          * This is primarily useful for posting notifications to the local peer, or for requeueing a packet you
          * don't want to handle just yet.
          * 
-         * \param[in]   packet      The Packet to queue to the inbox. The data will be \b copied.
+         * \param[in]   packet      The Packet to queue to the inbox. The payload is shared with \p packet by reference.
          */
         virtual void                    SendLoopback(const Packet& packet) = 0;
 
@@ -250,6 +295,59 @@ namespace wirefox {
          */
         virtual size_t                  GetEncryptionKeyLength() const = 0;
 
+        /**
+         * \brief Gets the number of worker threads that encrypt, decrypt and process datagrams.
+         *
+         * If zero, this work is done on the network and packet queue threads instead.
+         */
+        virtual size_t                  GetWorkerThreads() const = 0;
+
+        /**
+         * \brief Sets the number of worker threads that encrypt, decrypt and process datagrams.
+         *
+         * Datagrams to and from different remote peers are handled in parallel, while those of any one remote peer
+         * are still handled in the order they were sent or received. This mostly pays off for servers with many
+         * encrypted connections. Default is cfg::WORKER_THREADS.
+         *
+         * This must be set \b before Bind() is called. If this peer is already bound, this function does nothing.
+         *
+         * \param[in]   count       The number of threads to start, or zero to disable the worker threads.
+         */
+        virtual void                    SetWorkerThreads(size_t count) = 0;
+
+        /**
+         * \brief Sets the sizes of the operating system's receive and send buffers for this peer's socket, in bytes.
+         *
+         * A larger receive buffer lets a server absorb bursts from many clients at once without the operating system
+         * dropping datagrams; see PeerStatID::SOCKET_RECEIVE_DROPS. Zero keeps the operating system's default. Defaults
+         * are cfg::SOCKET_RECEIVE_BUFFER and cfg::SOCKET_SEND_BUFFER.
+         *
+         * May be called before or after Bind(). The operating system may round or cap the sizes, e.g. Linux limits them
+         * to net.core.rmem_max and net.core.wmem_max unless the process has CAP_NET_ADMIN. Use GetSocketBufferSizes()
+         * to find out which sizes are in effect.
+         *
+         * \param[in]   receive     The size of the receive buffer, or zero to leave it unchanged.
+         * \param[in]   send        The size of the send buffer, or zero to leave it unchanged.
+         */
+        virtual void                    SetSocketBufferSizes(size_t receive, size_t send) = 0;
+
+        /**
+         * \brief Gets the sizes of the operating system's receive and send buffers in effect for this peer's socket.
+         *
+         * Both are zero if the peer is not bound, or the platform doesn't tell.
+         *
+         * \param[out]  receive     The size of the receive buffer, in bytes.
+         * \param[out]  send        The size of the send buffer, in bytes.
+         */
+        virtual void                    GetSocketBufferSizes(size_t& receive, size_t& send) const = 0;
+
+        /**
+         * \brief Gets the socket implementation this peer uses.
+         *
+         * This differs from the SocketBackend passed to Factory::Create() if that backend is not available.
+         */
+        virtual SocketBackend           GetSocketBackend() const = 0;
+
         /**
          * \brief Registers and returns a new Channel for your packets.
          * 
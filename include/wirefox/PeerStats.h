@@ -35,7 +35,16 @@ namespace wirefox {
         /// [Meant for debugging.] Total number of datagrams received from the remote endpoint, including retransmissions and system messages.
         DATAGRAMS_RECEIVED,
         /// [Meant for debugging.] Congestion window size, in bytes. This acts as an upper limit for BYTES_IN_FLIGHT.
-        CWND
+        CWND,
+        /// Total number of datagrams the operating system dropped because the socket's receive buffer was full. This counts
+        /// datagrams from all remotes that share the socket, so it's the same for each of them. Zero if the platform doesn't tell.
+        SOCKET_RECEIVE_DROPS,
+        /// Total number of datagrams that couldn't be sent right away because the socket's send buffer was full, and had to
+        /// wait for room. This counts datagrams to all remotes that share the socket, so it's the same for each of them.
+        SOCKET_SEND_BLOCKED,
+        /// The largest datagram, in bytes, that is currently sent to the remote endpoint. This starts out at the configured
+        /// MTU, and grows once path MTU discovery confirms that the network path to the remote can carry bigger ones.
+        PATH_MTU
     };
 
     /**
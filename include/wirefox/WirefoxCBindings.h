@@ -26,10 +26,12 @@ typedef uint8_t TChannelIndex;
 
 // Empty enums just to have types rather than ints in function signatures. I really don't want to duplicate
 // all enums here *again*. If you're actually writing C and need those enums, copy them from Enumerations.h.
-typedef enum { _DUMMY_1 } ESocketProtocol, EConnectAttemptResult, EChannelMode, EPeerStatID;
+typedef enum { _DUMMY_1 } ESocketProtocol, ESocketBackend, EConnectAttemptResult, EChannelMode, EPeerStatID;
 typedef enum : uint8_t { _DUMMY_2 } EPacketOptions, EPacketPriority;
 
 WIREFOX_API HWirefoxPeer*   wirefox_peer_create(size_t maxPeers);
+WIREFOX_API HWirefoxPeer*   wirefox_peer_create_with_backend(size_t maxPeers, ESocketBackend backend);
+WIREFOX_API HWirefoxPeer*   wirefox_peer_create_sharded(size_t maxPeers, size_t shards);
 WIREFOX_API void            wirefox_peer_destroy(HWirefoxPeer* handle);
 WIREFOX_API int             wirefox_peer_bind(HWirefoxPeer* handle, ESocketProtocol protocol, uint16_t port);
 WIREFOX_API void            wirefox_peer_stop(HWirefoxPeer* handle, unsigned linger);
@@ -40,6 +42,7 @@ WIREFOX_API void            wirefox_peer_disconnect_immediate(HWirefoxPeer* hand
 
 WIREFOX_API void            wirefox_peer_send_loopback(HWirefoxPeer* handle, HPacket* packet);
 WIREFOX_API TPacketID       wirefox_peer_send(HWirefoxPeer* handle, HPacket* packet, TPeerID recipient, EPacketOptions options, EPacketPriority priority, TChannelIndex channelIndex);
+WIREFOX_API size_t          wirefox_peer_send_many(HWirefoxPeer* handle, HPacket* packet, const TPeerID* recipients, size_t count, EPacketOptions options, EPacketPriority priority, TChannelIndex channelIndex);
 WIREFOX_API HPacket*        wirefox_peer_receive(HWirefoxPeer* handle);
 
 WIREFOX_API TChannelIndex   wirefox_peer_make_channel(HWirefoxPeer* handle, EChannelMode mode);
@@ -63,6 +66,11 @@ WIREFOX_API int             wirefox_peer_get_crypto_enabled(HWirefoxPeer* handle
 WIREFOX_API void            wirefox_peer_set_crypto_enabled(HWirefoxPeer* handle, int enabled);
 WIREFOX_API void            wirefox_peer_set_crypto_identity(HWirefoxPeer* handle, const uint8_t* key_secret, const uint8_t* key_public);
 WIREFOX_API void            wirefox_peer_generate_crypto_identity(HWirefoxPeer* handle, uint8_t* key_secret, uint8_t* key_public);
+WIREFOX_API size_t          wirefox_peer_get_worker_threads(HWirefoxPeer* handle);
+WIREFOX_API void            wirefox_peer_set_worker_threads(HWirefoxPeer* handle, size_t count);
+WIREFOX_API void            wirefox_peer_set_socket_buffer_sizes(HWirefoxPeer* handle, size_t receive, size_t send);
+WIREFOX_API void            wirefox_peer_get_socket_buffer_sizes(HWirefoxPeer* handle, size_t* receive, size_t* send);
+WIREFOX_API ESocketBackend  wirefox_peer_get_socket_backend(HWirefoxPeer* handle);
 
 WIREFOX_API HPacket*        wirefox_packet_create(uint8_t cmd, const uint8_t* data, size_t len);
 WIREFOX_API void            wirefox_packet_destroy(HPacket* handle);
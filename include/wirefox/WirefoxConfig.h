@@ -28,6 +28,9 @@ namespace wirefox {
         class SocketNX;
         class SocketUDP;
 
+        class AllocatorSlab;
+        class AllocatorHeap;
+
         struct RemoteAddressNX;
         struct RemoteAddressASIO;
     }
@@ -38,6 +41,10 @@ namespace wirefox {
     /// Represents a unique identifier for a datagram. A remote endpoint acknowledges received datagrams using its ID.
     using DatagramID = uint32_t;
 
+    /// Represents the identifier a peer issues for one of its connections. Its remote endpoint puts it in front of
+    /// every connected datagram, so the peer can find the connection without looking up the sender's address.
+    using ConnectionID = uint64_t;
+
     /// Represents a concrete channel number that will be sent between hosts.
     using ChannelIndex = uint8_t;
 
@@ -73,11 +80,14 @@ namespace wirefox {
         using DefaultEncryption = detail::EncryptionLayerNull;
 #endif
 
+        /// The allocator used for Packets and stream buffers. Changing this lets you easily swap out implementations.
+        using DefaultAllocator = detail::AllocatorSlab;
+
         /// Specifies a header that Handshaker should send (and receive), to confirm that both endpoints are running Wirefox.
         constexpr static uint8_t WIREFOX_MAGIC[] = {'W', 'I', 'R', 'E', 'F', 'O', 'X'};
 
         /// Specifies the current protocol version. Peers will reject connections with peers who have a mismatching protocol version.
-        constexpr static uint8_t WIREFOX_PROTOCOL_VERSION = 0;
+        constexpr static uint8_t WIREFOX_PROTOCOL_VERSION = 6;
 
         /**
          * \brief Sets the Maximum Transmission Unit: maximum length of a single outgoing datagram in bytes.
@@ -85,16 +95,103 @@ namespace wirefox {
          * Tweak this value with caution: if any intermediate network link cannot handle packets of this size,
          * then the packet may be fragmented (best case, but very slow), or outright discarded (worst case).
          * For reference, the maximum recommended size for Ethernet links is 1500 bytes, INCLUDING headers/overhead.
+         *
+         * Every connection starts out with datagrams of this size, and falls back to it if bigger ones stop arriving.
+         * Packets are also split into segments that fit in a datagram of this size. See also MTU_MAX.
          */
         constexpr static size_t MTU = 1300;
 
+        /**
+         * \brief Sets the largest datagram, in bytes, that path MTU discovery will try to send to a remote.
+         *
+         * Once connected, a Peer sends probes of increasing size to find out how big a datagram the network path to
+         * the remote can carry, and then packs more segments into each datagram. The default fits a 9000-byte jumbo
+         * frame, minus the IPv6 and UDP headers. Set this to MTU to disable path MTU discovery.
+         */
+        constexpr static size_t MTU_MAX = 8952;
+
+        /**
+         * \brief Sets how close, in bytes, path MTU discovery must get to the largest size the path can carry.
+         *
+         * The search stops once the largest confirmed size and the smallest size known to fail are less than this
+         * many bytes apart. Smaller values find a slightly larger size, but take more probes.
+         */
+        constexpr static size_t PMTU_SEARCH_GRANULARITY = 32;
+
+        /**
+         * \brief Sets how many probes of the same size must be lost before path MTU discovery considers it too big.
+         */
+        constexpr static unsigned int PMTU_PROBE_COUNT = 3;
+
+        /**
+         * \brief Sets how long, in seconds, path MTU discovery waits before checking whether a bigger size has become
+         * available, e.g. because the route to the remote changed.
+         */
+        constexpr static unsigned int PMTU_RAISE_INTERVAL = 600;
+
+        /**
+         * \brief Sets how many times a packet must be sent before path MTU discovery suspects that datagrams of the
+         * discovered size no longer arrive, and falls back to MTU. Must be less than SEND_RETRY_COUNT.
+         */
+        constexpr static unsigned int PMTU_BLACK_HOLE_RESENDS = 3;
+
         /**
          * \brief Sets the length of the incoming stream buffer in bytes.
          *
          * Larger values mean fewer round trips between the network stream and the packet manager,
-         * but require more memory for each active connection.
+         * but require more memory for each active connection. Must fit the largest datagram a remote may send.
+         */
+        constexpr static size_t PACKETQUEUE_IN_LEN = MTU_MAX;
+
+        /**
+         * \brief Sets the maximum number of idle receive buffers that are kept around for reuse.
+         *
+         * Received Packets reference the buffer their datagram was read into, rather than holding a copy, and the
+         * buffer is recycled once all of those Packets are destroyed. Higher values avoid allocations when many
+         * received Packets are alive at once, at the cost of holding on to up to PACKETQUEUE_IN_LEN bytes each.
+         */
+        constexpr static size_t RECEIVE_BUFFER_POOL_IDLE = 256;
+
+        /**
+         * \brief Sets how many receive operations a socket keeps posted at once.
+         *
+         * Each holds a buffer of PACKETQUEUE_IN_LEN bytes. When the socket becomes readable, a burst of up to this many
+         * datagrams is taken out of the kernel before any of them is processed, so the kernel's receive buffer is less
+         * likely to overflow while the network thread is busy. Must be less than IO_URING_QUEUE_DEPTH.
+         */
+        constexpr static size_t RECEIVE_POSTED_READS = 32;
+
+        /**
+         * \brief Sets the default size of the operating system's receive buffer for a socket, in bytes.
+         *
+         * Zero keeps the operating system's default. Can be changed per peer with IPeer::SetSocketBufferSizes().
+         */
+        constexpr static size_t SOCKET_RECEIVE_BUFFER = 0;
+
+        /**
+         * \brief Sets the default size of the operating system's send buffer for a socket, in bytes.
+         *
+         * Zero keeps the operating system's default. Can be changed per peer with IPeer::SetSocketBufferSizes().
+         */
+        constexpr static size_t SOCKET_SEND_BUFFER = 0;
+
+        /**
+         * \brief Sets the maximum number of datagrams that are handed to the socket together, for one remote.
+         *
+         * Where the operating system supports segmentation offload, a batch of datagrams of the same length is passed to
+         * the kernel in a single call, which saves a lot of CPU time during bulk transfers. Larger batches save more,
+         * but since they are written all at once, they may also hold up the datagrams for other remotes a bit longer.
+         */
+        constexpr static size_t SEND_BATCH_DATAGRAMS = 32;
+
+        /**
+         * \brief Sets the maximum number of out-of-band packets that can wait to be sent.
+         *
+         * Out-of-band packets are mostly replies to strangers, such as handshake cookies and rejections. Senders with
+         * spoofed addresses can ask for far more of those than the socket can send; when the queue is full, new ones
+         * are dropped rather than held for ever longer. Strangers that are honest will simply retry.
          */
-        constexpr static size_t PACKETQUEUE_IN_LEN = MTU;
+        constexpr static size_t PACKETQUEUE_OUT_OF_BAND_LEN = 256;
 
         /**
          * \brief Sets the slow-start threshold of the window-based congestion manager.
@@ -130,6 +227,45 @@ namespace wirefox {
          */
         constexpr static size_t BINARYSTREAM_DEFAULT_CAPACITY = 128;
 
+        /**
+         * \brief Sets the largest block size, in bytes, that AllocatorSlab serves from its pools.
+         *
+         * Larger requests are passed through to the system heap. Must be a power of two.
+         */
+        constexpr static size_t ALLOCATOR_SLAB_MAX_BLOCK = 65536;
+
+        /**
+         * \brief Sets the approximate number of bytes, per size class, that each thread caches in AllocatorSlab.
+         *
+         * Allocations served from the calling thread's cache need no locking. Higher values reduce contention on the
+         * shared depot, but let idle threads hold on to more memory.
+         */
+        constexpr static size_t ALLOCATOR_THREAD_CACHE_BYTES = 262144;
+
+        /**
+         * \brief Controls whether encrypted connections may derive their nonces from a datagram counter.
+         *
+         * Counter nonces add 4 bytes to every datagram instead of a 24-byte random nonce, avoid asking the system for
+         * random bytes on every send, and let the receiver discard replayed datagrams. They are only used if the
+         * remote endpoint supports them as well; otherwise, connections fall back to random nonces.
+         */
+        constexpr static bool ENCRYPTION_COUNTER_NONCES = true;
+
+        /**
+         * \brief Controls whether encrypted connections use AES-256-GCM rather than ChaCha20-Poly1305.
+         *
+         * This only has effect if counter nonces are used, and both endpoints have hardware AES support (AES-NI).
+         */
+        constexpr static bool ENCRYPTION_PREFER_AES = true;
+
+        /**
+         * \brief Sets the number of recent datagram counters an encrypted connection remembers, to reject replays.
+         *
+         * Datagrams that arrive more than this many counters behind the newest one are discarded, as are datagrams
+         * that were already received. Must be a multiple of 64.
+         */
+        constexpr static size_t ENCRYPTION_REPLAY_WINDOW = 1024;
+
         /**
          * \brief Sets the sleep time in milliseconds for the packet queue.
          *
@@ -141,6 +277,56 @@ namespace wirefox {
          */
         constexpr static unsigned int THREAD_SLEEP_PACKETQUEUE_TICK = 5;
 
+        /**
+         * \brief Sets the default number of worker threads that encrypt, decrypt and process datagrams.
+         *
+         * Datagrams to and from different remote peers are handled in parallel, while those of any one remote peer are
+         * still handled in order. If zero, all of this work is done on the network and packet queue threads instead.
+         * Can be changed per peer with IPeer::SetWorkerThreads().
+         */
+        constexpr static unsigned int WORKER_THREADS = 0;
+
+        /**
+         * \brief Sets the number of threads that process handshake messages, including their key exchanges.
+         *
+         * Keeps expensive public-key cryptography off the threads that move datagrams, so that connected peers don't
+         * stall when many clients connect at once, e.g. after a server restart. If zero, handshakes are processed on
+         * the network and worker threads instead.
+         */
+        constexpr static unsigned int HANDSHAKE_THREADS = 1;
+
+        /**
+         * \brief Sets how many handshake messages may wait for each handshake thread.
+         *
+         * Messages that arrive while the queue is full are dropped, and a new connection request is not given a slot.
+         * The sender repeats them after CONNECT_RETRY_DELAY, so excess handshakes are spread out over time.
+         */
+        constexpr static size_t HANDSHAKE_QUEUE_LEN = 128;
+
+        /**
+         * \brief Sets the number of submission queue entries of a socket that uses SocketBackend::IO_URING.
+         *
+         * Writes that find the queue full are handed to the kernel right away, so this bounds how many writes can be
+         * batched into one system call. Must be a power of two.
+         */
+        constexpr static unsigned int IO_URING_QUEUE_DEPTH = 256;
+
+        /**
+         * \brief Sets how many sockets can send to a socket that uses SocketBackend::SHARED_MEMORY at once.
+         *
+         * Each sender is given a ring buffer of its own, so senders never wait for each other. Datagrams from a sender that
+         * finds all rings taken are dropped, until one of the other senders is unbound.
+         */
+        constexpr static size_t SHARED_MEMORY_RINGS = 64;
+
+        /**
+         * \brief Sets the size, in bytes, of each ring buffer of a socket that uses SocketBackend::SHARED_MEMORY.
+         *
+         * This plays the part of the operating system's receive buffer: datagrams that find the ring full are dropped.
+         * Memory is only committed for the part of a ring that is actually used. Must be a power of two.
+         */
+        constexpr static size_t SHARED_MEMORY_RING_BYTES = 256 * 1024;
+
         /**
          * \brief Sets the maximum number of connection requests that are sent out.
          * 
@@ -154,6 +340,52 @@ namespace wirefox {
          */
         constexpr static unsigned int CONNECT_RETRY_DELAY = 2000;
 
+        /**
+         * \brief Sets how long, in milliseconds, a handshake cookie remains valid.
+         *
+         * Before a RemotePeer slot is reserved for an incoming connection, the sender must echo a cookie that proves it
+         * can receive replies at its claimed address. Senders with a spoofed address never see their cookie, so they
+         * cannot tie up slots. Must be longer than CONNECT_RETRY_COUNT times CONNECT_RETRY_DELAY.
+         */
+        constexpr static unsigned int HANDSHAKE_COOKIE_LIFETIME = 10000;
+
+        /**
+         * \brief Sets how many connection requests per second a single IP address may send, on average.
+         *
+         * Requests from a source that exceeds this rate are answered with ConnectResult::IP_RATE_LIMITED, before any
+         * work is done for them. A successful handshake takes two requests. Keep in mind that many clients can share
+         * one IP address, for example behind a NAT.
+         */
+        constexpr static unsigned int CONNECT_RATE_LIMIT = 20;
+
+        /**
+         * \brief Sets how many connection requests a single IP address may send in a quick burst.
+         */
+        constexpr static unsigned int CONNECT_RATE_BURST = 40;
+
+        /**
+         * \brief Sets how many IP addresses a Peer remembers for connection rate limiting.
+         *
+         * When more sources than this send requests, the least recently seen one is forgotten. Each entry takes up
+         * less than a hundred bytes.
+         */
+        constexpr static size_t CONNECT_RATE_TABLE_SIZE = 4096;
+
+        /**
+         * \brief Sets how long, in seconds, a session ticket remains valid. Set to zero to disable session resumption.
+         *
+         * After an encrypted handshake, the accepting Peer hands the client a ticket. When the client reconnects to the
+         * same address, it can present that ticket to derive new session keys in a single round trip, skipping the
+         * key exchange, the identity challenge and the cookie round trip. Tickets are sealed with a key that is unique
+         * to the process that issued them.
+         */
+        constexpr static unsigned int SESSION_TICKET_LIFETIME = 3600;
+
+        /**
+         * \brief Sets how many session tickets a Peer keeps for reconnecting, at most one per remote address.
+         */
+        constexpr static size_t SESSION_TICKET_CACHE_SIZE = 64;
+
         /**
          * \brief Sets the maximum number of times a packet can be sent over the network.
          * 
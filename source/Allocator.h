@@ -0,0 +1,79 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#pragma once
+#include "WirefoxConfig.h"
+
+namespace wirefox {
+
+    namespace detail {
+
+        /**
+         * \cond WIREFOX_INTERNAL
+         * \brief Represents a snapshot of the allocation counters of an allocator.
+         *
+         * Allocators are expected to expose a static \p GetStats() that returns one of these. An allocator is required to
+         * provide static \p Allocate(size_t) and \p Deallocate(void*, size_t) functions, where the size passed to
+         * \p Deallocate is the same size that was passed to \p Allocate. See cfg::DefaultAllocator.
+         */
+        struct AllocatorStats {
+            /// The number of blocks that were requested from the allocator.
+            uint64_t    allocations = 0;
+            /// The number of blocks that were returned to the allocator.
+            uint64_t    deallocations = 0;
+            /// The number of times the allocator itself had to call into the system heap to obtain memory.
+            uint64_t    heapAllocations = 0;
+            /// The number of times the allocator itself returned memory to the system heap.
+            uint64_t    heapDeallocations = 0;
+            /// The number of bytes the allocator has obtained from the system heap, and not yet returned.
+            uint64_t    heapBytes = 0;
+        };
+
+        /**
+         * \brief Adapts a Wirefox allocator to the standard library Allocator concept.
+         *
+         * This can be passed to standard containers and std::shared_ptr, so their internal nodes and control blocks are
+         * served from the same pools as other Wirefox buffers.
+         *
+         * \tparam  T       The value type to allocate.
+         * \tparam  Alloc   The Wirefox allocator that provides the memory. Defaults to cfg::DefaultAllocator.
+         */
+        template<typename T, typename Alloc = cfg::DefaultAllocator>
+        class StlAllocator {
+        public:
+            using value_type = T;
+
+            StlAllocator() noexcept = default;
+            template<typename U>
+            StlAllocator(const StlAllocator<U, Alloc>&) noexcept {}
+
+            T* allocate(size_t n) {
+                return static_cast<T*>(Alloc::Allocate(n * sizeof(T)));
+            }
+
+            void deallocate(T* ptr, size_t n) noexcept {
+                Alloc::Deallocate(ptr, n * sizeof(T));
+            }
+
+            template<typename U>
+            struct rebind {
+                using other = StlAllocator<U, Alloc>;
+            };
+        };
+
+        template<typename T, typename U, typename Alloc>
+        bool operator==(const StlAllocator<T, Alloc>&, const StlAllocator<U, Alloc>&) noexcept { return true; }
+
+        template<typename T, typename U, typename Alloc>
+        bool operator!=(const StlAllocator<T, Alloc>&, const StlAllocator<U, Alloc>&) noexcept { return false; }
+
+        /// \endcond
+
+    }
+
+}
@@ -0,0 +1,43 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#include "PCH.h"
+#include "AllocatorHeap.h"
+
+using namespace detail;
+
+namespace {
+
+    std::atomic<uint64_t> g_allocations {0};
+    std::atomic<uint64_t> g_deallocations {0};
+    std::atomic<uint64_t> g_bytes {0};
+
+}
+
+void* AllocatorHeap::Allocate(size_t size) {
+    void* ptr = ::operator new(size);
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(size, std::memory_order_relaxed);
+    return ptr;
+}
+
+void AllocatorHeap::Deallocate(void* ptr, size_t size) noexcept {
+    if (!ptr) return;
+    ::operator delete(ptr);
+    g_deallocations.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+AllocatorStats AllocatorHeap::GetStats() {
+    // every block is its own heap allocation, so both sets of counters are the same
+    AllocatorStats stats;
+    stats.allocations = stats.heapAllocations = g_allocations.load(std::memory_order_relaxed);
+    stats.deallocations = stats.heapDeallocations = g_deallocations.load(std::memory_order_relaxed);
+    stats.heapBytes = g_bytes.load(std::memory_order_relaxed);
+    return stats;
+}
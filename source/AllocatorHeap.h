@@ -0,0 +1,41 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#pragma once
+#include "Allocator.h"
+
+namespace wirefox {
+
+    namespace detail {
+
+        /**
+         * \cond WIREFOX_INTERNAL
+         * \brief Represents an allocator that forwards every request straight to the system heap.
+         *
+         * This does no pooling whatsoever. It is mainly useful as a baseline when profiling, or when debugging memory
+         * issues with tools that need to see every individual allocation.
+         */
+        class AllocatorHeap {
+        public:
+            AllocatorHeap() = delete;
+
+            /// Allocates a block of at least \p size bytes.
+            static void*            Allocate(size_t size);
+
+            /// Frees a block that was returned by Allocate(). \p size must match the size that was requested.
+            static void             Deallocate(void* ptr, size_t size) noexcept;
+
+            /// Returns a snapshot of the allocation counters.
+            static AllocatorStats   GetStats();
+        };
+
+        /// \endcond
+
+    }
+
+}
@@ -0,0 +1,230 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#include "PCH.h"
+#include "AllocatorSlab.h"
+
+using namespace detail;
+
+namespace {
+
+    constexpr size_t SizeClassCount(size_t maxBlock, size_t minBlock) {
+        return maxBlock <= minBlock ? 1 : 1 + SizeClassCount(maxBlock / 2, minBlock);
+    }
+
+    /// The smallest block handed out; also guarantees that blocks are suitably aligned for any fundamental type.
+    constexpr size_t MIN_BLOCK = 16;
+    /// The number of power-of-two size classes between MIN_BLOCK and the configured maximum block size.
+    constexpr size_t CLASS_COUNT = SizeClassCount(cfg::ALLOCATOR_SLAB_MAX_BLOCK, MIN_BLOCK);
+    /// The minimum amount of memory that is requested from the system heap at once, when a size class runs dry.
+    constexpr size_t SLAB_LENGTH = 65536;
+
+    static_assert((cfg::ALLOCATOR_SLAB_MAX_BLOCK & (cfg::ALLOCATOR_SLAB_MAX_BLOCK - 1)) == 0, "ALLOCATOR_SLAB_MAX_BLOCK must be a power of two");
+    static_assert(cfg::ALLOCATOR_SLAB_MAX_BLOCK >= MIN_BLOCK, "ALLOCATOR_SLAB_MAX_BLOCK is too small");
+
+    /// A free block doubles as a node in the singly linked free list of its size class.
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct FreeList {
+        FreeBlock*  head = nullptr;
+        size_t      count = 0;
+
+        void Push(void* ptr) noexcept {
+            auto* block = static_cast<FreeBlock*>(ptr);
+            block->next = head;
+            head = block;
+            count++;
+        }
+
+        void* Pop() noexcept {
+            FreeBlock* block = head;
+            head = block->next;
+            count--;
+            return block;
+        }
+
+        // moves up to num blocks from the front of this list into another list
+        void MoveTo(FreeList& other, size_t num) noexcept {
+            while (head && num-- > 0)
+                other.Push(Pop());
+        }
+    };
+
+    struct Depot {
+        struct Bin {
+            cfg::LockableMutex  lock;
+            FreeList            free;
+        };
+
+        Bin                     bins[CLASS_COUNT];
+        std::atomic<uint64_t>   allocations {0};
+        std::atomic<uint64_t>   deallocations {0};
+        std::atomic<uint64_t>   heapAllocations {0};
+        std::atomic<uint64_t>   heapDeallocations {0};
+        std::atomic<uint64_t>   heapBytes {0};
+    };
+
+    struct ThreadCache {
+        FreeList    bins[CLASS_COUNT];
+    };
+
+    Depot& GetDepot() {
+        // deliberately leaked: thread caches may still flush into the depot while static destructors are running
+        static Depot* depot = new Depot;
+        return *depot;
+    }
+
+    void Flush(ThreadCache& cache) noexcept {
+        auto& depot = GetDepot();
+        for (size_t i = 0; i < CLASS_COUNT; i++) {
+            if (cache.bins[i].count == 0) continue;
+
+            WIREFOX_LOCK_GUARD(depot.bins[i].lock);
+            cache.bins[i].MoveTo(depot.bins[i].free, cache.bins[i].count);
+        }
+    }
+
+    ThreadCache* GetThreadCache() noexcept {
+        // Once a thread's cache is torn down, any later frees on that thread (e.g. from other thread_local destructors)
+        // go directly to the depot. The flag is trivially destructible, so it outlives the cache itself.
+        thread_local bool destroyed = false;
+        if (destroyed) return nullptr;
+
+        struct Owner {
+            ThreadCache cache;
+            bool& destroyed;
+
+            Owner(bool& destroyed) : destroyed(destroyed) {}
+            ~Owner() {
+                destroyed = true;
+                Flush(cache);
+            }
+        };
+
+        thread_local Owner owner(destroyed);
+        return &owner.cache;
+    }
+
+    size_t GetSizeClass(size_t size) noexcept {
+        size_t index = 0;
+        for (size_t block = MIN_BLOCK; block < size; block <<= 1)
+            index++;
+
+        return index;
+    }
+
+    constexpr size_t GetBlockSize(size_t index) {
+        return MIN_BLOCK << index;
+    }
+
+    constexpr size_t GetCacheLimit(size_t index) {
+        return std::max(size_t(8), cfg::ALLOCATOR_THREAD_CACHE_BYTES / GetBlockSize(index));
+    }
+
+    void Refill(FreeList& list, size_t index) {
+        auto& depot = GetDepot();
+
+        // prefer recycling blocks that other threads returned
+        {
+            WIREFOX_LOCK_GUARD(depot.bins[index].lock);
+            depot.bins[index].free.MoveTo(list, GetCacheLimit(index) / 2);
+        }
+        if (list.count > 0) return;
+
+        // nothing to recycle, so carve up a brand new slab
+        const size_t blockSize = GetBlockSize(index);
+        const size_t slabSize = std::max(SLAB_LENGTH, blockSize);
+        auto* slab = static_cast<uint8_t*>(::operator new(slabSize));
+        depot.heapAllocations.fetch_add(1, std::memory_order_relaxed);
+        depot.heapBytes.fetch_add(slabSize, std::memory_order_relaxed);
+
+        for (size_t offset = 0; offset + blockSize <= slabSize; offset += blockSize)
+            list.Push(slab + offset);
+    }
+
+}
+
+void* AllocatorSlab::Allocate(size_t size) {
+    auto& depot = GetDepot();
+    depot.allocations.fetch_add(1, std::memory_order_relaxed);
+
+    // too big to bother pooling
+    if (size > cfg::ALLOCATOR_SLAB_MAX_BLOCK) {
+        depot.heapAllocations.fetch_add(1, std::memory_order_relaxed);
+        depot.heapBytes.fetch_add(size, std::memory_order_relaxed);
+        return ::operator new(size);
+    }
+
+    const size_t index = GetSizeClass(size);
+    ThreadCache* cache = GetThreadCache();
+    if (!cache) {
+        // thread is shutting down, so bypass the cache
+        FreeList single;
+        Refill(single, index);
+        void* ptr = single.Pop();
+
+        WIREFOX_LOCK_GUARD(depot.bins[index].lock);
+        single.MoveTo(depot.bins[index].free, single.count);
+        return ptr;
+    }
+
+    auto& list = cache->bins[index];
+    if (list.count == 0)
+        Refill(list, index);
+
+    return list.Pop();
+}
+
+void AllocatorSlab::Deallocate(void* ptr, size_t size) noexcept {
+    if (!ptr) return;
+
+    auto& depot = GetDepot();
+    depot.deallocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (size > cfg::ALLOCATOR_SLAB_MAX_BLOCK) {
+        depot.heapDeallocations.fetch_add(1, std::memory_order_relaxed);
+        depot.heapBytes.fetch_sub(size, std::memory_order_relaxed);
+        ::operator delete(ptr);
+        return;
+    }
+
+    const size_t index = GetSizeClass(size);
+    ThreadCache* cache = GetThreadCache();
+    if (!cache) {
+        WIREFOX_LOCK_GUARD(depot.bins[index].lock);
+        depot.bins[index].free.Push(ptr);
+        return;
+    }
+
+    // if this thread is hoarding too many blocks (e.g. because it frees what another thread allocates), share half
+    auto& list = cache->bins[index];
+    list.Push(ptr);
+    if (list.count > GetCacheLimit(index)) {
+        WIREFOX_LOCK_GUARD(depot.bins[index].lock);
+        list.MoveTo(depot.bins[index].free, list.count / 2);
+    }
+}
+
+AllocatorStats AllocatorSlab::GetStats() {
+    const auto& depot = GetDepot();
+
+    AllocatorStats stats;
+    stats.allocations = depot.allocations.load(std::memory_order_relaxed);
+    stats.deallocations = depot.deallocations.load(std::memory_order_relaxed);
+    stats.heapAllocations = depot.heapAllocations.load(std::memory_order_relaxed);
+    stats.heapDeallocations = depot.heapDeallocations.load(std::memory_order_relaxed);
+    stats.heapBytes = depot.heapBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AllocatorSlab::FlushThreadCache() noexcept {
+    if (ThreadCache* cache = GetThreadCache())
+        Flush(*cache);
+}
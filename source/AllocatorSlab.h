@@ -0,0 +1,49 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#pragma once
+#include "Allocator.h"
+
+namespace wirefox {
+
+    namespace detail {
+
+        /**
+         * \cond WIREFOX_INTERNAL
+         * \brief Represents an allocator that serves small blocks from size-class slab pools.
+         *
+         * Requests are rounded up to the next power of two (minimum 16 bytes), and served from a free list for that size
+         * class. Every thread keeps a small cache of free blocks per size class, so the common case of allocating and
+         * freeing on the same thread takes no locks at all. Caches overflow into, and refill from, a shared depot.
+         * Slabs are only ever obtained from the system heap when the depot runs dry.
+         *
+         * Blocks may be freed on a different thread than they were allocated on. Memory obtained for slabs is kept for
+         * reuse and never returned to the system. Requests larger than ALLOCATOR_SLAB_MAX_BLOCK bypass the slabs.
+         */
+        class AllocatorSlab {
+        public:
+            AllocatorSlab() = delete;
+
+            /// Allocates a block of at least \p size bytes.
+            static void*            Allocate(size_t size);
+
+            /// Frees a block that was returned by Allocate(). \p size must match the size that was requested.
+            static void             Deallocate(void* ptr, size_t size) noexcept;
+
+            /// Returns a snapshot of the allocation counters.
+            static AllocatorStats   GetStats();
+
+            /// Moves all blocks cached by the calling thread back into the shared depot.
+            static void             FlushThreadCache() noexcept;
+        };
+
+        /// \endcond
+
+    }
+
+}
@@ -13,14 +13,20 @@ using namespace wirefox::detail;
 
 void AwaitableEvent::Wait() {
     std::unique_lock<decltype(m_mutex)> lock(m_mutex);
-    m_cv.wait(lock);
+    m_cv.wait(lock, [this] { return m_signaled; });
+    m_signaled = false;
 }
 
 void AwaitableEvent::WaitFor(Timespan duration) {
     std::unique_lock<decltype(m_mutex)> lock(m_mutex);
-    m_cv.wait_for(lock, std::chrono::milliseconds(Time::ToMilliseconds(duration)));
+    m_cv.wait_for(lock, std::chrono::milliseconds(Time::ToMilliseconds(duration)), [this] { return m_signaled; });
+    m_signaled = false;
 }
 
 void AwaitableEvent::Signal() {
+    {
+        WIREFOX_LOCK_GUARD(m_mutex);
+        m_signaled = true;
+    }
     m_cv.notify_all();
 }
@@ -27,7 +27,8 @@ namespace wirefox {
             /**
              * \brief Awaits this event indefinitely.
              * 
-             * The thread will sleep without time limit, until Signal() is called.
+             * The thread will sleep without time limit, until Signal() is called. Returns immediately if Signal() was
+             * already called since the last wait ended.
              */
             void    Wait();
 
@@ -35,7 +36,8 @@ namespace wirefox {
              * \brief Awaits this event for an amount of time, then returns.
              * 
              * The thread will sleep, generally consuming no additional CPU time on most implementations.
-             * If Signal() is called while this method is blocking, this method will return immediately.
+             * If Signal() is called while this method is blocking, this method will return immediately. The same goes if
+             * Signal() was called since the last wait ended, so signals sent while the waiting thread is busy aren't lost.
              * 
              * \param[in]   duration    The maximum amount of time that can be spent waiting.
              */
@@ -49,6 +51,7 @@ namespace wirefox {
         private:
             cfg::LockableMutex m_mutex;
             std::condition_variable m_cv;
+            bool    m_signaled = false;
         };
 
     }
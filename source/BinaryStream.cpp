@@ -24,6 +24,20 @@ namespace {
         return n;
     }
 
+    uint8_t* AllocateBuffer(size_t capacity) {
+        return capacity > 0
+            ? static_cast<uint8_t*>(cfg::DefaultAllocator::Allocate(capacity))
+            : nullptr;
+    }
+
+    void FreeBuffer(uint8_t* buffer, size_t capacity) noexcept {
+        cfg::DefaultAllocator::Deallocate(buffer, capacity);
+    }
+
+}
+
+void BinaryStream::BufferDeleter::operator()(uint8_t* buffer) const noexcept {
+    FreeBuffer(buffer, capacity);
 }
 
 BinaryStream::BinaryStream(const size_t capacity)
@@ -32,9 +46,7 @@ BinaryStream::BinaryStream(const size_t capacity)
     , m_subBytePosition(0)
     , m_readonly(false) {
     m_capacity = ToNextPowerOfTwo(capacity);
-    m_buffer = m_capacity > 0
-        ? new uint8_t[m_capacity]
-        : nullptr;
+    m_buffer = AllocateBuffer(m_capacity);
     m_buffer_ro = m_buffer;
 }
 
@@ -49,7 +61,7 @@ BinaryStream::BinaryStream(const uint8_t* buffer, size_t bufferlen, WrapMode mod
         m_capacity = ToNextPowerOfTwo(bufferlen);
         assert(m_capacity >= bufferlen);
 
-        m_buffer = m_capacity > 0 ? new uint8_t[m_capacity] : nullptr;
+        m_buffer = AllocateBuffer(m_capacity);
         m_buffer_ro = m_buffer;
         if (m_buffer)
             memcpy(m_buffer, buffer, bufferlen);
@@ -101,6 +113,9 @@ BinaryStream& BinaryStream::operator=(const BinaryStream& other) {
 
 BinaryStream& BinaryStream::operator=(BinaryStream&& other) noexcept {
     if (this != &other) {
+        // release our own buffer first, otherwise it would leak
+        Reset();
+
         this->m_buffer = other.m_buffer;
         this->m_buffer_ro = other.m_buffer_ro;
         this->m_capacity = other.m_capacity;
@@ -137,7 +152,7 @@ void BinaryStream::Seek(size_t position) {
 }
 
 void BinaryStream::SeekForce(size_t position) {
-    if (m_capacity <= position) {
+    if (m_length < position) {
         SeekToEnd();
         WriteZeroes(position - m_position);
     }
@@ -155,7 +170,7 @@ void BinaryStream::Reset() {
     if (m_buffer) {
         assert(m_buffer_ro);
         if (!m_readonly)
-            delete[] m_buffer;
+            FreeBuffer(m_buffer, m_capacity);
         m_buffer = nullptr;
     }
 
@@ -180,6 +195,20 @@ std::unique_ptr<uint8_t[]> BinaryStream::ToArray() const {
 }
 
 std::unique_ptr<uint8_t[]> BinaryStream::ReleaseBuffer(size_t* length) noexcept {
+    size_t bufferlen = 0;
+    const BufferPtr owned = ReleaseAllocatedBuffer(&bufferlen);
+    if (!owned) return nullptr;
+
+    if (length)
+        *length = bufferlen;
+
+    // the caller frees this with delete[], which is only valid for memory from the heap
+    auto ret = std::unique_ptr<uint8_t[]>(new uint8_t[bufferlen]);
+    memcpy(ret.get(), owned.get(), bufferlen);
+    return ret;
+}
+
+BinaryStream::BufferPtr BinaryStream::ReleaseAllocatedBuffer(size_t* length) noexcept {
     if (m_readonly) return nullptr;
     Align();
 
@@ -188,13 +217,14 @@ std::unique_ptr<uint8_t[]> BinaryStream::ReleaseBuffer(size_t* length) noexcept
         *length = m_length;
 
     // keep temporary ref to buffer, and clear all state
-    auto* ptr = m_buffer;
+    BufferPtr ret(m_buffer, BufferDeleter{m_capacity});
     m_buffer = nullptr;
+    m_buffer_ro = nullptr;
     m_length = 0;
     m_position = 0;
     m_capacity = 0;
 
-    return std::unique_ptr<uint8_t[]>(ptr);
+    return ret;
 }
 
 void BinaryStream::Write(ISerializable& obj) {
@@ -410,14 +440,14 @@ void BinaryStream::Reallocate(size_t newCapacity) {
 
     // allocate a new buffer
     newCapacity = std::max(ToNextPowerOfTwo(newCapacity), size_t(1));
-    uint8_t* newBuffer = new uint8_t[newCapacity];
+    uint8_t* newBuffer = AllocateBuffer(newCapacity);
 
     // copy from the previous buffer as much as we can fit
     if (m_buffer) {
         const auto bytesToCopy = std::min(m_length, newCapacity);
         if (bytesToCopy > 0)
             memcpy(newBuffer, m_buffer, bytesToCopy);
-        delete[] m_buffer;
+        FreeBuffer(m_buffer, m_capacity);
     }
 
     m_buffer = newBuffer;
@@ -0,0 +1,76 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#include "PCH.h"
+#include "BufferPool.h"
+#include "WirefoxConfigRefs.h"
+
+using namespace detail;
+
+struct BufferPool::State {
+    State(size_t blockSize, size_t maxIdle)
+        : blockSize(blockSize)
+        , maxIdle(maxIdle) {}
+
+    mutable cfg::LockableMutex lock;
+    std::vector<std::unique_ptr<uint8_t[]>> idle;
+    const size_t blockSize;
+    const size_t maxIdle;
+};
+
+struct BufferPool::Releaser {
+    // the deleter keeps the pool state alive, so buffers can be released after the BufferPool itself is gone
+    std::shared_ptr<State> state;
+
+    void operator()(uint8_t* buffer) const {
+        std::unique_ptr<uint8_t[]> owned(buffer);
+
+        WIREFOX_LOCK_GUARD(state->lock);
+        if (state->idle.size() < state->maxIdle)
+            state->idle.push_back(std::move(owned));
+    }
+};
+
+BufferPool::BufferPool(size_t blockSize, size_t maxIdle)
+    : m_state(std::make_shared<State>(blockSize, maxIdle)) {
+    assert(blockSize > 0);
+}
+
+BufferPool::Handle BufferPool::Acquire() {
+    std::unique_ptr<uint8_t[]> buffer;
+
+    {
+        WIREFOX_LOCK_GUARD(m_state->lock);
+        if (!m_state->idle.empty()) {
+            buffer = std::move(m_state->idle.back());
+            m_state->idle.pop_back();
+        }
+    }
+
+    // nothing to recycle, so grow the pool
+    if (!buffer)
+        buffer.reset(new uint8_t[m_state->blockSize]);
+
+    return Handle(buffer.release(), Releaser{m_state}, StlAllocator<uint8_t>());
+}
+
+size_t BufferPool::GetBlockSize() const noexcept {
+    return m_state->blockSize;
+}
+
+size_t BufferPool::GetIdleCount() const {
+    WIREFOX_LOCK_GUARD(m_state->lock);
+    return m_state->idle.size();
+}
+
+BufferPool::Handle BufferPool::Adopt(BinaryStream::BufferPtr buffer) {
+    // shared_ptr<T> can't adopt a unique_ptr<T[]> directly in C++14, so hand over the deleter explicitly
+    if (!buffer) return nullptr;
+    auto deleter = buffer.get_deleter();
+    return Handle(buffer.release(), deleter, StlAllocator<uint8_t>());
+}
@@ -0,0 +1,84 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#pragma once
+#include "WirefoxConfig.h"
+#include "BinaryStream.h"
+
+namespace wirefox {
+
+    namespace detail {
+
+        /**
+         * \cond WIREFOX_INTERNAL
+         * \brief Represents a pool of reference-counted, fixed-size byte buffers.
+         *
+         * Buffers are handed out as shared pointers. When the last reference to a buffer is dropped, it is returned to the
+         * pool, so it can be reused by a later Acquire() instead of being freed. This is mainly used for receive buffers:
+         * Packets received from the network reference a slice of the buffer their datagram was read into, rather than
+         * owning a copy of their payload.
+         *
+         * Buffers may safely outlive the pool they came from, and may be released on any thread.
+         */
+        class BufferPool {
+        public:
+            /// Represents a reference to a buffer owned by a BufferPool.
+            using Handle = std::shared_ptr<uint8_t>;
+
+            /**
+             * \brief Constructs a new, empty BufferPool.
+             *
+             * \param[in]   blockSize   The length, in bytes, of every buffer handed out by this pool.
+             * \param[in]   maxIdle     The maximum number of unused buffers that are retained for reuse. Any buffers released
+             *                          while the pool is already holding this many are freed instead.
+             */
+            BufferPool(size_t blockSize, size_t maxIdle = cfg::RECEIVE_BUFFER_POOL_IDLE);
+            /// Copy constructor.
+            BufferPool(const BufferPool&) = delete;
+            /// Move constructor.
+            BufferPool(BufferPool&&) noexcept = default;
+            /// Destructor. Frees all idle buffers; buffers that are still referenced are freed when released.
+            ~BufferPool() = default;
+
+            /// Copy assignment operator.
+            BufferPool& operator=(const BufferPool&) = delete;
+            /// Move assignment operator.
+            BufferPool& operator=(BufferPool&&) noexcept = default;
+
+            /**
+             * \brief Returns a buffer of GetBlockSize() bytes.
+             *
+             * Reuses an idle buffer if one is available, otherwise allocates a new one. The contents are unspecified.
+             */
+            Handle              Acquire();
+
+            /// Returns the length, in bytes, of the buffers handed out by this pool.
+            size_t              GetBlockSize() const noexcept;
+
+            /// Returns the number of released buffers that are currently waiting to be reused.
+            size_t              GetIdleCount() const;
+
+            /**
+             * \brief Wraps a buffer that was released by a BinaryStream into a Handle.
+             *
+             * The Handle takes ownership of the buffer, and frees it when the last reference is dropped.
+             */
+            static Handle       Adopt(BinaryStream::BufferPtr buffer);
+
+        private:
+            struct State;
+            struct Releaser;
+
+            std::shared_ptr<State> m_state;
+        };
+
+        /// \endcond
+
+    }
+
+}
@@ -8,6 +8,7 @@
 
 #include "PCH.h"
 #include "CongestionControl.h"
+#include "DatagramHeader.h"
 
 using namespace wirefox::detail;
 
@@ -27,6 +28,7 @@ CongestionControl::CongestionControl()
     , m_remoteDatagram(0)
     , m_nextUpdate(Time::Now())
     , m_bytesInFlight(0)
+    , m_datagramSize(cfg::MTU)
     , m_rttMin(0)
     , m_rttMax(0)
     , m_rttAvg(0) {}
@@ -97,6 +99,14 @@ DatagramID CongestionControl::PeekNextDatagramID() const {
     return m_nextDatagram;
 }
 
+void CongestionControl::SetMaximumDatagramSize(size_t size) {
+    m_datagramSize = size;
+}
+
+size_t CongestionControl::GetMaximumDatagramSize() const {
+    return m_datagramSize;
+}
+
 bool CongestionControl::GetRTTHistoryAvailable() const {
     return m_rttHistory.size() >= 2; // a few samples
 }
@@ -111,8 +121,20 @@ unsigned CongestionControl::GetAverageRTT() const {
 void CongestionControl::MakeAckList(std::vector<DatagramID>& acks, std::vector<DatagramID>& nacks) {
     assert(acks.empty());
     assert(nacks.empty());
-    acks.swap(m_acks);
-    nacks.swap(m_nacks);
+
+    // a datagram header only has room for so many of each, the rest go out with the next ackgram
+    const auto take = [](std::vector<DatagramID>& from, std::vector<DatagramID>& to) {
+        if (from.size() <= DatagramHeader::MAX_ACKS) {
+            to.swap(from);
+            return;
+        }
+
+        to.assign(from.begin(), from.begin() + DatagramHeader::MAX_ACKS);
+        from.erase(from.begin(), from.begin() + DatagramHeader::MAX_ACKS);
+    };
+
+    take(m_acks, acks);
+    take(m_nacks, nacks);
 }
 
 void CongestionControl::RecalculateRTT() {
@@ -55,6 +55,12 @@ namespace wirefox {
             /// Returns, but does not increment, the next outgoing PacketID.
             DatagramID          PeekNextDatagramID() const;
 
+            /// Sets the largest datagram, in bytes, that may be sent. Defaults to cfg::MTU; path MTU discovery may raise it.
+            void                SetMaximumDatagramSize(size_t size);
+
+            /// Returns the largest datagram, in bytes, that may be sent.
+            size_t              GetMaximumDatagramSize() const;
+
             /// Calculates and returns the estimated bandwidth to be used for sending new packets.
             virtual size_t      GetTransmissionBudget() const = 0;
 
@@ -124,12 +130,13 @@ namespace wirefox {
              */
             virtual RecvState   NotifyReceivedPacket(PacketID recv);
 
-        protected:
             /// Indicates whether \p lhs is greater than \p rhs, accounting for unsigned overflow.
             static bool         SequenceGreaterThan(DatagramID lhs, DatagramID rhs);
             /// Indicates whether \p lhs is less than \p rhs, accounting for unsigned overflow.
             static bool         SequenceLessThan(DatagramID lhs, DatagramID rhs);
 
+        protected:
+
             /**
              * \brief Recalculates the average round-trip-time using the current RTT history buffer.
              */
@@ -154,6 +161,7 @@ namespace wirefox {
             Timestamp               m_nextUpdate;
             Timestamp               m_oldestUnsentAck;
             size_t                  m_bytesInFlight;
+            size_t                  m_datagramSize;
 
             std::list<Timespan>     m_rttHistory;
             Timespan                m_rttMin, m_rttMax, m_rttAvg;
@@ -24,13 +24,13 @@ void CongestionControlWindow::Update(PeerStats& stats) {
 size_t CongestionControlWindow::GetTransmissionBudget() const {
     return std::min(
         m_bytesInFlight >= m_window ? 0 : m_window - m_bytesInFlight,
-        cfg::MTU - GetRetransmissionBudget());
+        m_datagramSize - GetRetransmissionBudget());
 }
 
 size_t CongestionControlWindow::GetRetransmissionBudget() const {
     return std::min(
         m_bytesInFlight,
-        cfg::MTU);
+        m_datagramSize);
 }
 
 Timespan CongestionControlWindow::GetRetransmissionRTO(unsigned retries) const {
@@ -60,15 +60,15 @@ void CongestionControlWindow::NotifyReceivedAck(DatagramID recv) {
 
     // increase congestion window size
     if (GetIsSlowStart())
-        m_window += cfg::MTU;
+        m_window += m_datagramSize;
     else
-        m_window += ((cfg::MTU * cfg::MTU) / m_window) + cfg::MTU / 8;
+        m_window += ((m_datagramSize * m_datagramSize) / m_window) + m_datagramSize / 8;
 }
 
 void CongestionControlWindow::NotifyReceivedNakGroup() {
     // should bring us back to slow start phase
-    m_threshold = std::max(m_window / 2, cfg::MTU * 2);
-    m_window = cfg::MTU;
+    m_threshold = std::max(m_window / 2, m_datagramSize * 2);
+    m_window = m_datagramSize;
 }
 
 bool CongestionControlWindow::GetIsSlowStart() const {
@@ -31,7 +31,7 @@ namespace {
             // To be suitable for sending, packet must meet all three conditions:
             // - not exceeding max length, - in the correct queue, - timeout elapsed
             [=](const auto& outgoing) -> bool {
-                return (outgoing.blob.GetLength() <= maxLength)
+                return (outgoing.GetLength() <= maxLength)
                     && ((wantResend && outgoing.sendCount > 0) || (!wantResend && outgoing.sendCount == 0))
                     && Time::Elapsed(outgoing.sendNext);
             }
@@ -52,6 +52,10 @@ namespace {
         auto* outgoing = GetQueuedPacket(remote, budget, true);
         if (!outgoing) return;
 
+        // a packet that keeps getting lost may be stuck in datagrams that the path no longer carries
+        if (outgoing->sendCount >= cfg::PMTU_BLACK_HOLE_RESENDS)
+            remote.pmtu->NotifyBlackHole();
+
         outgoing->sendNext = Time::Now() + remote.congestion->GetRetransmissionRTO(outgoing->sendCount);
         remote.stats.Add(PeerStatID::PACKETS_LOST, 1);
         sendQueue.push_back(outgoing);
@@ -75,8 +79,36 @@ namespace {
         outgoing->sendNext = Time::Now() + remote.congestion->GetRetransmissionRTO(outgoing->sendCount);
         sendQueue.push_back(outgoing);
 
-        assert(budget >= outgoing->blob.GetLength());
-        budget -= outgoing->blob.GetLength();
+        assert(budget >= outgoing->GetLength());
+        budget -= outgoing->GetLength();
+    }
+
+    /// Returns the number of bytes the ConnectionID prefix adds to datagrams sent to \p remote.
+    size_t Datagram_GetPrefixLength(const RemotePeer& remote) {
+        return remote.remoteConnectionID != 0 ? DatagramHeader::CONNECTION_ID_LENGTH : 0;
+    }
+
+    /**
+     * \brief Reserves room in front of a datagram for the ConnectionID, if the remote issued one, and for the encryption
+     * layer, if the Peer uses encryption.
+     *
+     * The nonce is written into this headroom, and the MAC appended after the plaintext, when the datagram is
+     * encrypted in place right before sending. The ConnectionID is written in front of that afterwards.
+     *
+     * \param[out]  datagram    The datagram whose blob is still empty.
+     * \param[in]   remote      The RemotePeer the datagram is for.
+     * \param[in]   master      The Peer that will send the datagram.
+     */
+    void Datagram_ReserveHeadroom(PacketQueue::OutgoingDatagram& datagram, const RemotePeer& remote, const Peer* master) {
+        datagram.connectionID = remote.remoteConnectionID;
+        datagram.headroom = Datagram_GetPrefixLength(remote)
+            + (master->GetEncryptionEnabled() ? cfg::DefaultEncryption::GetHeadroom() : 0);
+        datagram.blob.WriteZeroes(datagram.headroom);
+    }
+
+    /// Returns the number of bytes the encryption layer will append to datagrams sent by \p master.
+    size_t Datagram_GetTailroom(const Peer* master) {
+        return master->GetEncryptionEnabled() ? cfg::DefaultEncryption::GetTailroom() : 0;
     }
 
 }
@@ -87,10 +119,18 @@ PacketQueue::OutgoingDatagram* DatagramBuilder::MakeDatagram(RemotePeer& remote,
     // no packets to send
     if (remote.outbox.empty()) return nullptr;
 
-    // calculate our bandwidth budgets for transmission of packets
-    auto budgetResend = remote.congestion->GetRetransmissionBudget();
-    auto budgetSend = remote.congestion->GetTransmissionBudget();
-    assert(budgetSend + budgetResend <= cfg::MTU);
+    // the datagram header, the connection ID and the encryption overhead must fit in the path MTU as well, so reserve room for them
+    const size_t budgetMax = remote.pmtu->GetPathMtu() - DatagramHeader::DATA_HEADER_LENGTH - Datagram_GetPrefixLength(remote)
+        - (master->GetEncryptionEnabled() ? cfg::DefaultEncryption::GetOverhead() : 0);
+
+    // calculate our bandwidth budgets for transmission of packets. out-of-band datagrams go to many different endpoints
+    // and are never acked, so a congestion window makes no sense for them; it would only let handshake replies pile up
+    auto budgetResend = remote.IsOutOfBand() ? 0 : remote.congestion->GetRetransmissionBudget();
+    auto budgetSend = remote.IsOutOfBand() ? budgetMax : remote.congestion->GetTransmissionBudget();
+    assert(budgetSend + budgetResend <= cfg::MTU_MAX);
+
+    budgetResend = std::min(budgetResend, budgetMax);
+    budgetSend = std::min(budgetSend, budgetMax - budgetResend);
     if (budgetSend == 0 && budgetResend == 0) return nullptr;
 
     std::vector<PacketQueue::OutgoingPacket*> sendQueue;
@@ -112,8 +152,10 @@ PacketQueue::OutgoingDatagram* DatagramBuilder::MakeDatagram(RemotePeer& remote,
     // now, build a datagram to contain all the packets in sendQueue
     PacketQueue::OutgoingDatagram datagram;
     datagram.id = remote.congestion->GetNextDatagramID();
-    datagram.addr = sendQueue[0]->addr; // TODO: is this ok?
+    // each OOB packet has its own address, but a connected remote may have moved since its packets were queued
+    datagram.addr = remote.IsOutOfBand() ? sendQueue[0]->addr : remote.addr;
     datagram.crypto = sendQueue[0]->crypto; // should only ever be set for some OOB packets
+    datagram.workerKey = sendQueue[0]->workerKey;
     datagram.discard = Time::Now() + Time::FromSeconds(5);
 
     DatagramHeader header;
@@ -140,27 +182,36 @@ PacketQueue::OutgoingDatagram* DatagramBuilder::MakeDatagram(RemotePeer& remote,
         }
 
         // by determining the payload length beforehand, we can write everything in one go, rather than needing another copy of the payload
-        header.dataLength += outgoing->blob.GetLength();
+        header.dataLength += outgoing->GetLength();
         // keep track of which packets belong to this datagram, so we can ack them later
         datagram.packets.push_back(outgoing->id);
     }
 
-    // concatenate the header and all payload blobs into one stream
+    // gather the header, and all packet headers and payload slices, into one stream. the payloads are copied exactly once here,
+    // straight from the buffers the user handed to Send(), and the capacity is reserved upfront so the stream never reallocates,
+    // not even when it is encrypted later on.
+    Datagram_ReserveHeadroom(datagram, remote, master);
     header.Serialize(datagram.blob);
+    datagram.blob.Ensure(header.dataLength + Datagram_GetTailroom(master));
+    std::vector<PacketID> unreliable;
     for (const auto* outgoing : sendQueue) {
-        datagram.blob.WriteBytes(outgoing->blob);
+        outgoing->WriteTo(datagram.blob);
 
-        // if this packet is marked as unreliable, remove it from the outbox right now
         if (!outgoing->HasFlag(PacketOptions::RELIABLE))
-            remote.RemovePacketFromOutbox(outgoing->id);
+            unreliable.push_back(outgoing->id);
     }
 
+    // unreliable packets are removed from the outbox right now. this must wait until all packets are written, because
+    // erasing from the outbox moves the packets behind it, and sendQueue points at those
+    for (auto id : unreliable)
+        remote.RemovePacketFromOutbox(id);
+
     remote.stats.Add(PeerStatID::PACKETS_SENT, sendQueue.size());
     remote.sentbox.push_back(std::move(datagram));
     return &remote.sentbox.back();
 }
 
-PacketQueue::OutgoingDatagram* DatagramBuilder::MakeAckgram(RemotePeer& remote) {
+PacketQueue::OutgoingDatagram* DatagramBuilder::MakeAckgram(RemotePeer& remote, Peer* master) {
     WIREFOX_LOCK_GUARD(remote.lock);
 
     std::vector<DatagramID> acks, nacks;
@@ -179,8 +230,42 @@ PacketQueue::OutgoingDatagram* DatagramBuilder::MakeAckgram(RemotePeer& remote)
     header.datagramID = ackgram.id;
     header.acks.insert(header.acks.begin(), acks.begin(), acks.end()); // copy - can I move these instead maybe?
     header.nacks.insert(header.nacks.begin(), nacks.begin(), nacks.end());
+    Datagram_ReserveHeadroom(ackgram, remote, master);
     header.Serialize(ackgram.blob);
+    ackgram.blob.Ensure(Datagram_GetTailroom(master));
 
     remote.sentbox.push_back(std::move(ackgram));
     return &remote.sentbox.back();
 }
+
+PacketQueue::OutgoingDatagram* DatagramBuilder::MakeProbe(RemotePeer& remote, Peer* master, size_t size) {
+    WIREFOX_LOCK_GUARD(remote.lock);
+
+    PacketQueue::OutgoingDatagram probe;
+    probe.addr = remote.addr;
+    probe.id = remote.congestion->GetNextDatagramID();
+    probe.discard = Time::Now() + Time::FromSeconds(5);
+    probe.crypto = nullptr;
+    probe.probe = true;
+
+    DatagramHeader header;
+    header.flag_data = false;
+    header.flag_link = true;
+    header.flag_padding = true;
+    header.datagramID = probe.id;
+    Datagram_ReserveHeadroom(probe, remote, master);
+    header.Serialize(probe.blob);
+
+    // pad the datagram so it is exactly \p size bytes on the wire, once the encryption layer has added its overhead
+    const size_t overhead = master->GetEncryptionEnabled() ? cfg::DefaultEncryption::GetOverhead() : 0;
+    const size_t plaintext = size - Datagram_GetPrefixLength(remote) - overhead;
+    const size_t written = probe.blob.GetLength() - probe.headroom;
+    assert(plaintext > written);
+    probe.blob.Ensure(plaintext - written + Datagram_GetTailroom(master));
+    probe.blob.WriteZeroes(plaintext - written);
+
+    // the remote acks the probe like any other datagram, but if it's lost, it's not sent again
+    remote.pmtu->NotifyProbeSent(probe.id, size, remote.congestion->GetRetransmissionRTO(1));
+    remote.sentbox.push_back(std::move(probe));
+    return &remote.sentbox.back();
+}
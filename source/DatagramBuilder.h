@@ -41,8 +41,19 @@ namespace wirefox {
              * if any, will be assigned to the sentbox of \p remote.
              *
              * \param[in]   remote      The RemotePeer whose pending ACK/NAKs will be packed into a datagram.
+             * \param[in]   master      The Peer that will send the datagram. Should be the owner of \p remote.
              */
-            static PacketQueue::OutgoingDatagram*   MakeAckgram(RemotePeer& remote);
+            static PacketQueue::OutgoingDatagram*   MakeAckgram(RemotePeer& remote, Peer* master);
+
+            /**
+             * \brief Builds a new OutgoingDatagram that is padded to a certain size, to find out whether the network path
+             * to \p remote can carry datagrams of that size. The created datagram will be assigned to the sentbox of \p remote.
+             *
+             * \param[in]   remote      The RemotePeer whose path MTU is being probed.
+             * \param[in]   master      The Peer that will send the datagram. Should be the owner of \p remote.
+             * \param[in]   size        The size of the datagram on the wire, in bytes.
+             */
+            static PacketQueue::OutgoingDatagram*   MakeProbe(RemotePeer& remote, Peer* master, size_t size);
         };
 
         /// \endcond
@@ -12,34 +12,39 @@
 
 using namespace wirefox::detail;
 
+// C++14 still needs a definition for static constexpr members that are bound to a reference, e.g. by std::min()
+constexpr size_t DatagramHeader::DATA_HEADER_LENGTH;
+constexpr size_t DatagramHeader::MAX_ACKS;
+constexpr size_t DatagramHeader::CONNECTION_ID_LENGTH;
+
 void DatagramHeader::Serialize(BinaryStream& outstream) const {
     // control flags
     outstream.WriteBool(flag_data);
     outstream.WriteBool(flag_link);
     outstream.WriteBool(!acks.empty());
     outstream.WriteBool(!nacks.empty());
+    outstream.WriteBool(flag_padding);
 
     //outstream.Align();
     outstream.WriteInt32(datagramID);
 
     // acknowledgements
     if (!acks.empty()) {
-        const size_t numAcks = std::min(acks.size(), static_cast<size_t>(256));
-        assert(numAcks > 0);
+        const size_t numAcks = std::min(acks.size(), MAX_ACKS);
 
+        // the count must match the ids that follow, so any that don't fit are left out
         outstream.WriteByte(static_cast<uint8_t>(numAcks - 1));
-        for (auto id : acks)
-            outstream.WriteInt32(id);
+        for (size_t i = 0; i < numAcks; i++)
+            outstream.WriteInt32(acks[i]);
     }
 
     // non-acknowledgements
     if (!nacks.empty()) {
-        const size_t numNacks = std::min(nacks.size(), static_cast<size_t>(256));
-        assert(numNacks > 0);
+        const size_t numNacks = std::min(nacks.size(), MAX_ACKS);
 
         outstream.WriteByte(static_cast<uint8_t>(numNacks - 1));
-        for (auto id : nacks)
-            outstream.WriteInt32(id);
+        for (size_t i = 0; i < numNacks; i++)
+            outstream.WriteInt32(nacks[i]);
     }
 
     // payload
@@ -58,12 +63,16 @@ bool DatagramHeader::Deserialize(BinaryStream& instream) {
     flag_link = instream.ReadBool();
     const bool hasAcks = instream.ReadBool();
     const bool hasNacks = instream.ReadBool();
+    flag_padding = instream.ReadBool();
 
     // instream.Align();
     datagramID = instream.ReadUInt32();
 
     if (hasAcks) {
         const int numAcks = instream.ReadByte() + 1; // zero-indexed, so 0x00 means 1 ack
+        if (instream.IsEOF(numAcks * sizeof(DatagramID)))
+            return false;
+
         acks.clear();
         acks.reserve(numAcks);
         for (int i = 0; i < numAcks; i++)
@@ -72,6 +81,9 @@ bool DatagramHeader::Deserialize(BinaryStream& instream) {
 
     if (hasNacks) {
         const int numNacks = instream.ReadByte() + 1;
+        if (instream.IsEOF(numNacks * sizeof(DatagramID)))
+            return false;
+
         nacks.clear();
         nacks.reserve(numNacks);
         for (int i = 0; i < numNacks; i++)
@@ -79,7 +91,7 @@ bool DatagramHeader::Deserialize(BinaryStream& instream) {
     }
 
     if (flag_data) {
-        if (instream.IsEOF(sizeof(uint32_t)))
+        if (instream.IsEOF(sizeof(uint16_t)))
             return false;
 
         dataLength = instream.ReadUInt16();
@@ -92,3 +104,19 @@ bool DatagramHeader::Deserialize(BinaryStream& instream) {
 
     return true;
 }
+
+void DatagramHeader::WriteConnectionID(uint8_t* buffer, ConnectionID id) noexcept {
+    for (size_t i = 0; i < CONNECTION_ID_LENGTH; i++)
+        buffer[i] = static_cast<uint8_t>(id >> (8 * (CONNECTION_ID_LENGTH - 1 - i)));
+}
+
+ConnectionID DatagramHeader::PeekConnectionID(const uint8_t* buffer, size_t length) noexcept {
+    if (length < CONNECTION_ID_LENGTH)
+        return 0;
+
+    ConnectionID id = 0;
+    for (size_t i = 0; i < CONNECTION_ID_LENGTH; i++)
+        id = (id << 8) | buffer[i];
+
+    return id;
+}
@@ -23,6 +23,9 @@ namespace wirefox {
          * \brief Represents a header for a full datagram.
          * 
          * A datagram may contain zero or more PacketHeaders, each of which is followed by a Packet.
+         *
+         * Once a connection is set up, its datagrams may also be prefixed with a ConnectionID. That prefix is never
+         * encrypted, as the receiver needs it to find the connection, and with it the keys to decrypt the rest.
          */
         struct DatagramHeader {
             /// Indicates whether or not this datagram includes a payload (i.e. any packets).
@@ -31,6 +34,9 @@ namespace wirefox {
             /// Indicates whether the sender thinks it is connected to the receiver.
             bool        flag_link = false;
 
+            /// Indicates whether the rest of this datagram is padding, which only serves to probe the path MTU.
+            bool        flag_padding = false;
+
             /// Collection of DatagramIDs originally sent by receiver, which sender has succesfully received.
             std::vector<DatagramID> acks;
 
@@ -43,6 +49,15 @@ namespace wirefox {
             /// The length of this datagram's payload. Zero if flag_data unset.
             size_t      dataLength = 0;
 
+            /// The serialized length of a header for a datagram that carries a payload, but no acks or nacks.
+            static constexpr size_t DATA_HEADER_LENGTH = sizeof(uint8_t) + sizeof(DatagramID) + sizeof(uint16_t);
+
+            /// The maximum number of acks, and of nacks, that fit in a single header.
+            static constexpr size_t MAX_ACKS = 256;
+
+            /// The serialized length of the ConnectionID that may precede a datagram.
+            static constexpr size_t CONNECTION_ID_LENGTH = sizeof(ConnectionID);
+
             DatagramHeader() = default;
 
             /**
@@ -59,6 +74,26 @@ namespace wirefox {
              * \returns     True if a valid header was successfully read, false otherwise.
              */
             bool        Deserialize(BinaryStream& instream);
+
+            /**
+             * \brief Writes a ConnectionID prefix to a buffer.
+             *
+             * \param[out]  buffer      Pointer to at least CONNECTION_ID_LENGTH writable bytes.
+             * \param[in]   id          The ConnectionID to write.
+             */
+            static void WriteConnectionID(uint8_t* buffer, ConnectionID id) noexcept;
+
+            /**
+             * \brief Reads what would be the ConnectionID prefix of a received datagram.
+             *
+             * Whether the datagram actually has such a prefix is up to the caller to find out, e.g. by checking whether
+             * it matches any issued ConnectionID.
+             *
+             * \param[in]   buffer      The received datagram.
+             * \param[in]   length      The length of the datagram, in bytes.
+             * \returns     The prefix, or zero if the datagram is too short to have one.
+             */
+            static ConnectionID PeekConnectionID(const uint8_t* buffer, size_t length) noexcept;
         };
 
         /// \endcond
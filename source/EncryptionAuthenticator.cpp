@@ -12,27 +12,68 @@
 
 using namespace detail;
 
-EncryptionAuthenticator::EncryptionAuthenticator(ConnectionOrigin origin, EncryptionLayer& crypto)
+EncryptionAuthenticator::EncryptionAuthenticator(ConnectionOrigin origin, EncryptionLayer& crypto, PeerID localID)
     : m_crypto(crypto)
     , m_origin(origin)
+    , m_localID(localID)
+    , m_ticket(0)
     , m_state(STATE_KEY_EXCHANGE)
     , m_enableCryptoAfterReply(false) {}
 
 void EncryptionAuthenticator::Begin(BinaryStream& outstream) {
     outstream.WriteByte(STATE_KEY_EXCHANGE);
     outstream.WriteBytes(m_crypto.GetEphemeralPublicKey());
+    outstream.WriteByte(m_crypto.GetSupportedCiphers());
     outstream.WriteBool(m_crypto.GetNeedsChallenge());
     m_state = STATE_KEY_EXCHANGE;
 }
 
-ConnectResult EncryptionAuthenticator::Handle(BinaryStream& instream, BinaryStream& outstream) {
+bool EncryptionAuthenticator::BeginResume(const BinaryStream& ticket, BinaryStream& outstream) {
+    assert(m_origin == ConnectionOrigin::SELF);
+    return m_crypto.BeginResume(ticket, outstream);
+}
+
+bool EncryptionAuthenticator::HandleResume(PeerID remoteID, BinaryStream& instream, BinaryStream& outstream) {
+    switch (m_origin) {
+    case ConnectionOrigin::SELF:
+        // server accepted our ticket and sent its half of the new keys
+        if (!m_crypto.HandleResumeReply(instream))
+            return false;
+
+        // both endpoints have the keys now, so unlike a key exchange, even the server's reply was already fine to encrypt
+        m_crypto.SetCryptoEstablished();
+        ReadTicket(instream);
+
+        m_state = STATE_DONE;
+        outstream.WriteByte(STATE_DONE);
+        return true;
+
+    case ConnectionOrigin::REMOTE:
+        if (!m_crypto.HandleResumeRequest(m_localID, remoteID, instream, outstream))
+            return false;
+
+        // tickets are single-use on the client, so replace the one that was just spent
+        WriteTicket(remoteID, outstream);
+
+        // the client can only derive the keys once it has our reply, so that must go out unencrypted
+        m_enableCryptoAfterReply = true;
+        m_state = STATE_DONE;
+        return true;
+
+    default:
+        assert(false);
+        return false;
+    }
+}
+
+ConnectResult EncryptionAuthenticator::Handle(PeerID remoteID, BinaryStream& instream, BinaryStream& outstream) {
     // discard auth packets that are currently unexpected (possibly duplicate, or hostile)
     if (instream.ReadByte() != m_state)
         return ConnectResult::IN_PROGRESS;
 
     switch (m_state) {
     case STATE_KEY_EXCHANGE:
-        return HandleKeyExchange(instream, outstream);
+        return HandleKeyExchange(remoteID, instream, outstream);
     case STATE_AUTHENTICATION:
         return HandleAuth(instream, outstream);
     case STATE_DONE:
@@ -51,7 +92,7 @@ void EncryptionAuthenticator::PostHandle() {
     m_crypto.SetCryptoEstablished();
 }
 
-ConnectResult EncryptionAuthenticator::HandleKeyExchange(BinaryStream& instream, BinaryStream& outstream) {
+ConnectResult EncryptionAuthenticator::HandleKeyExchange(PeerID remoteID, BinaryStream& instream, BinaryStream& outstream) {
     // read out the remote public key into a buffer
     const auto keylen = cfg::DefaultEncryption::GetKeyLength();
     BinaryStream remoteKey(keylen);
@@ -59,13 +100,18 @@ ConnectResult EncryptionAuthenticator::HandleKeyExchange(BinaryStream& instream,
     remoteKey.SeekToBegin();
     instream.ReadBytes(remoteKey.GetWritableBuffer(), keylen);
 
+    // both endpoints list the ciphers they support alongside their key, so they can each pick the same one
+    if (!m_crypto.NegotiateCipher(instream.ReadByte()))
+        return ConnectResult::INCOMPATIBLE_SECURITY;
+
     // pass the buffer to the crypto layer, so the key exchange can be completed
     if (!m_crypto.HandleKeyExchange(m_origin, remoteKey))
         return ConnectResult::INCORRECT_REMOTE_IDENTITY;
 
     switch (m_origin) {
     case ConnectionOrigin::SELF:
-        // server just sent us their part of the key xchg
+        // server just sent us their part of the key xchg, and possibly a ticket for next time
+        ReadTicket(instream);
 
         // our next message must be sent with crypto! only kx is done unencrypted
         m_crypto.SetCryptoEstablished();
@@ -87,6 +133,8 @@ ConnectResult EncryptionAuthenticator::HandleKeyExchange(BinaryStream& instream,
         // give the client our ephemeral public key, for the key xchg
         outstream.WriteByte(STATE_KEY_EXCHANGE);
         outstream.WriteBytes(m_crypto.GetEphemeralPublicKey());
+        outstream.WriteByte(m_crypto.GetSupportedCiphers());
+        WriteTicket(remoteID, outstream);
 
         // only actually enable crypto AFTER this kx packet goes out, because client needs to have our unencrypted kx key first
         m_enableCryptoAfterReply = true;
@@ -127,3 +175,16 @@ ConnectResult EncryptionAuthenticator::HandleAuth(BinaryStream& instream, Binary
         return ConnectResult::OK;
     }
 }
+
+void EncryptionAuthenticator::WriteTicket(PeerID remoteID, BinaryStream& outstream) {
+    BinaryStream ticket(0);
+    m_crypto.WriteTicket(m_localID, remoteID, ticket);
+
+    outstream.WriteByte(static_cast<uint8_t>(ticket.GetLength()));
+    outstream.WriteBytes(ticket);
+}
+
+void EncryptionAuthenticator::ReadTicket(BinaryStream& instream) {
+    if (instream.ReadByte() == 0) return;
+    m_ticket = m_crypto.ReadTicket(instream);
+}
@@ -26,8 +26,9 @@ namespace wirefox {
              * \brief Construct a new instance of EncryptionAuthenticator.
              * \param[in]   origin      Specifies which party initiated this connection.
              * \param[in]   crypto      The EncryptionLayer instance that must be configured.
+             * \param[in]   localID     The PeerID of the local peer, which session tickets are bound to.
              */
-            EncryptionAuthenticator(ConnectionOrigin origin, EncryptionLayer& crypto);
+            EncryptionAuthenticator(ConnectionOrigin origin, EncryptionLayer& crypto, PeerID localID);
             EncryptionAuthenticator(const EncryptionAuthenticator&) = delete;
             EncryptionAuthenticator(EncryptionAuthenticator&&) = delete;
             ~EncryptionAuthenticator() = default;
@@ -45,13 +46,38 @@ namespace wirefox {
              */
             void Begin(BinaryStream& outstream);
 
+            /**
+             * \brief Writes a request to resume an earlier session, to be sent instead of calling Begin() later.
+             *
+             * Meant to be used by the initiating peer, before the basic handshake starts.
+             *
+             * \param[in]   ticket      A ticket obtained through GetTicket() after an earlier handshake with the same remote.
+             * \param[out]  outstream   Stream to be sent to the remote endpoint.
+             * \returns False if the ticket can't be used, in which case nothing is written.
+             */
+            bool BeginResume(const BinaryStream& ticket, BinaryStream& outstream);
+
+            /**
+             * \brief Handles a request written by BeginResume(), or the reply to it.
+             *
+             * If this returns true, the session keys are in place and the cryptographic handshake is skipped: the server
+             * waits for the final acknowledgement, and the client should send the response right away and is done.
+             *
+             * \param[in]   remoteID    The PeerID of the remote endpoint.
+             * \param[in]   instream    Stream that contains the message written by the remote endpoint.
+             * \param[out]  outstream   Response to be sent to the remote endpoint.
+             * \returns False if the session could not be resumed, in which case a full handshake is needed.
+             */
+            bool HandleResume(PeerID remoteID, BinaryStream& instream, BinaryStream& outstream);
+
             /**
              * \brief Handles an incoming message from a remote EncryptionAuthenticator.
              * 
+             * \param[in]   remoteID    The PeerID of the remote endpoint.
              * \param[in]   instream    Stream that contains the message written by the remote endpoint.
              * \param[out]  outstream   Response to be sent to the remote endpoint.
              */
-            ConnectResult Handle(BinaryStream& instream, BinaryStream& outstream);
+            ConnectResult Handle(PeerID remoteID, BinaryStream& instream, BinaryStream& outstream);
 
             /**
              * \brief Finalizes handling of a message.
@@ -60,12 +86,24 @@ namespace wirefox {
              */
             void PostHandle();
 
+            /**
+             * \brief Returns the ticket the remote endpoint handed out for resuming this session later.
+             *
+             * Only the initiating peer receives tickets. The stream is empty if the remote did not issue one, and should
+             * be ignored unless the handshake succeeds.
+             */
+            const BinaryStream& GetTicket() const { return m_ticket; }
+
         private:
-            ConnectResult HandleKeyExchange(BinaryStream& instream, BinaryStream& outstream);
+            ConnectResult HandleKeyExchange(PeerID remoteID, BinaryStream& instream, BinaryStream& outstream);
             ConnectResult HandleAuth(BinaryStream& instream, BinaryStream& outstream);
+            void WriteTicket(PeerID remoteID, BinaryStream& outstream);
+            void ReadTicket(BinaryStream& instream);
 
             EncryptionLayer& m_crypto;
             ConnectionOrigin m_origin;
+            PeerID m_localID;
+            BinaryStream m_ticket;
 
             enum {
                 STATE_KEY_EXCHANGE,
@@ -52,7 +52,7 @@ namespace wirefox {
              * If a cryptographic operation fails, or if a verification operation fails, or if the
              * implementation believes the connected party is compromised, this function returns true.
              * 
-             * This should be tested after calling HandleKeyExchange(), Encrypt(), or Decrypt().
+             * This should be tested after calling HandleKeyExchange(), EncryptInPlace(), or DecryptInPlace().
              */
             virtual bool GetNeedsToBail() const = 0;
 
@@ -148,20 +148,104 @@ namespace wirefox {
             virtual void ExpectRemoteIdentity(BinaryStream& pubkey) = 0;
 
             /**
-             * \brief Encrypts a piece of data into a ciphertext.
-             * 
-             * \param[in]   plaintext   The message that should be encrypted.
-             * \returns An opaque blob representing the ciphertext. May be longer than \p plaintext, if needed.
+             * \brief Returns a bitmask of the ciphers this layer supports.
+             *
+             * As part of the key exchange, this mask should be sent to the other party. Its meaning is up to the implementation.
              */
-            virtual BinaryStream Encrypt(const BinaryStream& plaintext) = 0;
+            virtual uint8_t GetSupportedCiphers() const = 0;
 
             /**
-             * \brief Decrypts a ciphertext into a plaintext.
-             * 
-             * \param[in]   ciphertext  The encrypted data, as received from the remote party.
-             * \returns The decrypted plaintext, on success. On failure, return value is undefined.
+             * \brief Selects the cipher that will be used for this connection.
+             *
+             * Both endpoints should call this with each other's GetSupportedCiphers() before HandleKeyExchange(),
+             * and will then agree on the same cipher.
+             *
+             * \param[in]   remoteCiphers   The mask returned by GetSupportedCiphers() on the remote endpoint.
+             * \returns False if the endpoints have no cipher in common.
+             */
+            virtual bool NegotiateCipher(uint8_t remoteCiphers) = 0;
+
+            /**
+             * \brief Encrypts a datagram in place.
+             *
+             * The GetHeadroom() bytes of \p datagram starting at \p offset are reserved for this layer, and the plaintext
+             * follows them. The plaintext is overwritten by the ciphertext, and the stream is extended by GetTailroom()
+             * bytes. Reserve that capacity upfront, so the stream does not need to reallocate.
+             *
+             * \param[in,out]  datagram    A stream containing the reserved headroom, followed by the plaintext.
+             * \param[in]      offset      The number of bytes in front of the headroom, which are left untouched.
+             * \returns The number of bytes at the start of \p datagram that precede the ciphertext, including \p offset.
+             */
+            virtual size_t EncryptInPlace(BinaryStream& datagram, size_t offset) = 0;
+
+            /**
+             * \brief Decrypts a ciphertext in place.
+             *
+             * A datagram may be rejected without GetNeedsToBail() being set, e.g. if it is a replay of an earlier
+             * datagram. Such datagrams should be discarded silently.
+             *
+             * \param[in,out]  buffer      The encrypted datagram, as received from the remote party. Will be overwritten.
+             * \param[in]      length      The length of the encrypted datagram, in bytes.
+             * \param[out]     plaintext   A readonly stream that wraps the plaintext inside \p buffer.
+             * \returns True if \p plaintext was set, false if the datagram was rejected.
+             */
+            virtual bool DecryptInPlace(uint8_t* buffer, size_t length, BinaryStream& plaintext) = 0;
+
+            /**
+             * \brief Writes a ticket that lets the remote endpoint resume this session later, without a key exchange.
+             *
+             * Meant to be used by the accepting peer (ConnectionOrigin::REMOTE) once the session keys are known. The
+             * ticket is opaque to the remote endpoint, and only valid for the given pair of PeerIDs. Implementations that
+             * do not support resumption write nothing.
+             *
+             * \param[in]   localID     The PeerID of the local peer.
+             * \param[in]   remoteID    The PeerID of the remote endpoint that the ticket is issued to.
+             * \param[out]  outstream   Stream to be sent to the remote endpoint.
+             */
+            virtual void WriteTicket(PeerID localID, PeerID remoteID, BinaryStream& outstream) = 0;
+
+            /**
+             * \brief Reads a ticket written by WriteTicket() on the remote endpoint.
+             *
+             * Meant to be used by the initiating peer (ConnectionOrigin::SELF) once the session keys are known.
+             *
+             * \returns The ticket, bundled with the secrets needed to use it, to be passed to BeginResume() later.
+             * Returns an empty stream if \p instream holds no valid ticket.
+             */
+            virtual BinaryStream ReadTicket(BinaryStream& instream) = 0;
+
+            /**
+             * \brief Writes a request to resume an earlier session, in place of a key exchange.
+             *
+             * Meant to be used by the initiating peer, on a fresh EncryptionLayer. Call ExpectRemoteIdentity() first if
+             * applicable: a session that was set up with a different expectation is not resumed.
+             *
+             * \param[in]   ticket      The stream returned by ReadTicket() during the earlier session.
+             * \param[out]  outstream   Stream to be sent to the remote endpoint.
+             * \returns False if the session cannot be resumed, in which case nothing is written.
+             */
+            virtual bool BeginResume(const BinaryStream& ticket, BinaryStream& outstream) = 0;
+
+            /**
+             * \brief Handles a request written by BeginResume() on the remote endpoint, and computes new session keys.
+             *
+             * Meant to be used by the accepting peer. The reply must be sent before calling SetCryptoEstablished().
+             *
+             * \param[in]   localID     The PeerID of the local peer.
+             * \param[in]   remoteID    The PeerID of the remote endpoint.
+             * \param[in]   instream    Stream that contains the request.
+             * \param[out]  outstream   Stream to be sent to the remote endpoint.
+             * \returns False if the ticket is not valid or was redeemed before, in which case a full key exchange is needed.
+             */
+            virtual bool HandleResumeRequest(PeerID localID, PeerID remoteID, BinaryStream& instream, BinaryStream& outstream) = 0;
+
+            /**
+             * \brief Handles the reply to BeginResume(), and computes new session keys.
+             *
+             * \param[in]   instream    Stream that contains the reply, as written by HandleResumeRequest().
+             * \returns False if the reply is malformed.
              */
-            virtual BinaryStream Decrypt(BinaryStream& ciphertext) = 0;
+            virtual bool HandleResumeReply(BinaryStream& instream) = 0;
         };
 
         /// \endcond
@@ -46,15 +46,41 @@ namespace wirefox {
             bool HandleChallengeIncoming(BinaryStream&, BinaryStream&) override { return true; }
             bool HandleChallengeResponse(BinaryStream&) override { return true; }
 
-            BinaryStream Encrypt(const BinaryStream& plaintext) override { return plaintext; }
-            BinaryStream Decrypt(BinaryStream& ciphertext) override { return ciphertext; }
+            uint8_t GetSupportedCiphers() const override { return 0; }
+            bool NegotiateCipher(uint8_t) override { return true; }
+            size_t EncryptInPlace(BinaryStream&, size_t offset) override { return offset; }
+            bool DecryptInPlace(uint8_t* buffer, size_t length, BinaryStream& plaintext) override {
+                plaintext = BinaryStream(buffer, length, BinaryStream::WrapMode::READONLY);
+                return true;
+            }
             void SetLocalIdentity(std::shared_ptr<Keypair>) override {}
 
+            void WriteTicket(PeerID, PeerID, BinaryStream&) override {}
+            BinaryStream ReadTicket(BinaryStream&) override { return BinaryStream(0); }
+            bool BeginResume(const BinaryStream&, BinaryStream&) override { return false; }
+            bool HandleResumeRequest(PeerID, PeerID, BinaryStream&, BinaryStream&) override { return false; }
+            bool HandleResumeReply(BinaryStream&) override { return false; }
+
+            /**
+             * \brief Checks whether a request written by BeginResume() holds a valid ticket, without changing any state.
+             */
+            static bool VerifyResumeRequest(PeerID, PeerID, BinaryStream&) { return false; }
+
             /**
              * \brief Returns the maximum amount of overhead added to a plaintext, in bytes.
              */
             static size_t GetOverhead() { return 0; }
 
+            /**
+             * \brief Returns the number of bytes that must be reserved in front of a plaintext passed to EncryptInPlace().
+             */
+            static size_t GetHeadroom() { return 0; }
+
+            /**
+             * \brief Returns the number of bytes EncryptInPlace() appends to a plaintext.
+             */
+            static size_t GetTailroom() { return 0; }
+
             /**
              * \brief Returns the length of the private or public key, in bytes.
              */
@@ -8,23 +8,157 @@
 
 #include "PCH.h"
 #include "EncryptionLayerSodium.h"
+#include "WirefoxTime.h"
 
 #ifdef WIREFOX_ENABLE_ENCRYPTION
 #define WIREFOX_SODIUM_MONITORING 0
 #include <sodium.h>
 
-static constexpr size_t WIREFOX_SODIUM_NONCE_LEN = crypto_secretbox_xchacha20poly1305_NONCEBYTES;
-static constexpr size_t WIREFOX_SODIUM_MAC_LEN = crypto_secretbox_xchacha20poly1305_MACBYTES;
+static constexpr size_t WIREFOX_SODIUM_NONCE_LEN = crypto_aead_xchacha20poly1305_ietf_NPUBBYTES;
+static constexpr size_t WIREFOX_SODIUM_MAC_LEN = crypto_aead_xchacha20poly1305_ietf_ABYTES;
+static constexpr size_t WIREFOX_SODIUM_COUNTER_LEN = sizeof(uint32_t);
+static constexpr size_t WIREFOX_SODIUM_COUNTER_NONCE_LEN = crypto_aead_chacha20poly1305_ietf_NPUBBYTES;
+
+static constexpr size_t WIREFOX_SODIUM_SECRET_LEN = crypto_kx_SESSIONKEYBYTES;
+static constexpr size_t WIREFOX_SODIUM_TICKET_PLAINTEXT_LEN = sizeof(uint32_t) + sizeof(uint8_t) + WIREFOX_SODIUM_SECRET_LEN;
+static constexpr size_t WIREFOX_SODIUM_TICKET_LEN = WIREFOX_SODIUM_NONCE_LEN + WIREFOX_SODIUM_TICKET_PLAINTEXT_LEN + WIREFOX_SODIUM_MAC_LEN;
+
+static_assert(crypto_aead_aes256gcm_NPUBBYTES == WIREFOX_SODIUM_COUNTER_NONCE_LEN, "counter nonce must fit both counter ciphers");
+static_assert(crypto_aead_chacha20poly1305_ietf_ABYTES == WIREFOX_SODIUM_MAC_LEN, "MAC length must be the same for all ciphers");
+static_assert(crypto_aead_aes256gcm_ABYTES == WIREFOX_SODIUM_MAC_LEN, "MAC length must be the same for all ciphers");
 
 using namespace detail;
 
 namespace {
 
-    BinaryStream PreallocateBuffer(const size_t len) {
-        BinaryStream buffer(len);
-        buffer.WriteZeroes(len); // advance length counter
-        buffer.SeekToBegin();
-        return buffer;
+    void WriteCounter(uint8_t* out, uint32_t counter) {
+        for (size_t i = 0; i < WIREFOX_SODIUM_COUNTER_LEN; i++)
+            out[i] = static_cast<uint8_t>(counter >> (i * 8));
+    }
+
+    uint32_t ReadCounter(const uint8_t* in) {
+        uint32_t counter = 0;
+        for (size_t i = 0; i < WIREFOX_SODIUM_COUNTER_LEN; i++)
+            counter |= static_cast<uint32_t>(in[i]) << (i * 8);
+        return counter;
+    }
+
+    void MakeCounterNonce(uint8_t* nonce, uint64_t counter) {
+        // the session keys differ per direction, so the counters of both directions may safely overlap
+        memset(nonce, 0, WIREFOX_SODIUM_COUNTER_NONCE_LEN);
+        for (size_t i = 0; i < sizeof counter; i++)
+            nonce[i] = static_cast<uint8_t>(counter >> (i * 8));
+    }
+
+    /**
+     * \brief Reconstructs a full 64-bit counter from the truncated counter that was sent on the wire.
+     *
+     * Picks whichever value with the given low bits lies closest to \p expected, so this works as long as datagrams
+     * are not reordered by more than 2^31 counters.
+     */
+    uint64_t ExpandCounter(uint64_t expected, uint32_t truncated) {
+        constexpr uint64_t span = uint64_t(1) << 32;
+        const uint64_t candidate = (expected & ~(span - 1)) | truncated;
+
+        if (candidate + span / 2 <= expected)
+            return candidate + span;
+        if (candidate > expected + span / 2 && candidate >= span)
+            return candidate - span;
+        return candidate;
+    }
+
+    /**
+     * \brief Hashes data into a key, with a one-byte label that separates keys derived from the same inputs.
+     *
+     * \param[out]  out     Receives WIREFOX_SODIUM_SECRET_LEN bytes.
+     * \param[in]   key     A secret of WIREFOX_SODIUM_SECRET_LEN bytes.
+     */
+    void DeriveKey(uint8_t* out, const uint8_t* key, uint8_t label, const uint8_t* data, size_t length) {
+        crypto_generichash_state state;
+        crypto_generichash_init(&state, key, WIREFOX_SODIUM_SECRET_LEN, WIREFOX_SODIUM_SECRET_LEN);
+        crypto_generichash_update(&state, &label, sizeof label);
+        crypto_generichash_update(&state, data, length);
+        crypto_generichash_final(&state, out, WIREFOX_SODIUM_SECRET_LEN);
+    }
+
+    /// Returns the key that seals the tickets issued by this process. Tickets become useless when the process exits.
+    const uint8_t* GetTicketKey() {
+        static const auto key = []() {
+            std::array<uint8_t, crypto_aead_xchacha20poly1305_ietf_KEYBYTES> ret;
+            if (sodium_init() < 0)
+                throw std::runtime_error("libsodium failed to init");
+            crypto_aead_xchacha20poly1305_ietf_keygen(ret.data());
+            return ret;
+        }();
+        return key.data();
+    }
+
+    /// Returns the time in seconds, for ticket expiry. Wraps around every 136 years.
+    uint32_t GetTicketClock() {
+        return static_cast<uint32_t>(static_cast<uint64_t>(Time::Now()) / 1000000000);
+    }
+
+    /// Writes the data a ticket is bound to: the PeerIDs of the endpoint that issued it, and of the one it was issued to.
+    void WriteTicketBinding(uint8_t* out, PeerID localID, PeerID remoteID) {
+        for (size_t i = 0; i < sizeof(PeerID); i++) {
+            out[i] = static_cast<uint8_t>(localID >> (i * 8));
+            out[sizeof(PeerID) + i] = static_cast<uint8_t>(remoteID >> (i * 8));
+        }
+    }
+
+    /// Identifies a ticket by its issue time and nonce. Sorting by issue time puts the ones that expire first in front.
+    using TicketID = std::pair<uint32_t, std::array<uint8_t, WIREFOX_SODIUM_NONCE_LEN>>;
+
+    /// Holds the tickets that were redeemed, until they expire. Like the ticket key, these are shared by the whole process.
+    struct SpentTickets {
+        cfg::LockableMutex  lock;
+        std::set<TicketID>  tickets;
+    };
+
+    SpentTickets& GetSpentTickets() {
+        static SpentTickets spent;
+        return spent;
+    }
+
+    TicketID MakeTicketID(const uint8_t* ticket, uint32_t issued) {
+        TicketID ret;
+        ret.first = issued;
+        std::copy(ticket, ticket + WIREFOX_SODIUM_NONCE_LEN, ret.second.begin());
+        return ret;
+    }
+
+    bool IsTicketSpent(const uint8_t* ticket, uint32_t issued) {
+        auto& spent = GetSpentTickets();
+        WIREFOX_LOCK_GUARD(spent.lock);
+        return spent.tickets.count(MakeTicketID(ticket, issued)) > 0;
+    }
+
+    /// Marks a ticket as redeemed. Returns false if it already was, e.g. because someone replayed the request it came in.
+    bool SpendTicket(const uint8_t* ticket, uint32_t issued) {
+        auto& spent = GetSpentTickets();
+        WIREFOX_LOCK_GUARD(spent.lock);
+
+        // only tickets this process issued end up here, so this set can't grow faster than legitimate resumptions
+        const uint32_t now = GetTicketClock();
+        while (!spent.tickets.empty() && now - spent.tickets.begin()->first > cfg::SESSION_TICKET_LIFETIME)
+            spent.tickets.erase(spent.tickets.begin());
+
+        return spent.tickets.insert(MakeTicketID(ticket, issued)).second;
+    }
+
+    /// Decrypts a ticket issued by this process, and checks that it is bound to these PeerIDs and has not expired or been redeemed.
+    bool OpenTicket(PeerID localID, PeerID remoteID, const uint8_t* ticket, uint8_t* plaintext) {
+        uint8_t binding[2 * sizeof(PeerID)];
+        WriteTicketBinding(binding, localID, remoteID);
+
+        if (crypto_aead_xchacha20poly1305_ietf_decrypt(plaintext, nullptr, nullptr,
+                ticket + WIREFOX_SODIUM_NONCE_LEN, WIREFOX_SODIUM_TICKET_LEN - WIREFOX_SODIUM_NONCE_LEN,
+                binding, sizeof binding, ticket, GetTicketKey()) != 0)
+            return false;
+
+        // the issue time is stored like a datagram counter
+        const uint32_t issued = ReadCounter(plaintext);
+        return GetTicketClock() - issued <= cfg::SESSION_TICKET_LIFETIME && !IsTicketSpent(ticket, issued);
     }
 
 #if WIREFOX_SODIUM_MONITORING
@@ -87,6 +221,12 @@ EncryptionLayerSodium::EncryptionLayerSodium()
     , m_issued_challenge{}
     , m_key_rx{}
     , m_key_tx{}
+    , m_resume_secret{}
+    , m_resume_nonce{}
+    , m_cipher(Cipher::XCHACHA20_POLY1305)
+    , m_tx_counter(0)
+    , m_rx_next(0)
+    , m_rx_window{}
     , m_error(false)
     , m_established(false)
     , m_remoteIdentityKnown(false)
@@ -102,7 +242,7 @@ EncryptionLayerSodium::EncryptionLayerSodium()
     if (sodium_init() < 0)
         throw std::runtime_error("libsodium failed to init");
 
-    m_kx = Keypair::CreateKeyExchange();
+    // the ephemeral keypair is generated on first use, so that constructing a layer is cheap
 }
 
 EncryptionLayerSodium::EncryptionLayerSodium(EncryptionLayerSodium&& other) noexcept
@@ -113,8 +253,9 @@ EncryptionLayerSodium::EncryptionLayerSodium(EncryptionLayerSodium&& other) noex
 EncryptionLayerSodium::~EncryptionLayerSodium() {
     // securely erase all keys from memory
     sodium_memzero(m_remote_identity_pk, KEY_LENGTH);
+    sodium_memzero(m_key_rx, KEY_LENGTH);
     sodium_memzero(m_key_tx, KEY_LENGTH);
-    sodium_memzero(m_key_tx, KEY_LENGTH);
+    sodium_memzero(m_resume_secret, KEY_LENGTH);
 }
 
 EncryptionLayerSodium& EncryptionLayerSodium::operator=(EncryptionLayerSodium&& other) noexcept {
@@ -130,7 +271,16 @@ EncryptionLayerSodium& EncryptionLayerSodium::operator=(EncryptionLayerSodium&&
         sodium_memzero(other.m_key_rx, sizeof m_key_rx);
         sodium_memzero(other.m_key_tx, sizeof m_key_tx);
 
-        m_error = other.m_error;
+        memcpy(m_resume_secret, other.m_resume_secret, sizeof m_resume_secret);
+        memcpy(m_resume_nonce, other.m_resume_nonce, sizeof m_resume_nonce);
+        sodium_memzero(other.m_resume_secret, sizeof m_resume_secret);
+
+        m_cipher = other.m_cipher;
+        m_tx_counter.store(other.m_tx_counter.load());
+        m_rx_next = other.m_rx_next;
+        memcpy(m_rx_window, other.m_rx_window, sizeof m_rx_window);
+
+        m_error.store(other.m_error.load());
         m_established = other.m_established;
         m_remoteIdentityKnown = other.m_remoteIdentityKnown;
         m_remoteAuthExpected = other.m_remoteAuthExpected;
@@ -150,16 +300,28 @@ size_t EncryptionLayerSodium::GetOverhead() {
     return WIREFOX_SODIUM_NONCE_LEN + WIREFOX_SODIUM_MAC_LEN;
 }
 
+size_t EncryptionLayerSodium::GetHeadroom() {
+    return WIREFOX_SODIUM_NONCE_LEN;
+}
+
+size_t EncryptionLayerSodium::GetTailroom() {
+    return WIREFOX_SODIUM_MAC_LEN;
+}
+
+EncryptionLayerSodium::Cipher EncryptionLayerSodium::GetCipher() const {
+    return m_cipher;
+}
+
 size_t EncryptionLayerSodium::GetKeyLength() {
     return KEY_LENGTH;
 }
 
 BinaryStream EncryptionLayerSodium::GetEphemeralPublicKey() const {
 #if WIREFOX_SODIUM_MONITORING
-    PrintKeyToStdout("kxpk = ", m_kx->key_public);
+    PrintKeyToStdout("kxpk = ", GetKeyExchangeKeypair().key_public);
 #endif
     BinaryStream ret(KEY_LENGTH);
-    ret.WriteBytes(m_kx->key_public, KEY_LENGTH);
+    ret.WriteBytes(GetKeyExchangeKeypair().key_public, KEY_LENGTH);
     ret.SeekToBegin();
     return ret;
 }
@@ -203,13 +365,14 @@ bool EncryptionLayerSodium::HandleKeyExchange(ConnectionOrigin origin, BinaryStr
 #endif
 
     // compute session keys now that we know all required keys
+    const auto& kx = GetKeyExchangeKeypair();
     switch (origin) {
     case ConnectionOrigin::SELF:
-        if (crypto_kx_client_session_keys(m_key_rx, m_key_tx, m_kx->key_public, m_kx->key_secret, remotekey) != 0)
+        if (crypto_kx_client_session_keys(m_key_rx, m_key_tx, kx.key_public, kx.key_secret, remotekey) != 0)
             m_error = true;
         break;
     case ConnectionOrigin::REMOTE:
-        if (crypto_kx_server_session_keys(m_key_rx, m_key_tx, m_kx->key_public, m_kx->key_secret, remotekey) != 0)
+        if (crypto_kx_server_session_keys(m_key_rx, m_key_tx, kx.key_public, kx.key_secret, remotekey) != 0)
             m_error = true;
         break;
     default:
@@ -260,50 +423,302 @@ void EncryptionLayerSodium::ExpectRemoteIdentity(BinaryStream& pubkey) {
     pubkey.ReadBytes(m_remote_identity_pk, KEY_LENGTH);
 }
 
-BinaryStream EncryptionLayerSodium::Encrypt(const BinaryStream& plaintext) {
-    // allocate a buffer long enough to hold the full ciphertext
-    const size_t ciphertext_len_full = plaintext.GetLength() + WIREFOX_SODIUM_MAC_LEN + WIREFOX_SODIUM_NONCE_LEN;
-    BinaryStream ciphertext = PreallocateBuffer(ciphertext_len_full);
-    auto* ciphertext_ptr = ciphertext.GetWritableBuffer() + WIREFOX_SODIUM_NONCE_LEN;
+uint8_t EncryptionLayerSodium::GetSupportedCiphers() const {
+    // random nonces are always supported, so that there is something to fall back to
+    uint8_t ciphers = static_cast<uint8_t>(Cipher::XCHACHA20_POLY1305);
 
-    // get a random nonce, and add it to the full ciphertext as prefix
-    uint8_t nonce[WIREFOX_SODIUM_NONCE_LEN];
-    randombytes_buf(nonce, sizeof nonce);
-    ciphertext.WriteBytes(nonce, sizeof nonce);
+    if (cfg::ENCRYPTION_COUNTER_NONCES) {
+        ciphers |= static_cast<uint8_t>(Cipher::CHACHA20_POLY1305);
 
-    // encrypt the plaintext and write it to the output BinaryStream
-    crypto_secretbox_xchacha20poly1305_easy(ciphertext_ptr, plaintext.GetBuffer(), plaintext.GetLength(), nonce, m_key_tx);
+        if (cfg::ENCRYPTION_PREFER_AES && crypto_aead_aes256gcm_is_available())
+            ciphers |= static_cast<uint8_t>(Cipher::AES256_GCM);
+    }
 
-    ciphertext.SeekToBegin();
-    return ciphertext;
+    return ciphers;
 }
 
-BinaryStream EncryptionLayerSodium::Decrypt(BinaryStream& ciphertext) {
-    // read out the nonce from the stream
-    uint8_t nonce[WIREFOX_SODIUM_NONCE_LEN];
-    assert(ciphertext.GetPosition() == 0);  // because we do pointer arithmetic below, which assumes the full ciphertext starts at GetBuffer().
-    ciphertext.SeekToBegin();               // but set it anyway, just to be safe
-    ciphertext.ReadBytes(nonce, sizeof nonce);
+bool EncryptionLayerSodium::NegotiateCipher(uint8_t remoteCiphers) {
+    const uint8_t common = GetSupportedCiphers() & remoteCiphers;
+
+    // both endpoints walk the same list, so they will agree without another round trip
+    for (Cipher cipher : {Cipher::AES256_GCM, Cipher::CHACHA20_POLY1305, Cipher::XCHACHA20_POLY1305}) {
+        if (common & static_cast<uint8_t>(cipher)) {
+            m_cipher = cipher;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+size_t EncryptionLayerSodium::EncryptInPlace(BinaryStream& datagram, size_t offset) {
+    // the caller should have left room for the nonce in front of the plaintext
+    assert(datagram.GetLength() >= offset + WIREFOX_SODIUM_NONCE_LEN);
+    const size_t plaintext_len = datagram.GetLength() - offset - WIREFOX_SODIUM_NONCE_LEN;
+
+    // append room for the MAC; this only reallocates if the caller did not reserve the tailroom
+    datagram.SeekToEnd();
+    datagram.WriteZeroes(WIREFOX_SODIUM_MAC_LEN);
+    datagram.SeekToBegin();
+
+    auto* headroom = datagram.GetWritableBuffer() + offset;
+    auto* message = headroom + WIREFOX_SODIUM_NONCE_LEN;
+    auto* mac = message + plaintext_len;
+
+    switch (m_cipher) {
+    case Cipher::XCHACHA20_POLY1305: {
+        // get a random nonce, and store it in the headroom as prefix
+        auto* nonce = headroom;
+        randombytes_buf(nonce, WIREFOX_SODIUM_NONCE_LEN);
+
+        // encrypt the plaintext over itself, and write the MAC into the tailroom
+        if (crypto_aead_xchacha20poly1305_ietf_encrypt_detached(message, mac, nullptr, message, plaintext_len, nullptr, 0, nullptr, nonce, m_key_tx) != 0)
+            m_error = true;
+
+        return offset;
+    }
+    case Cipher::CHACHA20_POLY1305:
+    case Cipher::AES256_GCM: {
+        // only the low bits of the counter go out, right in front of the ciphertext; the rest of the headroom is unused
+        const uint64_t counter = m_tx_counter.fetch_add(1);
+        uint8_t nonce[WIREFOX_SODIUM_COUNTER_NONCE_LEN];
+        MakeCounterNonce(nonce, counter);
+        WriteCounter(message - WIREFOX_SODIUM_COUNTER_LEN, static_cast<uint32_t>(counter));
+
+        int result;
+        if (m_cipher == Cipher::AES256_GCM)
+            result = crypto_aead_aes256gcm_encrypt_detached(message, mac, nullptr, message, plaintext_len, nullptr, 0, nullptr, nonce, m_key_tx);
+        else
+            result = crypto_aead_chacha20poly1305_ietf_encrypt_detached(message, mac, nullptr, message, plaintext_len, nullptr, 0, nullptr, nonce, m_key_tx);
+
+        if (result != 0)
+            m_error = true;
+
+        return offset + WIREFOX_SODIUM_NONCE_LEN - WIREFOX_SODIUM_COUNTER_LEN;
+    }
+    default:
+        assert(false && "invalid Cipher in EncryptionLayerSodium::EncryptInPlace");
+        m_error = true;
+        return offset;
+    }
+}
+
+bool EncryptionLayerSodium::DecryptInPlace(uint8_t* buffer, size_t length, BinaryStream& plaintext) {
+    const bool counterNonce = m_cipher != Cipher::XCHACHA20_POLY1305;
+    const size_t prefix_len = counterNonce ? WIREFOX_SODIUM_COUNTER_LEN : WIREFOX_SODIUM_NONCE_LEN;
 
     // prevent buffer overread if ciphertext is too small to actually contain a proper ciphertext
-    if (ciphertext.GetLength() < WIREFOX_SODIUM_MAC_LEN + WIREFOX_SODIUM_NONCE_LEN) {
+    if (length < prefix_len + WIREFOX_SODIUM_MAC_LEN) {
         m_error = true;
-        return ciphertext;
+        return false;
     }
 
-    const auto* ciphertext_ptr = ciphertext.GetBuffer() + WIREFOX_SODIUM_NONCE_LEN;
-    const size_t ciphertext_len = ciphertext.GetLength() - WIREFOX_SODIUM_NONCE_LEN;
-    const size_t plaintext_len = ciphertext_len - WIREFOX_SODIUM_MAC_LEN;
+    auto* message = buffer + prefix_len;
+    const size_t plaintext_len = length - prefix_len - WIREFOX_SODIUM_MAC_LEN;
+    const auto* mac = message + plaintext_len;
+    int result;
+
+    if (counterNonce) {
+        // duplicates and very late datagrams are dropped quietly; anything reliable in them will be resent anyway
+        const uint64_t counter = ExpandCounter(m_rx_next, ReadCounter(buffer));
+        if (!GetCounterIsFresh(counter))
+            return false;
+
+        uint8_t nonce[WIREFOX_SODIUM_COUNTER_NONCE_LEN];
+        MakeCounterNonce(nonce, counter);
+
+        if (m_cipher == Cipher::AES256_GCM)
+            result = crypto_aead_aes256gcm_decrypt_detached(message, nullptr, message, plaintext_len, mac, nullptr, 0, nonce, m_key_rx);
+        else
+            result = crypto_aead_chacha20poly1305_ietf_decrypt_detached(message, nullptr, message, plaintext_len, mac, nullptr, 0, nonce, m_key_rx);
 
-    // allocate a buffer long enough to hold the decrypted plaintext
-    BinaryStream plaintext = PreallocateBuffer(plaintext_len);
-    assert(plaintext.GetCapacity() >= plaintext_len);
+        // only a genuine datagram may move the replay window, otherwise forged counters could be used to shift it
+        if (result == 0)
+            MarkCounterSeen(counter);
 
-    // perform decryption
-    if (crypto_secretbox_xchacha20poly1305_open_easy(plaintext.GetWritableBuffer(), ciphertext_ptr, ciphertext_len, nonce, m_key_rx) != 0)
+    } else {
+        // the plaintext overwrites the ciphertext, so it ends up right behind the nonce
+        result = crypto_aead_xchacha20poly1305_ietf_decrypt_detached(message, nullptr, message, plaintext_len, mac, nullptr, 0, buffer, m_key_rx);
+    }
+
+    if (result != 0) {
         m_error = true;
+        return false;
+    }
+
+    plaintext = BinaryStream(message, plaintext_len, BinaryStream::WrapMode::READONLY);
+    return true;
+}
+
+void EncryptionLayerSodium::WriteTicket(PeerID localID, PeerID remoteID, BinaryStream& outstream) {
+    WriteTicket(localID, remoteID, outstream, 0);
+}
+
+void EncryptionLayerSodium::WriteTicket(PeerID localID, PeerID remoteID, BinaryStream& outstream, unsigned int age) {
+    if (cfg::SESSION_TICKET_LIFETIME == 0) return;
+
+    uint8_t plaintext[WIREFOX_SODIUM_TICKET_PLAINTEXT_LEN];
+    WriteCounter(plaintext, GetTicketClock() - age);
+    plaintext[sizeof(uint32_t)] = static_cast<uint8_t>(m_cipher);
+    GetResumptionSecret(plaintext + sizeof(uint32_t) + sizeof(uint8_t));
+
+    uint8_t binding[2 * sizeof(PeerID)];
+    WriteTicketBinding(binding, localID, remoteID);
+
+    // the ticket is sealed with a key only this process knows, so the remote can't read or alter it
+    uint8_t ticket[WIREFOX_SODIUM_TICKET_LEN];
+    randombytes_buf(ticket, WIREFOX_SODIUM_NONCE_LEN);
+    crypto_aead_xchacha20poly1305_ietf_encrypt(ticket + WIREFOX_SODIUM_NONCE_LEN, nullptr, plaintext, sizeof plaintext,
+        binding, sizeof binding, nullptr, ticket, GetTicketKey());
+    sodium_memzero(plaintext, sizeof plaintext);
+
+    outstream.WriteBytes(ticket, sizeof ticket);
+}
+
+BinaryStream EncryptionLayerSodium::ReadTicket(BinaryStream& instream) {
+    if (instream.IsEOF(WIREFOX_SODIUM_TICKET_LEN)) return BinaryStream(0);
+
+    uint8_t ticket[WIREFOX_SODIUM_TICKET_LEN];
+    instream.ReadBytes(ticket, sizeof ticket);
+
+    // the remote sealed the secret into the ticket, but we can compute it ourselves
+    uint8_t secret[KEY_LENGTH];
+    GetResumptionSecret(secret);
+
+    // also remember which identity was authenticated, so resuming can't bypass a different expectation later
+    BinaryStream ret(sizeof(uint8_t) * 2 + KEY_LENGTH * 2 + sizeof ticket);
+    ret.WriteByte(static_cast<uint8_t>(m_cipher));
+    ret.WriteByte(m_remoteIdentityKnown ? 1 : 0);
+    ret.WriteBytes(m_remote_identity_pk, KEY_LENGTH);
+    ret.WriteBytes(secret, KEY_LENGTH);
+    ret.WriteBytes(ticket, sizeof ticket);
+    ret.SeekToBegin();
+
+    sodium_memzero(secret, sizeof secret);
+    return ret;
+}
+
+bool EncryptionLayerSodium::BeginResume(const BinaryStream& ticket, BinaryStream& outstream) {
+    BinaryStream saved(ticket.GetBuffer(), ticket.GetLength(), BinaryStream::WrapMode::READONLY);
+    if (saved.IsEOF(sizeof(uint8_t) * 2 + KEY_LENGTH * 2 + WIREFOX_SODIUM_TICKET_LEN)) return false;
+
+    const uint8_t cipher = saved.ReadByte();
+    const bool identityKnown = saved.ReadByte() != 0;
+    uint8_t identity[KEY_LENGTH];
+    saved.ReadBytes(identity, KEY_LENGTH);
+
+    // a session that did not authenticate the identity we now expect can't stand in for a full handshake
+    if (m_remoteIdentityKnown && (!identityKnown || sodium_memcmp(identity, m_remote_identity_pk, KEY_LENGTH) != 0))
+        return false;
+    if ((GetSupportedCiphers() & cipher) == 0)
+        return false;
+
+    m_cipher = static_cast<Cipher>(cipher);
+    saved.ReadBytes(m_resume_secret, KEY_LENGTH);
+    randombytes_buf(m_resume_nonce, KEY_LENGTH);
+
+    // hand the ticket back, along with a fresh nonce so the new session keys differ from any earlier ones
+    outstream.WriteBytes(saved.GetBuffer() + saved.GetPosition(), WIREFOX_SODIUM_TICKET_LEN);
+    outstream.WriteBytes(m_resume_nonce, KEY_LENGTH);
+    return true;
+}
+
+bool EncryptionLayerSodium::VerifyResumeRequest(PeerID localID, PeerID remoteID, BinaryStream& instream) {
+    if (instream.IsEOF(WIREFOX_SODIUM_TICKET_LEN + KEY_LENGTH)) return false;
+
+    uint8_t ticket[WIREFOX_SODIUM_TICKET_LEN];
+    instream.ReadBytes(ticket, sizeof ticket);
+
+    uint8_t plaintext[WIREFOX_SODIUM_TICKET_PLAINTEXT_LEN];
+    const bool valid = OpenTicket(localID, remoteID, ticket, plaintext);
+    sodium_memzero(plaintext, sizeof plaintext);
+    return valid;
+}
+
+bool EncryptionLayerSodium::HandleResumeRequest(PeerID localID, PeerID remoteID, BinaryStream& instream, BinaryStream& outstream) {
+    if (instream.IsEOF(WIREFOX_SODIUM_TICKET_LEN + KEY_LENGTH)) return false;
+
+    uint8_t ticket[WIREFOX_SODIUM_TICKET_LEN];
+    uint8_t nonce_client[KEY_LENGTH];
+    instream.ReadBytes(ticket, sizeof ticket);
+    instream.ReadBytes(nonce_client, sizeof nonce_client);
+
+    uint8_t plaintext[WIREFOX_SODIUM_TICKET_PLAINTEXT_LEN];
+    const uint8_t* secret = plaintext + sizeof(uint32_t) + sizeof(uint8_t);
+    if (!OpenTicket(localID, remoteID, ticket, plaintext) || (GetSupportedCiphers() & plaintext[sizeof(uint32_t)]) == 0
+        || !SpendTicket(ticket, ReadCounter(plaintext))) {
+        sodium_memzero(plaintext, sizeof plaintext);
+        return false;
+    }
+
+    m_cipher = static_cast<Cipher>(plaintext[sizeof(uint32_t)]);
+
+    uint8_t nonce_server[KEY_LENGTH];
+    randombytes_buf(nonce_server, sizeof nonce_server);
+    DeriveResumedKeys(ConnectionOrigin::REMOTE, secret, nonce_client, nonce_server);
+    sodium_memzero(plaintext, sizeof plaintext);
+
+    outstream.WriteBytes(nonce_server, sizeof nonce_server);
+    return true;
+}
+
+bool EncryptionLayerSodium::HandleResumeReply(BinaryStream& instream) {
+    if (instream.IsEOF(KEY_LENGTH)) return false;
+
+    uint8_t nonce_server[KEY_LENGTH];
+    instream.ReadBytes(nonce_server, sizeof nonce_server);
+
+    DeriveResumedKeys(ConnectionOrigin::SELF, m_resume_secret, m_resume_nonce, nonce_server);
+    sodium_memzero(m_resume_secret, KEY_LENGTH);
+    return true;
+}
+
+void EncryptionLayerSodium::GetResumptionSecret(uint8_t* secret) const {
+    // both endpoints hold the same two keys, but each calls a different one rx; order them so they agree
+    const bool rxFirst = sodium_compare(m_key_rx, m_key_tx, KEY_LENGTH) < 0;
+    DeriveKey(secret, rxFirst ? m_key_rx : m_key_tx, 'R', rxFirst ? m_key_tx : m_key_rx, KEY_LENGTH);
+}
+
+void EncryptionLayerSodium::DeriveResumedKeys(ConnectionOrigin origin, const uint8_t* secret, const uint8_t* nonce_client, const uint8_t* nonce_server) {
+    uint8_t nonces[KEY_LENGTH * 2];
+    memcpy(nonces, nonce_client, KEY_LENGTH);
+    memcpy(nonces + KEY_LENGTH, nonce_server, KEY_LENGTH);
+
+    // one key per direction, like crypto_kx does
+    const bool isClient = origin == ConnectionOrigin::SELF;
+    DeriveKey(isClient ? m_key_tx : m_key_rx, secret, 'C', nonces, sizeof nonces);
+    DeriveKey(isClient ? m_key_rx : m_key_tx, secret, 'S', nonces, sizeof nonces);
+}
+
+const EncryptionLayerSodium::Keypair& EncryptionLayerSodium::GetKeyExchangeKeypair() const {
+    if (!m_kx)
+        m_kx = Keypair::CreateKeyExchange();
+
+    return *m_kx;
+}
+
+bool EncryptionLayerSodium::GetCounterIsFresh(uint64_t counter) const {
+    if (counter >= m_rx_next) return true;
+    if (m_rx_next - counter > cfg::ENCRYPTION_REPLAY_WINDOW) return false;
+
+    const size_t bit = counter % cfg::ENCRYPTION_REPLAY_WINDOW;
+    return (m_rx_window[bit / 64] & (uint64_t(1) << (bit % 64))) == 0;
+}
+
+void EncryptionLayerSodium::MarkCounterSeen(uint64_t counter) {
+    if (counter >= m_rx_next) {
+        // the slots of the counters that now fall out of the window are reused for the new counters, so clear them
+        const uint64_t advance = std::min<uint64_t>(counter + 1 - m_rx_next, cfg::ENCRYPTION_REPLAY_WINDOW);
+        for (uint64_t i = 0; i < advance; i++) {
+            const size_t bit = (m_rx_next + i) % cfg::ENCRYPTION_REPLAY_WINDOW;
+            m_rx_window[bit / 64] &= ~(uint64_t(1) << (bit % 64));
+        }
+
+        m_rx_next = counter + 1;
+    }
 
-    return plaintext;
+    const size_t bit = counter % cfg::ENCRYPTION_REPLAY_WINDOW;
+    m_rx_window[bit / 64] |= uint64_t(1) << (bit % 64);
 }
 
 #endif
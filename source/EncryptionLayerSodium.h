@@ -22,8 +22,19 @@ namespace wirefox {
         class EncryptionLayerSodium : public EncryptionLayer {
             static constexpr size_t KEY_LENGTH = 32;
             static constexpr size_t CHALLENGE_LENGTH = 64;
+            static constexpr size_t REPLAY_WINDOW_WORDS = cfg::ENCRYPTION_REPLAY_WINDOW / 64;
+
+            static_assert(cfg::ENCRYPTION_REPLAY_WINDOW > 0 && cfg::ENCRYPTION_REPLAY_WINDOW % 64 == 0,
+                "ENCRYPTION_REPLAY_WINDOW must be a positive multiple of 64");
 
         public:
+            /// Represents an AEAD construction that datagrams can be encrypted with. Values are bit flags.
+            enum class Cipher : uint8_t {
+                XCHACHA20_POLY1305  = 1 << 0,   ///< XChaCha20-Poly1305, with a random nonce sent along with every datagram.
+                CHACHA20_POLY1305   = 1 << 1,   ///< ChaCha20-Poly1305, with a nonce derived from a datagram counter.
+                AES256_GCM          = 1 << 2    ///< AES-256-GCM, with a nonce derived from a datagram counter. Requires AES-NI.
+            };
+
             /// Represents a public/private keypair suitable for use with libsodium's key exchange.
             class Keypair : public EncryptionLayer::Keypair {
                 friend class EncryptionLayerSodium;
@@ -82,24 +93,74 @@ namespace wirefox {
             void SetLocalIdentity(std::shared_ptr<EncryptionLayer::Keypair> keypair) override;
             void ExpectRemoteIdentity(BinaryStream& pubkey) override;
 
-            BinaryStream Encrypt(const BinaryStream& plaintext) override;
-            BinaryStream Decrypt(BinaryStream& ciphertext) override;
+            uint8_t GetSupportedCiphers() const override;
+            bool NegotiateCipher(uint8_t remoteCiphers) override;
+            size_t EncryptInPlace(BinaryStream& datagram, size_t offset) override;
+            bool DecryptInPlace(uint8_t* buffer, size_t length, BinaryStream& plaintext) override;
+
+            void WriteTicket(PeerID localID, PeerID remoteID, BinaryStream& outstream) override;
+
+            /**
+             * \brief Writes a ticket like WriteTicket(), but one that was issued \p age seconds ago.
+             *
+             * Mainly useful to check that tickets older than cfg::SESSION_TICKET_LIFETIME are refused.
+             */
+            void WriteTicket(PeerID localID, PeerID remoteID, BinaryStream& outstream, unsigned int age);
+            BinaryStream ReadTicket(BinaryStream& instream) override;
+            bool BeginResume(const BinaryStream& ticket, BinaryStream& outstream) override;
+            bool HandleResumeRequest(PeerID localID, PeerID remoteID, BinaryStream& instream, BinaryStream& outstream) override;
+            bool HandleResumeReply(BinaryStream& instream) override;
+
+            /**
+             * \brief Checks whether a request written by BeginResume() holds a valid ticket, without changing any state.
+             *
+             * This lets a peer decide whether to accept a request before allocating anything for the sender. A ticket
+             * is only valid until HandleResumeRequest() redeems it, so a captured request can't be replayed.
+             */
+            static bool VerifyResumeRequest(PeerID localID, PeerID remoteID, BinaryStream& instream);
+
+            /**
+             * \brief Returns the cipher that was selected by NegotiateCipher().
+             */
+            Cipher GetCipher() const;
 
             /**
              * \brief Returns the maximum amount of overhead added to a plaintext, in bytes.
              */
             static size_t GetOverhead();
 
+            /**
+             * \brief Returns the number of bytes that must be reserved in front of a plaintext passed to EncryptInPlace().
+             */
+            static size_t GetHeadroom();
+
+            /**
+             * \brief Returns the number of bytes EncryptInPlace() appends to a plaintext.
+             */
+            static size_t GetTailroom();
+
             /**
              * \brief Returns the length of the private or public key, in bytes.
              */
             static size_t GetKeyLength();
 
         private:
+            /// Computes the secret that a ticket for this session seals, from the session keys.
+            void GetResumptionSecret(uint8_t* secret) const;
+            /// Computes fresh session keys from a resumption secret and the nonces both endpoints contributed.
+            void DeriveResumedKeys(ConnectionOrigin origin, const uint8_t* secret, const uint8_t* nonce_client, const uint8_t* nonce_server);
+
+            /// Returns the ephemeral keypair, and generates it if that hasn't happened yet.
+            const Keypair& GetKeyExchangeKeypair() const;
+            /// Returns a value indicating whether a datagram with this counter has not been received yet.
+            bool GetCounterIsFresh(uint64_t counter) const;
+            /// Records that a datagram with this counter was received, and slides the replay window forward if needed.
+            void MarkCounterSeen(uint64_t counter);
+
             /// A handle to the local peer's keypair.
             std::shared_ptr<Keypair> m_identity;
-            /// A handle to the ephemeral keypair used for the key exchange.
-            std::shared_ptr<Keypair> m_kx;
+            /// A handle to the ephemeral keypair used for the key exchange. Generated on first use, see GetKeyExchangeKeypair().
+            mutable std::shared_ptr<Keypair> m_kx;
 
             /// The remote public key, if known beforehand.
             uint8_t m_remote_identity_pk[KEY_LENGTH];
@@ -112,7 +173,22 @@ namespace wirefox {
             /// Session key for encrypting outgoing messages.
             uint8_t m_key_tx[KEY_LENGTH];
 
-            bool m_error;
+            /// The secret of the session being resumed, between BeginResume() and HandleResumeReply().
+            uint8_t m_resume_secret[KEY_LENGTH];
+            /// The nonce sent by BeginResume(), which the new session keys depend on.
+            uint8_t m_resume_nonce[KEY_LENGTH];
+
+            /// The cipher used for datagrams in both directions.
+            Cipher m_cipher;
+            /// The counter of the next outgoing datagram, if the cipher uses counter nonces. Atomic, because out-of-band
+            /// datagrams encrypted with this layer may be written by another thread than the remote's own datagrams.
+            std::atomic<uint64_t> m_tx_counter;
+            /// One past the highest counter received so far, if the cipher uses counter nonces.
+            uint64_t m_rx_next;
+            /// Bitmap of the counters received within the replay window, indexed by counter modulo the window size.
+            uint64_t m_rx_window[REPLAY_WINDOW_WORDS];
+
+            std::atomic_bool m_error;
             bool m_established;
             bool m_remoteIdentityKnown;
             bool m_remoteAuthExpected;
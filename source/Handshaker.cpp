@@ -28,7 +28,7 @@ Handshaker::Handshaker(Peer* master, RemotePeer* remote, ConnectionOrigin origin
     , m_resendAttempts(0) {
     // set up authenticator if crypto enabled, so we can do the additional round trips
     if (m_peer->GetEncryptionEnabled())
-        m_auth = std::make_unique<EncryptionAuthenticator>(origin, *m_remote->crypto);
+        m_auth = std::make_unique<EncryptionAuthenticator>(origin, *m_remote->crypto, m_peer->GetMyPeerID());
 }
 
 void Handshaker::SetReplyHandler(ReplyHandler_t handler) {
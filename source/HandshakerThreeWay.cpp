@@ -11,24 +11,43 @@
 #include "Peer.h"
 #include "WirefoxConfigRefs.h"
 #include "EncryptionAuthenticator.h"
+#include "SipHash.h"
 
 using namespace wirefox::detail;
 
+static_assert(cfg::HANDSHAKE_COOKIE_LIFETIME > cfg::CONNECT_RETRY_COUNT * cfg::CONNECT_RETRY_DELAY,
+    "HANDSHAKE_COOKIE_LIFETIME must outlast all connection attempts");
+
 static constexpr size_t HANDSHAKE_HEADER_LEN =
     sizeof(cfg::WIREFOX_MAGIC) +    // magic number //-V119
     sizeof(uint8_t) +               // protocol version
     sizeof(PeerID) +                // peerID exchange
     sizeof(uint8_t);                // handshake stage
 
+namespace {
+
+    /// Returns the secret that authenticates the cookies issued by this process.
+    const SipHash::Key& GetCookieKey() {
+        static const SipHash::Key key = SipHash::CreateKey();
+        return key;
+    }
+
+}
+
 void HandshakerThreeWay::Begin() {
     // Begin should only be called if this local socket is the one initiating the connection
     assert(GetOrigin() == ConnectionOrigin::SELF);
 
+    // if we've been connected to this address before, try to pick up where we left off
+    if (m_auth) {
+        const BinaryStream ticket = m_peer->TakeResumeTicket(m_remote->addr);
+        if (!ticket.IsEmpty() && !m_auth->BeginResume(ticket, m_resumeRequest))
+            m_resumeRequest.Clear();
+    }
+
     // write a connection request and send it
     BinaryStream hello(HANDSHAKE_HEADER_LEN);
-    WriteReplyHeader(hello, m_peer->GetMyPeerID());
-    hello.WriteByte(INITIAL_CLIENT);
-    hello.WriteBool(m_peer->GetEncryptionEnabled());
+    WriteRequest(hello);
 
     m_expectedOpcode = INITIAL_SERVER;
     Reply(std::move(hello));
@@ -47,9 +66,9 @@ void HandshakerThreeWay::Handle(const Packet& packet) {
     if (instream.IsEOF(HANDSHAKE_HEADER_LEN)) {
         // handshake header not long enough, don't bother parsing it
         Complete(ConnectResult::INCOMPATIBLE_PROTOCOL);
+        return;
     }
 
-
     // read and compare the magic number, to make sure we're talking to a Wirefox endpoint
     uint8_t magic[sizeof cfg::WIREFOX_MAGIC] = {0};
     instream.ReadBytes(magic, sizeof cfg::WIREFOX_MAGIC);
@@ -108,11 +127,41 @@ void HandshakerThreeWay::Handle(const Packet& packet) {
             return;
         }
 
+        // from now on, put the client's connection ID in front of our connected datagrams
+        m_remote->remoteConnectionID = instream.ReadUInt64();
+
+        // the cookie was already checked by HandleOutOfBandRequest
+        instream.Skip(instream.ReadByte());
+
+        // if the client presented a valid ticket, reply with the new session keys and skip the key exchange
+        BinaryStream resumption(0);
+        const bool resumed = instream.ReadByte() > 0 && m_auth && m_auth->HandleResume(remoteID, instream, resumption);
+
         m_expectedOpcode = m_peer->GetEncryptionEnabled() ? AUTH_MSG : UNENCRYPTED_ACK;
         reply.WriteByte(INITIAL_SERVER);
         reply.WriteBool(m_peer->GetEncryptionEnabled());
+        reply.WriteBool(resumed);
+        reply.WriteInt64(m_remote->localConnectionID);
+        reply.WriteBytes(resumption);
         Reply(std::move(reply));
 
+        if (resumed)
+            m_auth->PostHandle();
+
+    } else if (m_expectedOpcode == INITIAL_SERVER && opcode == RETRY) {
+        // we're the client, and server wants proof that we're really at this address before it accepts our request
+        assert(GetOrigin() == ConnectionOrigin::SELF);
+        if (instream.IsEOF(sizeof(uint8_t) + COOKIE_LENGTH) || instream.ReadByte() != COOKIE_LENGTH) return;
+
+        instream.ReadBytes(m_cookie.data(), COOKIE_LENGTH);
+        m_hasCookie = true;
+
+        // repeat the request with the cookie in it. this counts as a resend, so a stream of bogus retries cannot
+        // keep this handshake alive forever
+        BinaryStream hello(HANDSHAKE_HEADER_LEN + COOKIE_LENGTH);
+        WriteRequest(hello);
+        Reply(std::move(hello), true);
+
     } else if (m_expectedOpcode == UNENCRYPTED_ACK && opcode == m_expectedOpcode) {
         // we're the server, and client just sent part 3 of the handshake
         assert(GetOrigin() == ConnectionOrigin::REMOTE);
@@ -123,6 +172,25 @@ void HandshakerThreeWay::Handle(const Packet& packet) {
         // we're the client, and server just replied to our initial request
         assert(GetOrigin() == ConnectionOrigin::SELF);
 
+        // the server's encryption preference was already checked against ours
+        instream.ReadBool();
+        const bool resumed = instream.ReadBool();
+        m_remote->remoteConnectionID = instream.ReadUInt64();
+
+        if (resumed && m_auth && !m_resumeRequest.IsEmpty()) {
+            // server accepted our ticket, so the keys are known and we only need to confirm that
+            reply.WriteByte(AUTH_MSG);
+            if (!m_auth->HandleResume(m_remote->id, instream, reply)) {
+                Complete(ConnectResult::INCOMPATIBLE_SECURITY);
+                return;
+            }
+
+            m_peer->SetResumeTicket(m_remote->addr, m_auth->GetTicket());
+            Reply(std::move(reply));
+            Complete(ConnectResult::OK);
+            return;
+        }
+
         if (m_peer->GetEncryptionEnabled()) {
             // basic handshake is now finished, begin crypto key exchange
             reply.WriteByte(AUTH_MSG);
@@ -139,14 +207,16 @@ void HandshakerThreeWay::Handle(const Packet& packet) {
 
     } else if (m_expectedOpcode == AUTH_MSG && opcode == m_expectedOpcode) {
         reply.WriteByte(AUTH_MSG);
-        auto authresult = m_auth->Handle(instream, reply);
+        auto authresult = m_auth->Handle(m_remote->id, instream, reply);
 
         // send intermediate messages to remote party
         if (!reply.IsEmpty())
             Reply(std::move(reply));
         m_auth->PostHandle();
 
-        // mark handshake result
+        // mark handshake result, and hold on to the ticket the server gave us now that it's proven who it is
+        if (authresult == ConnectResult::OK && GetOrigin() == ConnectionOrigin::SELF)
+            m_peer->SetResumeTicket(m_remote->addr, m_auth->GetTicket());
         if (authresult != ConnectResult::IN_PROGRESS) {
             Complete(authresult);
         }
@@ -159,6 +229,96 @@ void HandshakerThreeWay::WriteOutOfBandErrorReply(BinaryStream& outstream, PeerI
     outstream.WriteByte(static_cast<uint8_t>(reply));
 }
 
+bool HandshakerThreeWay::HandleOutOfBandRequest(BinaryStream& outstream, PeerID myID, const RemoteAddress& addr, const Packet& packet) {
+    BinaryStream instream = packet.GetStream();
+
+    // a stranger can't be taking part in any handshake stage other than the first, so ignore anything else
+    if (instream.IsEOF(HANDSHAKE_HEADER_LEN + sizeof(bool))) return false;
+
+    uint8_t magic[sizeof cfg::WIREFOX_MAGIC] = {0};
+    instream.ReadBytes(magic, sizeof cfg::WIREFOX_MAGIC);
+    if (std::memcmp(cfg::WIREFOX_MAGIC, magic, sizeof cfg::WIREFOX_MAGIC) != 0) return false;
+
+    if (instream.ReadByte() != cfg::WIREFOX_PROTOCOL_VERSION) {
+        // tell the sender right away, so it doesn't need to wait for a timeout
+        WriteOutOfBandErrorReply(outstream, myID, ConnectResult::INCOMPATIBLE_VERSION);
+        return false;
+    }
+
+    const PeerID remoteID = instream.ReadUInt64();
+    if (instream.ReadByte() != INITIAL_CLIENT) return false;
+
+    // skip the encryption preference and connection ID, Handle() deals with those once a slot is reserved
+    instream.ReadBool();
+    instream.ReadUInt64();
+
+    // check the cookie, if there is one. it's only valid if it was issued recently, for this exact address and PeerID
+    const uint8_t cookieLength = instream.ReadByte();
+    if (cookieLength == COOKIE_LENGTH && !instream.IsEOF(COOKIE_LENGTH)) {
+        const uint32_t issued = instream.ReadUInt32();
+        const uint64_t mac = instream.ReadUInt64();
+        const uint32_t age = GetCookieClock() - issued;
+        if (age <= cfg::HANDSHAKE_COOKIE_LIFETIME && mac == GetCookieMac(addr, remoteID, issued))
+            return true;
+    } else {
+        instream.Skip(cookieLength);
+    }
+
+    // a session ticket will do as well: only a client we've already verified can hold one. it can only be redeemed
+    // once, so a request that was captured on the way can't be replayed from elsewhere to take the client's PeerID
+    if (instream.ReadByte() > 0 && cfg::DefaultEncryption::VerifyResumeRequest(myID, remoteID, instream))
+        return true;
+
+    // no valid cookie, so issue a new one. the retry is kept small, so it can't be used to amplify spoofed traffic much
+    WriteReplyHeader(outstream, myID);
+    outstream.WriteByte(RETRY);
+    outstream.WriteByte(COOKIE_LENGTH);
+    WriteCookie(outstream, addr, remoteID, GetCookieClock());
+    return false;
+}
+
+void HandshakerThreeWay::WriteCookie(BinaryStream& outstream, const RemoteAddress& addr, PeerID remoteID, uint32_t issued) {
+    outstream.WriteInt32(issued);
+    outstream.WriteInt64(GetCookieMac(addr, remoteID, issued));
+}
+
+uint64_t HandshakerThreeWay::GetCookieMac(const RemoteAddress& addr, PeerID remoteID, uint32_t issued) {
+    const auto address = addr.GetBytes();
+
+    // serialize everything the cookie vouches for into one block
+    std::array<uint8_t, std::tuple_size<RemoteAddress::Bytes>::value + sizeof(PeerID) + sizeof(uint32_t)> input;
+    auto it = std::copy(address.begin(), address.end(), input.begin());
+    for (size_t i = 0; i < sizeof(PeerID); i++)
+        *it++ = static_cast<uint8_t>(remoteID >> (8 * i));
+    for (size_t i = 0; i < sizeof(uint32_t); i++)
+        *it++ = static_cast<uint8_t>(issued >> (8 * i));
+
+    return SipHash::Hash(GetCookieKey(), input.data(), input.size());
+}
+
+uint32_t HandshakerThreeWay::GetCookieClock() {
+    // milliseconds, wrapping around every 49 days; only ever compared to recent values, so that's fine
+    return static_cast<uint32_t>(static_cast<uint64_t>(Time::Now()) / 1000000);
+}
+
+void HandshakerThreeWay::WriteRequest(BinaryStream& outstream) const {
+    WriteReplyHeader(outstream, m_peer->GetMyPeerID());
+    outstream.WriteByte(INITIAL_CLIENT);
+    outstream.WriteBool(m_peer->GetEncryptionEnabled());
+
+    // the server should put this in front of the connected datagrams it sends us
+    outstream.WriteInt64(m_remote->localConnectionID);
+
+    // echo the server's cookie, if it handed us one
+    outstream.WriteByte(m_hasCookie ? COOKIE_LENGTH : 0);
+    if (m_hasCookie)
+        outstream.WriteBytes(m_cookie.data(), COOKIE_LENGTH);
+
+    // and present our session ticket, if we have one
+    outstream.WriteByte(static_cast<uint8_t>(m_resumeRequest.GetLength()));
+    outstream.WriteBytes(m_resumeRequest);
+}
+
 void HandshakerThreeWay::WriteReplyHeader(BinaryStream& outstream, PeerID myID) {
     outstream.WriteBytes(cfg::WIREFOX_MAGIC, sizeof cfg::WIREFOX_MAGIC);
     outstream.WriteByte(cfg::WIREFOX_PROTOCOL_VERSION);
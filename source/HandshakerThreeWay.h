@@ -19,6 +19,15 @@ namespace wirefox {
          * 
          * Works exactly like a TCP handshake. The initiating party sends the first message (request), the
          * remote answers with an acknowledgement, and the initiating party answers that with another ack.
+         *
+         * Before any of that, the remote answers a request from an unknown address with a retry message, which holds
+         * a cookie: a timestamp and a MAC over the sender's address and PeerID. The request is only accepted once it is
+         * repeated with a valid cookie. Because the cookie is verified rather than stored, senders with a spoofed
+         * address cannot make the remote allocate anything at all.
+         *
+         * If encryption is enabled and the client holds a session ticket from an earlier connection to the same address,
+         * the request carries that ticket. A valid ticket stands in for the cookie, and the reply carries the new session
+         * keys, so the client is connected after a single round trip.
          */
         class HandshakerThreeWay : public Handshaker {
         public:
@@ -31,7 +40,10 @@ namespace wirefox {
              */
             HandshakerThreeWay(Peer* master, RemotePeer* remote, ConnectionOrigin origin)
                 : Handshaker(master, remote, origin)
-                , m_expectedOpcode(NOT_STARTED) {}
+                , m_expectedOpcode(NOT_STARTED)
+                , m_cookie{}
+                , m_hasCookie(false)
+                , m_resumeRequest(0) {}
 
             void            Begin() override;
             void            Handle(const Packet& packet) override;
@@ -45,8 +57,29 @@ namespace wirefox {
              */
             static void     WriteOutOfBandErrorReply(BinaryStream& outstream, PeerID myID, ConnectResult reply);
 
+            /**
+             * \brief Inspects a connection request from an unknown address, without allocating any state for it.
+             *
+             * If the request carries a valid cookie or session ticket, this returns true, and the caller should reserve a RemotePeer slot
+             * and pass the request on to its Handshaker. Otherwise, a reply may be written to \p outstream, which should
+             * be sent back to \p addr if it is not empty. This is a retry message with a fresh cookie, or an error.
+             *
+             * \param[out]  outstream   The BinaryStream to write the formatted response to.
+             * \param[in]   myID        The local peer's PeerID, for identification purposes.
+             * \param[in]   addr        The address the request was received from.
+             * \param[in]   packet      The request itself.
+             */
+            static bool     HandleOutOfBandRequest(BinaryStream& outstream, PeerID myID, const RemoteAddress& addr, const Packet& packet);
+
         private:
+            /// The length of a cookie: the time it was issued, and a MAC.
+            static constexpr size_t COOKIE_LENGTH = sizeof(uint32_t) + sizeof(uint64_t);
+
             static void     WriteReplyHeader(BinaryStream& outstream, PeerID myID);
+            static void     WriteCookie(BinaryStream& outstream, const RemoteAddress& addr, PeerID remoteID, uint32_t issued);
+            static uint64_t GetCookieMac(const RemoteAddress& addr, PeerID remoteID, uint32_t issued);
+            static uint32_t GetCookieClock();
+            void            WriteRequest(BinaryStream& outstream) const;
             void            ReplyWithError(BinaryStream& outstream, ConnectResult problem);
 
             enum : uint8_t {
@@ -55,8 +88,13 @@ namespace wirefox {
                 INITIAL_SERVER,
                 AUTH_MSG,
                 UNENCRYPTED_ACK,
-                ERROR_OCCURRED
+                ERROR_OCCURRED,
+                RETRY
             } m_expectedOpcode;
+
+            std::array<uint8_t, COOKIE_LENGTH> m_cookie;
+            bool            m_hasCookie;
+            BinaryStream    m_resumeRequest;
         };
 
         /// \endcond
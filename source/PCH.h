@@ -39,7 +39,9 @@
 
 #include <string>
 #include <vector>
+#include <array>
 #include <queue>
+#include <deque>
 #include <map>
 #include <set>
 #include <unordered_map>
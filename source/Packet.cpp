@@ -9,20 +9,30 @@
 #include "PCH.h"
 #include "Packet.h"
 #include "BinaryStream.h"
+#include "WirefoxConfigRefs.h"
 
 namespace {
 
-    std::unique_ptr<uint8_t[]> CopyFrom(const uint8_t* raw, size_t count) {
+    using PayloadAllocator = detail::StlAllocator<uint8_t>;
+
+    std::shared_ptr<const uint8_t> MakeShared(BinaryStream::BufferPtr owned) {
+        // hand the buffer's own deleter to the shared_ptr, and let the control block come from the pools as well
+        if (!owned) return nullptr;
+        auto deleter = owned.get_deleter();
+        return std::shared_ptr<const uint8_t>(owned.release(), deleter, PayloadAllocator());
+    }
+
+    std::shared_ptr<const uint8_t> CopyFrom(const uint8_t* raw, size_t count) {
         // packet can have no payload; nullptr would be more elegant than a zero size array
         if (!raw || count == 0) return nullptr;
 
         // allocate a new buffer the size of the source buffer
         const auto bufferlen = count * sizeof(decltype(*raw));
-        std::unique_ptr<uint8_t[]> dataCopy(new uint8_t[count]);
+        BinaryStream::BufferPtr dataCopy(static_cast<uint8_t*>(cfg::DefaultAllocator::Allocate(bufferlen)), BinaryStream::BufferDeleter{bufferlen});
 
         // copy the data using a memcpy
         memcpy(dataCopy.get(), raw, bufferlen);
-        return dataCopy;
+        return MakeShared(std::move(dataCopy));
     }
 
 }
@@ -54,16 +64,25 @@ Packet::Packet(PacketCommand cmd, const BinaryStream& data)
     : m_sender(0)
     , m_command(cmd)
     , m_length(data.GetLength())
-    , m_data(data.ToArray()) {}
+    , m_data(CopyFrom(data.GetBuffer(), data.GetLength())) {}
 
 Packet::Packet(PacketCommand cmd, BinaryStream&& data)
     : m_sender(0)
     , m_command(cmd)
     , m_length(0)
-    , m_data(data.ReleaseBuffer(&m_length)) {}
+    , m_data(MakeShared(data.ReleaseAllocatedBuffer(&m_length))) {}
+
+void* Packet::operator new(size_t size) {
+    return cfg::DefaultAllocator::Allocate(size);
+}
+
+void Packet::operator delete(void* ptr, size_t size) noexcept {
+    cfg::DefaultAllocator::Deallocate(ptr, size);
+}
 
 Packet& Packet::operator=(const Packet& rhs) {
-    m_data = CopyFrom(rhs.m_data.get(), rhs.m_length);
+    // the payload is immutable, so copies can safely share it
+    m_data = rhs.m_data;
     m_command = rhs.m_command;
     m_length = rhs.m_length;
     m_sender = rhs.m_sender;
@@ -101,10 +120,30 @@ void Packet::ToDatagram(BinaryStream& outstream) const {
         outstream.WriteBytes(m_data.get(), m_length);
 }
 
+size_t Packet::ToDatagramSlice(BinaryStream& outstream, size_t offset, size_t length, size_t& payloadOffset) const {
+    assert(offset + length <= GetDatagramLength());
+    assert(!outstream.IsReadOnly());
+
+    // the cmd id is the only byte in the serialized format that isn't stored in the payload buffer
+    if (offset == 0 && length > 0) {
+        outstream.WriteByte(static_cast<uint8_t>(m_command));
+        length--;
+    } else {
+        offset--;
+    }
+
+    payloadOffset = offset;
+    return length;
+}
+
 Packet Packet::FromDatagram(PeerID sender, BinaryStream& instream, size_t len) {
     return Packet(sender, instream, len);
 }
 
+Packet Packet::FromDatagram(PeerID sender, BinaryStream& instream, size_t len, const std::shared_ptr<const uint8_t>& backing) {
+    return Packet(sender, instream, len, backing);
+}
+
 Packet::Packet(PeerID sender, BinaryStream& instream, size_t len)
     : m_sender(sender)
     , m_length(len - 1) {
@@ -115,3 +154,20 @@ Packet::Packet(PeerID sender, BinaryStream& instream, size_t len)
     assert(GetDatagramLength() == len);
     instream.Skip(len - 1);
 }
+
+Packet::Packet(PeerID sender, BinaryStream& instream, size_t len, const std::shared_ptr<const uint8_t>& backing)
+    : m_sender(sender)
+    , m_length(len - 1) {
+    assert(len >= 1);
+    assert(backing != nullptr);
+    m_command = static_cast<PacketCommand>(instream.ReadByte());
+
+    // aliasing constructor: m_data points into the middle of the backing buffer, but shares ownership of the whole thing
+    const auto* payload = instream.GetBuffer() + instream.GetPosition();
+    assert(payload >= backing.get());
+    if (m_length > 0)
+        m_data = std::shared_ptr<const uint8_t>(backing, payload);
+
+    assert(GetDatagramLength() == len);
+    instream.Skip(len - 1);
+}
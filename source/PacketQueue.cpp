@@ -14,16 +14,22 @@
 #include "PacketHeader.h"
 #include "Peer.h"
 #include "ChannelBuffer.h"
+#include "UpdateThread.h"
 
 using namespace detail;
 
 static_assert(cfg::THREAD_SLEEP_PACKETQUEUE_TICK > 0, "wirefox::cfg::THREAD_SLEEP_PACKETQUEUE_TICK must be greater than zero");
 
-PacketQueue::PacketQueue(Peer* peer)
+PacketQueue::PacketQueue(Peer* peer, std::shared_ptr<UpdateThread> updater)
     : m_peer(peer)
-    , m_updateThreadAbort(false) {
-    // start up I/O thread
-    m_updateThread = std::thread(std::bind(&PacketQueue::ThreadWorker, this));
+    , m_updateThreadAbort(false)
+    , m_updater(std::move(updater))
+    , m_workers(std::make_unique<WorkerPool>(cfg::WORKER_THREADS)) {
+    // start up I/O thread, unless one is shared with other queues
+    if (m_updater)
+        m_updater->Add(this);
+    else
+        m_updateThread = std::thread(std::bind(&PacketQueue::ThreadWorker, this));
 }
 
 PacketQueue::~PacketQueue() {
@@ -36,6 +42,19 @@ void PacketQueue::Stop() {
 	m_updateNotify.Signal();
 	if (m_updateThread.joinable())
 		m_updateThread.join();
+	if (m_updater)
+		m_updater->Remove(this);
+
+	// workers may reference remotes, so they must be done before those are deallocated
+	m_workers->Stop();
+}
+
+void PacketQueue::SetWorkerThreads(size_t count) {
+    m_workers = std::make_unique<WorkerPool>(count);
+}
+
+size_t PacketQueue::GetWorkerThreads() const {
+    return m_workers->GetThreadCount();
 }
 
 PacketID PacketQueue::EnqueueOutgoing(const Packet& packet, RemotePeer* remote, PacketOptions options, PacketPriority priority, const Channel& channel) {
@@ -43,20 +62,52 @@ PacketID PacketQueue::EnqueueOutgoing(const Packet& packet, RemotePeer* remote,
     assert(packet.GetLength() < cfg::PACKET_MAX_LENGTH);
     (void)priority; // TODO
 
-    // if disconnect is in progress, disallow queueing of more packets
-    if (remote->IsDisconnecting()) return 0;
+    return EnqueueSegments(packet, MakeSegments(packet), remote, options, channel);
+}
+
+size_t PacketQueue::EnqueueOutgoing(const Packet& packet, const std::vector<RemotePeer*>& remotes, PacketOptions options, const Channel& channel) {
+    assert(packet.GetLength() < cfg::PACKET_MAX_LENGTH);
 
-    // serialize the packet to an opaque blob (only prepends the cmdid, but that's an implementation detail we should ignore here)
-    BinaryStream fullPacketStream(packet.GetDatagramLength());
-    packet.ToDatagram(fullPacketStream);
-    assert(fullPacketStream.GetLength() == packet.GetDatagramLength());
+    // segmentation does not depend on the recipient, so do it only once for everyone
+    const auto segments = MakeSegments(packet);
 
-    // compute how many MTU-sized blocks we need for the full blob
+    size_t queued = 0;
+    for (auto* remote : remotes) {
+        assert(remote);
+        if (EnqueueSegments(packet, segments, remote, options, channel) != 0)
+            queued++;
+    }
+
+    return queued;
+}
+
+PacketQueue::Segments PacketQueue::MakeSegments(const Packet& packet) {
+    // compute how many MTU-sized blocks we need for the full serialized packet. these are sized for the base MTU, rather
+    // than a remote's path MTU: a segment can't be split up any further once it's queued, so it must still fit if path
+    // MTU discovery falls back. on a path that carries bigger datagrams, DatagramBuilder packs several into each one
     const size_t CHUNK_SIZE = cfg::MTU - 100;
-    const size_t segments = (fullPacketStream.GetLength() - 1) / CHUNK_SIZE + 1;
+    const size_t fullLength = packet.GetDatagramLength();
+    const size_t count = (fullLength - 1) / CHUNK_SIZE + 1;
+
+    Segments segments(count);
+    for (size_t i = 0; i < count; i++) {
+        auto& segment = segments[i];
+        segment.offset = i * CHUNK_SIZE;
+        segment.length = std::min(fullLength - segment.offset, CHUNK_SIZE);
+        segment.payloadLength = packet.ToDatagramSlice(segment.prefix, segment.offset, segment.length, segment.payloadOffset);
+    }
+
+    return segments;
+}
+
+PacketID PacketQueue::EnqueueSegments(const Packet& packet, const Segments& segments, RemotePeer* remote, PacketOptions options, const Channel& channel) {
+    // if disconnect is in progress, disallow queueing of more packets
+    if (remote->IsDisconnecting()) return 0;
 
     WIREFOX_LOCK_GUARD(remote->lock);
 
+    // the remote may have been reset after the caller looked it up, e.g. because its connection timed out
+    if (!remote->active || !remote->congestion) return 0;
 
     SequenceID containerSequenceID = 0;
     PacketID containerPacketID = remote->congestion->GetNextPacketID();
@@ -66,7 +117,9 @@ PacketID PacketQueue::EnqueueOutgoing(const Packet& packet, RemotePeer* remote,
     if (auto* chbuf = remote->GetChannelBuffer(m_peer, channel.id))
         containerSequenceID = chbuf->GetNextOutgoing();
 
-    for (size_t i = 0; i < segments; i++) {
+    for (size_t i = 0; i < segments.size(); i++) {
+        const auto& segment = segments[i];
+
         OutgoingPacket meta;
         meta.id = containerPacketID;
         meta.addr = remote->addr;
@@ -78,30 +131,32 @@ PacketID PacketQueue::EnqueueOutgoing(const Packet& packet, RemotePeer* remote,
 
         // if packet is segmented, upgrade reliability, because if any of those segments get lost,
         // then the entire transmission is rendered useless
-        if (segments > 1) {
+        if (segments.size() > 1) {
             meta.id = remote->congestion->GetNextPacketID();
             meta.options = meta.options | PacketOptions::RELIABLE;
             segmentIDs.emplace(meta.id);
         }
 
         // build and write a packet header for this message
-        size_t bufferLength = std::min(fullPacketStream.GetLength() - (i * CHUNK_SIZE), CHUNK_SIZE);
         PacketHeader header;
-        header.flag_segment = i < (segments - 1); // not the last segment?
+        header.flag_segment = i < (segments.size() - 1); // not the last segment?
         header.flag_jumbo = packet.GetLength() >= std::numeric_limits<uint16_t>::max();
         header.id = meta.id;
         header.options = options;
         header.channel = channel.id;
         header.sequence = containerSequenceID;
-        header.length = static_cast<uint32_t>(bufferLength);
-        header.offset = static_cast<uint32_t>(i * CHUNK_SIZE);
+        header.length = static_cast<uint32_t>(segment.length);
+        header.offset = static_cast<uint32_t>(segment.offset);
         header.splitContainer = containerPacketID;
         header.splitIndex = static_cast<uint32_t>(i);
 
-        // build the full transmissible packet, including serialized header
+        // build the full transmissible packet: the serialized header, plus a reference to this segment's slice of the payload
         header.Serialize(meta.blob);
-        meta.blob.WriteBytes(fullPacketStream.GetBuffer() + header.offset, bufferLength);
-        //std::cout << "Queued split packet " << header.splitContainer << "." << header.splitIndex << ", size = " << meta.blob.GetLength() << ", wrapped by " << header.id << std::endl;
+        meta.blob.WriteBytes(segment.prefix);
+        meta.payload = packet.GetSharedBuffer();
+        meta.payloadOffset = segment.payloadOffset;
+        meta.payloadLength = segment.payloadLength;
+        //std::cout << "Queued split packet " << header.splitContainer << "." << header.splitIndex << ", size = " << meta.GetLength() << ", wrapped by " << header.id << std::endl;
 
         // and queue the packet
         remote->outbox.push_back(std::move(meta));
@@ -111,7 +166,7 @@ PacketID PacketQueue::EnqueueOutgoing(const Packet& packet, RemotePeer* remote,
     if (options & PacketOptions::WITH_RECEIPT) {
         remote->receipt->Track(containerPacketID);
 
-        if (segments > 1)
+        if (segments.size() > 1)
             remote->receipt->RegisterSplitPacket(containerPacketID, std::move(segmentIDs));
     }
 
@@ -130,6 +185,7 @@ void PacketQueue::EnqueueOutOfBand(const Packet& packet, const RemoteAddress& ad
     meta.options = PacketOptions::UNRELIABLE;
     meta.remote = &m_peer->GetRemoteByIndex(0);
     meta.crypto = (forceCryptoBy != nullptr) ? forceCryptoBy->crypto : nullptr;
+    meta.workerKey = (forceCryptoBy != nullptr) ? GetWorkerKey(*forceCryptoBy) : 0;
     meta.sendNext = Time::Now();
     meta.sendCount = 0;
 
@@ -139,10 +195,16 @@ void PacketQueue::EnqueueOutOfBand(const Packet& packet, const RemoteAddress& ad
     header.offset = 0;
     header.Serialize(meta.blob);
 
-    // concat the packet header and packet payload, then queue the merged blob for sending
-    packet.ToDatagram(meta.blob);
+    // the packet header is followed by the packet itself, which can be referenced as a whole
+    meta.payload = packet.GetSharedBuffer();
+    meta.payloadLength = packet.ToDatagramSlice(meta.blob, 0, packet.GetDatagramLength(), meta.payloadOffset);
 
     WIREFOX_LOCK_GUARD(meta.remote->lock);
+
+    // out-of-band packets are unreliable anyway, so rather drop one than let a flood of them build up a backlog
+    if (meta.remote->outbox.size() >= cfg::PACKETQUEUE_OUT_OF_BAND_LEN)
+        return;
+
     meta.remote->outbox.push_back(std::move(meta));
 }
 
@@ -169,43 +231,80 @@ bool PacketQueue::OutgoingPacket::HasFlag(PacketOptions test) const {
     return (static_cast<num_t>(options) & static_cast<num_t>(test)) == static_cast<num_t>(test);
 }
 
+void PacketQueue::OutgoingPacket::WriteTo(BinaryStream& outstream) const {
+    outstream.WriteBytes(blob);
+
+    // this is the only place the payload is ever copied on its way out
+    if (payloadLength > 0)
+        outstream.WriteBytes(payload.get() + payloadOffset, payloadLength);
+}
+
 void PacketQueue::ThreadWorker() {
     while (!m_updateThreadAbort) {
-        const size_t remotesMax = m_peer->GetMaximumPeers();
-        for (size_t i = 0; i <= remotesMax; i++) {
-            auto& remote = m_peer->GetRemoteByIndex(i);
-            if (!remote.active) continue;
-
-            WIREFOX_LOCK_GUARD(remote.lock);
-
-            // give the handshaker the opportunity to resend possibly lost packets
-            if (remote.handshake && !remote.handshake->IsDone())
-                remote.handshake->Update();
-            // various periodic updates
-            if (remote.congestion)
-                remote.congestion->Update(remote.stats);
-            if (remote.receipt)
-                remote.receipt->Update();
-
-            // disconnection timeout
-            auto timeout = remote.disconnect.load();
-            if (timeout.IsValid() && Time::Elapsed(timeout)) {
-                m_peer->DisconnectImmediate(&remote);
-                return;
-            }
+        Update();
 
-            // skip cycle if socket hasn't fully initialized yet
-            if (remote.socket == nullptr || !remote.socket->IsOpenAndReady()) continue;
+        // sleep a maximum of x milliseconds, but wake up earlier if requested
+        m_updateNotify.WaitFor(Time::FromMilliseconds(cfg::THREAD_SLEEP_PACKETQUEUE_TICK));
+    }
+}
+
+void PacketQueue::Wake() {
+    if (m_updater)
+        m_updater->Notify(this);
+    else
+        m_updateNotify.Signal();
+}
 
-            DoReadCycle(remote);
-            DoWriteCycle(remote);
+void PacketQueue::Update() {
+    // only visit the remotes in use, so a Peer with many free slots doesn't spend its ticks skipping over them
+    m_peer->GetRemotesInUse(m_remotesInUse);
+
+    // the kernel counts these for the whole socket, so ask once per tick rather than once per remote
+    const size_t drops = m_remotesInUse.empty() ? 0 : m_peer->GetReceiveDrops();
+    const size_t blocked = m_remotesInUse.empty() ? 0 : m_peer->GetSendBlocked();
+
+    for (auto* ptr : m_remotesInUse) {
+        auto& remote = *ptr;
+        if (!remote.active) continue;
+
+        WIREFOX_LOCK_GUARD(remote.lock);
+        remote.stats.Set(PeerStatID::SOCKET_RECEIVE_DROPS, drops);
+        remote.stats.Set(PeerStatID::SOCKET_SEND_BLOCKED, blocked);
+
+        // give the handshaker the opportunity to resend possibly lost packets
+        if (remote.handshake && !remote.handshake->IsDone())
+            remote.handshake->Update();
+        // various periodic updates
+        if (remote.congestion)
+            remote.congestion->Update(remote.stats);
+        if (remote.pmtu && remote.congestion) {
+            remote.pmtu->Update();
+            remote.congestion->SetMaximumDatagramSize(remote.pmtu->GetPathMtu());
+            remote.stats.Set(PeerStatID::PATH_MTU, remote.pmtu->GetPathMtu());
+        }
+        if (remote.receipt)
+            remote.receipt->Update();
+
+        // disconnection timeout
+        auto timeout = remote.disconnect.load();
+        if (timeout.IsValid() && Time::Elapsed(timeout)) {
+            m_peer->DisconnectImmediate(&remote);
+            continue;
         }
 
-        // sleep a maximum of x milliseconds, but wake up earlier if requested
-        m_updateNotify.WaitFor(Time::FromMilliseconds(cfg::THREAD_SLEEP_PACKETQUEUE_TICK));
+        // skip cycle if socket hasn't fully initialized yet
+        if (remote.socket == nullptr || !remote.socket->IsOpenAndReady()) continue;
+
+        DoReadCycle(remote);
+        DoWriteCycle(remote);
     }
 }
 
+size_t PacketQueue::GetWorkerKey(const RemotePeer& remote) const {
+    // slot indices are dense, so they make a key that spreads remotes evenly across the workers
+    return remote.slot;
+}
+
 void PacketQueue::DoReadCycle(RemotePeer& remote) {
     using namespace std::placeholders;
 
@@ -216,75 +315,216 @@ void PacketQueue::DoReadCycle(RemotePeer& remote) {
 }
 
 void PacketQueue::DoWriteCycle(RemotePeer& remote) {
-    using namespace std::placeholders;
-    if (remote.socket->IsWritePending()) return;
+    // datagrams to the same remote go out one batch at a time, so they can't overtake each other on the worker threads
+    if (remote.writing) return;
 
     // update queue size in debug stats tracker
     remote.stats.Set(PeerStatID::PACKETS_IN_QUEUE, remote.outbox.size());
 
-    OutgoingDatagram* datagram = remote.GetNextDatagram(m_peer);
-    if (!datagram) return;
+    // the sentbox only needs the packet list of a datagram to handle acks, so hand the blob itself over to the worker
+    // and the socket, which need it until the write completes
+    auto batch = std::allocate_shared<PendingWriteBatch>(StlAllocator<PendingWriteBatch>());
+    size_t workerKey = GetWorkerKey(remote);
+    while (batch->size() < cfg::SEND_BATCH_DATAGRAMS) {
+        OutgoingDatagram* datagram = remote.GetNextDatagram(m_peer);
+        if (!datagram) break;
+
+        batch->emplace_back();
+        auto& write = batch->back();
+        write.blob = std::move(datagram->blob);
+        write.headroom = datagram->headroom;
+        write.connectionID = datagram->connectionID;
+        write.addr = datagram->addr;
+        write.id = datagram->id;
+        write.peer = remote.id;
+
+        // encrypt this datagram if that's enabled
+        if (m_peer->GetEncryptionEnabled()) {
+            // get correct crypto layer for this packet -- if DatagramBuilder set an explicit crypto layer, use that one
+            write.crypto = (datagram->crypto != nullptr) ? datagram->crypto : remote.crypto;
+
+            // only encrypt if key exchange was completed already
+            if (write.crypto && !write.crypto->GetCryptoEstablished())
+                write.crypto = nullptr;
+        }
+
+        // out-of-band datagrams are addressed to all sorts of endpoints, so they don't go out in batches. one that is
+        // encrypted on behalf of a connected remote must go to that remote's worker, or two threads could use its crypto
+        // layer at the same time
+        if (remote.IsOutOfBand()) {
+            if (datagram->crypto)
+                workerKey = datagram->workerKey;
+            break;
+        }
+
+        // a probe that's too big for the path is never acked, and mustn't hold up the congestion window until it expires
+        if (datagram->probe) continue;
+
+        // count the datagram as in flight right away, so the congestion window also limits the next one in this batch.
+        // it isn't encrypted yet, so assume the largest overhead the encryption layer may add
+        const size_t prefix = write.connectionID != 0 ? DatagramHeader::CONNECTION_ID_LENGTH : 0;
+        const size_t overhead = write.crypto ? cfg::DefaultEncryption::GetOverhead() : 0;
+        remote.congestion->NotifySendingBytes(write.id, write.blob.GetLength() - write.headroom + prefix + overhead);
+    }
+
+    if (batch->empty()) return;
 
-    // encrypt this datagram if that's enabled
-    if (m_peer->GetEncryptionEnabled()) {
-        // get correct crypto layer for this packet -- if DatagramBuilder set an explicit crypto layer, use that one
-        EncryptionLayer* crypto = (datagram->crypto != nullptr)
-            ? datagram->crypto.get()
-            : remote.crypto.get();
+    remote.writing = true;
+    m_workers->Post(workerKey, [this, &remote, batch]() {
+        EncryptAndWrite(remote, batch);
+    });
+}
+
+void PacketQueue::EncryptAndWrite(RemotePeer& remote, const PendingWriteBatchPtr& batch) {
+    using namespace std::placeholders;
+
+    std::vector<Socket::WriteBuffer> datagrams;
+    datagrams.reserve(batch->size());
+    size_t length = 0;
 
-        // if key exchange was completed already, replace the datagram blob with a ciphertext
-        const bool encryptionDesired = crypto && crypto->GetCryptoEstablished();
-        if (encryptionDesired) {
-            datagram->blob = crypto->Encrypt(datagram->blob);
+    for (auto& write : *batch) {
+        const size_t prefix = write.connectionID != 0 ? DatagramHeader::CONNECTION_ID_LENGTH : 0;
+
+        if (write.crypto) {
+            // DatagramBuilder left room for the nonce and MAC around the plaintext, so this overwrites the blob without allocating anything
+            assert(write.headroom == prefix + cfg::DefaultEncryption::GetHeadroom());
+            write.headroom = write.crypto->EncryptInPlace(write.blob, prefix);
 
             // I don't know why this would happen, but I guess encryption could fail?
-            if (crypto->GetNeedsToBail()) {
+            if (write.crypto->GetNeedsToBail()) {
+                remote.writing = false;
                 m_peer->DisconnectImmediate(&remote);
                 return;
             }
         }
+
+        // the connection ID goes right in front of the (encrypted) datagram, in the room DatagramBuilder left for it
+        if (prefix > 0) {
+            assert(write.headroom >= prefix);
+            write.headroom -= prefix;
+            DatagramHeader::WriteConnectionID(write.blob.GetWritableBuffer() + write.headroom, write.connectionID);
+        }
+
+        // skip over whatever part of the room reserved for the encryption layer went unused
+        datagrams.push_back({ write.blob.GetBuffer() + write.headroom, write.blob.GetLength() - write.headroom });
+        length += datagrams.back().length;
     }
 
-    // dispatch an async write op for this remote
-    remote.stats.Add(PeerStatID::BYTES_SENT, datagram->blob.GetLength());
-    remote.stats.Add(PeerStatID::DATAGRAMS_SENT, 1);
-    remote.congestion->NotifySendingBytes(datagram->id, datagram->blob.GetLength());
-    remote.socket->BeginWrite(datagram->addr, datagram->blob.GetBuffer(), datagram->blob.GetLength(),
-        std::bind(&PacketQueue::OnWriteFinished, shared_from_this(), &remote, datagram->id, _1, _2));
+    const auto& first = batch->front();
+    std::shared_ptr<Socket> socket;
+
+    {
+        WIREFOX_LOCK_GUARD(remote.lock);
+
+        // the remote may have been disconnected while this batch was waiting for a worker
+        if (remote.id != first.peer) return;
+        if (!remote.congestion || !remote.socket) {
+            remote.writing = false;
+            return;
+        }
+
+        remote.stats.Add(PeerStatID::BYTES_SENT, length);
+        remote.stats.Add(PeerStatID::DATAGRAMS_SENT, datagrams.size());
+        socket = remote.socket;
+    }
+
+    // dispatch an async write op for this remote. all datagrams in a batch share the address, see DoWriteCycle()
+    socket->BeginWriteBatch(first.addr, datagrams,
+        std::bind(&PacketQueue::OnWriteFinished, shared_from_this(), &remote, batch, _1, _2));
 }
 
-void PacketQueue::OnWriteFinished(RemotePeer* remote, DatagramID, bool error, size_t) {
+void PacketQueue::OnWriteFinished(RemotePeer* remote, const PendingWriteBatchPtr& batch, bool error, size_t) {
     // would've liked to pass remote by reference, but changing the param type to RemotePeer& seems to cause a rather vague compiler error?
     //   C2661 'std::tuple<wirefox::detail::PacketQueue *,wirefox::detail::RemotePeer,std::_Ph<1>,std::_Ph<2>>::tuple': no overloaded function takes 4 arguments
     // EDIT: apparently need to use std::ref(), but I don't think directly referencing the temporary in ThreadWorker is a good idea...
     assert(remote);
 
-    if (error)
+    // if the slot was reset in the meantime, it may already be writing on behalf of a new connection
+    if (remote->id != batch->front().peer) return;
+
+    if (error) {
         m_peer->DisconnectImmediate(remote);
-}
+        return;
+    }
 
-void PacketQueue::OnReadFinished(bool error, const RemoteAddress& sender, const uint8_t* buffer, size_t transferred) {
-    auto* remote = m_peer->GetRemoteByAddress(sender);
+    // the next batch for this remote can go out right away
+    remote->writing = false;
+    Wake();
+}
 
+void PacketQueue::OnReadFinished(bool error, const RemoteAddress& sender, const BufferPool::Handle& buffer, size_t transferred) {
     // error handling: in general, on failure, disconnect
     if (error) {
-        m_peer->DisconnectImmediate(remote);
+        m_peer->DisconnectImmediate(m_peer->GetRemoteByAddress(sender));
         return;
     }
 
+    DispatchDatagram(sender, buffer, transferred);
+}
+
+void PacketQueue::DispatchDatagram(const RemoteAddress& sender, const BufferPool::Handle& buffer, size_t transferred) {
+    // a connected remote puts the connection ID we issued to it in front of its datagrams. that finds the remote without
+    // an address lookup, and keeps finding it when its address changes, e.g. because a NAT rebinds its port. anything
+    // else, such as handshake messages, is matched by address
+    ConnectionID connectionID = DatagramHeader::PeekConnectionID(buffer.get(), transferred);
+    auto* remote = m_peer->GetRemoteByConnectionID(connectionID);
+    if (!remote) {
+        // if we share our port with other Peers, the remote may be connected to one of those instead
+        if (connectionID != 0 && m_peer->RouteDatagram(connectionID, sender, buffer, transferred))
+            return;
+
+        connectionID = 0;
+        remote = m_peer->GetRemoteByAddress(sender);
+    }
+
     if (!remote) {
         // unknown, unconnected sender
-        m_peer->OnUnconnectedMessage(sender, buffer, transferred);
+        m_peer->OnUnconnectedMessage(sender, buffer.get(), transferred);
+        return;
+    }
+
+    // while a handshake is in progress, its messages are handled on a handshake thread. every other datagram from the
+    // remote takes the same route until that thread has caught up, so it can't overtake the handshake messages before
+    // it, e.g. by being decrypted before the handshake has produced the keys
+    if ((remote->handshake && !remote->handshake->IsDone()) || remote->handshakeBacklog > 0) {
+        remote->handshakeBacklog++;
+        const bool posted = m_peer->PostHandshakeTask(*remote, [this, remote, sender, connectionID, buffer, transferred]() {
+            HandleDatagram(remote, sender, connectionID, buffer, transferred);
+            remote->handshakeBacklog--;
+        });
+
+        // if the handshake thread is too far behind, drop the datagram; the remote will send it again
+        if (!posted)
+            remote->handshakeBacklog--;
         return;
     }
 
-    BinaryStream inbuffer(buffer, transferred, BinaryStream::WrapMode::READONLY);
+    // the rest only concerns this one remote, so it can be done in parallel with the datagrams of other remotes
+    m_workers->Post(GetWorkerKey(*remote), [this, remote, sender, connectionID, buffer, transferred]() {
+        HandleDatagram(remote, sender, connectionID, buffer, transferred);
+    });
+}
+
+void PacketQueue::HandleDatagram(RemotePeer* remote, const RemoteAddress& sender, ConnectionID connectionID, const BufferPool::Handle& buffer, size_t transferred) {
+    // the remote may have been disconnected while this datagram was waiting for a worker
+    if (!remote->active) return;
+    if (connectionID != 0 ? remote->localConnectionID != connectionID : !(remote->addr == sender)) return;
+
+    // the connection ID is not part of the datagram itself
+    const size_t prefix = connectionID != 0 ? DatagramHeader::CONNECTION_ID_LENGTH : 0;
+    uint8_t* datagram = buffer.get() + prefix;
+    const size_t length = transferred - prefix;
+
+    // Packets parsed from this datagram will reference slices of this buffer, instead of copying them out of it
+    BinaryStream inbuffer(datagram, length, BinaryStream::WrapMode::READONLY);
     remote->stats.Add(PeerStatID::DATAGRAMS_RECEIVED, 1);
     remote->stats.Add(PeerStatID::BYTES_RECEIVED, transferred);
 
-    // if we know the remote, then the message may be encrypted
-    if (remote->crypto && remote->crypto->GetCryptoEstablished()) {
-        inbuffer = remote->crypto->Decrypt(inbuffer);
+    // if we know the remote, then the message may be encrypted. it is decrypted within the receive buffer itself,
+    // so received Packets keep referencing that buffer.
+    const bool authenticated = remote->crypto && remote->crypto->GetCryptoEstablished();
+    if (authenticated) {
+        const bool accepted = remote->crypto->DecryptInPlace(datagram, length, inbuffer);
 
         // the ciphertext might be malformed for several reasons; decryption failure == bad connection
         // TODO: Vulnerability to TCP-reset-style attack: an adversary could intentially inject a corrupt datagram. Is this a problem?
@@ -293,6 +533,9 @@ void PacketQueue::OnReadFinished(bool error, const RemoteAddress& sender, const
             m_peer->DisconnectImmediate(remote);
             return;
         }
+
+        // replayed datagrams are simply ignored
+        if (!accepted) return;
     }
 
     // decode the datagram header if it is complete
@@ -303,8 +546,8 @@ void PacketQueue::OnReadFinished(bool error, const RemoteAddress& sender, const
         return;
     }
 
-    // the payload and header length cannot be bigger than the MTU together, as that makes no sense, and is probably an attack
-    if (datagramHeader.flag_data && datagramHeader.dataLength + inbuffer.GetPosition() > cfg::MTU) {
+    // the payload and header length cannot be bigger than the largest MTU together, as that makes no sense, and is probably an attack
+    if (datagramHeader.flag_data && datagramHeader.dataLength + inbuffer.GetPosition() > cfg::MTU_MAX) {
         std::string msg = "PacketQueue: [Remote " + std::to_string(remote->id) + "] Received too big data section ("
             + std::to_string(datagramHeader.dataLength + inbuffer.GetPosition()) + ")! Killing connection.";
         std::cerr << msg << std::endl;
@@ -334,12 +577,33 @@ void PacketQueue::OnReadFinished(bool error, const RemoteAddress& sender, const
     }
 #endif
 
-    // Inform the congestion manager of this packet's arrival: particularly, this may queue NAKs.
-    // Also, the congestion manager tells us whether this datagram is a duplicate.
-    if (remote->congestion->NotifyReceivedDatagram(datagramHeader.datagramID, !datagramHeader.flag_data) == CongestionControl::RecvState::DUPLICATE) {
-        std::string errmsg = "PacketQueue: [Remote " + std::to_string(remote->id) + "] Duplicate datagram recv: " + std::to_string(datagramHeader.datagramID);
-        std::cerr << errmsg << std::endl;
-        return;
+    {
+        // the update thread uses the congestion manager as well, e.g. to collect the acks queued below
+        WIREFOX_LOCK_GUARD(remote->lock);
+
+        // the remote may have been reset while we were waiting for the lock
+        if (!remote->congestion) return;
+
+        // Inform the congestion manager of this packet's arrival: particularly, this may queue NAKs.
+        // Also, the congestion manager tells us whether this datagram is a duplicate.
+        // probes carry no data, but the remote does want to know whether they arrived
+        const bool isAckDatagram = !datagramHeader.flag_data && !datagramHeader.flag_padding;
+        if (remote->congestion->NotifyReceivedDatagram(datagramHeader.datagramID, isAckDatagram) == CongestionControl::RecvState::DUPLICATE) {
+            std::string errmsg = "PacketQueue: [Remote " + std::to_string(remote->id) + "] Duplicate datagram recv: " + std::to_string(datagramHeader.datagramID);
+            std::cerr << errmsg << std::endl;
+            return;
+        }
+
+        // if the remote's address changed, that's where it's at now. only the newest datagram may move it, so a late
+        // datagram from the old address doesn't move it back. the connection ID travels in the clear, so only a datagram
+        // that decrypted under the session keys proves it came from the remote; otherwise, anyone who saw the ID could
+        // redirect the connection to an address of their choosing
+        if (CongestionControl::SequenceGreaterThan(datagramHeader.datagramID, remote->newestDatagram)) {
+            remote->newestDatagram = datagramHeader.datagramID;
+
+            if (authenticated && connectionID != 0 && !(remote->addr == sender))
+                m_peer->SetRemoteAddress(*remote, sender);
+        }
     }
 
     // deal with incoming (n)acks
@@ -348,15 +612,30 @@ void PacketQueue::OnReadFinished(bool error, const RemoteAddress& sender, const
     if (!datagramHeader.nacks.empty())
         remote->HandleNonAcknowledgements(datagramHeader.nacks);
 
+    // the rest of a probe is padding
+    if (datagramHeader.flag_padding) return;
+
     // datagram may contain any number of packets, so keep parsing headers until we run out
     PacketHeader packetHeader;
     while (packetHeader.Deserialize(inbuffer)) {
-        // catch some obvious corruptions
-        assert(packetHeader.offset < cfg::PACKET_MAX_LENGTH);
-        assert(packetHeader.length < datagramHeader.dataLength);
+        // the header comes from the remote, and a Packet made from it is a view into the receive buffer, so reject
+        // the rest of the datagram if the packet doesn't fit in what's left of it. a segment must also fit within the
+        // largest packet the reassembly buffer accepts
+        if (packetHeader.length < 1 || inbuffer.IsEOF(packetHeader.length)) break;
+        if (packetHeader.offset + static_cast<uint64_t>(packetHeader.length) >= cfg::PACKET_MAX_LENGTH) break;
 
         // not a duplicate receive?
-        if (remote->congestion->NotifyReceivedPacket(packetHeader.id) == CongestionControl::RecvState::NEW) {
+        bool isNew;
+        {
+            WIREFOX_LOCK_GUARD(remote->lock);
+
+            // the lock was released since the check above, so the remote may have been reset in the meantime
+            if (!remote->congestion) return;
+
+            isNew = remote->congestion->NotifyReceivedPacket(packetHeader.id) == CongestionControl::RecvState::NEW;
+        }
+
+        if (isNew) {
             remote->stats.Add(PeerStatID::PACKETS_RECEIVED, 1);
 
             // split packet?
@@ -367,7 +646,7 @@ void PacketQueue::OnReadFinished(bool error, const RemoteAddress& sender, const
             }
 
             // construct an actual Packet instance and get moving with it
-            auto packet = Packet::Factory::Create(Packet::FromDatagram(remote->id, inbuffer, packetHeader.length));
+            auto packet = Packet::Factory::Create(Packet::FromDatagram(remote->id, inbuffer, packetHeader.length, buffer));
 
             if (packet->GetCommand() < PacketCommand::USER_PACKET)
                 // don't deliver system packets to user, but handle them immediately
@@ -382,7 +661,7 @@ void PacketQueue::OnReadFinished(bool error, const RemoteAddress& sender, const
     }
 
     // request an immediate update, so a new read will be scheduled asap
-    m_updateNotify.Signal();
+    Wake();
 }
 
 void PacketQueue::HandleSplitPacket(RemotePeer& remote, const PacketHeader& header, BinaryStream& instream) {
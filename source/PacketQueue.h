@@ -11,6 +11,7 @@
 #include "BinaryStream.h"
 #include "WirefoxTime.h"
 #include "AwaitableEvent.h"
+#include "WorkerPool.h"
 #include "WirefoxConfigRefs.h"
 
 namespace wirefox {
@@ -23,6 +24,7 @@ namespace wirefox {
         struct RemotePeer;
         class Peer;
         class Socket;
+        class UpdateThread;
         class EncryptionLayer;
 
         /**
@@ -34,12 +36,17 @@ namespace wirefox {
          */
         class PacketQueue : public std::enable_shared_from_this<PacketQueue> {
             using CryptoPtr = std::shared_ptr<EncryptionLayer>;
+            using PayloadPtr = std::shared_ptr<const uint8_t>;
 
         public:
             /// Represents an outbound packet that is not yet assigned to a datagram.
             struct OutgoingPacket {
                 CryptoPtr       crypto;     ///< If not nullptr, force this packet to be encrypted using this crypto layer.
-                BinaryStream    blob;       ///< A byte blob that contains both the packet header and payload.
+                size_t          workerKey = 0; ///< If \p crypto is set, the worker key of the remote that owns it. See GetWorkerKey().
+                BinaryStream    blob;       ///< A byte blob that contains the packet header, and any serialized bytes that precede the payload slice.
+                PayloadPtr      payload;    ///< The shared payload buffer of the Packet this was queued from. Never copied or modified.
+                size_t          payloadOffset = 0; ///< The offset into \p payload at which this packet's slice begins.
+                size_t          payloadLength = 0; ///< The length of this packet's slice of \p payload, in bytes.
                 RemoteAddress   addr;       ///< The remote endpoint this packet is addressed to.
                 RemotePeer*     remote;     ///< The peer slot associated with this packet.
                 Timestamp       sendNext;   ///< Indicates when this packet should be treated as lost and resent.
@@ -49,22 +56,45 @@ namespace wirefox {
 
                 /// Returns a value indicating whether the given PacketOptions are set for this OutgoingPacket.
                 bool            HasFlag(PacketOptions test) const;
+
+                /// Returns the total length, in bytes, this packet will occupy in a datagram.
+                size_t          GetLength() const { return blob.GetLength() + payloadLength; }
+
+                /// Appends the serialized packet (header and payload slice) to a datagram blob.
+                void            WriteTo(BinaryStream& outstream) const;
+            };
+
+            /// Represents one segment of a Packet, which can be queued to the outbox of any number of recipients.
+            struct OutgoingSegment {
+                BinaryStream    prefix {sizeof(uint8_t)}; ///< Any serialized bytes that precede the payload slice.
+                size_t          offset;     ///< The offset into the serialized packet at which this segment begins.
+                size_t          length;     ///< The total length of this segment, in bytes.
+                size_t          payloadOffset = 0; ///< The offset into the packet's payload at which this segment's slice begins.
+                size_t          payloadLength = 0; ///< The length of this segment's slice of the payload, in bytes.
             };
 
             /// Represents an outbound datagram that is not yet fully delivered.
             struct OutgoingDatagram {
                 CryptoPtr       crypto;     ///< If not nullptr, force this packet to be encrypted using this crypto layer.
+                size_t          workerKey = 0; ///< If \p crypto is set, the worker key of the remote that owns it. See GetWorkerKey().
                 BinaryStream    blob;       ///< A byte blob that contains both the datagram header and all packets, if any.
+                size_t          headroom = 0; ///< The number of bytes at the start of blob that are reserved for the ConnectionID and the encryption layer, and not (yet) part of the datagram.
+                ConnectionID    connectionID = 0; ///< If not zero, the ConnectionID to write in front of the datagram.
                 RemoteAddress   addr;       ///< The remote endpoint this packet is addressed to.
                 DatagramID      id;         ///< The ID number of this datagram.
                 Timestamp       discard;    ///< The timestamp at which this datagram should be removed / cleaned up.
-                std::vector<PacketID> packets; ///< The list of PacketIDs this datagram contains. Used for acking packets.
+                bool            probe = false; ///< Indicates whether this datagram is padding that probes the path MTU.
+                std::vector<PacketID, StlAllocator<PacketID>> packets; ///< The list of PacketIDs this datagram contains. Used for acking packets.
             };
 
             /**
              * \brief Constructs a new PacketQueue, starts a worker thread, and regist specified underlying Socket.
+             *
+             * \param[in]   peer        The Peer that owns this queue.
+             * \param[in]   updater     If not nullptr, this queue is updated by a thread it shares with other queues,
+             *                          rather than by a thread of its own.
              */
-            PacketQueue(Peer* peer);
+            PacketQueue(Peer* peer, std::shared_ptr<UpdateThread> updater = nullptr);
 
             /**
              * \brief Destroys this PacketQueue, deallocates queued packets, and stops the worker thread.
@@ -76,11 +106,23 @@ namespace wirefox {
              */
             void            Stop();
 
+            /**
+             * \brief Replaces the pool of threads that encrypt, decrypt and process datagrams.
+             *
+             * Must not be called while the socket is open.
+             *
+             * \param[in]   count   The number of threads. If zero, datagrams are processed on the packet queue and socket threads.
+             */
+            void            SetWorkerThreads(size_t count);
+
+            /// Returns the number of threads that encrypt, decrypt and process datagrams.
+            size_t          GetWorkerThreads() const;
+
             /**
              * \brief Send an outgoing message.
              *
-             * Adds a packet onto the outgoing queue. The packet and its contents will be copied, so you can safely deallocate
-             * your own copy of the packet after this function returns.
+             * Adds a packet onto the outgoing queue. The queue keeps a reference to the packet's payload rather than a copy,
+             * so you can safely deallocate your own copy of the packet after this function returns.
              *
              * \param[in]   packet      The packet to send out.
              * \param[in]   remote      Which remote peer to send the packet to.
@@ -90,11 +132,25 @@ namespace wirefox {
              */
             PacketID        EnqueueOutgoing(const Packet& packet, RemotePeer* remote, PacketOptions options, PacketPriority priority, const Channel& channel);
 
+            /**
+             * \brief Send an outgoing message to multiple recipients.
+             *
+             * Adds a packet onto the outgoing queues of all specified remotes. The packet is segmented only once, and all
+             * recipients share a reference to the same payload.
+             *
+             * \param[in]   packet      The packet to send out.
+             * \param[in]   remotes     Which remote peers to send the packet to.
+             * \param[in]   options     Reliability settings for this packet.
+             * \param[in]   channel     Ordered and sequenced packets only wait for packets in the same channel.
+             * \returns     The number of remotes the packet was queued for.
+             */
+            size_t          EnqueueOutgoing(const Packet& packet, const std::vector<RemotePeer*>& remotes, PacketOptions options, const Channel& channel);
+
             /**
              * \brief Send a message to a specific remote endpoint.
              *
-             * Adds a packet onto the outgoing queue. The packet and its contents will be copied, so you can safely deallocate
-             * your own copy of the packet after this function returns.
+             * Adds a packet onto the outgoing queue. The queue keeps a reference to the packet's payload rather than a copy,
+             * so you can safely deallocate your own copy of the packet after this function returns.
              *
              * \param[in]   packet      The packet to send out.
              * \param[in]   addr        The raw remote address to send data to.
@@ -125,16 +181,58 @@ namespace wirefox {
              */
             std::unique_ptr<Packet> DequeueIncoming();
 
+            /**
+             * \brief Runs one tick of the worker thread.
+             *
+             * Gives every remote in use its periodic updates, and starts reads and writes for them where needed. The worker
+             * thread (or the shared UpdateThread) calls this every cfg::THREAD_SLEEP_PACKETQUEUE_TICK milliseconds, or
+             * sooner if woken up. Must not be called from more than one thread at a time.
+             */
+            void            Update();
+
+            /**
+             * \brief Finds the remote a received datagram belongs to, and hands the datagram to the thread that handles it.
+             *
+             * \param[in]   sender      The address the datagram came from.
+             * \param[in]   buffer      The buffer that holds the datagram. Packets may keep referencing it.
+             * \param[in]   transferred The length of the datagram, in bytes.
+             */
+            void            DispatchDatagram(const RemoteAddress& sender, const BufferPool::Handle& buffer, size_t transferred);
+
         private:
             using Inbox = std::queue<std::unique_ptr<Packet>>;
 
+            using Segments = std::vector<OutgoingSegment, StlAllocator<OutgoingSegment>>;
+
+            /// Represents a datagram that is handed from the packet queue thread to a worker, and then to the Socket.
+            struct PendingWrite {
+                CryptoPtr       crypto;     ///< If not nullptr, the datagram must be encrypted using this crypto layer.
+                BinaryStream    blob;       ///< The datagram blob, moved out of the sentbox. Must stay alive until the write completes.
+                size_t          headroom;   ///< The number of bytes at the start of blob that are not part of the datagram.
+                ConnectionID    connectionID; ///< If not zero, the ConnectionID to write in front of the datagram.
+                RemoteAddress   addr;       ///< The remote endpoint this datagram is addressed to.
+                DatagramID      id;         ///< The ID number of this datagram.
+                PeerID          peer;       ///< The ID of the remote when the datagram was built, to detect a reset slot.
+            };
+            /// Represents the datagrams for one remote that are handed to the Socket together.
+            using PendingWriteBatch = std::vector<PendingWrite>;
+            using PendingWriteBatchPtr = std::shared_ptr<PendingWriteBatch>;
+
+            static Segments MakeSegments(const Packet& packet);
+            PacketID        EnqueueSegments(const Packet& packet, const Segments& segments, RemotePeer* remote, PacketOptions options, const Channel& channel);
+
             void            ThreadWorker();
+            void            Wake();
+
+            size_t          GetWorkerKey(const RemotePeer& remote) const;
 
             void            DoReadCycle(RemotePeer& remote);
             void            DoWriteCycle(RemotePeer& remote);
+            void            EncryptAndWrite(RemotePeer& remote, const PendingWriteBatchPtr& batch);
 
-            void            OnWriteFinished(RemotePeer* remote, DatagramID id, bool error, size_t transferred);
-            void            OnReadFinished(bool error, const RemoteAddress& sender, const uint8_t* buffer, size_t transferred);
+            void            OnWriteFinished(RemotePeer* remote, const PendingWriteBatchPtr& batch, bool error, size_t transferred);
+            void            OnReadFinished(bool error, const RemoteAddress& sender, const BufferPool::Handle& buffer, size_t transferred);
+            void            HandleDatagram(RemotePeer* remote, const RemoteAddress& sender, ConnectionID connectionID, const BufferPool::Handle& buffer, size_t transferred);
 
             void            HandleSplitPacket(RemotePeer& remote, const PacketHeader& header, BinaryStream& instream);
             void            HandleIncomingPacket(RemotePeer& remote, const PacketHeader& header, std::unique_ptr<Packet> packet);
@@ -146,6 +244,9 @@ namespace wirefox {
             std::atomic_bool    m_updateThreadAbort;
             std::thread         m_updateThread;
             AwaitableEvent      m_updateNotify;
+            std::shared_ptr<UpdateThread> m_updater;
+            std::unique_ptr<WorkerPool> m_workers;
+            std::vector<RemotePeer*> m_remotesInUse;
         };
 
         /// \endcond
@@ -0,0 +1,103 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#include "PCH.h"
+#include "PathMtuDiscovery.h"
+
+using namespace wirefox::detail;
+
+static_assert(cfg::MTU_MAX >= cfg::MTU, "wirefox::cfg::MTU_MAX must be at least wirefox::cfg::MTU");
+static_assert(cfg::PMTU_PROBE_COUNT > 0, "wirefox::cfg::PMTU_PROBE_COUNT must be greater than zero");
+static_assert(cfg::PMTU_BLACK_HOLE_RESENDS < cfg::SEND_RETRY_COUNT, "wirefox::cfg::PMTU_BLACK_HOLE_RESENDS must be less than wirefox::cfg::SEND_RETRY_COUNT");
+
+PathMtuDiscovery::PathMtuDiscovery()
+    : m_pathMtu(cfg::MTU)
+    , m_searchHigh(cfg::MTU_MAX)
+    , m_probeSize(0)
+    , m_probeID(0)
+    , m_probeTimeout(0)
+    , m_probeLosses(0)
+    , m_nextRaise(0) {}
+
+void PathMtuDiscovery::Update() {
+    // a probe that isn't acked in time was most likely too big
+    if (m_probeSize != 0 && Time::Elapsed(m_probeTimeout))
+        OnProbeLost();
+
+    // the route may have changed since the search ended, so every now and then, see if bigger datagrams fit now
+    if (m_probeSize == 0 && GetSearchComplete() && m_searchHigh < cfg::MTU_MAX && Time::Elapsed(m_nextRaise))
+        m_searchHigh = cfg::MTU_MAX;
+}
+
+size_t PathMtuDiscovery::GetProbeSize() const {
+    // only one probe is in flight at a time, so a lost probe is never mistaken for another one of a different size
+    if (m_probeSize != 0 || GetSearchComplete()) return 0;
+
+    // try the largest size first, which is what a jumbo frame network will carry, so it's found in one round trip.
+    // once that fails, halve the range between what's confirmed and what isn't
+    if (m_searchHigh == cfg::MTU_MAX)
+        return m_searchHigh;
+
+    return m_pathMtu + (m_searchHigh - m_pathMtu + 1) / 2;
+}
+
+void PathMtuDiscovery::NotifyProbeSent(DatagramID id, size_t size, Timespan timeout) {
+    assert(size > m_pathMtu && size <= m_searchHigh);
+
+    m_probeID = id;
+    m_probeSize = size;
+    m_probeTimeout = Time::Now() + timeout;
+}
+
+bool PathMtuDiscovery::NotifyReceivedAck(DatagramID id) {
+    if (m_probeSize == 0 || id != m_probeID) return false;
+
+    // the probe arrived, so the path can carry datagrams of this size
+    m_pathMtu = m_probeSize;
+    m_probeSize = 0;
+    m_probeLosses = 0;
+
+    if (GetSearchComplete())
+        m_nextRaise = Time::Now() + Time::FromSeconds(cfg::PMTU_RAISE_INTERVAL);
+
+    return true;
+}
+
+bool PathMtuDiscovery::NotifyReceivedNak(DatagramID id) {
+    if (m_probeSize == 0 || id != m_probeID) return false;
+
+    OnProbeLost();
+    return true;
+}
+
+void PathMtuDiscovery::NotifyBlackHole() {
+    if (m_pathMtu <= cfg::MTU) return;
+
+    // the size that was confirmed earlier doesn't get through anymore, so look for a smaller one
+    m_searchHigh = m_pathMtu - 1;
+    m_pathMtu = cfg::MTU;
+    m_probeSize = 0;
+    m_probeLosses = 0;
+}
+
+void PathMtuDiscovery::OnProbeLost() {
+    // a probe may also be lost to congestion, so only give up on its size after a few tries
+    if (++m_probeLosses >= cfg::PMTU_PROBE_COUNT) {
+        m_searchHigh = m_probeSize - 1;
+        m_probeLosses = 0;
+
+        if (GetSearchComplete())
+            m_nextRaise = Time::Now() + Time::FromSeconds(cfg::PMTU_RAISE_INTERVAL);
+    }
+
+    m_probeSize = 0;
+}
+
+bool PathMtuDiscovery::GetSearchComplete() const {
+    return m_searchHigh < m_pathMtu + cfg::PMTU_SEARCH_GRANULARITY;
+}
@@ -0,0 +1,96 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#pragma once
+#include "WirefoxConfig.h"
+#include "WirefoxTime.h"
+
+namespace wirefox {
+
+    namespace detail {
+
+        /**
+         * \cond WIREFOX_INTERNAL
+         * \brief Finds out how big a datagram the network path to a remote endpoint can carry.
+         *
+         * This follows the outline of Datagram Packetization Layer PMTU Discovery (RFC 8899). Every connection starts
+         * out at cfg::MTU. Once connected, padded probe datagrams of a larger size are sent, one at a time. If the remote
+         * acks a probe, its size is confirmed, and bigger datagrams may be sent from then on. If a probe of the same size
+         * is lost several times in a row, that size is considered too big for the path. The search runs between those
+         * two bounds, until it is close enough to the largest size the path can carry.
+         *
+         * If datagrams of the confirmed size stop arriving, the path may have changed, so the search falls back to
+         * cfg::MTU and starts over.
+         */
+        class PathMtuDiscovery {
+        public:
+            /// Default constructor.
+            PathMtuDiscovery();
+
+            /// Checks for lost probes, and restarts the search once in a while. Must be called periodically.
+            void            Update();
+
+            /// Returns the largest datagram, in bytes, that may currently be sent to the remote.
+            size_t          GetPathMtu() const { return m_pathMtu; }
+
+            /// Returns the size, in bytes, of the probe that should be sent next, or zero if no probe is needed right now.
+            size_t          GetProbeSize() const;
+
+            /**
+             * \brief Informs the search that a probe is being sent.
+             *
+             * \param[in]   id          The DatagramID of the probe.
+             * \param[in]   size        The size of the probe, in bytes, as returned by GetProbeSize().
+             * \param[in]   timeout     How long to wait for an ack, before the probe is considered lost.
+             */
+            void            NotifyProbeSent(DatagramID id, size_t size, Timespan timeout);
+
+            /**
+             * \brief Informs the search that the remote acknowledged a datagram.
+             *
+             * \param[in]   id          The DatagramID that was acknowledged.
+             * \returns     True if the datagram was the current probe.
+             */
+            bool            NotifyReceivedAck(DatagramID id);
+
+            /**
+             * \brief Informs the search that the remote did not receive a datagram.
+             *
+             * \param[in]   id          The DatagramID that was not acknowledged.
+             * \returns     True if the datagram was the current probe.
+             */
+            bool            NotifyReceivedNak(DatagramID id);
+
+            /**
+             * \brief Informs the search that datagrams of the current size appear to no longer arrive.
+             *
+             * Falls back to cfg::MTU, and searches again below the size that stopped working.
+             */
+            void            NotifyBlackHole();
+
+        private:
+            /// Counts a probe loss, and lowers the upper bound of the search once a size was lost too often.
+            void            OnProbeLost();
+
+            /// Returns a value indicating whether the search is close enough to the upper bound to stop probing.
+            bool            GetSearchComplete() const;
+
+            size_t          m_pathMtu;
+            size_t          m_searchHigh;
+            size_t          m_probeSize;
+            DatagramID      m_probeID;
+            Timestamp       m_probeTimeout;
+            unsigned        m_probeLosses;
+            Timestamp       m_nextRaise;
+        };
+
+        /// \endcond
+
+    }
+
+}
@@ -15,21 +15,63 @@
 #include "EncryptionAuthenticator.h"
 #include "DatagramHeader.h"
 #include "Channel.h"
+#include "SocketIoUring.h"
+#include "SocketSharedMemory.h"
 
 using namespace wirefox::detail;
 
+namespace {
+
+    std::shared_ptr<Socket> CreateSocket(SocketBackend& backend) {
+#ifdef WIREFOX_ENABLE_IO_URING
+        if (backend == SocketBackend::IO_URING) {
+            if (auto socket = SocketIoUring::Create())
+                return socket;
+        }
+#endif
+#ifdef WIREFOX_ENABLE_SHARED_MEMORY
+        if (backend == SocketBackend::SHARED_MEMORY)
+            return SocketSharedMemory::Create();
+#endif
+
+        // requested backend is not available, use the portable one instead
+        backend = SocketBackend::DEFAULT;
+        return cfg::DefaultSocket::Create();
+    }
+
+}
+
 std::unique_ptr<IPeer> IPeer::Factory::Create(size_t maxPeers) {
     return std::make_unique<Peer>(maxPeers);
 }
 
-Peer::Peer(size_t maxPeers)
+std::unique_ptr<IPeer> IPeer::Factory::Create(size_t maxPeers, SocketBackend backend) {
+    return std::make_unique<Peer>(maxPeers, backend);
+}
+
+Peer::Peer(size_t maxPeers, SocketBackend backend)
+    : Peer(maxPeers, CreateSocket(backend)) {
+    // CreateSocket() changed the backend to the one that is actually in use
+    m_socketBackend = backend;
+}
+
+Peer::Peer(size_t maxPeers, std::shared_ptr<Socket> socket, std::shared_ptr<UpdateThread> updater)
     : m_id(GeneratePeerID())
     , m_remotesMax(maxPeers + 1)
     , m_remotesIncoming(0)
     , m_advertisement(0)
-    , m_masterSocket(cfg::DefaultSocket::Create())
-    , m_remotes(std::unique_ptr<RemotePeer[]>(new RemotePeer[m_remotesMax]))
-    , m_queue(std::make_shared<PacketQueue>(this))
+    , m_connectLimiter(cfg::CONNECT_RATE_TABLE_SIZE, cfg::CONNECT_RATE_LIMIT, cfg::CONNECT_RATE_BURST)
+    , m_socketBackend(SocketBackend::DEFAULT)
+    , m_masterSocket(std::move(socket))
+    , m_remotes(std::make_unique<std::atomic<RemotePeer*>[]>(m_remotesMax))
+    , m_inUseHead(nullptr)
+    , m_inUseTail(nullptr)
+    , m_queue(std::make_shared<PacketQueue>(this, std::move(updater)))
+    , m_handshakeWorkers(std::make_unique<WorkerPool>(cfg::HANDSHAKE_THREADS, cfg::HANDSHAKE_QUEUE_LEN))
+    , m_addressLookup(m_remotesMax, AddressHasher{SipHash::CreateKey()})
+    , m_connectionIDSecret(SipHash::CreateKey())
+    , m_connectionIDCounter(0)
+    , m_connectionIDBase(0)
     , m_channels{ChannelMode::UNORDERED}
     , m_crypto_enabled(false) {}
 
@@ -38,6 +80,12 @@ Peer::Peer(Peer&& other) noexcept
     , m_remotesMax(0)
     , m_remotesIncoming(0)
     , m_advertisement(0)
+    , m_connectLimiter(cfg::CONNECT_RATE_TABLE_SIZE, cfg::CONNECT_RATE_LIMIT, cfg::CONNECT_RATE_BURST)
+    , m_socketBackend(SocketBackend::DEFAULT)
+    , m_inUseHead(nullptr)
+    , m_inUseTail(nullptr)
+    , m_connectionIDCounter(0)
+    , m_connectionIDBase(0)
     , m_crypto_enabled(false) {
     *this = std::move(other);
 }
@@ -45,7 +93,13 @@ Peer::Peer(Peer&& other) noexcept
 Peer::~Peer() {
     // clean shutdown, stop worker threads before deallocating everything
     m_masterSocket->Unbind();
+    m_handshakeWorkers->Stop();
     m_queue->Stop();
+
+    if (m_remotes) {
+        for (size_t i = 0; i < m_remotesMax; i++)
+            delete m_remotes[i].load();
+    }
 }
 
 Peer& Peer::operator=(Peer&& other) noexcept {
@@ -67,11 +121,24 @@ Peer& Peer::operator=(Peer&& other) noexcept {
         other.m_simExtraPing = 0;
 #endif
 
+        m_socketBackend = other.m_socketBackend;
         m_masterSocket = std::move(other.m_masterSocket);
         m_remotes = std::move(other.m_remotes);
         m_queue = std::move(other.m_queue);
+        m_handshakeWorkers = std::move(other.m_handshakeWorkers);
         m_remoteLookup = std::move(other.m_remoteLookup);
+        m_inUseHead = other.m_inUseHead;
+        m_inUseTail = other.m_inUseTail;
+        other.m_inUseHead = nullptr;
+        other.m_inUseTail = nullptr;
+        m_addressLookup = std::move(other.m_addressLookup);
+        m_connectionIDSecret = other.m_connectionIDSecret;
+        m_connectionIDCounter = other.m_connectionIDCounter.load();
+        m_connectionIDBase = other.m_connectionIDBase;
+        m_router = std::move(other.m_router);
+        m_sharedSlots = std::move(other.m_sharedSlots);
         m_channels = std::move(other.m_channels);
+        m_tickets = std::move(other.m_tickets);
     }
 
     return *this;
@@ -79,16 +146,17 @@ Peer& Peer::operator=(Peer&& other) noexcept {
 
 ConnectAttemptResult Peer::Connect(const std::string& host, uint16_t port, const uint8_t* public_key) {
     auto* slot = GetNextAvailableConnectSlot();
-    if (!slot) return ConnectAttemptResult::NO_FREE_SLOTS;
+    if (!slot || !AcquireSharedSlot()) return ConnectAttemptResult::NO_FREE_SLOTS;
 
-    slot->Setup(this, ConnectionOrigin::SELF);
+    ReserveRemote(*slot, ConnectionOrigin::SELF);
+    slot->localConnectionID = MakeConnectionID(*slot);
 
     if (public_key) {
         // Cannot specify public key while also having crypto disabled, that's dangerous because
         // our only other option here is to silently discard the key, which would lead to the user thinking
         // they're having an encrypted conversation when they really aren't. Therefore, treat as error.
         if (!GetEncryptionEnabled()) {
-            slot->Reset();
+            ResetRemote(*slot);
             return ConnectAttemptResult::INVALID_PARAMETER;
         }
 
@@ -105,7 +173,7 @@ ConnectAttemptResult Peer::Connect(const std::string& host, uint16_t port, const
             return;
         }
 
-        slot->addr = addr;
+        SetRemoteAddress(*slot, addr);
         slot->socket = std::move(socket);
         SetupRemotePeerCallbacks(slot);
         slot->handshake->Begin();
@@ -114,7 +182,7 @@ ConnectAttemptResult Peer::Connect(const std::string& host, uint16_t port, const
 
     // make sure to un-reserve the slot we just prepared, if the connect attempt never went out
     if (ret != ConnectAttemptResult::OK)
-        slot->Reset();
+        ResetRemote(*slot);
 
     return ret;
 }
@@ -122,9 +190,10 @@ ConnectAttemptResult Peer::Connect(const std::string& host, uint16_t port, const
 bool Peer::Bind(SocketProtocol family, uint16_t port) {
     // Remote 0 is a special reserved slot, where out-of-band (i.e. unconnected) communication is performed.
     // We do it this way so PacketQueue requires no extra logic when iterating over the remotes array.
-    m_remotes[0].Setup(this, ConnectionOrigin::INVALID);
-    m_remotes[0].socket = m_masterSocket;
-    m_remotes[0].active = true;
+    auto& oob = GetRemoteByIndex(0);
+    ReserveRemote(oob, ConnectionOrigin::INVALID);
+    oob.socket = m_masterSocket;
+    oob.active = true;
 
     return m_masterSocket->Bind(family, port);
 }
@@ -163,18 +232,21 @@ void Peer::DisconnectImmediate(RemotePeer* remote) {
         remote->handshake->Complete(ConnectResult::CONNECT_FAILED);
 
     // ... but in any case, kill the connection
-    remote->Reset();
+    ResetRemote(*remote);
 }
 
 void Peer::Stop(Timespan linger) {
-    for (size_t i = 1 /* skip oob socket */; i < m_remotesMax; i++) {
-        auto& slot = m_remotes[i];
-        if (slot.IsConnected() && linger > 0)
+    std::vector<RemotePeer*> remotes;
+    GetRemotesInUse(remotes);
+    for (auto* remote : remotes) {
+        if (remote->slot == 0) continue; // skip oob socket
+
+        if (remote->IsConnected() && linger > 0)
             // if connection was established, perform graceful disconnect
-            Disconnect(slot.id, linger);
+            Disconnect(remote->id, linger);
         else
             // otherwise (or if graceful is disabled), at least prevent new outgoing messages
-            slot.disconnect = Time::Now() + linger;
+            remote->disconnect = Time::Now() + linger;
     }
 
     // block the main thread for the specified linger duration, so that the network
@@ -183,8 +255,11 @@ void Peer::Stop(Timespan linger) {
         std::this_thread::sleep_for(std::chrono::milliseconds(Time::ToMilliseconds(linger)));
 
     // finally, actually kill all connections and clean up the entire remotes array
-    for (size_t i = 1 /* skip oob socket */; i < m_remotesMax; i++)
-        m_remotes[i].Reset();
+    GetRemotesInUse(remotes);
+    for (auto* remote : remotes) {
+        if (remote->slot != 0) // skip oob socket
+            ResetRemote(*remote);
+    }
     // and stop network activity
     m_masterSocket->Unbind();
 }
@@ -200,6 +275,22 @@ PacketID Peer::Send(const Packet& packet, PeerID recipient, PacketOptions option
     return m_queue->EnqueueOutgoing(packet, remote, options, priority, channel);
 }
 
+size_t Peer::Send(const Packet& packet, const std::vector<PeerID>& recipients, PacketOptions options, PacketPriority priority, const Channel& channel) {
+    // sanity check, hard cap on data length
+    if (packet.GetLength() > cfg::PACKET_MAX_LENGTH) return 0;
+
+    // translate peerIDs to remotes, skipping the ones we don't know
+    std::vector<RemotePeer*> remotes;
+    remotes.reserve(recipients.size());
+    for (auto recipient : recipients)
+        if (auto* remote = GetRemoteByID(recipient))
+            remotes.push_back(remote);
+
+    // the queue doesn't prioritize packets yet, for a single recipient either, so there is nothing to pass it on to
+    (void)priority;
+    return m_queue->EnqueueOutgoing(packet, remotes, options, channel);
+}
+
 void Peer::SendLoopback(const Packet& packet) {
     m_queue->EnqueueLoopback(packet);
 }
@@ -277,10 +368,93 @@ bool Peer::GetEncryptionEnabled() const {
     return m_crypto_enabled;
 }
 
+size_t Peer::GetWorkerThreads() const {
+    return m_queue->GetWorkerThreads();
+}
+
+void Peer::SetWorkerThreads(size_t count) {
+    // settings cannot be changed after the socket is bound
+    if (m_masterSocket->IsOpenAndReady()) return;
+
+    m_queue->SetWorkerThreads(count);
+}
+
+void Peer::SetSocketBufferSizes(size_t receive, size_t send) {
+    m_masterSocket->SetBufferSizes(receive, send);
+}
+
+void Peer::GetSocketBufferSizes(size_t& receive, size_t& send) const {
+    m_masterSocket->GetBufferSizes(receive, send);
+}
+
+size_t Peer::GetHandshakeThreads() const {
+    return m_handshakeWorkers->GetThreadCount();
+}
+
+void Peer::SetHandshakeThreads(size_t count) {
+    // settings cannot be changed after the socket is bound
+    if (m_masterSocket->IsOpenAndReady()) return;
+
+    m_handshakeWorkers = std::make_unique<WorkerPool>(count, cfg::HANDSHAKE_QUEUE_LEN);
+}
+
 std::shared_ptr<EncryptionLayer::Keypair> Peer::GetEncryptionIdentity() const {
     return m_crypto_identity;
 }
 
+void Peer::SetEncryptionIdentity(std::shared_ptr<EncryptionLayer::Keypair> keypair) {
+    if (!m_crypto_enabled || m_masterSocket->IsOpenAndReady()) return;
+
+    m_crypto_identity = std::move(keypair);
+}
+
+void Peer::SetConnectRateLimit(unsigned int perSecond, unsigned int burst) {
+    m_connectLimiter.SetLimit(perSecond, burst);
+}
+
+void Peer::SetMyPeerID(PeerID id) {
+    assert(id != 0);
+    if (m_masterSocket->IsOpenAndReady()) return;
+
+    m_id = id;
+}
+
+bool Peer::SetShard(uint32_t connectionIDBase, DatagramRouter router, std::shared_ptr<SharedSlots> slots) {
+    if (!m_masterSocket->SetReusePort(true)) return false;
+
+    m_connectionIDBase = connectionIDBase;
+    m_router = std::move(router);
+    m_sharedSlots = std::move(slots);
+    return true;
+}
+
+bool Peer::AcceptRoutedDatagram(ConnectionID id, const RemoteAddress& sender, const BufferPool::Handle& buffer, size_t transferred) {
+    if (!GetRemoteByConnectionID(id)) return false;
+
+    m_queue->DispatchDatagram(sender, buffer, transferred);
+    return true;
+}
+
+bool Peer::RouteDatagram(ConnectionID id, const RemoteAddress& sender, const BufferPool::Handle& buffer, size_t transferred) const {
+    return m_router && m_router(id, sender, buffer, transferred);
+}
+
+uint16_t Peer::GetLocalPort() const {
+    return m_masterSocket->GetLocalPort();
+}
+
+size_t Peer::GetReceiveDrops() const {
+    return m_masterSocket->GetReceiveDrops();
+}
+
+size_t Peer::GetSendBlocked() const {
+    return m_masterSocket->GetSendBlocked();
+}
+
+SocketBackend Peer::GetSocketBackend() const {
+    return m_socketBackend;
+}
+
 void Peer::SendOutOfBand(const Packet& packet, const RemoteAddress& addr) {
     m_queue->EnqueueOutOfBand(packet, addr, nullptr);
 }
@@ -334,10 +508,11 @@ ChannelMode Peer::GetChannelModeByIndex(ChannelIndex index) const {
 }
 
 void Peer::GetAllConnectedPeers(std::vector<PeerID>& output) const {
-    for (size_t i = 1 /* skip oob socket */; i < m_remotesMax; i++) {
-        auto& slot = m_remotes[i];
-        if (slot.IsConnected())
-            output.push_back(slot.id);
+    WIREFOX_LOCK_GUARD(m_inUseLock);
+
+    for (auto* remote = m_inUseHead; remote; remote = remote->nextInUse) {
+        if (remote->IsConnected())
+            output.push_back(remote->id);
     }
 }
 
@@ -373,23 +548,35 @@ void SendRejectionReply(Peer* peer, const RemoteAddress& addr, ConnectResult rea
 }
 
 void Peer::OnNewIncomingPeer(const RemoteAddress& addr, const Packet& packet) {
-    // TODO: IP rate limit check, as countermeasure against SYN flood-style DoS attack
-
     // looks like this is going somewhere; let's reserve a RemotePeer slot for this new fellow
     auto* remote = GetNextAvailableIncomingSlot();
-    if (!remote) {
+    if (!remote || !AcquireSharedSlot()) {
         // no slots available :(
         SendRejectionReply(this, addr, ConnectResult::NO_FREE_SLOTS);
         return;
     }
 
     // configure the new remote
-    remote->Setup(this, ConnectionOrigin::REMOTE);
+    ReserveRemote(*remote, ConnectionOrigin::REMOTE);
+    remote->localConnectionID = MakeConnectionID(*remote);
     SetupRemotePeerCallbacks(remote);
     remote->socket = m_masterSocket; // TODO: FIX ME! Incompatible with future TCP implementation. TCP needs to hand us a new socket from an acceptor!
-    remote->addr = addr;
+    SetRemoteAddress(*remote, addr);
     remote->active = true;
-    remote->handshake->Handle(packet);
+
+    // key exchanges and identity challenges are expensive, so they're done on a handshake thread, where a burst of
+    // connection requests can't hold up the datagrams of remotes that are already connected. the remote may be reset,
+    // or even reused for another connection, while this message waits for that thread
+    Handshaker* handshake = remote->handshake.get();
+    const bool posted = PostHandshakeTask(*remote, [remote, handshake, addr, packet]() {
+        WIREFOX_LOCK_GUARD(remote->lock);
+        if (remote->active && remote->handshake.get() == handshake && remote->addr == addr)
+            handshake->Handle(packet);
+    });
+
+    // if the handshake threads are too busy to take this on, give the slot back; the sender will try again later
+    if (!posted)
+        ResetRemote(*remote);
 }
 
 void Peer::OnDisconnect(RemotePeer& remote, PacketCommand cmd) {
@@ -413,7 +600,7 @@ void Peer::OnSystemPacket(RemotePeer& remote, std::unique_ptr<Packet> packet) {
         Packet dc_ack(PacketCommand::DISCONNECT_ACK, nullptr, 0);
         m_queue->EnqueueOutOfBand(dc_ack, remote.addr, &remote);
 
-        remote.Reset();
+        ResetRemote(remote);
         break;
     }
     case PacketCommand::RPC_SIGNAL: {
@@ -444,11 +631,9 @@ void Peer::OnUnconnectedMessage(const RemoteAddress& addr, BinaryStream& instrea
     PacketHeader header;
 
     // for this unconnected (internal) packet to make sense, it must have data (a command for us), and must not be a split packet.
-    // if this assert trips, the packet is malformed. in a debug env, this should not happen, but in the wild it's possible of course
-    if (!header.Deserialize(instream) || header.flag_segment) {
-        assert(false);
+    // anyone can send us these, so the payload it claims to have must actually be there before we copy it
+    if (!header.Deserialize(instream) || header.flag_segment || header.length == 0 || instream.IsEOF(header.length))
         return;
-    }
 
     Packet packet = Packet::FromDatagram(0, instream, header.length);
     switch (packet.GetCommand()) {
@@ -467,14 +652,30 @@ void Peer::OnUnconnectedMessage(const RemoteAddress& addr, BinaryStream& instrea
 
         RemotePeer* remote = GetRemoteByAddress(addr);
         if (!remote) {
-            // new address we haven't seen before, treat as a new connection request
-            OnNewIncomingPeer(addr, packet);
+            // new address we haven't seen before. turn away sources that send more requests than any honest client
+            // would, before spending any effort on them
+            const auto verdict = m_connectLimiter.Consume(addr);
+            if (verdict == RateLimiter::Verdict::REJECT)
+                SendRejectionReply(this, addr, ConnectResult::IP_RATE_LIMITED);
+            if (verdict != RateLimiter::Verdict::ALLOW)
+                break;
+
+            // only treat this as a new connection request if the sender has proven that it can receive replies at
+            // this address; until then, don't reserve anything for it
+            BinaryStream reply(0);
+            if (cfg::DefaultHandshaker::HandleOutOfBandRequest(reply, GetMyPeerID(), addr, packet)) {
+                OnNewIncomingPeer(addr, packet);
+            } else if (!reply.IsEmpty()) {
+                Packet retry(PacketCommand::CONNECT_ATTEMPT, std::move(reply));
+                SendOutOfBand(retry, addr);
+            }
             break;
         }
         // if handshake already complete, ignore this message, it's likely a duplicate or delayed (re)send
         if (remote->handshake->IsDone())
             break;
 
+        // PacketQueue hands us the messages of a remote whose handshake is in progress on its handshake thread
         remote->handshake->Handle(packet);
 
         // if handshake failed, discard this remote endpoint
@@ -526,12 +727,9 @@ void Peer::OnUnconnectedMessage(const RemoteAddress& addr, const uint8_t* msg, s
     // it is likely we just killed the connection (comm error), but in any case we can't handle this packet anymore.
     if (header.flag_link) return;
 
-    // for this unconnected (internal) packet to make sense, it must have data (a command for us), and must not be a split packet.
-    // if this assert trips, the packet is malformed. in a debug env, this should not happen, but in the wild it's possible of course
-    if (!header.flag_data) {
-        assert(false);
-        return;
-    }
+    // for this unconnected (internal) packet to make sense, it must have data (a command for us). otherwise it's malformed,
+    // or it's a datagram for a connection we just closed, whose ConnectionID prefix we can no longer recognize
+    if (!header.flag_data) return;
 
     OnUnconnectedMessage(addr, instream);
 }
@@ -565,6 +763,10 @@ void Peer::SendHandshakePart(RemotePeer* remote, BinaryStream&& outstream) {
     m_queue->EnqueueOutOfBand(packet, remote->addr, forceCryptoBy);
 }
 
+bool Peer::PostHandshakeTask(const RemotePeer& remote, WorkerPool::Task task) {
+    return m_handshakeWorkers->Post(remote.slot, std::move(task));
+}
+
 void Peer::SendHandshakeCompleteNotification(RemotePeer* remote, Packet&& notification) {
     assert(remote);
     const auto result = remote->handshake->GetResult();
@@ -580,7 +782,7 @@ void Peer::SendHandshakeCompleteNotification(RemotePeer* remote, Packet&& notifi
 
     if (isFailure)
         // an error occurred, this connection must be dropped
-        remote->Reset();
+        ResetRemote(*remote);
 }
 
 RemotePeer* Peer::GetRemoteByID(PeerID id) {
@@ -588,17 +790,24 @@ RemotePeer* Peer::GetRemoteByID(PeerID id) {
     auto it = m_remoteLookup.find(id);
     if (it != m_remoteLookup.end()) return it->second;
 
-    // linear search through peers array
-    for (size_t i = 1 /* skip oob socket */; i < m_remotesMax; i++) {
-        auto& remote = m_remotes[i];
-        if (remote.id == id && remote.active) {
-            // insert into map for future fast lookup
-            m_remoteLookup.emplace(id, &remote);
-            return &remote;
+    // linear search through the remotes in use
+    RemotePeer* found = nullptr;
+    {
+        WIREFOX_LOCK_GUARD(m_inUseLock);
+
+        for (auto* remote = m_inUseHead; remote; remote = remote->nextInUse) {
+            if (remote->slot != 0 /* skip oob socket */ && remote->id == id && remote->active) {
+                found = remote;
+                break;
+            }
         }
     }
 
-    return nullptr;
+    // insert into map for future fast lookup
+    if (found)
+        m_remoteLookup.emplace(id, found);
+
+    return found;
 }
 
 RemotePeer* Peer::GetRemoteByID(PeerID id) const {
@@ -606,11 +815,12 @@ RemotePeer* Peer::GetRemoteByID(PeerID id) const {
     auto it = m_remoteLookup.find(id);
     if (it != m_remoteLookup.end()) return it->second;
 
-    // linear search through peers array
-    for (size_t i = 1 /* skip oob socket */; i < m_remotesMax; i++) {
-        auto& remote = m_remotes[i];
-        if (remote.id == id && remote.active)
-            return &remote;
+    // linear search through the remotes in use
+    WIREFOX_LOCK_GUARD(m_inUseLock);
+
+    for (auto* remote = m_inUseHead; remote; remote = remote->nextInUse) {
+        if (remote->slot != 0 /* skip oob socket */ && remote->id == id && remote->active)
+            return remote;
     }
 
     return nullptr;
@@ -618,15 +828,165 @@ RemotePeer* Peer::GetRemoteByID(PeerID id) const {
 
 RemotePeer& Peer::GetRemoteByIndex(size_t index) const {
     assert(index < m_remotesMax);
-    return m_remotes[index];
+
+    auto* remote = m_remotes[index].load();
+    if (remote) return *remote;
+
+    // first use of this slot. if another thread beat us to it, use theirs. slots are never freed until the Peer is
+    // destroyed, so pointers to them stay valid even after a remote is reset
+    auto fresh = std::make_unique<RemotePeer>(index);
+    if (m_remotes[index].compare_exchange_strong(remote, fresh.get()))
+        return *fresh.release();
+
+    return *remote;
+}
+
+RemotePeer* Peer::GetAllocatedRemote(size_t index) const {
+    assert(index < m_remotesMax);
+    return m_remotes[index].load();
+}
+
+void Peer::GetRemotesInUse(std::vector<RemotePeer*>& output) const {
+    output.clear();
+
+    WIREFOX_LOCK_GUARD(m_inUseLock);
+
+    for (auto* remote = m_inUseHead; remote; remote = remote->nextInUse)
+        output.push_back(remote);
 }
 
 RemotePeer* Peer::GetRemoteByAddress(const RemoteAddress& addr) const {
-    for (size_t i = 1 /* skip oob socket */; i < m_remotesMax; i++)
-        if (m_remotes[i].active && m_remotes[i].addr == addr)
-            return &m_remotes[i];
+    const auto key = addr.GetBytes();
 
-    return nullptr;
+    WIREFOX_LOCK_GUARD(m_addressLock);
+
+    auto it = m_addressLookup.find(key);
+    if (it == m_addressLookup.end() || !it->second->active)
+        return nullptr;
+
+    return it->second;
+}
+
+RemotePeer* Peer::GetRemoteByConnectionID(ConnectionID id) const {
+    // IDs issued by other Peers that share our port are below or above our range
+    const auto index = static_cast<size_t>(id & std::numeric_limits<uint32_t>::max());
+    if (index <= m_connectionIDBase || index - m_connectionIDBase >= m_remotesMax)
+        return nullptr;
+
+    auto* remote = GetAllocatedRemote(index - m_connectionIDBase);
+    if (!remote || !remote->active || remote->localConnectionID != id)
+        return nullptr;
+
+    return remote;
+}
+
+ConnectionID Peer::MakeConnectionID(const RemotePeer& remote) {
+    const auto index = static_cast<uint64_t>(m_connectionIDBase) + remote.slot;
+    assert(remote.slot > 0 && index <= std::numeric_limits<uint32_t>::max());
+
+    // a keyed hash of a counter gives unpredictable bits that don't repeat for a long while
+    const uint64_t counter = m_connectionIDCounter++;
+    uint8_t input[sizeof counter];
+    for (size_t i = 0; i < sizeof counter; i++)
+        input[i] = static_cast<uint8_t>(counter >> (8 * i));
+
+    const uint64_t secret = SipHash::Hash(m_connectionIDSecret, input, sizeof input) & ~uint64_t(std::numeric_limits<uint32_t>::max());
+    return secret | index;
+}
+
+void Peer::SetRemoteAddress(RemotePeer& remote, const RemoteAddress& addr) {
+    WIREFOX_LOCK_GUARD(m_addressLock);
+
+    // forget the old address, but only if it's still ours; another remote may have taken it over since
+    auto it = m_addressLookup.find(remote.addr.GetBytes());
+    if (it != m_addressLookup.end() && it->second == &remote)
+        m_addressLookup.erase(it);
+
+    remote.addr = addr;
+    m_addressLookup[addr.GetBytes()] = &remote;
+}
+
+void Peer::ReserveRemote(RemotePeer& remote, ConnectionOrigin origin) {
+    assert(&remote == GetAllocatedRemote(remote.slot));
+    remote.Setup(this, origin);
+
+    WIREFOX_LOCK_GUARD(m_inUseLock);
+
+    // already in the list if it was reserved before
+    if (remote.prevInUse || m_inUseHead == &remote) return;
+
+    remote.prevInUse = m_inUseTail;
+    remote.nextInUse = nullptr;
+    if (m_inUseTail)
+        m_inUseTail->nextInUse = &remote;
+    else
+        m_inUseHead = &remote;
+
+    m_inUseTail = &remote;
+}
+
+void Peer::ResetRemote(RemotePeer& remote) {
+    {
+        WIREFOX_LOCK_GUARD(m_addressLock);
+
+        auto it = m_addressLookup.find(remote.addr.GetBytes());
+        if (it != m_addressLookup.end() && it->second == &remote)
+            m_addressLookup.erase(it);
+    }
+
+    {
+        WIREFOX_LOCK_GUARD(m_inUseLock);
+
+        if (remote.prevInUse || m_inUseHead == &remote) {
+            if (remote.prevInUse)
+                remote.prevInUse->nextInUse = remote.nextInUse;
+            else
+                m_inUseHead = remote.nextInUse;
+
+            if (remote.nextInUse)
+                remote.nextInUse->prevInUse = remote.prevInUse;
+            else
+                m_inUseTail = remote.prevInUse;
+
+            remote.prevInUse = nullptr;
+            remote.nextInUse = nullptr;
+
+            // the slot reserved with AcquireSharedSlot() is free again for all Peers sharing our port
+            if (m_sharedSlots && remote.slot != 0)
+                m_sharedSlots->reserved--;
+        }
+    }
+
+    remote.Reset();
+}
+
+size_t Peer::AddressHasher::operator()(const RemoteAddress::Bytes& key) const noexcept {
+    return static_cast<size_t>(SipHash::Hash(secret, key.data(), key.size()));
+}
+
+void Peer::SetResumeTicket(const RemoteAddress& addr, BinaryStream ticket) {
+    if (ticket.IsEmpty()) return;
+
+    WIREFOX_LOCK_GUARD(m_ticketLock);
+
+    // make room by dropping an arbitrary ticket; a client that talks to this many servers just reconnects the slow way
+    const auto key = addr.GetBytes();
+    if (m_tickets.size() >= cfg::SESSION_TICKET_CACHE_SIZE && m_tickets.find(key) == m_tickets.end())
+        m_tickets.erase(m_tickets.begin());
+
+    m_tickets[key] = std::move(ticket);
+}
+
+BinaryStream Peer::TakeResumeTicket(const RemoteAddress& addr) {
+    WIREFOX_LOCK_GUARD(m_ticketLock);
+
+    auto it = m_tickets.find(addr.GetBytes());
+    if (it == m_tickets.end())
+        return BinaryStream(0);
+
+    BinaryStream ticket = std::move(it->second);
+    m_tickets.erase(it);
+    return ticket;
 }
 
 size_t Peer::GetMaximumPeers() const {
@@ -697,16 +1057,28 @@ PeerID Peer::GeneratePeerID() {
 }
 
 RemotePeer* Peer::GetNextAvailableConnectSlot() const {
-    // get first slot that is not reserved
+    // get first slot that is not reserved; a slot that was never allocated is not reserved either
     for (size_t i = 0; i < m_remotesMax; i++) {
-        auto& slot = m_remotes[i];
-        if (!slot.reserved)
-            return &slot;
+        auto* slot = GetAllocatedRemote(i);
+        if (!slot || !slot->reserved)
+            return &GetRemoteByIndex(i);
     }
 
     return nullptr;
 }
 
+bool Peer::AcquireSharedSlot() {
+    if (!m_sharedSlots) return true;
+
+    // other Peers may be reserving at the same time, so only take a slot if the limit still holds afterwards
+    size_t reserved = m_sharedSlots->reserved;
+    do {
+        if (reserved >= m_sharedSlots->limit) return false;
+    } while (!m_sharedSlots->reserved.compare_exchange_weak(reserved, reserved + 1));
+
+    return true;
+}
+
 RemotePeer* Peer::GetNextAvailableIncomingSlot() const {
     if (!GetMaximumIncomingPeers()) return nullptr;
 
@@ -714,9 +1086,9 @@ RemotePeer* Peer::GetNextAvailableIncomingSlot() const {
     // this way we don't have to do any additional counting/searching to keep apart inbound/outbound remotes.
     auto minIndex = m_remotesMax - GetMaximumIncomingPeers();
     for (size_t i = m_remotesMax - 1; i >= minIndex; i--) {
-        auto& slot = m_remotes[i];
-        if (!slot.reserved)
-            return &slot;
+        auto* slot = GetAllocatedRemote(i);
+        if (!slot || !slot->reserved)
+            return &GetRemoteByIndex(i);
     }
 
     return nullptr;
@@ -11,6 +11,8 @@
 #include "PacketQueue.h"
 #include "EncryptionLayer.h"
 #include "RpcController.h"
+#include "RateLimiter.h"
+#include "WorkerPool.h"
 
 namespace wirefox {
 
@@ -28,11 +30,30 @@ namespace wirefox {
          */
         class Peer final : public IPeer {
         public:
+            /// Represents a callback that hands a received datagram to another Peer that shares the same port.
+            /// Returns false if no other Peer is connected to the remote that was issued the ConnectionID.
+            using DatagramRouter = std::function<bool(ConnectionID id, const RemoteAddress& sender, const BufferPool::Handle& buffer, size_t transferred)>;
+
+            /// Counts the remotes of all Peers that share a port, so together they stay within one limit.
+            struct SharedSlots {
+                std::atomic<size_t> reserved{0};
+                std::atomic<size_t> limit{0};
+            };
+
             /**
              * \brief Default constructor.
              * \param[in]   maxPeers    Specifies the maximum number of remotes this Peer can be connected to.
+             * \param[in]   backend     Specifies the socket implementation to use, if available.
+             */
+            Peer(size_t maxPeers = 1, SocketBackend backend = SocketBackend::DEFAULT);
+            /**
+             * \brief Constructs a Peer that uses the specified socket, e.g. one that isn't backed by a real network.
+             * \param[in]   maxPeers    Specifies the maximum number of remotes this Peer can be connected to.
+             * \param[in]   socket      The unbound socket to use.
+             * \param[in]   updater     If not nullptr, the thread that runs this Peer's periodic updates, which may be
+             *                          shared by many Peers. Otherwise, the Peer starts a thread of its own.
              */
-            Peer(size_t maxPeers = 1);
+            Peer(size_t maxPeers, std::shared_ptr<Socket> socket, std::shared_ptr<UpdateThread> updater = nullptr);
             /// Copy constructor.
             Peer(const Peer&) = delete;
             /// Move constructor.
@@ -62,6 +83,7 @@ namespace wirefox {
             void                        DisconnectImmediate(RemotePeer* remote);
 
             PacketID                    Send(const Packet& packet, PeerID recipient, PacketOptions options, PacketPriority priority, const Channel& channel) override;
+            size_t                      Send(const Packet& packet, const std::vector<PeerID>& recipients, PacketOptions options, PacketPriority priority, const Channel& channel) override;
             void                        SendLoopback(const Packet& packet) override;
             std::unique_ptr<Packet>     Receive() override;
 
@@ -75,12 +97,91 @@ namespace wirefox {
             void                        GenerateIdentity(uint8_t* key_secret, uint8_t* key_public) const override;
             size_t                      GetEncryptionKeyLength() const override;
             bool                        GetEncryptionEnabled() const override;
+            size_t                      GetWorkerThreads() const override;
+            void                        SetWorkerThreads(size_t count) override;
+            void                        SetSocketBufferSizes(size_t receive, size_t send) override;
+            void                        GetSocketBufferSizes(size_t& receive, size_t& send) const override;
+            SocketBackend               GetSocketBackend() const override;
+
+            /// Returns the number of threads that process handshake messages.
+            size_t                      GetHandshakeThreads() const;
+
+            /**
+             * \brief Sets the number of threads that process handshake messages. Default is cfg::HANDSHAKE_THREADS.
+             *
+             * Cannot be changed after the Peer is bound.
+             *
+             * \param[in]   count       The number of threads to start, or zero to process handshakes on the threads
+             *                          that receive them.
+             */
+            void                        SetHandshakeThreads(size_t count);
 
             /**
              * \brief Returns the cryptographic identity of this Peer.
              */
             std::shared_ptr<EncryptionLayer::Keypair> GetEncryptionIdentity() const;
 
+            /**
+             * \brief Replaces the cryptographic identity of this Peer with one that is shared with other Peers.
+             *
+             * Has no effect if encryption is disabled, or if the socket is already bound.
+             */
+            void                        SetEncryptionIdentity(std::shared_ptr<EncryptionLayer::Keypair> keypair);
+
+            /**
+             * \brief Changes how many connection requests per second a single IP address may send.
+             *
+             * The defaults are cfg::CONNECT_RATE_LIMIT and cfg::CONNECT_RATE_BURST. A server that expects many clients
+             * from one address, such as a load test on loopback, can raise them.
+             *
+             * \param[in]   perSecond   The number of requests a source may send per second, on average.
+             * \param[in]   burst       The number of requests a source may send in a quick burst.
+             */
+            void                        SetConnectRateLimit(unsigned int perSecond, unsigned int burst);
+
+            /**
+             * \brief Overrides the PeerID this Peer introduces itself with. Must be called before the socket is bound.
+             */
+            void                        SetMyPeerID(PeerID id);
+
+            /**
+             * \brief Makes this Peer one of several that share a port, each serving its own remotes.
+             *
+             * Must be called before Bind(). The operating system spreads remotes across the Peers by address. A connected
+             * datagram that arrives at the wrong Peer, e.g. because the remote's address changed, is handed to \p router.
+             *
+             * \param[in]   connectionIDBase    Added to the slot indices in the ConnectionIDs this Peer issues, so each
+             *                                  Peer sharing the port issues IDs from its own range.
+             * \param[in]   router              Called for connected datagrams that belong to none of this Peer's remotes.
+             * \param[in]   slots               Shared with the other Peers. New remotes are only accepted while fewer
+             *                                  than its limit are reserved in total.
+             * \returns     False if the socket cannot share its port on this platform.
+             */
+            bool                        SetShard(uint32_t connectionIDBase, DatagramRouter router, std::shared_ptr<SharedSlots> slots);
+
+            /**
+             * \brief Hands a datagram that arrived at another Peer sharing the port to this one, if it's ours.
+             *
+             * \returns     False if none of our remotes was issued ConnectionID \p id, in which case nothing is done.
+             */
+            bool                        AcceptRoutedDatagram(ConnectionID id, const RemoteAddress& sender, const BufferPool::Handle& buffer, size_t transferred);
+
+            /**
+             * \brief Passes a connected datagram that belongs to none of our remotes to the DatagramRouter set by SetShard().
+             *
+             * \returns     False if there is no router, or no other Peer took the datagram.
+             */
+            bool                        RouteDatagram(ConnectionID id, const RemoteAddress& sender, const BufferPool::Handle& buffer, size_t transferred) const;
+
+            /// Returns the local port the socket is bound to, or zero if unknown.
+            uint16_t                    GetLocalPort() const;
+
+            /// Returns the number of datagrams the operating system dropped because the socket's receive buffer was full.
+            size_t                      GetReceiveDrops() const;
+
+            /// Returns the number of datagrams that had to wait for room in the socket's send buffer.
+            size_t                      GetSendBlocked() const;
+
             /**
              * \brief Sends an unconnected packet to an arbitrary remote endpoint.
              * 
@@ -103,10 +204,23 @@ namespace wirefox {
 
             /**
              * \brief Retrieves a RemotePeer using its slot index.
+             *
+             * Slots are allocated the first time they are retrieved, and then kept until this Peer is destroyed, so a
+             * Peer with many slots only pays for the ones it has used.
+             *
              * \param[in]   index       The slot index. Range [0, maxPeers].
              */
             RemotePeer&                 GetRemoteByIndex(size_t index) const;
 
+            /**
+             * \brief Retrieves all RemotePeers that are currently reserved, including the out-of-band remote.
+             *
+             * Takes time proportional to the number of remotes in use, rather than to the number of slots.
+             *
+             * \param[out]  output      Cleared, and then filled with the remotes in use.
+             */
+            void                        GetRemotesInUse(std::vector<RemotePeer*>& output) const;
+
             /**
              * \brief Retrieves the RemotePeer that represents the specified PeerID.
              * 
@@ -124,13 +238,74 @@ namespace wirefox {
             /**
              * \brief Retrieves the RemotePeer that is associated with a RemoteAddress.
              * 
-             * If possible, it is preferable to use GetRemoteByID(), for faster lookup.
+             * Runs in constant time, as addresses are indexed by SetRemoteAddress(). This is done for every received
+             * datagram, so it must not depend on the number of slots.
              * 
              * \param[in]   addr        The RemoteAddress of the remote you want to look up.
              * \returns     RemotePeer pointer if found, nullptr if not found.
              */
             RemotePeer*                 GetRemoteByAddress(const RemoteAddress& addr) const;
 
+            /**
+             * \brief Retrieves the RemotePeer that a ConnectionID was issued to.
+             *
+             * A ConnectionID holds the slot index of its remote, so this takes no more than an array access. It also
+             * keeps working if the remote's address changes.
+             *
+             * \param[in]   id          A ConnectionID as made by MakeConnectionID(), or any other number.
+             * \returns     RemotePeer pointer if \p id is issued to an active remote, nullptr otherwise.
+             */
+            RemotePeer*                 GetRemoteByConnectionID(ConnectionID id) const;
+
+            /**
+             * \brief Makes a new ConnectionID for a remote, to be sent to it during the handshake.
+             *
+             * The low 32 bits are the slot index of \p remote, plus the base set by SetShard(). The high bits are derived from a secret, so they can't be
+             * guessed by third parties, and are different every time a slot is reused. A ConnectionID is never zero.
+             */
+            ConnectionID                MakeConnectionID(const RemotePeer& remote);
+
+            /**
+             * \brief Sets the address of a remote, and indexes it so GetRemoteByAddress() can find the remote.
+             *
+             * \param[in]   remote      The remote whose address is now known.
+             * \param[in]   addr        The RemoteAddress that datagrams from this remote come from.
+             */
+            void                        SetRemoteAddress(RemotePeer& remote, const RemoteAddress& addr);
+
+            /**
+             * \brief Reserves a remote for a new connection, and adds it to the list of remotes in use.
+             *
+             * \param[in]   remote      The remote to set up. Must be a slot of this Peer.
+             * \param[in]   origin      Who initiated the connection, or ConnectionOrigin::INVALID for the out-of-band remote.
+             * \sa RemotePeer::Setup()
+             */
+            void                        ReserveRemote(RemotePeer& remote, ConnectionOrigin origin);
+
+            /**
+             * \brief Clears a remote's address from the index, and resets it so its slot can be used again.
+             * \sa RemotePeer::Reset()
+             */
+            void                        ResetRemote(RemotePeer& remote);
+
+            /**
+             * \brief Stores a session ticket for resuming a connection to an address later.
+             *
+             * \param[in]   addr        The RemoteAddress that issued the ticket.
+             * \param[in]   ticket      The ticket, as returned by EncryptionAuthenticator::GetTicket(). If empty, nothing is stored.
+             */
+            void                        SetResumeTicket(const RemoteAddress& addr, BinaryStream ticket);
+
+            /**
+             * \brief Removes and returns the session ticket stored for an address.
+             *
+             * Tickets are single-use: resuming a session hands out a new ticket.
+             *
+             * \param[in]   addr        The RemoteAddress we are about to connect to.
+             * \returns     The ticket, or an empty stream if none is stored.
+             */
+            BinaryStream                TakeResumeTicket(const RemoteAddress& addr);
+
             void                        SetNetworkSimulation(float packetLoss, unsigned additionalPing) override;
 
 
@@ -152,7 +327,8 @@ namespace wirefox {
             /**
              * \brief Informs the Peer that a new, unverified sender is requesting connection.
              * 
-             * This function will assign a RemotePeer slot for this unverified sender, and begin a handshake.
+             * This function will assign a RemotePeer slot for this unverified sender, and begin a handshake. It should only
+             * be called once the sender has echoed a valid cookie, see HandshakerThreeWay::HandleOutOfBandRequest().
              * 
              * \param[in]   addr        The RemoteAddress of the new, unverified sender.
              * \param[in]   packet      The message that they sent to us. Should be a connection request.
@@ -192,6 +368,18 @@ namespace wirefox {
              */
             void                        OnUnconnectedMessage(const RemoteAddress& addr, const uint8_t* msg, size_t msglen);
 
+            /**
+             * \brief Queues a task for the handshake thread that serves a remote.
+             *
+             * Tasks for the same remote are run one at a time, in the order they were posted. If there are no handshake
+             * threads, the task is run immediately.
+             *
+             * \param[in]   remote      The remote peer the task concerns.
+             * \param[in]   task        The function to run.
+             * \returns     False if the task was discarded, because the thread has too many tasks waiting already.
+             */
+            bool                        PostHandshakeTask(const RemotePeer& remote, WorkerPool::Task task);
+
             /**
              * \brief Requests that the Peer posts a message receipt.
              *
@@ -205,15 +393,23 @@ namespace wirefox {
             void                        SendHandshakePart(RemotePeer* remote, BinaryStream&& outstream);
             void                        SendHandshakeCompleteNotification(RemotePeer* remote, Packet&& notification);
 
+            struct AddressHasher {
+                SipHash::Key secret;
+                size_t operator()(const RemoteAddress::Bytes& key) const noexcept;
+            };
+
             static PeerID               GeneratePeerID();
+            RemotePeer*                 GetAllocatedRemote(size_t index) const;
             RemotePeer*                 GetNextAvailableConnectSlot() const;
             RemotePeer*                 GetNextAvailableIncomingSlot() const;
+            bool                        AcquireSharedSlot();
 
             PeerID m_id;
             size_t m_remotesMax;
             size_t m_remotesIncoming;
             BinaryStream m_advertisement;
             RpcController m_rpc;
+            RateLimiter m_connectLimiter;
 
 #if WIREFOX_ENABLE_NETWORK_SIM
             float                       m_simLossRate {0};
@@ -223,12 +419,30 @@ namespace wirefox {
                                         m_simqueue;
 #endif
 
+            SocketBackend                   m_socketBackend;
             std::shared_ptr<Socket>         m_masterSocket;
-            std::unique_ptr<RemotePeer[]>   m_remotes;
+            std::unique_ptr<std::atomic<RemotePeer*>[]> m_remotes;
+            mutable cfg::LockableMutex      m_inUseLock;    // the list of remotes in use must exist before m_queue starts its thread
+            RemotePeer*                     m_inUseHead;
+            RemotePeer*                     m_inUseTail;
             std::shared_ptr<PacketQueue>    m_queue;
+            std::unique_ptr<WorkerPool>     m_handshakeWorkers;
             std::map<PeerID, RemotePeer*>   m_remoteLookup;
+
+            mutable cfg::LockableMutex      m_addressLock;
+            std::unordered_map<RemoteAddress::Bytes, RemotePeer*, AddressHasher, std::equal_to<RemoteAddress::Bytes>, StlAllocator<std::pair<const RemoteAddress::Bytes, RemotePeer*>>>
+                                            m_addressLookup;
+            SipHash::Key                    m_connectionIDSecret;
+            std::atomic<uint64_t>           m_connectionIDCounter;
+            uint32_t                        m_connectionIDBase;
+            DatagramRouter                  m_router;
+            std::shared_ptr<SharedSlots>    m_sharedSlots;
             std::vector<ChannelMode>        m_channels;
 
+            mutable cfg::LockableMutex      m_ticketLock;
+            std::map<RemoteAddress::Bytes, BinaryStream>
+                                            m_tickets;
+
             std::shared_ptr<EncryptionLayer::Keypair> m_crypto_identity;
             bool m_crypto_enabled;
         };
@@ -0,0 +1,130 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#include "PCH.h"
+#include "RateLimiter.h"
+
+using namespace detail;
+
+size_t RateLimiter::KeyHasher::operator()(const Key& key) const noexcept {
+    return static_cast<size_t>(SipHash::Hash(secret, key.data(), key.size()));
+}
+
+RateLimiter::RateLimiter(size_t capacity, unsigned int perSecond, unsigned int burst)
+    : m_capacity(capacity)
+    , m_interval(Time::FromSeconds(1) / perSecond)
+    , m_tolerance(m_interval * (burst - 1))
+    , m_index(capacity, KeyHasher{SipHash::CreateKey()})
+    , m_head(NONE)
+    , m_tail(NONE) {
+    assert(capacity > 0 && capacity < NONE);
+    assert(perSecond > 0 && burst > 0);
+    m_entries.reserve(capacity);
+}
+
+RateLimiter::Verdict RateLimiter::Consume(const RemoteAddress& addr) {
+    const Key key = GetKey(addr);
+    const auto now = static_cast<uint64_t>(Time::Now());
+
+    WIREFOX_LOCK_GUARD(m_lock);
+
+    uint32_t index;
+    auto it = m_index.find(key);
+    if (it != m_index.end()) {
+        index = it->second;
+        Unlink(index);
+
+    } else if (m_entries.size() < m_capacity) {
+        index = static_cast<uint32_t>(m_entries.size());
+        m_entries.push_back(Entry{key, 0, NONE, NONE, false});
+        m_index.emplace(key, index);
+
+    } else {
+        // table is full, recycle the entry of the source we've heard from least recently
+        index = m_tail;
+        Unlink(index);
+        m_index.erase(m_entries[index].key);
+        m_entries[index] = Entry{key, 0, NONE, NONE, false};
+        m_index.emplace(key, index);
+    }
+
+    PushFront(index);
+
+    // the bucket is empty if it won't be full again until more than a burst's worth of intervals from now
+    auto& entry = m_entries[index];
+    const uint64_t full = std::max(entry.full, now);
+    if (full - now > m_tolerance) {
+        if (entry.rejected)
+            return Verdict::DROP;
+
+        entry.rejected = true;
+        return Verdict::REJECT;
+    }
+
+    entry.full = full + m_interval;
+    entry.rejected = false;
+    return Verdict::ALLOW;
+}
+
+void RateLimiter::SetLimit(unsigned int perSecond, unsigned int burst) {
+    assert(perSecond > 0 && burst > 0);
+    WIREFOX_LOCK_GUARD(m_lock);
+
+    m_interval = Time::FromSeconds(1) / perSecond;
+    m_tolerance = m_interval * (burst - 1);
+}
+
+size_t RateLimiter::GetCount() const {
+    WIREFOX_LOCK_GUARD(m_lock);
+    return m_entries.size();
+}
+
+RateLimiter::Key RateLimiter::GetKey(const RemoteAddress& addr) {
+    const auto bytes = addr.GetBytes();
+
+    // drop the port, any source can pick as many of those as it likes
+    Key key;
+    std::copy(bytes.begin(), bytes.begin() + key.size(), key.begin());
+
+    // likewise for the interface identifier of native IPv6 addresses; IPv4-mapped ones are ::ffff:a.b.c.d
+    constexpr uint8_t mapped[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+    if (!std::equal(std::begin(mapped), std::end(mapped), key.begin()))
+        std::fill(key.begin() + 8, key.end(), 0);
+
+    return key;
+}
+
+void RateLimiter::Unlink(uint32_t index) {
+    auto& entry = m_entries[index];
+
+    if (entry.prev != NONE)
+        m_entries[entry.prev].next = entry.next;
+    else
+        m_head = entry.next;
+
+    if (entry.next != NONE)
+        m_entries[entry.next].prev = entry.prev;
+    else
+        m_tail = entry.prev;
+
+    entry.prev = NONE;
+    entry.next = NONE;
+}
+
+void RateLimiter::PushFront(uint32_t index) {
+    auto& entry = m_entries[index];
+    entry.prev = NONE;
+    entry.next = m_head;
+
+    if (m_head != NONE)
+        m_entries[m_head].prev = index;
+    else
+        m_tail = index;
+
+    m_head = index;
+}
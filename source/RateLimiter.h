@@ -0,0 +1,115 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#pragma once
+#include "WirefoxConfig.h"
+#include "WirefoxTime.h"
+#include "WirefoxConfigRefs.h"
+#include "SipHash.h"
+
+namespace wirefox {
+
+    namespace detail {
+
+        /**
+         * \cond WIREFOX_INTERNAL
+         * \brief Limits how often each source IP address may do something, such as ask for a new connection.
+         *
+         * Every source gets a token bucket that holds up to a burst of tokens, and refills at a steady rate. The bucket
+         * is stored as the time at which it will be full again (the generic cell rate algorithm), so an entry is just an
+         * address and a timestamp. IPv4 sources are tracked per address, and IPv6 sources per /64 prefix, because a
+         * single IPv6 host is commonly handed an entire prefix.
+         *
+         * Memory use is bounded: once the table holds \p capacity sources, the one heard from least recently is
+         * forgotten to make room. A forgotten source starts over with a full bucket, so a table that is too small only
+         * makes the limit more lenient. The table is keyed with SipHash, so remote endpoints can't pick addresses
+         * that all land in the same hash bucket.
+         */
+        class RateLimiter {
+        public:
+            /**
+             * \brief Constructs a new, empty RateLimiter.
+             *
+             * \param[in]   capacity    The maximum number of sources to keep track of.
+             * \param[in]   perSecond   The number of tokens a bucket gains per second.
+             * \param[in]   burst       The number of tokens a bucket can hold.
+             */
+            RateLimiter(size_t capacity, unsigned int perSecond, unsigned int burst);
+            RateLimiter(const RateLimiter&) = delete;
+            RateLimiter(RateLimiter&&) = delete;
+            ~RateLimiter() = default;
+
+            RateLimiter&        operator=(const RateLimiter&) = delete;
+            RateLimiter&        operator=(RateLimiter&&) = delete;
+
+            /// Describes what to do with a request from a source.
+            enum class Verdict {
+                /// The source is within its limit.
+                ALLOW,
+                /// The source just went over its limit. Tell it, so an honest client can give up right away.
+                REJECT,
+                /// The source is still over its limit and was already told. Ignore it, to spend as little as possible on it.
+                DROP
+            };
+
+            /**
+             * \brief Takes a token from the bucket of a source address.
+             *
+             * If the bucket is empty, nothing is taken, so a source that backs off recovers at the normal rate.
+             */
+            Verdict             Consume(const RemoteAddress& addr);
+
+            /**
+             * \brief Changes the rate and burst size of every bucket, from the next request on.
+             *
+             * \param[in]   perSecond   The number of tokens a bucket gains per second.
+             * \param[in]   burst       The number of tokens a bucket can hold.
+             */
+            void                SetLimit(unsigned int perSecond, unsigned int burst);
+
+            /// Returns the number of sources currently being tracked.
+            size_t              GetCount() const;
+
+        private:
+            using Key = std::array<uint8_t, 16>;
+
+            struct KeyHasher {
+                SipHash::Key secret;
+                size_t operator()(const Key& key) const noexcept;
+            };
+
+            struct Entry {
+                Key         key;
+                uint64_t    full;       // the time at which this bucket is full again
+                uint32_t    prev;       // next more recently used entry
+                uint32_t    next;       // next less recently used entry
+                bool        rejected;   // whether the source was told it's over the limit since it was last allowed
+            };
+
+            static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+            static Key          GetKey(const RemoteAddress& addr);
+            void                Unlink(uint32_t index);
+            void                PushFront(uint32_t index);
+
+            mutable cfg::LockableMutex  m_lock;
+            const size_t                m_capacity;
+            Timespan                    m_interval;
+            Timespan                    m_tolerance;
+            std::vector<Entry>          m_entries;
+            std::unordered_map<Key, uint32_t, KeyHasher, std::equal_to<Key>, StlAllocator<std::pair<const Key, uint32_t>>>
+                                        m_index;
+            uint32_t                    m_head;
+            uint32_t                    m_tail;
+        };
+
+        /// \endcond
+
+    }
+
+}
@@ -10,6 +10,7 @@
 #include "ReassemblyBuffer.h"
 #include "PacketHeader.h"
 #include "RemotePeer.h"
+#include "BufferPool.h"
 
 using namespace detail;
 
@@ -65,12 +66,15 @@ std::unique_ptr<Packet> ReassemblyBuffer::Reassemble(PacketID container) {
     auto& split = itr->second;
     if (split.last == 0 || split.received.size() != split.last + 1) return nullptr;
 
-    // ensure we start deserializing the packet where it actually starts
+    // hand the reassembled buffer over to the packet, rather than copying what may be a rather large payload
     //std::cout << "Successfully reassembled group " << container << ", with " << split.received.size() << " segments" << std::endl;
-    split.blob.SeekToBegin();
-
-    // deserialize the packet, erase the partial buffer, and return the final reassembled packet
-    auto packet = Packet::Factory::Create(Packet::FromDatagram(m_remote->id, split.blob, split.blob.GetLength()));
+    size_t length = 0;
+    std::shared_ptr<const uint8_t> backing = BufferPool::Adopt(split.blob.ReleaseAllocatedBuffer(&length));
     m_backlog.erase(itr);
+    if (!backing) return nullptr;
+
+    // deserialize the packet and return the final reassembled packet
+    BinaryStream instream(backing.get(), length, BinaryStream::WrapMode::READONLY);
+    auto packet = Packet::Factory::Create(Packet::FromDatagram(m_remote->id, instream, length, backing));
     return packet;
 }
@@ -24,12 +24,20 @@ namespace {
 
 }
 
-RemotePeer::RemotePeer()
+RemotePeer::RemotePeer(size_t slot)
     : assembly(this)
     , id(0)
     , disconnect(0)
     , reserved(false)
-    , active(false) {}
+    , active(false)
+    , writing(false)
+    , handshakeBacklog(0)
+    , localConnectionID(0)
+    , remoteConnectionID(0)
+    , newestDatagram(0)
+    , slot(slot)
+    , prevInUse(nullptr)
+    , nextInUse(nullptr) {}
 
 bool RemotePeer::IsConnected() const {
     return active && handshake != nullptr && handshake->GetResult() == ConnectResult::OK;
@@ -39,6 +47,9 @@ void RemotePeer::HandleAcknowledgements(const std::vector<DatagramID>& acklist)
     // TODO: profile this method; multiple linear searches are being done, is this a problem?
     WIREFOX_LOCK_GUARD(lock);
 
+    // the caller checked this remote under the lock earlier, but it may have been reset since
+    if (!receipt || !congestion || !pmtu) return;
+
     for (auto ack : acklist) {
         // First, try to find the datagram that the remote is talking about
         auto d_it = std::find_if(sentbox.begin(), sentbox.end(), [ack](const auto& datagram) {
@@ -56,15 +67,23 @@ void RemotePeer::HandleAcknowledgements(const std::vector<DatagramID>& acklist)
             sentbox.erase(d_it);
         }
 
-        // inform the congestion manager of this ack also
+        // inform the congestion manager of this ack also, and path MTU discovery in case it was a probe
         congestion->NotifyReceivedAck(ack);
+        pmtu->NotifyReceivedAck(ack);
     }
 }
 
 void RemotePeer::HandleNonAcknowledgements(const std::vector<DatagramID>& naklist) {
     WIREFOX_LOCK_GUARD(lock);
 
+    if (!congestion || !pmtu) return;
+
+    bool congested = false;
     for (auto nak : naklist) {
+        // a lost probe only means it was too big for the path, which says nothing about congestion
+        if (!pmtu->NotifyReceivedNak(nak))
+            congested = true;
+
         // First, try to find the datagram that the remote is talking about
         auto d_it = std::find_if(sentbox.begin(), sentbox.end(), [nak](const auto& datagram) {
             return datagram.id == nak;
@@ -85,7 +104,8 @@ void RemotePeer::HandleNonAcknowledgements(const std::vector<DatagramID>& naklis
         }
     }
 
-    congestion->NotifyReceivedNakGroup();
+    if (congested)
+        congestion->NotifyReceivedNakGroup();
 }
 
 PacketQueue::OutgoingDatagram* RemotePeer::GetNextDatagram(Peer* master) {
@@ -93,7 +113,15 @@ PacketQueue::OutgoingDatagram* RemotePeer::GetNextDatagram(Peer* master) {
     if (congestion->GetNeedsToSendAcks()) {
         // gather the list of desired (n)acks from the congestion manager.
         assert(IsConnected());
-        return DatagramBuilder::MakeAckgram(*this);
+        return DatagramBuilder::MakeAckgram(*this, master);
+    }
+
+    // if path MTU discovery wants to try a bigger size, send a probe. without the don't-fragment bit, the operating
+    // system would fragment a probe that's too big, and it would seem to arrive just fine. wait until the remote has
+    // acked a few datagrams: it may not have finished the handshake yet, and that also gives a round trip time to go by
+    if (IsConnected() && congestion->GetRTTHistoryAvailable() && socket && socket->GetDontFragment()) {
+        if (const size_t probe = pmtu->GetProbeSize())
+            return DatagramBuilder::MakeProbe(*this, master, probe);
     }
 
     // otherwise, look for packets to send and build a datagram out of them
@@ -121,6 +149,7 @@ void RemotePeer::Setup(Peer* master, ConnectionOrigin origin) {
     reserved = true;
     congestion = std::make_unique<cfg::DefaultCongestionControl>();
     receipt = std::make_unique<ReceiptTracker>(master, *this);
+    pmtu = std::make_unique<PathMtuDiscovery>();
 
     // used by remote #0 to stop handshake from being instantiated, as out-of-band comms should not do handshakes
     if (origin != ConnectionOrigin::INVALID) {
@@ -134,14 +163,19 @@ void RemotePeer::Reset() {
     WIREFOX_LOCK_GUARD(lock);
 
     active = false;
+    writing = false;
     disconnect = 0;
     id = 0;
+    localConnectionID = 0;
+    remoteConnectionID = 0;
+    newestDatagram = 0;
     addr = RemoteAddress();
     socket = nullptr;
     handshake = nullptr;
     congestion = nullptr;
     crypto = nullptr;
     receipt = nullptr;
+    pmtu = nullptr;
     assembly = ReassemblyBuffer(this);
     stats = PeerStats();
     outbox.clear();
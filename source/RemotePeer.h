@@ -12,6 +12,7 @@
 #include "CongestionControl.h"
 #include "ChannelBuffer.h"
 #include "ReceiptTracker.h"
+#include "PathMtuDiscovery.h"
 #include "EncryptionLayer.h"
 #include "ReassemblyBuffer.h"
 #include "WirefoxConfigRefs.h"
@@ -26,7 +27,11 @@ namespace wirefox {
          * \brief Represents and contains state for a remote network peer.
          */
         struct RemotePeer {
-            RemotePeer();
+            /**
+             * \brief Constructs a new, unreserved RemotePeer.
+             * \param[in]   slot        The index of the slot this RemotePeer occupies in its Peer.
+             */
+            explicit RemotePeer(size_t slot = 0);
             ~RemotePeer() = default;
 
             /// Represents a synchronization primitive, used to sync access before most operations.
@@ -59,6 +64,9 @@ namespace wirefox {
             /// A handle to an object that services requests for delivery receipts.
             std::unique_ptr<ReceiptTracker> receipt;
 
+            /// A handle to the search for the largest datagram that can be sent to \p addr.
+            std::unique_ptr<PathMtuDiscovery> pmtu;
+
             /// A handle to an object that services requests for delivery receipts.
             ReassemblyBuffer assembly;
 
@@ -77,6 +85,29 @@ namespace wirefox {
             /// Indicates whether this slot should receive socket callbacks, and should have read/write cycles invoked.
             std::atomic_bool active;
 
+            /// Indicates whether a datagram to this remote is still being encrypted or sent. Datagrams go out one at a time.
+            std::atomic_bool writing;
+
+            /// The number of datagrams from this remote that are waiting for a handshake thread. Later datagrams are queued
+            /// behind them until they've all been handled, so everything is handled in the order it arrived.
+            std::atomic<size_t> handshakeBacklog;
+
+            /// The ConnectionID we issued to this remote, or zero if none. It prefixes the connected datagrams the remote sends us.
+            std::atomic<ConnectionID> localConnectionID;
+
+            /// The ConnectionID this remote issued to us, or zero if none. It prefixes the connected datagrams we send.
+            ConnectionID remoteConnectionID;
+
+            /// The newest DatagramID received from this remote. Only a datagram newer than all others can change \p addr.
+            DatagramID  newestDatagram;
+
+            /// The index of the slot this remote occupies in its Peer. Never changes, as slots are not moved or reallocated.
+            const size_t slot;
+
+            /// The previous and next remote in the Peer's list of slots in use, or nullptr at either end. Owned by the Peer.
+            RemotePeer* prevInUse;
+            RemotePeer* nextInUse;
+
             /**
              * \brief Reserves this RemotePeer, and randomizes the packet ID sequence.
              * 
@@ -0,0 +1,320 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#include "PCH.h"
+#include "ShardedPeer.h"
+
+using namespace wirefox::detail;
+
+std::unique_ptr<IPeer> IPeer::Factory::CreateSharded(size_t maxPeers, size_t shards) {
+    return std::make_unique<ShardedPeer>(maxPeers, shards);
+}
+
+ShardedPeer::ShardedPeer(size_t maxPeers, size_t shards)
+    : m_maxPeers(std::max(maxPeers, size_t(1)))
+    , m_slots(std::make_shared<Peer::SharedSlots>())
+    , m_nextReceive(0) {
+    assert(shards > 0);
+    shards = std::max(shards, size_t(1));
+
+    // idle slots are cheap, so every shard can hold all remotes in case the operating system sends them all its way
+    m_shards.reserve(shards);
+    for (size_t i = 0; i < shards; i++)
+        m_shards.push_back(std::make_unique<Peer>(m_maxPeers));
+
+    // to the outside world, all shards are the same peer
+    for (size_t i = 1; i < shards; i++)
+        m_shards[i]->SetMyPeerID(m_shards[0]->GetMyPeerID());
+}
+
+ShardedPeer::~ShardedPeer() {
+    // stop all network threads first, so no shard routes a datagram to another one that's already destroyed
+    for (auto& shard : m_shards)
+        shard->Stop(0);
+}
+
+ConnectAttemptResult ShardedPeer::Connect(const std::string& host, uint16_t port, const uint8_t* public_key) {
+    // replies to outgoing connections could arrive at any of the shards, so only incoming ones are supported
+    (void)host;
+    (void)port;
+    (void)public_key;
+    return ConnectAttemptResult::INVALID_STATE;
+}
+
+bool ShardedPeer::Bind(SocketProtocol family, uint16_t port) {
+    const size_t count = m_shards.size();
+    if (count > 1) {
+        for (size_t i = 0; i < count; i++) {
+            // forward datagrams from remotes that moved to a new address to the shard that issued their ConnectionID
+            auto router = [this, i](ConnectionID id, const RemoteAddress& sender, const BufferPool::Handle& buffer, size_t transferred) {
+                const size_t target = GetShardIndex(id);
+                return target != i && target < m_shards.size() && m_shards[target]->AcceptRoutedDatagram(id, sender, buffer, transferred);
+            };
+
+            if (!m_shards[i]->SetShard(static_cast<uint32_t>(i * m_maxPeers), router, m_slots))
+                return false;
+
+            // a routed datagram is dispatched on the thread of the shard that received it. handling datagrams inline
+            // would then let two threads work on the same remote, while a worker thread keeps them in order
+            if (m_shards[i]->GetWorkerThreads() == 0)
+                m_shards[i]->SetWorkerThreads(1);
+        }
+    }
+
+    // the first shard picks the port if none was specified, all others follow it
+    if (!m_shards[0]->Bind(family, port)) return false;
+    const uint16_t shared = port != 0 ? port : m_shards[0]->GetLocalPort();
+
+    for (size_t i = 1; i < count; i++) {
+        if (shared == 0 || !m_shards[i]->Bind(family, shared)) {
+            for (size_t j = 0; j < i; j++)
+                m_shards[j]->Stop(0);
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ShardedPeer::Disconnect(PeerID who, Timespan linger) {
+    if (auto* shard = GetShardByID(who))
+        shard->Disconnect(who, linger);
+}
+
+void ShardedPeer::DisconnectImmediate(PeerID who) {
+    if (auto* shard = GetShardByID(who))
+        shard->DisconnectImmediate(who);
+}
+
+void ShardedPeer::Stop(Timespan linger) {
+    if (linger == 0) {
+        for (auto& shard : m_shards)
+            shard->Stop(0);
+
+        return;
+    }
+
+    // every shard blocks for the linger duration, so let them linger at the same time
+    std::vector<std::thread> threads;
+    threads.reserve(m_shards.size());
+    for (auto& shard : m_shards) {
+        auto* peer = shard.get();
+        threads.emplace_back([peer, linger] { peer->Stop(linger); });
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
+
+PacketID ShardedPeer::Send(const Packet& packet, PeerID recipient, PacketOptions options, PacketPriority priority, const Channel& channel) {
+    auto* shard = GetShardByID(recipient);
+    if (!shard) return 0;
+
+    return shard->Send(packet, recipient, options, priority, channel);
+}
+
+size_t ShardedPeer::Send(const Packet& packet, const std::vector<PeerID>& recipients, PacketOptions options, PacketPriority priority, const Channel& channel) {
+    // split the recipients by the shard that serves them, skipping the ones we don't know
+    std::vector<std::vector<PeerID>> groups(m_shards.size());
+    for (auto recipient : recipients) {
+        for (size_t i = 0; i < m_shards.size(); i++) {
+            if (m_shards[i]->GetRemoteByID(recipient)) {
+                groups[i].push_back(recipient);
+                break;
+            }
+        }
+    }
+
+    size_t sent = 0;
+    for (size_t i = 0; i < m_shards.size(); i++)
+        if (!groups[i].empty())
+            sent += m_shards[i]->Send(packet, groups[i], options, priority, channel);
+
+    return sent;
+}
+
+void ShardedPeer::SendLoopback(const Packet& packet) {
+    m_shards[0]->SendLoopback(packet);
+}
+
+std::unique_ptr<Packet> ShardedPeer::Receive() {
+    // take turns, so a busy shard can't starve the others. several threads may receive at once; the turn only needs to
+    // advance atomically, it doesn't order anything else
+    const size_t count = m_shards.size();
+    const size_t first = m_nextReceive.fetch_add(1, std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) {
+        if (auto packet = m_shards[(first + i) % count]->Receive())
+            return packet;
+    }
+
+    return nullptr;
+}
+
+void ShardedPeer::SetOfflineAdvertisement(const BinaryStream& data) {
+    for (auto& shard : m_shards)
+        shard->SetOfflineAdvertisement(data);
+}
+
+void ShardedPeer::DisableOfflineAdvertisement() {
+    for (auto& shard : m_shards)
+        shard->DisableOfflineAdvertisement();
+}
+
+void ShardedPeer::Ping(const std::string& hostname, uint16_t port) const {
+    m_shards[0]->Ping(hostname, port);
+}
+
+void ShardedPeer::PingLocalNetwork(uint16_t port) const {
+    m_shards[0]->PingLocalNetwork(port);
+}
+
+void ShardedPeer::SetEncryptionEnabled(bool enabled) {
+    // the first shard generates the identity, and all others present the same one
+    m_shards[0]->SetEncryptionEnabled(enabled);
+    for (size_t i = 1; i < m_shards.size(); i++) {
+        m_shards[i]->SetEncryptionEnabled(enabled);
+        m_shards[i]->SetEncryptionIdentity(m_shards[0]->GetEncryptionIdentity());
+    }
+}
+
+void ShardedPeer::SetEncryptionIdentity(const uint8_t* key_secret, const uint8_t* key_public) {
+    for (auto& shard : m_shards)
+        shard->SetEncryptionIdentity(key_secret, key_public);
+}
+
+void ShardedPeer::GenerateIdentity(uint8_t* key_secret, uint8_t* key_public) const {
+    m_shards[0]->GenerateIdentity(key_secret, key_public);
+}
+
+size_t ShardedPeer::GetEncryptionKeyLength() const {
+    return m_shards[0]->GetEncryptionKeyLength();
+}
+
+bool ShardedPeer::GetEncryptionEnabled() const {
+    return m_shards[0]->GetEncryptionEnabled();
+}
+
+size_t ShardedPeer::GetWorkerThreads() const {
+    return m_shards[0]->GetWorkerThreads();
+}
+
+void ShardedPeer::SetWorkerThreads(size_t count) {
+    for (auto& shard : m_shards)
+        shard->SetWorkerThreads(count);
+}
+
+void ShardedPeer::SetSocketBufferSizes(size_t receive, size_t send) {
+    for (auto& shard : m_shards)
+        shard->SetSocketBufferSizes(receive, send);
+}
+
+void ShardedPeer::GetSocketBufferSizes(size_t& receive, size_t& send) const {
+    m_shards[0]->GetSocketBufferSizes(receive, send);
+}
+
+SocketBackend ShardedPeer::GetSocketBackend() const {
+    return m_shards[0]->GetSocketBackend();
+}
+
+Channel ShardedPeer::MakeChannel(ChannelMode mode) {
+    // all shards hand out channel indices in the same order, so they stay in sync
+    Channel channel = m_shards[0]->MakeChannel(mode);
+    for (size_t i = 1; i < m_shards.size(); i++)
+        m_shards[i]->MakeChannel(mode);
+
+    return channel;
+}
+
+ChannelMode ShardedPeer::GetChannelModeByIndex(ChannelIndex index) const {
+    return m_shards[0]->GetChannelModeByIndex(index);
+}
+
+void ShardedPeer::GetAllConnectedPeers(std::vector<PeerID>& output) const {
+    for (auto& shard : m_shards)
+        shard->GetAllConnectedPeers(output);
+}
+
+bool ShardedPeer::GetPingAvailable(PeerID who) const {
+    auto* shard = GetShardByID(who);
+    return shard && shard->GetPingAvailable(who);
+}
+
+unsigned ShardedPeer::GetPing(PeerID who) const {
+    auto* shard = GetShardByID(who);
+    return shard ? shard->GetPing(who) : 0;
+}
+
+const PeerStats* ShardedPeer::GetStats(PeerID who) const {
+    auto* shard = GetShardByID(who);
+    return shard ? shard->GetStats(who) : nullptr;
+}
+
+size_t ShardedPeer::GetMaximumPeers() const {
+    return m_maxPeers;
+}
+
+size_t ShardedPeer::GetMaximumIncomingPeers() const {
+    return m_shards[0]->GetMaximumIncomingPeers();
+}
+
+void ShardedPeer::SetMaximumIncomingPeers(size_t incoming) {
+    // any shard may take all of them, the shared counter keeps the total in check
+    for (auto& shard : m_shards)
+        shard->SetMaximumIncomingPeers(incoming);
+
+    m_slots->limit = m_shards[0]->GetMaximumIncomingPeers();
+}
+
+PeerID ShardedPeer::GetMyPeerID() const {
+    return m_shards[0]->GetMyPeerID();
+}
+
+void ShardedPeer::SetNetworkSimulation(float packetLoss, unsigned additionalPing) {
+    for (auto& shard : m_shards)
+        shard->SetNetworkSimulation(packetLoss, additionalPing);
+}
+
+void ShardedPeer::RpcRegisterSlot(const std::string& identifier, RpcCallbackAsync_t handler) {
+    for (auto& shard : m_shards)
+        shard->RpcRegisterSlot(identifier, handler);
+}
+
+void ShardedPeer::RpcUnregisterSlot(const std::string& identifier) {
+    for (auto& shard : m_shards)
+        shard->RpcUnregisterSlot(identifier);
+}
+
+void ShardedPeer::RpcSignal(const std::string& identifier, PeerID recipient, const BinaryStream& params) {
+    if (auto* shard = GetShardByID(recipient))
+        shard->RpcSignal(identifier, recipient, params);
+}
+
+size_t ShardedPeer::GetShardCount() const {
+    return m_shards.size();
+}
+
+Peer& ShardedPeer::GetShard(size_t index) const {
+    assert(index < m_shards.size());
+    return *m_shards[index];
+}
+
+Peer* ShardedPeer::GetShardByID(PeerID id) const {
+    for (auto& shard : m_shards)
+        if (shard->GetRemoteByID(id))
+            return shard.get();
+
+    return nullptr;
+}
+
+size_t ShardedPeer::GetShardIndex(ConnectionID id) const {
+    // shard i issues the slot indices (i * m_maxPeers, (i + 1) * m_maxPeers]
+    const auto index = static_cast<size_t>(id & std::numeric_limits<uint32_t>::max());
+    if (index == 0) return m_shards.size();
+
+    return (index - 1) / m_maxPeers;
+}
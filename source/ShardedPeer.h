@@ -0,0 +1,110 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#pragma once
+#include "PeerAbstract.h"
+#include "Peer.h"
+
+namespace wirefox {
+
+    namespace detail {
+
+        /**
+         * \cond WIREFOX_INTERNAL
+         * \brief Represents an IPeer that spreads its connections across several Peers that share one port.
+         *
+         * Every shard is a complete Peer, with its own socket, PacketQueue, threads and slots. The operating system picks
+         * a shard for every remote endpoint by address, and the shard that receives a connection request serves that
+         * connection from then on. That spreads remotes unevenly, so every shard has room for all of them, and a counter
+         * they share enforces the overall limit. Calls that concern a single remote are forwarded to the shard that serves it, and
+         * settings are applied to all shards, so together they behave as one peer with one PeerID and identity.
+         *
+         * If a remote's address changes, its datagrams may arrive at another shard. Those still carry the ConnectionID
+         * the remote was issued, and every shard issues IDs from its own range, so they are handed to the right shard.
+         */
+        class ShardedPeer final : public IPeer {
+        public:
+            /**
+             * \brief Constructs a new ShardedPeer.
+             * \param[in]   maxPeers    The maximum number of remotes, across all shards.
+             * \param[in]   shards      The number of shards. At least one.
+             */
+            ShardedPeer(size_t maxPeers, size_t shards);
+            ShardedPeer(const ShardedPeer&) = delete;
+            ShardedPeer(ShardedPeer&&) = delete;
+            ~ShardedPeer();
+
+            ShardedPeer&                operator=(const ShardedPeer&) = delete;
+            ShardedPeer&                operator=(ShardedPeer&&) = delete;
+
+            ConnectAttemptResult        Connect(const std::string& host, uint16_t port, const uint8_t* public_key) override;
+            bool                        Bind(SocketProtocol family, uint16_t port) override;
+            void                        Disconnect(PeerID who, Timespan linger) override;
+            void                        DisconnectImmediate(PeerID who) override;
+            void                        Stop(Timespan linger) override;
+
+            PacketID                    Send(const Packet& packet, PeerID recipient, PacketOptions options, PacketPriority priority, const Channel& channel) override;
+            size_t                      Send(const Packet& packet, const std::vector<PeerID>& recipients, PacketOptions options, PacketPriority priority, const Channel& channel) override;
+            void                        SendLoopback(const Packet& packet) override;
+            std::unique_ptr<Packet>     Receive() override;
+
+            void                        SetOfflineAdvertisement(const BinaryStream& data) override;
+            void                        DisableOfflineAdvertisement() override;
+            void                        Ping(const std::string& hostname, uint16_t port) const override;
+            void                        PingLocalNetwork(uint16_t port) const override;
+
+            void                        SetEncryptionEnabled(bool enabled) override;
+            void                        SetEncryptionIdentity(const uint8_t* key_secret, const uint8_t* key_public) override;
+            void                        GenerateIdentity(uint8_t* key_secret, uint8_t* key_public) const override;
+            size_t                      GetEncryptionKeyLength() const override;
+            bool                        GetEncryptionEnabled() const override;
+            size_t                      GetWorkerThreads() const override;
+            void                        SetWorkerThreads(size_t count) override;
+            void                        SetSocketBufferSizes(size_t receive, size_t send) override;
+            void                        GetSocketBufferSizes(size_t& receive, size_t& send) const override;
+            SocketBackend               GetSocketBackend() const override;
+
+            Channel                     MakeChannel(ChannelMode mode) override;
+            ChannelMode                 GetChannelModeByIndex(ChannelIndex index) const override;
+            void                        GetAllConnectedPeers(std::vector<PeerID>& output) const override;
+            bool                        GetPingAvailable(PeerID who) const override;
+            unsigned                    GetPing(PeerID who) const override;
+            const PeerStats*            GetStats(PeerID who) const override;
+
+            size_t                      GetMaximumPeers() const override;
+            size_t                      GetMaximumIncomingPeers() const override;
+            void                        SetMaximumIncomingPeers(size_t incoming) override;
+            PeerID                      GetMyPeerID() const override;
+
+            void                        SetNetworkSimulation(float packetLoss, unsigned additionalPing) override;
+
+            void                        RpcRegisterSlot(const std::string& identifier, RpcCallbackAsync_t handler) override;
+            void                        RpcUnregisterSlot(const std::string& identifier) override;
+            void                        RpcSignal(const std::string& identifier, PeerID recipient, const BinaryStream& params) override;
+
+            /// Returns the number of shards.
+            size_t                      GetShardCount() const;
+
+            /// Returns one of the shards. \p index must be less than GetShardCount().
+            Peer&                       GetShard(size_t index) const;
+
+        private:
+            Peer*                       GetShardByID(PeerID id) const;
+            size_t                      GetShardIndex(ConnectionID id) const;
+
+            size_t                          m_maxPeers;
+            std::vector<std::unique_ptr<Peer>> m_shards;
+            std::shared_ptr<Peer::SharedSlots> m_slots;
+            std::atomic<size_t>             m_nextReceive;
+        };
+
+        /// \endcond
+
+    }
+
+}
@@ -0,0 +1,299 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#include "PCH.h"
+#include "SimulatedNetwork.h"
+
+using namespace wirefox::detail;
+
+namespace {
+
+    constexpr uint16_t EPHEMERAL_PORT_FIRST = 49152;
+
+    uint64_t GetLinkSeed(uint64_t seed, uint16_t from, uint16_t to) {
+        // give every link a generator of its own, so traffic on one link doesn't change what happens on another
+        uint64_t x = seed + ((static_cast<uint64_t>(from) << 16 | to) + 1) * 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    // the std distributions are free to differ between standard libraries, so these work on the raw output instead,
+    // which mt19937_64 defines exactly. that way, a seed reproduces the same run on every platform
+
+    /// Returns a number in [0, 1), made from the top 53 bits of the next output.
+    double DrawFraction(std::mt19937_64& rng) {
+        return static_cast<double>(rng() >> 11) / static_cast<double>(uint64_t(1) << 53);
+    }
+
+    /// Returns a number in [0, max]. The modulo favours low numbers by at most max / 2^64, which is negligible here.
+    uint64_t DrawInteger(std::mt19937_64& rng, uint64_t max) {
+        return rng() % (max + 1);
+    }
+
+}
+
+SimulatedNetwork::SimulatedNetwork(uint64_t seed, bool manualClock)
+    : m_manualClock(manualClock)
+    , m_seed(seed)
+    , m_manualNow(Time::FromSeconds(1))
+    , m_nextPort(EPHEMERAL_PORT_FIRST)
+    , m_eventOrder(0)
+    , m_closing(false) {
+    if (!m_manualClock)
+        m_thread = std::thread(std::bind(&SimulatedNetwork::ThreadWorker, this));
+}
+
+SimulatedNetwork::~SimulatedNetwork() {
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_closing = true;
+    }
+
+    m_wake.notify_all();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void SimulatedNetwork::SetDefaultConditions(const LinkConditions& conditions) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_defaultConditions = conditions;
+
+    // links that were set up before this, but never given conditions of their own, follow the new defaults
+    for (auto& entry : m_links)
+        if (!entry.second.custom)
+            entry.second.conditions = conditions;
+}
+
+void SimulatedNetwork::SetLinkConditions(uint16_t from, uint16_t to, const LinkConditions& conditions) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto& link = GetLink(from, to);
+    link.conditions = conditions;
+    link.custom = true;
+}
+
+SimulatedNetwork::LinkStats SimulatedNetwork::GetLinkStats(uint16_t from, uint16_t to) const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = m_links.find(std::make_pair(from, to));
+    return it == m_links.end() ? LinkStats() : it->second.stats;
+}
+
+SimulatedNetwork::LinkStats SimulatedNetwork::GetReceiveStats(uint16_t to) const {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    LinkStats total;
+    for (const auto& entry : m_links) {
+        if (entry.first.second != to) continue;
+
+        const auto& stats = entry.second.stats;
+        total.sent += stats.sent;
+        total.delivered += stats.delivered;
+        total.lost += stats.lost;
+        total.queueDrops += stats.queueDrops;
+        total.reordered += stats.reordered;
+        total.unreachable += stats.unreachable;
+    }
+
+    return total;
+}
+
+uint16_t SimulatedNetwork::Bind(uint16_t port, Receiver receiver) {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    // hand out ephemeral ports in order, rather than at random, so runs are reproducible
+    if (port == 0) {
+        for (size_t attempt = 0; attempt <= UINT16_MAX - EPHEMERAL_PORT_FIRST && port == 0; attempt++) {
+            if (!m_endpoints.count(m_nextPort))
+                port = m_nextPort;
+
+            m_nextPort = m_nextPort == UINT16_MAX ? EPHEMERAL_PORT_FIRST : m_nextPort + 1;
+        }
+    }
+
+    if (port == 0 || m_endpoints.count(port)) return 0;
+
+    m_endpoints.emplace(port, std::move(receiver));
+    return port;
+}
+
+void SimulatedNetwork::Unbind(uint16_t port) {
+    // wait for a delivery that may be in progress
+    std::lock_guard<std::recursive_mutex> deliver(m_deliverLock);
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_endpoints.erase(port);
+}
+
+void SimulatedNetwork::Send(uint16_t from, uint16_t to, const uint8_t* data, size_t length) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    const Timestamp now = GetNow();
+    auto& link = GetLink(from, to);
+    const auto& conditions = link.conditions;
+    link.stats.sent++;
+
+    // Gilbert-Elliott loss model: datagrams are lost at one rate normally, and at another during a burst
+    const bool lost = Roll(link, link.burst ? conditions.burstLoss : conditions.loss);
+    if (link.burst ? Roll(link, conditions.burstEnd) : Roll(link, conditions.burstStart))
+        link.burst = !link.burst;
+
+    if (lost) {
+        link.stats.lost++;
+        return;
+    }
+
+    // the bottleneck sends one datagram after another. what's still waiting its turn takes up room in the queue
+    Timestamp departure = now;
+    if (conditions.bandwidth > 0) {
+        const Timestamp start = std::max(now, link.busyUntil);
+        const double queued = static_cast<double>(Time::Between(now, start)) * conditions.bandwidth / 1e9;
+        if (conditions.queueLimit > 0 && queued + length > conditions.queueLimit) {
+            link.stats.queueDrops++;
+            return;
+        }
+
+        link.busyUntil = start + static_cast<Timespan>(length * 1e9 / conditions.bandwidth);
+        departure = link.busyUntil;
+    }
+
+    Timestamp arrival = departure + conditions.delay;
+    if (conditions.jitter > 0)
+        arrival = arrival + DrawInteger(link.rng, conditions.jitter);
+
+    // a datagram that is held back doesn't hold back the ones behind it, which is what lets them overtake it
+    if (Roll(link, conditions.reorder)) {
+        arrival = arrival + conditions.reorderDelay;
+        link.stats.reordered++;
+    } else {
+        arrival = std::max(arrival, link.lastArrival);
+        link.lastArrival = arrival;
+    }
+
+    Event event;
+    event.to = to;
+    event.from = from;
+    event.data.assign(data, data + length);
+    Schedule(arrival, std::move(event));
+}
+
+void SimulatedNetwork::Post(std::function<void()> call) {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    Event event;
+    event.call = std::move(call);
+    Schedule(GetNow(), std::move(event));
+}
+
+Timestamp SimulatedNetwork::Now() const {
+    std::lock_guard<std::mutex> lock(m_lock);
+    return GetNow();
+}
+
+void SimulatedNetwork::Advance(Timespan duration) {
+    assert(m_manualClock);
+
+    Timestamp target;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        target = m_manualNow + duration;
+    }
+
+    // the clock moves from one event to the next, so anything sent during a delivery is timed from that moment
+    DeliverDue(target);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_manualNow = std::max(m_manualNow, target);
+}
+
+Timestamp SimulatedNetwork::GetNow() const {
+    return m_manualClock ? m_manualNow : Time::Now();
+}
+
+SimulatedNetwork::Link& SimulatedNetwork::GetLink(uint16_t from, uint16_t to) {
+    const auto key = std::make_pair(from, to);
+    auto it = m_links.find(key);
+    if (it != m_links.end()) return it->second;
+
+    Link link;
+    link.conditions = m_defaultConditions;
+    link.rng.seed(GetLinkSeed(m_seed, from, to));
+    return m_links.emplace(key, std::move(link)).first->second;
+}
+
+bool SimulatedNetwork::Roll(Link& link, double chance) {
+    // don't draw a number if the outcome is certain, so links without loss or reordering are cheap
+    if (chance <= 0) return false;
+    if (chance >= 1) return true;
+
+    return DrawFraction(link.rng) < chance;
+}
+
+void SimulatedNetwork::Schedule(Timestamp due, Event event) {
+    const EventKey key(static_cast<uint64_t>(due), m_eventOrder++);
+    auto it = m_events.emplace(key, std::move(event)).first;
+
+    // the thread may be waiting for a later event
+    if (it == m_events.begin())
+        m_wake.notify_one();
+}
+
+void SimulatedNetwork::DeliverDue(Timestamp now) {
+    std::lock_guard<std::recursive_mutex> deliver(m_deliverLock);
+
+    while (true) {
+        Event event;
+        Receiver receiver;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            if (m_events.empty() || m_events.begin()->first.first > static_cast<uint64_t>(now)) break;
+
+            auto it = m_events.begin();
+            if (m_manualClock)
+                m_manualNow = std::max(m_manualNow, Timestamp(it->first.first));
+
+            event = std::move(it->second);
+            m_events.erase(it);
+
+            if (!event.call) {
+                auto& stats = GetLink(event.from, event.to).stats;
+                auto endpoint = m_endpoints.find(event.to);
+                if (endpoint != m_endpoints.end()) {
+                    receiver = endpoint->second;
+                    stats.delivered++;
+                } else {
+                    stats.unreachable++;
+                }
+            }
+        }
+
+        // call out without holding the lock, so the callee may send right away
+        if (event.call)
+            event.call();
+        else if (receiver)
+            receiver(event.from, event.data.data(), event.data.size());
+    }
+}
+
+void SimulatedNetwork::ThreadWorker() {
+    std::unique_lock<std::mutex> lock(m_lock);
+
+    while (!m_closing) {
+        if (m_events.empty()) {
+            m_wake.wait(lock);
+            continue;
+        }
+
+        const Timestamp due(m_events.begin()->first.first);
+        if (!Time::Elapsed(due)) {
+            m_wake.wait_for(lock, std::chrono::nanoseconds(Time::Between(Time::Now(), due)));
+            continue;
+        }
+
+        lock.unlock();
+        DeliverDue(Time::Now());
+        lock.lock();
+    }
+}
@@ -0,0 +1,156 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#pragma once
+#include "WirefoxConfig.h"
+#include "WirefoxTime.h"
+
+namespace wirefox {
+
+    namespace detail {
+
+        /**
+         * \cond WIREFOX_INTERNAL
+         * \brief Connects sockets within the same process through links with configurable, reproducible conditions.
+         *
+         * Every pair of endpoints is joined by a link in each direction. A link sends datagrams through a bottleneck with
+         * a limited bandwidth and queue, delays them, and may drop or reorder them. Each link makes its random choices with a
+         * generator of its own, derived from the seed, in the order datagrams are sent over it. So the same traffic on the
+         * same seed always has the same outcome, no matter how it interleaves with traffic on other links.
+         *
+         * By default, the network follows the system clock, and a thread of its own delivers datagrams when they are due.
+         * With a manual clock, time only moves on when Advance() is called, which delivers everything that became due on
+         * the calling thread. Either way, deliveries never overlap, so each endpoint receives its datagrams one at a time.
+         */
+        class SimulatedNetwork final {
+        public:
+            /// Describes the conditions on a link.
+            struct LinkConditions {
+                uint64_t    bandwidth = 0;      ///< Bytes per second the link can carry, or zero for no limit.
+                size_t      queueLimit = 0;     ///< Bytes that may wait for the bandwidth before more are dropped, or zero for no limit.
+                Timespan    delay = 0;          ///< Time it takes a datagram to cross the link.
+                Timespan    jitter = 0;         ///< Largest random extra delay. Jitter alone never reorders datagrams.
+                double      loss = 0;           ///< Chance that a datagram is lost.
+                double      burstStart = 0;     ///< Chance that a loss burst starts after a datagram. See also Gilbert-Elliott model.
+                double      burstEnd = 1;       ///< Chance that a loss burst ends after a datagram.
+                double      burstLoss = 1;      ///< Chance that a datagram is lost during a loss burst.
+                double      reorder = 0;        ///< Chance that a datagram is held back, so the ones behind it overtake it.
+                Timespan    reorderDelay = 0;   ///< How long a datagram that is held back is delayed, on top of the rest.
+            };
+
+            /// Counts what happened to the datagrams sent over a link.
+            struct LinkStats {
+                size_t      sent = 0;           ///< Datagrams handed to the link.
+                size_t      delivered = 0;      ///< Datagrams delivered to a bound endpoint.
+                size_t      lost = 0;           ///< Datagrams dropped by the loss model.
+                size_t      queueDrops = 0;     ///< Datagrams dropped because the queue was full.
+                size_t      reordered = 0;      ///< Datagrams that were held back.
+                size_t      unreachable = 0;    ///< Datagrams that arrived at a port nobody was bound to.
+            };
+
+            /// Represents a callback that receives a datagram on behalf of an endpoint.
+            using Receiver = std::function<void(uint16_t sender, const uint8_t* data, size_t length)>;
+
+            /**
+             * \brief Constructs a new network.
+             *
+             * \param[in]   seed        Seeds the random choices of all links.
+             * \param[in]   manualClock If true, time stands still until Advance() is called.
+             */
+            SimulatedNetwork(uint64_t seed, bool manualClock = false);
+            ~SimulatedNetwork();
+
+            SimulatedNetwork(const SimulatedNetwork&) = delete;
+            SimulatedNetwork& operator=(const SimulatedNetwork&) = delete;
+
+            /// Sets the conditions for all links that have none of their own.
+            void            SetDefaultConditions(const LinkConditions& conditions);
+
+            /// Sets the conditions for the link from one port to another. Datagrams already on their way are not affected.
+            void            SetLinkConditions(uint16_t from, uint16_t to, const LinkConditions& conditions);
+
+            /// Returns the stats of the link from one port to another.
+            LinkStats       GetLinkStats(uint16_t from, uint16_t to) const;
+
+            /// Returns the stats of all links into a port, added together.
+            LinkStats       GetReceiveStats(uint16_t to) const;
+
+            /**
+             * \brief Binds an endpoint to a port.
+             *
+             * \param[in]   port        The port to bind to, or zero to pick the next free one.
+             * \param[in]   receiver    Fired for every datagram delivered to the port.
+             * \returns     The port that was bound, or zero if it was taken.
+             */
+            uint16_t        Bind(uint16_t port, Receiver receiver);
+
+            /// Unbinds a port. No datagrams are delivered to it once this returns, unless called during a delivery.
+            void            Unbind(uint16_t port);
+
+            /// Sends a datagram from one port to another. The data is copied, so it need not remain valid.
+            void            Send(uint16_t from, uint16_t to, const uint8_t* data, size_t length);
+
+            /// Runs a function as soon as possible, on the thread that delivers datagrams.
+            void            Post(std::function<void()> call);
+
+            /// Returns the time according to the network's clock.
+            Timestamp       Now() const;
+
+            /// Moves the manual clock forward, and delivers everything that became due. Not allowed with the system clock.
+            void            Advance(Timespan duration);
+
+        private:
+            struct Link {
+                LinkConditions  conditions;
+                LinkStats       stats;
+                std::mt19937_64 rng;
+                Timestamp       busyUntil;      // when the bottleneck finishes sending what is queued
+                Timestamp       lastArrival;    // keeps jitter from reordering datagrams
+                bool            burst = false;
+                bool            custom = false; // conditions were set for this link specifically
+            };
+
+            struct Event {
+                uint16_t                to = 0;
+                uint16_t                from = 0;
+                std::vector<uint8_t>    data;
+                std::function<void()>   call;
+            };
+
+            using EventKey = std::pair<uint64_t, uint64_t>;     // due time, then order of scheduling
+
+            Timestamp       GetNow() const;
+            Link&           GetLink(uint16_t from, uint16_t to);
+            bool            Roll(Link& link, double chance);
+            void            Schedule(Timestamp due, Event event);
+            void            DeliverDue(Timestamp now);
+            void            ThreadWorker();
+
+            const bool      m_manualClock;
+            const uint64_t  m_seed;
+
+            mutable std::mutex          m_lock;         // guards everything below, but isn't held during deliveries
+            Timestamp                   m_manualNow;
+            std::recursive_mutex        m_deliverLock;  // held during deliveries, so they never overlap
+            std::condition_variable     m_wake;
+            LinkConditions              m_defaultConditions;
+            std::map<std::pair<uint16_t, uint16_t>, Link> m_links;
+            std::map<uint16_t, Receiver> m_endpoints;
+            uint16_t                    m_nextPort;
+            std::map<EventKey, Event>   m_events;
+            uint64_t                    m_eventOrder;
+
+            std::thread                 m_thread;
+            bool                        m_closing;
+        };
+
+        /// \endcond
+
+    }
+
+}
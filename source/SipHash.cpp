@@ -0,0 +1,78 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#include "PCH.h"
+#include "SipHash.h"
+
+using namespace detail;
+
+namespace {
+
+    uint64_t RotateLeft(uint64_t x, int b) {
+        return (x << b) | (x >> (64 - b));
+    }
+
+    uint64_t ReadLittleEndian(const uint8_t* p, size_t length) {
+        uint64_t ret = 0;
+        for (size_t i = 0; i < length; i++)
+            ret |= static_cast<uint64_t>(p[i]) << (8 * i);
+        return ret;
+    }
+
+    void SipRound(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3) {
+        v0 += v1; v1 = RotateLeft(v1, 13); v1 ^= v0; v0 = RotateLeft(v0, 32);
+        v2 += v3; v3 = RotateLeft(v3, 16); v3 ^= v2;
+        v0 += v3; v3 = RotateLeft(v3, 21); v3 ^= v0;
+        v2 += v1; v1 = RotateLeft(v1, 17); v1 ^= v2; v2 = RotateLeft(v2, 32);
+    }
+
+}
+
+SipHash::Key SipHash::CreateKey() {
+    std::random_device rng;
+    Key key;
+    for (auto& byte : key)
+        byte = static_cast<uint8_t>(rng());
+
+    return key;
+}
+
+uint64_t SipHash::Hash(const Key& key, const uint8_t* data, size_t length) noexcept {
+    const uint64_t k0 = ReadLittleEndian(key.data(), 8);
+    const uint64_t k1 = ReadLittleEndian(key.data() + 8, 8);
+
+    uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+
+    // compress all whole 8-byte words
+    const size_t tail = length % 8;
+    const uint8_t* end = data + (length - tail);
+    for (const uint8_t* p = data; p != end; p += 8) {
+        const uint64_t m = ReadLittleEndian(p, 8);
+        v3 ^= m;
+        SipRound(v0, v1, v2, v3);
+        SipRound(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+
+    // the last word holds the remaining bytes, and the low byte of the input length in its top byte
+    const uint64_t m = ReadLittleEndian(end, tail) | (static_cast<uint64_t>(length) << 56);
+    v3 ^= m;
+    SipRound(v0, v1, v2, v3);
+    SipRound(v0, v1, v2, v3);
+    v0 ^= m;
+
+    // finalization
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; i++)
+        SipRound(v0, v1, v2, v3);
+
+    return v0 ^ v1 ^ v2 ^ v3;
+}
@@ -0,0 +1,49 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#pragma once
+#include "WirefoxConfig.h"
+
+namespace wirefox {
+
+    namespace detail {
+
+        /**
+         * \cond WIREFOX_INTERNAL
+         * \brief Implements SipHash-2-4, a fast keyed hash function for short inputs.
+         *
+         * Without knowing the key, it is infeasible to predict or forge the hash of any input. This makes it suitable
+         * as a message authentication code for data that only the owner of the key needs to verify, such as handshake
+         * cookies, and for hash tables whose keys are chosen by remote endpoints.
+         */
+        class SipHash {
+        public:
+            /// The length of a key, in bytes.
+            static constexpr size_t KEY_LENGTH = 16;
+
+            /// Represents a secret key.
+            using Key = std::array<uint8_t, KEY_LENGTH>;
+
+            /// Returns a new key made of random bytes.
+            static Key          CreateKey();
+
+            /**
+             * \brief Computes the 64-bit SipHash-2-4 of a buffer.
+             *
+             * \param[in]   key     The secret key.
+             * \param[in]   data    Pointer to the input bytes.
+             * \param[in]   length  The number of bytes in \p data.
+             */
+            static uint64_t     Hash(const Key& key, const uint8_t* data, size_t length) noexcept;
+        };
+
+        /// \endcond
+
+    }
+
+}
@@ -9,6 +9,7 @@
 #pragma once
 #include "Enumerations.h"
 #include "WirefoxConfig.h"
+#include "BufferPool.h"
 
 namespace wirefox {
 
@@ -33,12 +34,18 @@ namespace wirefox {
                 /// The socket is bound to a local port.
                 OPEN
             };
-            /// Represents a callback fired by Socket::BeginRead().
-            typedef std::function<void(bool error, RemoteAddress sender, uint8_t* buffer, size_t transferred)> SocketReadCallback_t;
+            /// Represents a callback fired by Socket::BeginRead(). The buffer may be retained by the callee after it returns.
+            typedef std::function<void(bool error, RemoteAddress sender, BufferPool::Handle buffer, size_t transferred)> SocketReadCallback_t;
 
             /// Represents a callback fired by Socket::BeginWrite().
             typedef std::function<void(bool error, size_t transferred)> SocketWriteCallback_t;
 
+            /// Represents one datagram passed to Socket::BeginWriteBatch().
+            struct WriteBuffer {
+                const uint8_t*  data;       ///< A pointer to the datagram.
+                size_t          length;     ///< The length of the datagram, in bytes.
+            };
+
             /// Represents a callback fired by Socket::Connect(). Wraps the new client socket to use for this connection.
             typedef std::function<void(bool error, RemoteAddress addr, std::shared_ptr<Socket> socket, std::string errormsg)> SocketConnectCallback_t;
 
@@ -100,6 +107,57 @@ namespace wirefox {
              */
             virtual bool Bind(SocketProtocol family, unsigned short port) = 0;
 
+            /**
+             * \brief Allows several sockets to be bound to the same port, so incoming datagrams are spread across them.
+             *
+             * Must be called before Bind(). The operating system picks a socket for each remote endpoint, and keeps
+             * delivering that endpoint's datagrams to the same socket for as long as the set of sockets doesn't change.
+             *
+             * \returns False if the platform does not support sharing a port this way.
+             */
+            virtual bool SetReusePort(bool enabled) { return !enabled; }
+
+            /**
+             * \brief Returns the local port this socket is bound to, or zero if it isn't bound or the port is unknown.
+             */
+            virtual uint16_t GetLocalPort() const { return 0; }
+
+            /**
+             * \brief Returns the total number of datagrams the operating system dropped because the receive buffer was full.
+             *
+             * Zero if the platform does not report this.
+             */
+            virtual size_t GetReceiveDrops() { return 0; }
+
+            /**
+             * \brief Returns the total number of datagrams that had to wait because the send buffer was full.
+             *
+             * Zero if the platform does not report this.
+             */
+            virtual size_t GetSendBlocked() { return 0; }
+
+            /**
+             * \brief Sets the sizes of the operating system's receive and send buffers, in bytes.
+             *
+             * Zero leaves a buffer at its current size. If the socket is not bound, the sizes are applied by Bind().
+             *
+             * \returns False if the platform rejected one of the sizes, or doesn't support setting them.
+             */
+            virtual bool SetBufferSizes(size_t receive, size_t send) { return receive == 0 && send == 0; }
+
+            /**
+             * \brief Returns the sizes of the operating system's receive and send buffers in effect, or zero if unknown.
+             */
+            virtual void GetBufferSizes(size_t& receive, size_t& send) const { receive = send = 0; }
+
+            /**
+             * \brief Returns a value indicating whether the socket sends its datagrams with the don't-fragment bit set.
+             *
+             * If so, a datagram that is too big for the network path is dropped rather than fragmented, and one that is
+             * too big for the network interface is reported as written without being sent. Path MTU discovery relies on this.
+             */
+            virtual bool GetDontFragment() const { return false; }
+
             /**
              * \brief Resolve a hostname into a RemoteAddress.
              * 
@@ -118,6 +176,8 @@ namespace wirefox {
              * 
              * \note        You must ensure that the data buffer you pass in will remain valid up until the callback is fired.
              * 
+             * A datagram that is too big to be sent is not treated as an error; it is lost, like it would be on the way.
+             *
              * \param[in]   addr        The remote endpoint to send data to.
              * \param[in]   data        A pointer to the data to write.
              * \param[in]   datalen     The length of the buffer represented by \p data.
@@ -125,6 +185,50 @@ namespace wirefox {
              */
             virtual void BeginWrite(const RemoteAddress& addr, const uint8_t* data, size_t datalen, SocketWriteCallback_t callback) = 0;
 
+            /**
+             * \brief Send several datagrams to the same remote endpoint.
+             *
+             * Like BeginWrite(), but the callback is fired only once, when all datagrams were written or one of them
+             * failed, with the total number of bytes written. Sockets that can pass several datagrams to the operating
+             * system at once override this; by default, every datagram is written with a BeginWrite() of its own.
+             *
+             * \note        The datagrams must remain valid until the callback is fired. The vector that describes them
+             *              need only remain valid for the duration of this call.
+             *
+             * \param[in]   addr        The remote endpoint to send the datagrams to.
+             * \param[in]   datagrams   The datagrams to write, in order. Must not be empty.
+             * \param[in]   callback    A callback to fire on completion of the writes (whether they succeeded or not).
+             */
+            virtual void BeginWriteBatch(const RemoteAddress& addr, const std::vector<WriteBuffer>& datagrams, SocketWriteCallback_t callback) {
+                assert(!datagrams.empty());
+                if (datagrams.size() == 1) {
+                    BeginWrite(addr, datagrams[0].data, datagrams[0].length, std::move(callback));
+                    return;
+                }
+
+                struct Progress {
+                    std::atomic<size_t>     remaining;
+                    std::atomic<size_t>     transferred;
+                    std::atomic_bool        error;
+                    SocketWriteCallback_t   callback;
+                };
+                auto progress = std::make_shared<Progress>();
+                progress->remaining = datagrams.size();
+                progress->transferred = 0;
+                progress->error = false;
+                progress->callback = std::move(callback);
+
+                for (const auto& datagram : datagrams) {
+                    BeginWrite(addr, datagram.data, datagram.length, [progress](bool error, size_t transferred) {
+                        progress->transferred.fetch_add(transferred);
+                        if (error) progress->error = true;
+
+                        if (progress->remaining.fetch_sub(1) == 1)
+                            progress->callback(progress->error, progress->transferred);
+                    });
+                }
+            }
+
             /**
              * \brief Read data from a remote endpoint.
              * 
@@ -132,6 +236,10 @@ namespace wirefox {
              * Note that this function will automatically keep restarting (i.e. you should not call BeginRead again), using the same
              * callback you passed the first time, until the socket is closed.
              * 
+             * Each completed read is delivered in its own reference-counted buffer, so the callback may keep references into
+             * it (e.g. as Packet payloads) without blocking subsequent reads. Several reads may be posted at once, so datagrams
+             * keep being received while earlier ones are processed, but the callback is never invoked concurrently.
+             * 
              * \param[in]   callback    A callback to fire on completion of the read (whether it succeeded or not).
              */
             virtual void BeginRead(SocketReadCallback_t callback) = 0;
@@ -144,9 +252,9 @@ namespace wirefox {
             virtual bool IsReadPending() const = 0;
 
             /**
-             * \brief Indicates whether an async send operation is currently pending.
+             * \brief Indicates whether any async send operations are currently pending.
              *
-             * If this function returns true, you should not attempt to begin a new send op (Socket::BeginWrite()).
+             * Several send ops may be pending at once, and BeginWrite() may be called from multiple threads concurrently.
              */
             virtual bool IsWritePending() const = 0;
 
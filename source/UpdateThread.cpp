@@ -0,0 +1,95 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#include "PCH.h"
+#include "UpdateThread.h"
+#include "PacketQueue.h"
+
+using namespace detail;
+
+UpdateThread::UpdateThread(Timespan tick)
+    : m_tick(tick)
+    , m_abort(false) {
+    assert(tick > 0);
+    m_thread = std::thread(std::bind(&UpdateThread::ThreadWorker, this));
+}
+
+UpdateThread::~UpdateThread() {
+    assert(m_queues.empty());
+
+    m_abort.store(true);
+    m_notify.Signal();
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void UpdateThread::Add(PacketQueue* queue) {
+    assert(queue);
+    WIREFOX_LOCK_GUARD(m_lock);
+    m_queues.push_back(queue);
+}
+
+void UpdateThread::Remove(PacketQueue* queue) {
+    WIREFOX_LOCK_GUARD(m_lock);
+    m_queues.erase(std::remove(m_queues.begin(), m_queues.end(), queue), m_queues.end());
+
+    WIREFOX_LOCK_GUARD(m_pendingLock);
+    m_pending.erase(std::remove(m_pending.begin(), m_pending.end(), queue), m_pending.end());
+}
+
+void UpdateThread::Notify(PacketQueue* queue) {
+    {
+        // a queue that is busy tends to ask several times in a row, ThreadWorker() weeds out the rest
+        WIREFOX_LOCK_GUARD(m_pendingLock);
+        if (!m_pending.empty() && m_pending.back() == queue) return;
+        m_pending.push_back(queue);
+    }
+
+    m_notify.Signal();
+}
+
+size_t UpdateThread::GetCount() const {
+    WIREFOX_LOCK_GUARD(m_lock);
+    return m_queues.size();
+}
+
+void UpdateThread::ThreadWorker() {
+    std::vector<PacketQueue*> pending;
+    Timestamp nextTick = Time::Now();
+
+    while (!m_abort) {
+        {
+            WIREFOX_LOCK_GUARD(m_lock);
+
+            {
+                WIREFOX_LOCK_GUARD(m_pendingLock);
+                pending.swap(m_pending);
+            }
+
+            if (Time::Elapsed(nextTick)) {
+                // a tick updates everyone, which includes the queues that asked for it
+                nextTick = Time::Now() + m_tick;
+                for (auto* queue : m_queues)
+                    queue->Update();
+
+            } else {
+                std::sort(pending.begin(), pending.end());
+                pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+                for (auto* queue : pending)
+                    queue->Update();
+            }
+
+            pending.clear();
+        }
+
+        // sleep until the next tick, unless a queue asks for an update before then
+        const Timestamp now = Time::Now();
+        if (nextTick > now)
+            m_notify.WaitFor(Time::Between(now, nextTick));
+    }
+}
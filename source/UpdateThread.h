@@ -0,0 +1,79 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#pragma once
+#include "WirefoxConfig.h"
+#include "AwaitableEvent.h"
+
+namespace wirefox {
+
+    namespace detail {
+
+        class PacketQueue;
+
+        /**
+         * \cond WIREFOX_INTERNAL
+         * \brief Represents a single thread that runs the periodic updates of many PacketQueues.
+         *
+         * Normally every PacketQueue starts a thread of its own. That is fine for a server, but a process that hosts
+         * thousands of client Peers, such as a load generator, would spend most of its time switching between their
+         * threads. Queues that share an UpdateThread are updated one after another instead, every tick, and a queue that
+         * asks to be woken up early is updated on its own.
+         *
+         * If updating all queues takes longer than a tick, the next tick simply starts late.
+         */
+        class UpdateThread {
+        public:
+            /**
+             * \brief Constructs a new UpdateThread, and starts the thread.
+             *
+             * \param[in]   tick    How often every queue is updated.
+             */
+            UpdateThread(Timespan tick = Time::FromMilliseconds(cfg::THREAD_SLEEP_PACKETQUEUE_TICK));
+            /// Copy constructor.
+            UpdateThread(const UpdateThread&) = delete;
+            /// Move constructor.
+            UpdateThread(UpdateThread&&) = delete;
+            /// Destructor. Stops the thread. All queues must have been removed already.
+            ~UpdateThread();
+
+            /// Copy assignment operator.
+            UpdateThread& operator=(const UpdateThread&) = delete;
+            /// Move assignment operator.
+            UpdateThread& operator=(UpdateThread&&) = delete;
+
+            /// Starts updating a queue.
+            void            Add(PacketQueue* queue);
+
+            /// Stops updating a queue. Blocks while the thread is updating queues, so the queue is safe to destroy after.
+            void            Remove(PacketQueue* queue);
+
+            /// Requests that a queue is updated as soon as possible, rather than at the next tick.
+            void            Notify(PacketQueue* queue);
+
+            /// Returns the number of queues being updated.
+            size_t          GetCount() const;
+
+        private:
+            void            ThreadWorker();
+
+            const Timespan          m_tick;
+            mutable cfg::LockableMutex m_lock;      // held while queues are updated
+            std::vector<PacketQueue*> m_queues;
+            cfg::LockableMutex      m_pendingLock;
+            std::vector<PacketQueue*> m_pending;    // queues that asked to be updated early
+            AwaitableEvent          m_notify;
+            std::atomic_bool        m_abort;
+            std::thread             m_thread;
+        };
+
+        /// \endcond
+
+    }
+
+}
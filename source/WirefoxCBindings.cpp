@@ -48,6 +48,24 @@ HWirefoxPeer* wirefox_peer_create(size_t maxPeers) {
     return PeerToHandle(m_handlesPeer.back().get());
 }
 
+HWirefoxPeer* wirefox_peer_create_with_backend(size_t maxPeers, ESocketBackend backend) {
+    auto uptr = IPeer::Factory::Create(maxPeers, static_cast<SocketBackend>(backend));
+
+    WIREFOX_LOCK_GUARD(m_handleTableMutex);
+    m_handlesPeer.push_back(std::move(uptr));
+
+    return PeerToHandle(m_handlesPeer.back().get());
+}
+
+HWirefoxPeer* wirefox_peer_create_sharded(size_t maxPeers, size_t shards) {
+    auto uptr = IPeer::Factory::CreateSharded(maxPeers, shards);
+
+    WIREFOX_LOCK_GUARD(m_handleTableMutex);
+    m_handlesPeer.push_back(std::move(uptr));
+
+    return PeerToHandle(m_handlesPeer.back().get());
+}
+
 void wirefox_peer_destroy(HWirefoxPeer* handle) {
     if (handle == nullptr) return;
 
@@ -96,6 +114,13 @@ TPacketID wirefox_peer_send(HWirefoxPeer* handle, HPacket* packet, TPeerID recip
     return peer->Send(*HandleToPacket(packet), static_cast<PeerID>(recipient), static_cast<PacketOptions>(options), static_cast<PacketPriority>(priority), channel);
 }
 
+size_t wirefox_peer_send_many(HWirefoxPeer* handle, HPacket* packet, const TPeerID* recipients, size_t count, EPacketOptions options, EPacketPriority priority, TChannelIndex channelIndex) {
+    auto peer = HandleToPeer(handle);
+    auto channel = Channel(channelIndex, peer->GetChannelModeByIndex(channelIndex));
+    std::vector<PeerID> typedRecipients(recipients, recipients + count);
+    return peer->Send(*HandleToPacket(packet), typedRecipients, static_cast<PacketOptions>(options), static_cast<PacketPriority>(priority), channel);
+}
+
 HPacket* wirefox_peer_receive(HWirefoxPeer* handle) {
     auto uptr = HandleToPeer(handle)->Receive();
     if (uptr == nullptr) return nullptr; // don't add nullptrs to the handle table
@@ -187,6 +212,29 @@ void wirefox_peer_generate_crypto_identity(HWirefoxPeer* handle, uint8_t* key_se
     HandleToPeer(handle)->GenerateIdentity(key_secret, key_public);
 }
 
+size_t wirefox_peer_get_worker_threads(HWirefoxPeer* handle) {
+    return HandleToPeer(handle)->GetWorkerThreads();
+}
+
+void wirefox_peer_set_worker_threads(HWirefoxPeer* handle, size_t count) {
+    HandleToPeer(handle)->SetWorkerThreads(count);
+}
+
+void wirefox_peer_set_socket_buffer_sizes(HWirefoxPeer* handle, size_t receive, size_t send) {
+    HandleToPeer(handle)->SetSocketBufferSizes(receive, send);
+}
+
+void wirefox_peer_get_socket_buffer_sizes(HWirefoxPeer* handle, size_t* receive, size_t* send) {
+    size_t r, s;
+    HandleToPeer(handle)->GetSocketBufferSizes(r, s);
+    if (receive) *receive = r;
+    if (send) *send = s;
+}
+
+ESocketBackend wirefox_peer_get_socket_backend(HWirefoxPeer* handle) {
+    return static_cast<ESocketBackend>(HandleToPeer(handle)->GetSocketBackend());
+}
+
 HPacket* wirefox_packet_create(uint8_t cmd, const uint8_t* data, size_t len) {
     auto uptr = Packet::Factory::Create(static_cast<PacketCommand>(cmd), data, len);
 
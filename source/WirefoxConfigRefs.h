@@ -30,6 +30,9 @@
 #include "RemoteAddressASIO.h"
 #endif
 
+// DefaultAllocator
+#include "AllocatorSlab.h"
+
 // DefaultHandshaker
 #include "HandshakerThreeWay.h"
 
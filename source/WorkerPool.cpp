@@ -0,0 +1,84 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#include "PCH.h"
+#include "WorkerPool.h"
+
+using namespace detail;
+
+struct WorkerPool::Worker {
+    cfg::LockableMutex      lock;
+    std::condition_variable notify;
+    std::deque<Task>        tasks;
+    bool                    abort = false;
+    std::thread             thread;
+
+    void Run() {
+        std::unique_lock<decltype(lock)> guard(lock);
+
+        while (true) {
+            notify.wait(guard, [this] { return abort || !tasks.empty(); });
+            if (abort) break;
+
+            Task task = std::move(tasks.front());
+            tasks.pop_front();
+
+            // don't hold up Post() while the task runs
+            guard.unlock();
+            task();
+            guard.lock();
+        }
+    }
+};
+
+WorkerPool::WorkerPool(size_t threads, size_t capacity)
+    : m_capacity(capacity) {
+    m_workers.reserve(threads);
+    for (size_t i = 0; i < threads; i++) {
+        auto worker = std::make_unique<Worker>();
+        worker->thread = std::thread(&Worker::Run, worker.get());
+        m_workers.push_back(std::move(worker));
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    Stop();
+}
+
+bool WorkerPool::Enqueue(size_t key, Task task) {
+    auto& worker = *m_workers[key % m_workers.size()];
+    {
+        WIREFOX_LOCK_GUARD(worker.lock);
+        if (worker.abort) return false;
+        if (m_capacity > 0 && worker.tasks.size() >= m_capacity) return false;
+
+        worker.tasks.push_back(std::move(task));
+    }
+    worker.notify.notify_one();
+    return true;
+}
+
+void WorkerPool::Stop() {
+    for (auto& worker : m_workers) {
+        {
+            WIREFOX_LOCK_GUARD(worker->lock);
+            worker->abort = true;
+            worker->tasks.clear();
+        }
+        worker->notify.notify_one();
+    }
+
+    for (auto& worker : m_workers) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+}
+
+size_t WorkerPool::GetThreadCount() const noexcept {
+    return m_workers.size();
+}
@@ -0,0 +1,91 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#pragma once
+#include "WirefoxConfig.h"
+
+namespace wirefox {
+
+    namespace detail {
+
+        /**
+         * \cond WIREFOX_INTERNAL
+         * \brief Represents a fixed set of threads that run posted tasks.
+         *
+         * Every task is posted with a key, and all tasks with the same key are run by the same thread, in the order they
+         * were posted. PacketQueue uses the index of a RemotePeer as key, so that datagrams for different remotes can be
+         * encrypted and decrypted in parallel, while the datagrams of any one remote stay in order.
+         *
+         * A pool without threads runs every task immediately, on the thread that posts it. A pool may also limit how many
+         * tasks can wait for each thread, in which case Post() discards tasks for a thread that is too far behind.
+         */
+        class WorkerPool {
+        public:
+            /// Represents a unit of work.
+            using Task = std::function<void()>;
+
+            /**
+             * \brief Constructs a new WorkerPool, and starts its threads.
+             *
+             * \param[in]   threads     The number of threads to start. If zero, tasks are run inline by Post().
+             * \param[in]   capacity    The maximum number of tasks that may wait for each thread, or zero for no limit.
+             */
+            WorkerPool(size_t threads, size_t capacity = 0);
+            /// Copy constructor.
+            WorkerPool(const WorkerPool&) = delete;
+            /// Move constructor.
+            WorkerPool(WorkerPool&&) = delete;
+            /// Destructor. Stops all threads.
+            ~WorkerPool();
+
+            /// Copy assignment operator.
+            WorkerPool& operator=(const WorkerPool&) = delete;
+            /// Move assignment operator.
+            WorkerPool& operator=(WorkerPool&&) = delete;
+
+            /**
+             * \brief Queues a task to be run by one of the threads.
+             *
+             * \param[in]   key     Tasks with the same key are run one at a time, in the order they were posted.
+             * \param[in]   task    The function to run.
+             * \returns     False if the task was discarded, because its thread's queue is full or the pool was stopped.
+             */
+            template<typename Fn>
+            bool            Post(size_t key, Fn&& task) {
+                // run inline without wrapping the task in a Task first, which might allocate
+                if (m_workers.empty()) {
+                    task();
+                    return true;
+                }
+
+                return Enqueue(key, Task(std::forward<Fn>(task)));
+            }
+
+            /**
+             * \brief Stops all threads, after they finish their current task. Any tasks still queued are discarded,
+             * as are tasks posted afterwards.
+             */
+            void            Stop();
+
+            /// Returns the number of threads in this pool.
+            size_t          GetThreadCount() const noexcept;
+
+        private:
+            struct Worker;
+
+            bool            Enqueue(size_t key, Task task);
+
+            std::vector<std::unique_ptr<Worker>> m_workers;
+            size_t          m_capacity;
+        };
+
+        /// \endcond
+
+    }
+
+}
@@ -24,3 +24,16 @@ std::string RemoteAddressASIO::ToString() const {
     txt << endpoint_udp.address().to_string();
     return txt.str();
 }
+
+RemoteAddressASIO::Bytes RemoteAddressASIO::GetBytes() const {
+    const auto address = endpoint_udp.address();
+    const auto ip = address.is_v4()
+        ? asio::ip::make_address_v6(asio::ip::v4_mapped, address.to_v4()).to_bytes()
+        : address.to_v6().to_bytes();
+
+    Bytes ret;
+    std::copy(ip.begin(), ip.end(), ret.begin());
+    ret[16] = static_cast<uint8_t>(endpoint_udp.port() >> 8);
+    ret[17] = static_cast<uint8_t>(endpoint_udp.port() & 0xFF);
+    return ret;
+}
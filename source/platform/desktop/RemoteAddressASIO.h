@@ -18,6 +18,12 @@ namespace wirefox {
          */
         struct RemoteAddressASIO {
             friend class SocketUDP;
+            friend class SocketIoUring;
+            friend class SocketSharedMemory;
+            friend class SocketSimulated;
+
+            /// Represents the IP address and port of an endpoint in binary form. IPv4 addresses are mapped into IPv6.
+            using Bytes = std::array<uint8_t, 18>;
 
             RemoteAddressASIO() = default;
             ~RemoteAddressASIO() = default;
@@ -31,6 +37,9 @@ namespace wirefox {
             /// Returns a string version of this address' hostname or IP address.
             std::string ToString() const;
 
+            /// Returns the IP address and port of this address in binary form, e.g. for hashing or authenticating it.
+            Bytes GetBytes() const;
+
         private:
             asio::ip::udp::endpoint endpoint_udp;
         };
@@ -0,0 +1,778 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#include "PCH.h"
+#include "SocketIoUring.h"
+
+#ifdef WIREFOX_ENABLE_IO_URING
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// older C libraries don't know about io_uring yet, but the numbers are the same on all common architectures
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register 427
+#endif
+
+using namespace wirefox::detail;
+
+namespace {
+
+    int RingSetup(unsigned entries, io_uring_params* params) {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int RingEnter(int ring, unsigned submit, unsigned wait, unsigned flags) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, ring, submit, wait, flags, nullptr, 0));
+    }
+
+    int RingRegister(int ring, unsigned opcode, const void* arg, unsigned args) {
+        return static_cast<int>(syscall(__NR_io_uring_register, ring, opcode, arg, args));
+    }
+
+    bool SetBufferSize(int fd, int option, int forceOption, size_t size) {
+        if (size == 0) return true;
+
+        // a privileged process may exceed the system-wide limit, which is rather low by default
+        const int value = static_cast<int>(std::min<size_t>(size, std::numeric_limits<int>::max()));
+        return ::setsockopt(fd, SOL_SOCKET, forceOption, &value, sizeof(value)) == 0
+            || ::setsockopt(fd, SOL_SOCKET, option, &value, sizeof(value)) == 0;
+    }
+
+    size_t GetBufferSize(int fd, int option) {
+        int value = 0;
+        socklen_t length = sizeof(value);
+        if (fd < 0 || ::getsockopt(fd, SOL_SOCKET, option, &value, &length) != 0) return 0;
+
+        // the kernel doubles the requested size to make room for its bookkeeping, asio undoes that as well
+        return static_cast<size_t>(value) / 2;
+    }
+
+    bool SetDontFragment(int fd, SocketProtocol family) {
+        // like SocketUDP, set the don't-fragment bit regardless of what the kernel has learned about the path MTU
+        const int probe = IP_PMTUDISC_PROBE;
+        if (family == SocketProtocol::IPv4)
+            return ::setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &probe, sizeof(probe)) == 0;
+
+        const int probe6 = IPV6_PMTUDISC_PROBE;
+        ::setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &probe, sizeof(probe));
+        return ::setsockopt(fd, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &probe6, sizeof(probe6)) == 0;
+    }
+
+}
+
+struct SocketIoUring::Operation {
+    enum class Type {
+        READ,
+        WRITE,
+        CALL,
+        CLOSE
+    };
+
+    Type                    type;
+    msghdr                  msg;
+    iovec                   iov;
+    sockaddr_storage        name;
+    alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(uint32_t))];
+    BufferPool::Handle      buffer;
+    SocketWriteCallback_t   onWrite;
+    int                     flags;
+    std::function<void()>   onCall;
+};
+
+SocketIoUring::SocketIoUring()
+    : m_state(SocketState::CLOSED)
+    , m_family()
+    , m_reusePort(false)
+    , m_fixedFile(false)
+    , m_dontFragment(false)
+    , m_receiveBufferSize(cfg::SOCKET_RECEIVE_BUFFER)
+    , m_sendBufferSize(cfg::SOCKET_SEND_BUFFER)
+    , m_socket(-1)
+    , m_ring(-1)
+    , m_sqRingPtr(nullptr)
+    , m_sqRingSize(0)
+    , m_cqRingPtr(nullptr)
+    , m_cqRingSize(0)
+    , m_sqes(nullptr)
+    , m_sqesSize(0)
+    , m_sqHead(nullptr)
+    , m_sqTail(nullptr)
+    , m_sqFlags(nullptr)
+    , m_sqMask(0)
+    , m_sqEntries(0)
+    , m_cqHead(nullptr)
+    , m_cqTail(nullptr)
+    , m_cqMask(0)
+    , m_cqes(nullptr)
+    , m_closing(true)
+    , m_inflight(0)
+    , m_reading(0)
+    , m_sending(0)
+    , m_receiveDrops(0)
+    , m_sendBlocked(0)
+    , m_readpool(cfg::PACKETQUEUE_IN_LEN) {}
+
+std::shared_ptr<Socket> SocketIoUring::Create() {
+    // see SocketUDP::Create() on why this is a factory method
+    std::shared_ptr<SocketIoUring> socket(new SocketIoUring);
+    if (!socket->SetupRing())
+        return nullptr;
+
+    return socket;
+}
+
+SocketIoUring::~SocketIoUring() {
+    Disconnect();
+    Unbind();
+    ReleaseRing();
+}
+
+ConnectAttemptResult SocketIoUring::Connect(const std::string& host, const unsigned short port, SocketConnectCallback_t callback) {
+    if (GetState() != SocketState::OPEN || !IsOpenAndReady())
+        return ConnectAttemptResult::INVALID_STATE;
+
+    // make sure input parameters are not nonsensical
+    if (host.empty() || port == 0)
+        return ConnectAttemptResult::INVALID_PARAMETER;
+
+    // attempt to resolve the given hostname into an endpoint
+    RemoteAddress addr;
+    if (!Resolve(host, port, addr))
+        return ConnectAttemptResult::INVALID_HOSTNAME;
+
+    // the callback is expected to run on the network thread, so bounce it off the ring
+    assert(callback);
+    auto* op = AcquireOperation();
+    op->type = Operation::Type::CALL;
+    op->onCall = std::bind(callback, false, addr, shared_from_this(), std::string());
+    {
+        WIREFOX_LOCK_GUARD(m_sqLock);
+        auto* sqe = m_closing ? nullptr : GetSubmissionEntry();
+        if (!sqe) {
+            ReleaseOperation(op);
+            return ConnectAttemptResult::INVALID_STATE;
+        }
+
+        sqe->opcode = IORING_OP_NOP;
+        PushSubmissionEntry(op);
+    }
+    SubmitNotify();
+
+    return ConnectAttemptResult::OK;
+}
+
+void SocketIoUring::Disconnect() {
+    // Not implemented for UDP. Connections are managed on a RemotePeer level instead.
+}
+
+void SocketIoUring::Unbind() {
+    // wakes up any reads that are still waiting for data
+    const int fd = m_socket.load();
+    if (fd >= 0) {
+        ::shutdown(fd, SHUT_RDWR);
+        m_state = SocketState::CLOSED;
+    }
+
+    // have the ring thread cancel the posted reads, and wait until all operations completed
+    if (m_ringThread.joinable()) {
+        auto* op = AcquireOperation();
+        op->type = Operation::Type::CLOSE;
+        {
+            WIREFOX_LOCK_GUARD(m_sqLock);
+            m_closing = true;
+
+            auto* sqe = GetSubmissionEntry();
+            if (sqe) {
+                sqe->opcode = IORING_OP_NOP;
+                PushSubmissionEntry(op);
+            } else {
+                ReleaseOperation(op);
+            }
+        }
+        SubmitNotify();
+
+        m_ringThread.join();
+    }
+
+    if (fd >= 0) {
+        if (m_fixedFile)
+            RingRegister(m_ring, IORING_UNREGISTER_FILES, nullptr, 0);
+
+        ::close(fd);
+        m_socket = -1;
+        m_fixedFile = false;
+    }
+}
+
+bool SocketIoUring::Bind(const SocketProtocol family, const unsigned short port) {
+    // socket should be inactive and unbound
+    if (GetState() != SocketState::CLOSED || m_ring < 0) return false;
+
+    m_family = family;
+    const asio::ip::udp::endpoint endpoint(family == SocketProtocol::IPv4 ? asio::ip::udp::v4() : asio::ip::udp::v6(), port);
+
+    const int fd = ::socket(endpoint.data()->sa_family, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (fd < 0) return false;
+
+    const int enable = 1;
+    bool ok = true;
+#ifdef SO_REUSEPORT
+    if (m_reusePort)
+        ok = ok && ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == 0;
+#endif
+    ok = ok && ::bind(fd, endpoint.data(), static_cast<socklen_t>(endpoint.size())) == 0;
+
+    // enable UDP multicasting
+    ok = ok && ::setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable)) == 0;
+
+    // a buffer the system refuses to resize is not worth failing over, the default still works
+    if (ok)
+        ApplyBufferSizes(fd);
+
+    // path MTU discovery needs this, but can do without it
+    m_dontFragment = ok && SetDontFragment(fd, family);
+
+    // have reads report how many datagrams the kernel dropped so far. not essential, so ignore failure
+#ifdef SO_RXQ_OVFL
+    if (ok)
+        ::setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+#endif
+
+    if (!ok) {
+        ::close(fd);
+        return false;
+    }
+
+    // registering the socket with the ring saves the kernel from looking it up again for every operation
+    m_socket = fd;
+    m_fixedFile = RingRegister(m_ring, IORING_REGISTER_FILES, &fd, 1) == 0;
+
+    // start the thread that completes operations
+    m_reads.clear();
+    m_readCallback = nullptr;
+    m_closing = false;
+    m_ringThread = std::thread(std::bind(&SocketIoUring::ThreadWorker, this));
+    m_state = SocketState::OPEN;
+
+    return true;
+}
+
+bool SocketIoUring::SetReusePort(bool enabled) {
+#ifdef SO_REUSEPORT
+    if (GetState() != SocketState::CLOSED) return false;
+
+    m_reusePort = enabled;
+    return true;
+#else
+    return !enabled;
+#endif
+}
+
+uint16_t SocketIoUring::GetLocalPort() const {
+    const int fd = m_socket.load();
+    if (fd < 0) return 0;
+
+    asio::ip::udp::endpoint endpoint;
+    socklen_t length = static_cast<socklen_t>(endpoint.capacity());
+    if (::getsockname(fd, endpoint.data(), &length) != 0) return 0;
+
+    endpoint.resize(length);
+    return endpoint.port();
+}
+
+size_t SocketIoUring::GetReceiveDrops() {
+    return m_receiveDrops.load();
+}
+
+size_t SocketIoUring::GetSendBlocked() {
+    return m_sendBlocked.load();
+}
+
+bool SocketIoUring::SetBufferSizes(size_t receive, size_t send) {
+    if (receive > 0) m_receiveBufferSize = receive;
+    if (send > 0) m_sendBufferSize = send;
+
+    // if not bound yet, Bind() takes care of it
+    const int fd = m_socket.load();
+    return fd < 0 || ApplyBufferSizes(fd);
+}
+
+void SocketIoUring::GetBufferSizes(size_t& receive, size_t& send) const {
+    const int fd = m_socket.load();
+    receive = GetBufferSize(fd, SO_RCVBUF);
+    send = GetBufferSize(fd, SO_SNDBUF);
+}
+
+bool SocketIoUring::GetDontFragment() const {
+    return m_dontFragment;
+}
+
+bool SocketIoUring::Resolve(const std::string& hostname, uint16_t port, RemoteAddress& output) {
+    const auto protocol = m_family == SocketProtocol::IPv4 ? asio::ip::udp::v4() : asio::ip::udp::v6();
+
+    // perform hostname resolution
+    asio::io_context context;
+    asio::error_code ec;
+    asio::ip::udp::resolver resolver(context);
+    asio::ip::udp::resolver::iterator it = resolver.resolve(protocol, hostname, std::to_string(port), ec);
+
+    // socket error, or no results?
+    if (ec || it == asio::ip::udp::resolver::iterator())
+        return false;
+
+    output.endpoint_udp = *it; // assume first entry is ok, for simplicity
+    return true;
+}
+
+void SocketIoUring::BeginWrite(const RemoteAddress& addr, const uint8_t* data, size_t datalen, SocketWriteCallback_t callback) {
+    auto* op = AcquireOperation();
+    op->type = Operation::Type::WRITE;
+    op->onWrite = std::move(callback);
+
+    const auto& endpoint = addr.endpoint_udp;
+    std::memcpy(&op->name, endpoint.data(), endpoint.size());
+    op->iov.iov_base = const_cast<uint8_t*>(data);
+    op->iov.iov_len = datalen;
+    op->msg = msghdr();
+    op->msg.msg_name = &op->name;
+    op->msg.msg_namelen = static_cast<socklen_t>(endpoint.size());
+    op->msg.msg_iov = &op->iov;
+    op->msg.msg_iovlen = 1;
+
+    // fail instead of waiting for room in the send buffer, so the ring thread can count it before trying again
+    op->flags = MSG_DONTWAIT;
+
+    {
+        // writes for different remotes may be dispatched from several worker threads at once
+        WIREFOX_LOCK_GUARD(m_sqLock);
+
+        // like an asio socket that was closed, a closed ring never completes the write
+        m_sending.fetch_add(1);
+        if (m_closing || !PostWrite(op)) {
+            m_sending.fetch_sub(1);
+            ReleaseOperation(op);
+            return;
+        }
+    }
+
+    SubmitNotify();
+}
+
+void SocketIoUring::BeginRead(SocketReadCallback_t callback) {
+    // the ring thread posts all reads, so their completions are delivered there without interrupting other threads
+    auto* op = AcquireOperation();
+    op->type = Operation::Type::CALL;
+    op->onCall = [this, callback] {
+        m_readCallback = callback;
+    };
+
+    {
+        WIREFOX_LOCK_GUARD(m_sqLock);
+        auto* sqe = m_closing ? nullptr : GetSubmissionEntry();
+        if (!sqe) {
+            ReleaseOperation(op);
+            return;
+        }
+
+        // count the read as pending right away, so it isn't started twice
+        m_reading.fetch_add(1);
+        sqe->opcode = IORING_OP_NOP;
+        PushSubmissionEntry(op);
+    }
+
+    SubmitNotify();
+}
+
+bool SocketIoUring::IsReadPending() const {
+    return m_reading.load() > 0;
+}
+
+bool SocketIoUring::IsWritePending() const {
+    return m_sending.load() > 0;
+}
+
+Socket::SocketState SocketIoUring::GetState() const {
+    return m_state;
+}
+
+SocketProtocol SocketIoUring::GetProtocol() const {
+    return m_family;
+}
+
+bool SocketIoUring::IsOpenAndReady() const {
+    return m_socket.load() >= 0 && !m_closing;
+}
+
+bool SocketIoUring::SetupRing() {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = cfg::IO_URING_QUEUE_DEPTH * 4;
+
+    m_ring = RingSetup(cfg::IO_URING_QUEUE_DEPTH, &params);
+    if (m_ring < 0) return false;
+
+    // a dropped completion would leak its operation and hang Unbind(), so require the kernel to hold on to them
+    if (!(params.features & IORING_FEAT_NODROP)) return false;
+
+    // map the submission and completion rings, which may share one mapping
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single)
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+    void* sq = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED) return false;
+    m_sqRingPtr = sq;
+
+    if (single) {
+        m_cqRingPtr = m_sqRingPtr;
+    } else {
+        void* cq = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED) return false;
+        m_cqRingPtr = cq;
+    }
+
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) return false;
+    m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+    auto* sqbase = static_cast<uint8_t*>(m_sqRingPtr);
+    auto* cqbase = static_cast<uint8_t*>(m_cqRingPtr);
+    m_sqHead = reinterpret_cast<unsigned*>(sqbase + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned*>(sqbase + params.sq_off.tail);
+    m_sqFlags = reinterpret_cast<unsigned*>(sqbase + params.sq_off.flags);
+    m_sqMask = *reinterpret_cast<unsigned*>(sqbase + params.sq_off.ring_mask);
+    m_sqEntries = params.sq_entries;
+    m_cqHead = reinterpret_cast<unsigned*>(cqbase + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned*>(cqbase + params.cq_off.tail);
+    m_cqMask = *reinterpret_cast<unsigned*>(cqbase + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<io_uring_cqe*>(cqbase + params.cq_off.cqes);
+
+    // slot i of the submission queue always refers to entry i, so submitting only has to move the tail
+    auto* array = reinterpret_cast<unsigned*>(sqbase + params.sq_off.array);
+    for (unsigned i = 0; i < m_sqEntries; i++)
+        array[i] = i;
+
+    // ask the kernel whether it supports all operations we need
+    constexpr unsigned probeOps = 256;
+    std::vector<uint8_t> probeMemory(sizeof(io_uring_probe) + probeOps * sizeof(io_uring_probe_op));
+    auto* probe = reinterpret_cast<io_uring_probe*>(probeMemory.data());
+    if (RingRegister(m_ring, IORING_REGISTER_PROBE, probe, probeOps) != 0) return false;
+
+    for (unsigned opcode : {IORING_OP_NOP, IORING_OP_SENDMSG, IORING_OP_RECVMSG, IORING_OP_ASYNC_CANCEL}) {
+        if (opcode >= probe->ops_len || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED))
+            return false;
+    }
+
+    return true;
+}
+
+void SocketIoUring::ReleaseRing() {
+    if (m_sqes)
+        munmap(m_sqes, m_sqesSize);
+    if (m_cqRingPtr && m_cqRingPtr != m_sqRingPtr)
+        munmap(m_cqRingPtr, m_cqRingSize);
+    if (m_sqRingPtr)
+        munmap(m_sqRingPtr, m_sqRingSize);
+    if (m_ring >= 0)
+        ::close(m_ring);
+
+    m_sqes = nullptr;
+    m_cqRingPtr = nullptr;
+    m_sqRingPtr = nullptr;
+    m_ring = -1;
+}
+
+SocketIoUring::Operation* SocketIoUring::AcquireOperation() {
+    WIREFOX_LOCK_GUARD(m_opLock);
+    if (m_opsFree.empty()) {
+        m_ops.push_back(std::make_unique<Operation>());
+        return m_ops.back().get();
+    }
+
+    auto* op = m_opsFree.back();
+    m_opsFree.pop_back();
+    return op;
+}
+
+void SocketIoUring::ReleaseOperation(Operation* op) {
+    // drop the references now rather than whenever the operation is reused
+    op->buffer = nullptr;
+    op->onWrite = nullptr;
+    op->onCall = nullptr;
+
+    WIREFOX_LOCK_GUARD(m_opLock);
+    m_opsFree.push_back(op);
+}
+
+io_uring_sqe* SocketIoUring::GetSubmissionEntry() {
+    // caller must hold m_sqLock
+    const unsigned tail = *m_sqTail;
+    while (tail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries) {
+        // the ring is full of entries nobody submitted yet, so take them into the kernel right away
+        if (RingEnter(m_ring, m_sqEntries, 0, 0) >= 0 || errno == EINTR) continue;
+        if (errno != EAGAIN && errno != EBUSY) return nullptr;
+
+        // the kernel is out of room for completions. the ring thread makes room, unless we are the ring thread
+        if (std::this_thread::get_id() == m_ringThread.get_id()) return nullptr;
+        std::this_thread::yield();
+    }
+
+    auto* sqe = &m_sqes[tail & m_sqMask];
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    return sqe;
+}
+
+void SocketIoUring::PushSubmissionEntry(Operation* op) {
+    // caller must hold m_sqLock, and have filled in the entry returned by GetSubmissionEntry()
+    const unsigned tail = *m_sqTail;
+    m_sqes[tail & m_sqMask].user_data = reinterpret_cast<uintptr_t>(op);
+    m_inflight.fetch_add(1);
+
+    __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_SEQ_CST);
+}
+
+void SocketIoUring::Submit() {
+    // one thread at a time enters the kernel, and takes along the entries that other threads queued in the meantime
+    for (;;) {
+        std::unique_lock<std::mutex> lock(m_submitLock, std::try_to_lock);
+        if (!lock.owns_lock()) return;
+
+        for (;;) {
+            const unsigned pending = __atomic_load_n(m_sqTail, __ATOMIC_SEQ_CST) - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+            if (pending == 0) break;
+
+            // if the kernel can't take them now, the ring thread tries again after reaping some completions
+            if (RingEnter(m_ring, pending, 0, 0) < 0 && errno != EINTR) return;
+        }
+
+        lock.unlock();
+
+        // an entry queued while we held the lock may have seen it taken and left its submission to us
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (__atomic_load_n(m_sqTail, __ATOMIC_SEQ_CST) == __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE))
+            return;
+    }
+}
+
+void SocketIoUring::SubmitNotify() {
+    // pairs with the fence in Submit(), so either we get the lock or its holder sees our entry
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    Submit();
+}
+
+bool SocketIoUring::PostRead() {
+    // ring thread only. every read gets a fresh buffer, because Packets may still be referencing the last one
+    auto* op = AcquireOperation();
+    op->type = Operation::Type::READ;
+    op->buffer = m_readpool.Acquire();
+    op->iov.iov_base = op->buffer.get();
+    op->iov.iov_len = m_readpool.GetBlockSize();
+    op->msg = msghdr();
+    op->msg.msg_name = &op->name;
+    op->msg.msg_namelen = sizeof(op->name);
+    op->msg.msg_iov = &op->iov;
+    op->msg.msg_iovlen = 1;
+    op->msg.msg_control = op->control;
+    op->msg.msg_controllen = sizeof(op->control);
+
+    {
+        WIREFOX_LOCK_GUARD(m_sqLock);
+        auto* sqe = GetSubmissionEntry();
+        if (!sqe) {
+            ReleaseOperation(op);
+            return false;
+        }
+
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->fd = m_fixedFile ? 0 : m_socket.load();
+        sqe->flags = m_fixedFile ? IOSQE_FIXED_FILE : 0;
+        sqe->addr = reinterpret_cast<uintptr_t>(&op->msg);
+        sqe->len = 1;
+        PushSubmissionEntry(op);
+    }
+
+    m_reads.push_back(op);
+    return true;
+}
+
+bool SocketIoUring::PostWrite(Operation* op) {
+    // caller must hold m_sqLock
+    auto* sqe = GetSubmissionEntry();
+    if (!sqe) return false;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = m_fixedFile ? 0 : m_socket.load();
+    sqe->flags = m_fixedFile ? IOSQE_FIXED_FILE : 0;
+    sqe->addr = reinterpret_cast<uintptr_t>(&op->msg);
+    sqe->len = 1;
+    sqe->msg_flags = static_cast<uint32_t>(op->flags);
+    PushSubmissionEntry(op);
+    return true;
+}
+
+bool SocketIoUring::ApplyBufferSizes(int fd) const {
+    const bool receive = SetBufferSize(fd, SO_RCVBUF, SO_RCVBUFFORCE, m_receiveBufferSize);
+    const bool send = SetBufferSize(fd, SO_SNDBUF, SO_SNDBUFFORCE, m_sendBufferSize);
+    return receive && send;
+}
+
+void SocketIoUring::CompleteOperation(Operation* op, int result) {
+    switch (op->type) {
+    case Operation::Type::READ: {
+        m_reads.erase(std::find(m_reads.begin(), m_reads.end(), op));
+
+        // wrap the sender in a RemoteAddress, to help somewhat conceal the implementation detail
+        RemoteAddress addr;
+        const size_t namelen = op->msg.msg_namelen;
+        if (result >= 0 && namelen > 0 && namelen <= addr.endpoint_udp.capacity()) {
+            std::memcpy(addr.endpoint_udp.data(), &op->name, namelen);
+            addr.endpoint_udp.resize(namelen);
+        }
+
+        // the kernel attaches its drop counter once it's no longer zero
+#ifdef SO_RXQ_OVFL
+        if (result >= 0) {
+            for (auto* cmsg = CMSG_FIRSTHDR(&op->msg); cmsg; cmsg = CMSG_NXTHDR(&op->msg, cmsg)) {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                    uint32_t drops;
+                    std::memcpy(&drops, CMSG_DATA(cmsg), sizeof(drops));
+                    m_receiveDrops = drops;
+                }
+            }
+        }
+#endif
+
+        auto buffer = std::move(op->buffer);
+        ReleaseOperation(op);
+
+        // reads that were woken up or cancelled by Unbind() aren't of interest to anyone
+        if (m_closing || !m_readCallback) break;
+
+        // pass the read data to the subscriber (probably PacketQueue)
+        auto callback = m_readCallback;
+        if (result < 0) {
+            // like SocketUDP, stop reading after an error
+            m_readCallback = nullptr;
+            callback(true, addr, buffer, 0);
+        } else {
+            callback(false, addr, buffer, static_cast<size_t>(result));
+        }
+        break;
+    }
+
+    case Operation::Type::WRITE: {
+        if (result == -EAGAIN && (op->flags & MSG_DONTWAIT)) {
+            // the send buffer is full. post it again without the flag, so the kernel waits until there's room
+            m_sendBlocked.fetch_add(1);
+            op->flags &= ~MSG_DONTWAIT;
+
+            WIREFOX_LOCK_GUARD(m_sqLock);
+            if (!m_closing && PostWrite(op)) break;
+        }
+
+        auto callback = std::move(op->onWrite);
+        ReleaseOperation(op);
+
+        // a datagram too big to be sent is lost, like with SocketUDP::BeginWrite()
+        m_sending.fetch_sub(1);
+        assert(callback);
+        callback(result < 0 && result != -EMSGSIZE, result < 0 ? 0 : static_cast<size_t>(result));
+        break;
+    }
+
+    case Operation::Type::CALL: {
+        auto call = std::move(op->onCall);
+        ReleaseOperation(op);
+        call();
+        break;
+    }
+
+    case Operation::Type::CLOSE: {
+        ReleaseOperation(op);
+
+        // reads on a socket that was shut down usually complete by themselves, but make sure of it
+        WIREFOX_LOCK_GUARD(m_sqLock);
+        for (auto* read : m_reads) {
+            auto* sqe = GetSubmissionEntry();
+            if (!sqe) break;
+
+            // the cancellation itself has nothing to complete, so it isn't counted as in flight
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = reinterpret_cast<uintptr_t>(read);
+            __atomic_store_n(m_sqTail, *m_sqTail + 1, __ATOMIC_SEQ_CST);
+        }
+        break;
+    }
+    }
+
+    m_inflight.fetch_sub(1);
+}
+
+void SocketIoUring::ThreadWorker() {
+    for (;;) {
+        Submit();
+
+        // sleep until something completes
+        unsigned head = *m_cqHead;
+        const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            if (m_closing && m_inflight == 0) break;
+
+            RingEnter(m_ring, 0, 1, IORING_ENTER_GETEVENTS);
+            continue;
+        }
+
+        // hand out the completions. entries with no user data belong to cancellations, and can be skipped
+        for (; head != tail; head++) {
+            const auto& cqe = m_cqes[head & m_cqMask];
+            auto* op = reinterpret_cast<Operation*>(static_cast<uintptr_t>(cqe.user_data));
+            const int result = cqe.res;
+            __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+
+            if (op)
+                CompleteOperation(op, result);
+        }
+
+#ifdef IORING_SQ_CQ_OVERFLOW
+        // completions that didn't fit in the ring are held by the kernel, until we ask for them
+        if (__atomic_load_n(m_sqFlags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW)
+            RingEnter(m_ring, 0, 0, IORING_ENTER_GETEVENTS);
+#endif
+
+        // keep enough reads posted to absorb a burst of datagrams. they are submitted together at the top of the loop
+        if (!m_closing && m_readCallback) {
+            while (m_reads.size() < cfg::RECEIVE_POSTED_READS)
+                if (!PostRead()) break;
+        }
+
+        m_reading = m_reads.size() + (m_readCallback ? 1 : 0);
+    }
+
+    m_reading = 0;
+}
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#pragma once
+#include "Socket.h"
+#include "WirefoxConfig.h"
+#include "WirefoxConfigRefs.h"
+
+#ifdef WIREFOX_ENABLE_IO_URING
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace wirefox {
+
+    namespace detail {
+
+        /**
+         * \cond WIREFOX_INTERNAL
+         * \brief Represents a UDP Socket that hands its reads and writes to the Linux kernel through an io_uring.
+         *
+         * Several receive operations are kept posted at all times, so datagrams that arrive in a burst don't wait for the
+         * next read to be started. Writes from different threads are queued in the same submission ring, and whichever
+         * thread gets to submit first takes all of them into the kernel with a single system call. Completions are all
+         * handled by one thread per socket, which also invokes the callbacks, so they run serially like with SocketUDP.
+         *
+         * Use Create() to construct one; it returns nullptr if the running kernel can't provide the features this needs.
+         */
+        class SocketIoUring final
+            : public Socket
+            , public std::enable_shared_from_this<SocketIoUring> {
+        protected:
+            SocketIoUring();
+
+        public:
+            /// Constructs and initializes a new SocketIoUring instance. Returns nullptr if io_uring is not available.
+            static std::shared_ptr<Socket> Create();
+
+            ~SocketIoUring();
+
+            ConnectAttemptResult    Connect(const std::string& host, unsigned short port, SocketConnectCallback_t callback) override;
+            void                    Disconnect() override;
+            void                    Unbind() override;
+            bool                    Bind(SocketProtocol family, unsigned short port) override;
+            bool                    SetReusePort(bool enabled) override;
+            uint16_t                GetLocalPort() const override;
+            size_t                  GetReceiveDrops() override;
+            size_t                  GetSendBlocked() override;
+            bool                    SetBufferSizes(size_t receive, size_t send) override;
+            void                    GetBufferSizes(size_t& receive, size_t& send) const override;
+            bool                    GetDontFragment() const override;
+            bool                    Resolve(const std::string& hostname, uint16_t port, RemoteAddress& output) override;
+            void                    BeginWrite(const RemoteAddress& addr, const uint8_t* data, size_t datalen, SocketWriteCallback_t callback) override;
+            void                    BeginRead(SocketReadCallback_t callback) override;
+            bool                    IsReadPending() const override;
+            bool                    IsWritePending() const override;
+
+            SocketState             GetState() const override;
+            SocketProtocol          GetProtocol() const override;
+
+            bool                    IsOpenAndReady() const override;
+
+        private:
+            struct Operation;
+
+            bool                    SetupRing();
+            void                    ReleaseRing();
+
+            Operation*              AcquireOperation();
+            void                    ReleaseOperation(Operation* op);
+
+            io_uring_sqe*           GetSubmissionEntry();
+            void                    PushSubmissionEntry(Operation* op);
+            void                    Submit();
+            void                    SubmitNotify();
+
+            bool                    PostRead();
+            bool                    PostWrite(Operation* op);
+            bool                    ApplyBufferSizes(int fd) const;
+            void                    CompleteOperation(Operation* op, int result);
+
+            void                    ThreadWorker();
+
+            SocketState             m_state;
+            SocketProtocol          m_family;
+            bool                    m_reusePort;
+            bool                    m_fixedFile;
+            bool                    m_dontFragment;
+            size_t                  m_receiveBufferSize;
+            size_t                  m_sendBufferSize;
+            std::atomic<int>        m_socket;
+
+            // ring memory shared with the kernel
+            int                     m_ring;
+            void*                   m_sqRingPtr;
+            size_t                  m_sqRingSize;
+            void*                   m_cqRingPtr;
+            size_t                  m_cqRingSize;
+            io_uring_sqe*           m_sqes;
+            size_t                  m_sqesSize;
+            unsigned*               m_sqHead;
+            unsigned*               m_sqTail;
+            unsigned*               m_sqFlags;
+            unsigned                m_sqMask;
+            unsigned                m_sqEntries;
+            unsigned*               m_cqHead;
+            unsigned*               m_cqTail;
+            unsigned                m_cqMask;
+            io_uring_cqe*           m_cqes;
+
+            cfg::LockableMutex      m_sqLock;       // guards the submission queue tail and the entries behind it
+            std::mutex              m_submitLock;   // held by the thread that enters the kernel on behalf of the others
+
+            cfg::LockableMutex      m_opLock;
+            std::vector<std::unique_ptr<Operation>> m_ops;
+            std::vector<Operation*> m_opsFree;
+
+            std::thread             m_ringThread;
+            std::atomic_bool        m_closing;
+            std::atomic<size_t>     m_inflight;
+            std::atomic<size_t>     m_reading;
+            std::atomic<size_t>     m_sending;
+            std::atomic<size_t>     m_receiveDrops;
+            std::atomic<size_t>     m_sendBlocked;
+            std::vector<Operation*> m_reads;        // only touched by the ring thread
+
+            SocketReadCallback_t    m_readCallback;
+            BufferPool              m_readpool;
+        };
+
+        /// \endcond
+
+    }
+
+}
+
+#endif
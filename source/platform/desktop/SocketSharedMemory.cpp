@@ -0,0 +1,545 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#include "PCH.h"
+#include "SocketSharedMemory.h"
+
+#ifdef WIREFOX_ENABLE_SHARED_MEMORY
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <random>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace wirefox::detail;
+
+// the same atomics are used by processes that map the memory at different addresses
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "shared memory sockets require lock-free atomics");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be a plain 32-bit integer");
+static_assert((cfg::SHARED_MEMORY_RING_BYTES & (cfg::SHARED_MEMORY_RING_BYTES - 1)) == 0, "wirefox::cfg::SHARED_MEMORY_RING_BYTES must be a power of two");
+static_assert(cfg::SHARED_MEMORY_RING_BYTES > cfg::PACKETQUEUE_IN_LEN * 2, "wirefox::cfg::SHARED_MEMORY_RING_BYTES must hold several of the largest datagrams");
+
+namespace {
+
+    constexpr uint32_t SEGMENT_MAGIC = 0x57465831;          // 'WFX1', changes whenever the layout does
+    constexpr size_t RECORD_HEADER = 2 * sizeof(uint32_t);  // datagram length, sender port
+    constexpr size_t RING_MASK = cfg::SHARED_MEMORY_RING_BYTES - 1;
+    constexpr uint16_t EPHEMERAL_PORT_FIRST = 49152;
+    constexpr unsigned EPHEMERAL_PORT_ATTEMPTS = 64;
+
+    std::string GetSegmentName(SocketProtocol family, uint16_t port) {
+        return std::string("/wirefox.") + (family == SocketProtocol::IPv4 ? "4." : "6.") + std::to_string(port);
+    }
+
+    size_t GetRecordSize(size_t datalen) {
+        // keep records aligned, so a header is never split by the end of the ring
+        return (RECORD_HEADER + datalen + RECORD_HEADER - 1) & ~(RECORD_HEADER - 1);
+    }
+
+    bool IsProcessAlive(pid_t pid) {
+        return ::kill(pid, 0) == 0 || errno == EPERM;
+    }
+
+    void* OpenSharedMemory(const std::string& name, size_t size) {
+        const int fd = ::shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+        if (fd < 0) return nullptr;
+
+        // an object of another size was made by a different version of the library
+        struct stat info;
+        void* memory = MAP_FAILED;
+        if (::fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) == size)
+            memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        ::close(fd);
+        return memory == MAP_FAILED ? nullptr : memory;
+    }
+
+    void FutexWait(std::atomic<uint32_t>& word, uint32_t expected) {
+        // the timeout is only a safety net, in case a wakeup is lost because a sender crashed halfway
+        timespec timeout{ 0, 100 * 1000 * 1000 };
+        ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+    }
+
+    void Notify(std::atomic<uint32_t>& word, const std::atomic<uint32_t>& sleeping) {
+        // the futex is shared between processes, so it can't use FUTEX_PRIVATE_FLAG
+        word.fetch_add(1);
+        if (sleeping.load())
+            ::syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+}
+
+struct SocketSharedMemory::Ring {
+    std::atomic<uint64_t>   owner;      // identifies the sender that claimed this ring, or zero if it's free
+    std::atomic<uint64_t>   drops;
+    alignas(64) std::atomic<uint64_t> head;     // only advanced by the receiver
+    alignas(64) std::atomic<uint64_t> tail;     // only advanced by the sender
+    alignas(64) uint8_t     data[cfg::SHARED_MEMORY_RING_BYTES];
+};
+
+struct SocketSharedMemory::Segment {
+    std::atomic<uint32_t>   magic;
+    std::atomic<int32_t>    pid;
+    std::atomic<uint32_t>   closed;
+    std::atomic<uint32_t>   sleeping;   // set while the receiver may be waiting on the futex
+    alignas(64) std::atomic<uint32_t> futex;
+    alignas(64) Ring        rings[cfg::SHARED_MEMORY_RINGS];
+};
+
+SocketSharedMemory::SocketSharedMemory()
+    : m_state(SocketState::CLOSED)
+    , m_family()
+    , m_port(0)
+    , m_owner(0)
+    , m_segment(nullptr)
+    , m_callsPending(false)
+    , m_closing(true)
+    , m_reading(false)
+    , m_readpool(cfg::PACKETQUEUE_IN_LEN) {}
+
+std::shared_ptr<Socket> SocketSharedMemory::Create() {
+    // see SocketUDP::Create() on why this is a factory method
+    return std::shared_ptr<SocketSharedMemory>(new SocketSharedMemory);
+}
+
+SocketSharedMemory::~SocketSharedMemory() {
+    Unbind();
+}
+
+ConnectAttemptResult SocketSharedMemory::Connect(const std::string& host, const unsigned short port, SocketConnectCallback_t callback) {
+    if (GetState() != SocketState::OPEN || !IsOpenAndReady())
+        return ConnectAttemptResult::INVALID_STATE;
+
+    // make sure input parameters are not nonsensical
+    if (host.empty() || port == 0)
+        return ConnectAttemptResult::INVALID_PARAMETER;
+
+    // attempt to resolve the given hostname into an endpoint
+    RemoteAddress addr;
+    if (!Resolve(host, port, addr))
+        return ConnectAttemptResult::INVALID_HOSTNAME;
+
+    // the callback is expected to run on the network thread
+    assert(callback);
+    if (!Post(std::bind(callback, false, addr, shared_from_this(), std::string())))
+        return ConnectAttemptResult::INVALID_STATE;
+
+    return ConnectAttemptResult::OK;
+}
+
+void SocketSharedMemory::Disconnect() {
+    // Not implemented, like for UDP. Connections are managed on a RemotePeer level instead.
+}
+
+void SocketSharedMemory::Unbind() {
+    {
+        WIREFOX_LOCK_GUARD(m_writeLock);
+        std::lock_guard<std::mutex> lock(m_callLock);
+        if (GetState() != SocketState::OPEN || m_closing) return;
+
+        // stop other sockets from finding this one. those that already did will notice it's closed
+        m_closing = true;
+        m_segment->closed = 1;
+        ::shm_unlink(GetSegmentName(m_family, m_port).c_str());
+    }
+
+    Notify(m_segment->futex, m_segment->sleeping);
+    m_thread.join();
+
+    WIREFOX_LOCK_GUARD(m_writeLock);
+    for (auto& destination : m_destinations)
+        ReleaseDestination(destination.second);
+    m_destinations.clear();
+
+    // like with a closed asio socket, calls that didn't run yet never will
+    m_calls.clear();
+    m_callsPending = false;
+    m_readCallback = nullptr;
+    m_reading = false;
+
+    ::munmap(m_segment, sizeof(Segment));
+    m_segment = nullptr;
+    m_port = 0;
+    m_state = SocketState::CLOSED;
+}
+
+bool SocketSharedMemory::Bind(const SocketProtocol family, const unsigned short port) {
+    // socket should be inactive and unbound
+    if (GetState() != SocketState::CLOSED) return false;
+
+    m_family = family;
+    if (port != 0) {
+        if (!CreateSegment(port)) return false;
+    } else {
+        // there is no kernel to hand out a free port, so try random ones from the range it would use
+        std::mt19937 rng(std::random_device{}());
+        std::uniform_int_distribution<unsigned> range(EPHEMERAL_PORT_FIRST, UINT16_MAX);
+
+        bool bound = false;
+        for (unsigned attempt = 0; attempt < EPHEMERAL_PORT_ATTEMPTS && !bound; attempt++)
+            bound = CreateSegment(static_cast<uint16_t>(range(rng)));
+
+        if (!bound) return false;
+    }
+
+    // start the thread that receives datagrams
+    m_owner = static_cast<uint64_t>(::getpid()) << 32 | m_port;
+    m_readCallback = nullptr;
+    m_closing = false;
+    m_thread = std::thread(std::bind(&SocketSharedMemory::ThreadWorker, this));
+    m_state = SocketState::OPEN;
+
+    return true;
+}
+
+uint16_t SocketSharedMemory::GetLocalPort() const {
+    return m_port;
+}
+
+size_t SocketSharedMemory::GetReceiveDrops() {
+    if (GetState() != SocketState::OPEN) return 0;
+
+    // senders count the datagrams that found their ring full
+    size_t drops = 0;
+    for (const auto& ring : m_segment->rings)
+        drops += static_cast<size_t>(ring.drops.load(std::memory_order_relaxed));
+
+    return drops;
+}
+
+bool SocketSharedMemory::GetDontFragment() const {
+    // a datagram too big for the receiver's buffers is dropped, so path MTU discovery can find the largest one that fits
+    return true;
+}
+
+bool SocketSharedMemory::Resolve(const std::string& hostname, uint16_t port, RemoteAddress& output) {
+    const auto protocol = m_family == SocketProtocol::IPv4 ? asio::ip::udp::v4() : asio::ip::udp::v6();
+
+    // perform hostname resolution
+    asio::io_context context;
+    asio::error_code ec;
+    asio::ip::udp::resolver resolver(context);
+    asio::ip::udp::resolver::iterator it = resolver.resolve(protocol, hostname, std::to_string(port), ec);
+
+    // socket error, or no results?
+    if (ec || it == asio::ip::udp::resolver::iterator())
+        return false;
+
+    // other hosts can't be reached through shared memory
+    if (!it->endpoint().address().is_loopback())
+        return false;
+
+    output.endpoint_udp = *it;
+    return true;
+}
+
+void SocketSharedMemory::BeginWrite(const RemoteAddress& addr, const uint8_t* data, size_t datalen, SocketWriteCallback_t callback) {
+    {
+        // writes for different remotes may be dispatched from several worker threads at once
+        WIREFOX_LOCK_GUARD(m_writeLock);
+
+        // like an asio socket that was closed, a closed socket never completes the write
+        if (m_closing) return;
+
+        // a datagram that can't be delivered is lost, like one sent to a UDP port nobody listens on
+        auto* destination = GetDestination(addr);
+        if (destination && Write(*destination, data, datalen))
+            Notify(destination->segment->futex, destination->segment->sleeping);
+    }
+
+    assert(callback);
+    callback(false, datalen);
+}
+
+void SocketSharedMemory::BeginWriteBatch(const RemoteAddress& addr, const std::vector<WriteBuffer>& datagrams, SocketWriteCallback_t callback) {
+    assert(!datagrams.empty());
+    size_t transferred = 0;
+
+    {
+        WIREFOX_LOCK_GUARD(m_writeLock);
+        if (m_closing) return;
+
+        // copy the whole batch before waking the receiver, so it's woken at most once
+        auto* destination = GetDestination(addr);
+        bool written = false;
+        for (const auto& datagram : datagrams) {
+            if (destination && Write(*destination, datagram.data, datagram.length))
+                written = true;
+
+            transferred += datagram.length;
+        }
+
+        if (written)
+            Notify(destination->segment->futex, destination->segment->sleeping);
+    }
+
+    assert(callback);
+    callback(false, transferred);
+}
+
+void SocketSharedMemory::BeginRead(SocketReadCallback_t callback) {
+    // count the read as pending right away, so it isn't started twice
+    if (!Post([this, callback] { m_readCallback = callback; }))
+        return;
+
+    m_reading = true;
+}
+
+bool SocketSharedMemory::IsReadPending() const {
+    return m_reading;
+}
+
+bool SocketSharedMemory::IsWritePending() const {
+    // writes complete before BeginWrite() returns
+    return false;
+}
+
+Socket::SocketState SocketSharedMemory::GetState() const {
+    return m_state;
+}
+
+SocketProtocol SocketSharedMemory::GetProtocol() const {
+    return m_family;
+}
+
+bool SocketSharedMemory::IsOpenAndReady() const {
+    return m_state == SocketState::OPEN;
+}
+
+bool SocketSharedMemory::CreateSegment(uint16_t port) {
+    const auto name = GetSegmentName(m_family, port);
+    int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+
+    // a process that crashed leaves its port taken, so take it over if that process is gone
+    if (fd < 0 && errno == EEXIST) {
+        auto* stale = static_cast<Segment*>(OpenSharedMemory(name, sizeof(Segment)));
+        if (stale) {
+            const pid_t pid = stale->pid.load();
+            ::munmap(stale, sizeof(Segment));
+
+            // a pid of zero means the object is still being set up
+            if (pid != 0 && !IsProcessAlive(pid)) {
+                ::shm_unlink(name.c_str());
+                fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+            }
+        }
+    }
+
+    if (fd < 0) return false;
+
+    void* memory = MAP_FAILED;
+    if (::ftruncate(fd, sizeof(Segment)) == 0)
+        memory = ::mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        ::shm_unlink(name.c_str());
+        return false;
+    }
+
+    // the new object is zero-filled, which is the initial state of all fields. senders ignore it until the magic is set
+    m_segment = static_cast<Segment*>(memory);
+    m_segment->pid = ::getpid();
+    m_segment->magic.store(SEGMENT_MAGIC, std::memory_order_release);
+    m_port = port;
+
+    return true;
+}
+
+SocketSharedMemory::Destination* SocketSharedMemory::GetDestination(const RemoteAddress& addr) {
+    const auto& endpoint = addr.endpoint_udp;
+    if (!endpoint.address().is_loopback()) return nullptr;
+
+    const uint16_t port = endpoint.port();
+    auto it = m_destinations.find(port);
+    if (it != m_destinations.end()) {
+        if (!it->second.segment->closed.load()) return &it->second;
+
+        // the receiver was unbound, but another socket may have been bound to the same port since
+        ReleaseDestination(it->second);
+        m_destinations.erase(it);
+    }
+
+    auto* segment = static_cast<Segment*>(OpenSharedMemory(GetSegmentName(m_family, port), sizeof(Segment)));
+    if (!segment) return nullptr;
+
+    if (segment->magic.load(std::memory_order_acquire) != SEGMENT_MAGIC || segment->closed.load()) {
+        ::munmap(segment, sizeof(Segment));
+        return nullptr;
+    }
+
+    Destination destination{ segment, ClaimRing(segment) };
+    return &m_destinations.emplace(port, destination).first->second;
+}
+
+SocketSharedMemory::Ring* SocketSharedMemory::ClaimRing(Segment* segment) const {
+    for (auto& ring : segment->rings) {
+        uint64_t owner = 0;
+        if (ring.owner.compare_exchange_strong(owner, m_owner))
+            return &ring;
+    }
+
+    // take over the ring of a sender that crashed. the records it left behind are still delivered, since this sender
+    // simply continues where the other one stopped
+    for (auto& ring : segment->rings) {
+        uint64_t owner = ring.owner.load();
+        if (!IsProcessAlive(static_cast<pid_t>(owner >> 32)) && ring.owner.compare_exchange_strong(owner, m_owner))
+            return &ring;
+    }
+
+    return nullptr;
+}
+
+void SocketSharedMemory::ReleaseDestination(Destination& destination) const {
+    if (destination.ring) {
+        uint64_t owner = m_owner;
+        destination.ring->owner.compare_exchange_strong(owner, 0);
+    }
+
+    ::munmap(destination.segment, sizeof(Segment));
+}
+
+bool SocketSharedMemory::Write(Destination& destination, const uint8_t* data, size_t datalen) const {
+    // a datagram too big for the receiver's buffers is lost, like one too big for the network interface
+    if (datalen > cfg::PACKETQUEUE_IN_LEN) return false;
+
+    // all rings may have been taken the last time, so try again
+    if (!destination.ring) {
+        destination.ring = ClaimRing(destination.segment);
+        if (!destination.ring) return false;
+    }
+
+    // the receiver only frees up space, so if there's room now, there still is after copying
+    auto& ring = *destination.ring;
+    const size_t size = GetRecordSize(datalen);
+    const uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    if (tail + size - ring.head.load(std::memory_order_acquire) > cfg::SHARED_MEMORY_RING_BYTES) {
+        ring.drops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    const size_t offset = tail & RING_MASK;
+    const uint32_t header[] = { static_cast<uint32_t>(datalen), m_port };
+    std::memcpy(ring.data + offset, header, RECORD_HEADER);
+
+    // the datagram itself may wrap around the end of the ring
+    const size_t start = (offset + RECORD_HEADER) & RING_MASK;
+    const size_t first = std::min(datalen, cfg::SHARED_MEMORY_RING_BYTES - start);
+    std::memcpy(ring.data + start, data, first);
+    std::memcpy(ring.data, data + first, datalen - first);
+
+    ring.tail.store(tail + size, std::memory_order_release);
+    return true;
+}
+
+bool SocketSharedMemory::Post(std::function<void()> call) {
+    // the segment stays mapped for as long as the socket isn't closing
+    std::lock_guard<std::mutex> lock(m_callLock);
+    if (m_closing) return false;
+
+    m_calls.push_back(std::move(call));
+    m_callsPending = true;
+    Notify(m_segment->futex, m_segment->sleeping);
+    return true;
+}
+
+bool SocketSharedMemory::Drain() {
+    if (!m_readCallback) return false;
+
+    const auto loopback = m_family == SocketProtocol::IPv4
+        ? asio::ip::address(asio::ip::address_v4::loopback())
+        : asio::ip::address(asio::ip::address_v6::loopback());
+
+    bool received = false;
+    for (auto& ring : m_segment->rings) {
+        // take a limited number of datagrams from each ring, so one busy sender doesn't hold up the others
+        for (size_t i = 0; i < cfg::RECEIVE_POSTED_READS; i++) {
+            const uint64_t head = ring.head.load(std::memory_order_relaxed);
+            const uint64_t tail = ring.tail.load(std::memory_order_acquire);
+            if (head == tail) break;
+
+            const size_t offset = head & RING_MASK;
+            uint32_t header[2];
+            std::memcpy(header, ring.data + offset, RECORD_HEADER);
+
+            // only a broken sender writes a record like this, so whatever else is in the ring can't be trusted either
+            const size_t datalen = header[0];
+            if (datalen > m_readpool.GetBlockSize() || tail - head < GetRecordSize(datalen)) {
+                ring.head.store(tail, std::memory_order_release);
+                break;
+            }
+
+            auto buffer = m_readpool.Acquire();
+            const size_t start = (offset + RECORD_HEADER) & RING_MASK;
+            const size_t first = std::min(datalen, cfg::SHARED_MEMORY_RING_BYTES - start);
+            std::memcpy(buffer.get(), ring.data + start, first);
+            std::memcpy(buffer.get() + first, ring.data, datalen - first);
+
+            // the datagram was copied out, so the sender may reuse its space
+            ring.head.store(head + GetRecordSize(datalen), std::memory_order_release);
+
+            RemoteAddress sender;
+            sender.endpoint_udp = asio::ip::udp::endpoint(loopback, static_cast<uint16_t>(header[1]));
+            m_readCallback(false, sender, std::move(buffer), datalen);
+            received = true;
+        }
+    }
+
+    return received;
+}
+
+bool SocketSharedMemory::IsDrained() const {
+    // datagrams are left in the rings until someone wants them
+    if (!m_readCallback) return true;
+
+    for (const auto& ring : m_segment->rings)
+        if (ring.head.load(std::memory_order_relaxed) != ring.tail.load(std::memory_order_acquire))
+            return false;
+
+    return true;
+}
+
+void SocketSharedMemory::ThreadWorker() {
+    std::vector<std::function<void()>> calls;
+
+    while (!m_closing) {
+        if (m_callsPending) {
+            {
+                std::lock_guard<std::mutex> lock(m_callLock);
+                calls.swap(m_calls);
+                m_callsPending = false;
+            }
+
+            for (auto& call : calls)
+                call();
+            calls.clear();
+        }
+
+        if (Drain()) continue;
+
+        // nothing to do, so sleep until a sender signals the futex. senders only do that if they see the flag, so set
+        // it first, then check once more, to not miss a datagram that arrived in between
+        const uint32_t futex = m_segment->futex.load();
+        m_segment->sleeping = 1;
+        if (!m_closing && !m_callsPending && IsDrained())
+            FutexWait(m_segment->futex, futex);
+
+        m_segment->sleeping = 0;
+    }
+}
+
+#endif
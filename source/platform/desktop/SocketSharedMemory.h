@@ -0,0 +1,112 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#pragma once
+#include "Socket.h"
+#include "WirefoxConfig.h"
+#include "WirefoxConfigRefs.h"
+
+#ifdef WIREFOX_ENABLE_SHARED_MEMORY
+
+namespace wirefox {
+
+    namespace detail {
+
+        /**
+         * \cond WIREFOX_INTERNAL
+         * \brief Represents a Socket that exchanges datagrams with other processes on the same host through shared memory.
+         *
+         * Binding to a port creates a named shared memory object for it, holding a number of single-producer, single-consumer
+         * ring buffers. A socket that sends to that port claims one of the rings for itself, and copies its datagrams into it,
+         * so the kernel never touches the data. Only when the receiving thread is asleep, the sender wakes it with a futex.
+         * Since nothing ever waits for room, writes are complete by the time BeginWrite() returns, and so is their callback.
+         *
+         * Ports live in a namespace of their own, so they never clash with UDP ports. Remote endpoints are still represented
+         * as loopback addresses, so everything above the Socket works as it would with UDP. Like UDP, a datagram that finds
+         * no receiver, or a full ring, is dropped without reporting an error.
+         */
+        class SocketSharedMemory final
+            : public Socket
+            , public std::enable_shared_from_this<SocketSharedMemory> {
+        protected:
+            SocketSharedMemory();
+
+        public:
+            /// Constructs and initializes a new SocketSharedMemory instance.
+            static std::shared_ptr<Socket> Create();
+
+            ~SocketSharedMemory();
+
+            ConnectAttemptResult    Connect(const std::string& host, unsigned short port, SocketConnectCallback_t callback) override;
+            void                    Disconnect() override;
+            void                    Unbind() override;
+            bool                    Bind(SocketProtocol family, unsigned short port) override;
+            uint16_t                GetLocalPort() const override;
+            size_t                  GetReceiveDrops() override;
+            bool                    GetDontFragment() const override;
+            bool                    Resolve(const std::string& hostname, uint16_t port, RemoteAddress& output) override;
+            void                    BeginWrite(const RemoteAddress& addr, const uint8_t* data, size_t datalen, SocketWriteCallback_t callback) override;
+            void                    BeginWriteBatch(const RemoteAddress& addr, const std::vector<WriteBuffer>& datagrams, SocketWriteCallback_t callback) override;
+            void                    BeginRead(SocketReadCallback_t callback) override;
+            bool                    IsReadPending() const override;
+            bool                    IsWritePending() const override;
+
+            SocketState             GetState() const override;
+            SocketProtocol          GetProtocol() const override;
+
+            bool                    IsOpenAndReady() const override;
+
+        private:
+            struct Ring;
+            struct Segment;
+
+            /// Represents the shared memory of another socket this one sends to.
+            struct Destination {
+                Segment*            segment;
+                Ring*               ring;       // the ring claimed by this socket, or nullptr if all were taken
+            };
+
+            bool                    CreateSegment(uint16_t port);
+            Destination*            GetDestination(const RemoteAddress& addr);
+            Ring*                   ClaimRing(Segment* segment) const;
+            void                    ReleaseDestination(Destination& destination) const;
+            bool                    Write(Destination& destination, const uint8_t* data, size_t datalen) const;
+            bool                    Post(std::function<void()> call);
+            bool                    Drain();
+            bool                    IsDrained() const;
+
+            void                    ThreadWorker();
+
+            SocketState             m_state;
+            SocketProtocol          m_family;
+            uint16_t                m_port;
+            uint64_t                m_owner;        // identifies this socket in the rings it claimed
+            Segment*                m_segment;
+
+            cfg::LockableMutex      m_writeLock;    // guards the destinations, and makes this socket the only producer of its rings
+            std::unordered_map<uint16_t, Destination> m_destinations;
+
+            std::mutex              m_callLock;
+            std::vector<std::function<void()>> m_calls;
+            std::atomic_bool        m_callsPending;
+
+            std::thread             m_thread;
+            std::atomic_bool        m_closing;
+            std::atomic_bool        m_reading;
+
+            SocketReadCallback_t    m_readCallback;
+            BufferPool              m_readpool;
+        };
+
+        /// \endcond
+
+    }
+
+}
+
+#endif
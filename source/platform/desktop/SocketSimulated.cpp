@@ -0,0 +1,165 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#include "PCH.h"
+#include "SocketSimulated.h"
+
+#include <cstring>
+
+using namespace wirefox::detail;
+
+SocketSimulated::SocketSimulated(std::shared_ptr<SimulatedNetwork> network)
+    : m_network(std::move(network))
+    , m_state(SocketState::CLOSED)
+    , m_family()
+    , m_port(0)
+    , m_reading(false)
+    , m_readpool(cfg::PACKETQUEUE_IN_LEN) {}
+
+std::shared_ptr<Socket> SocketSimulated::Create(std::shared_ptr<SimulatedNetwork> network) {
+    // see SocketUDP::Create() on why this is a factory method
+    assert(network);
+    return std::shared_ptr<SocketSimulated>(new SocketSimulated(std::move(network)));
+}
+
+SocketSimulated::~SocketSimulated() {
+    Unbind();
+}
+
+ConnectAttemptResult SocketSimulated::Connect(const std::string& host, const unsigned short port, SocketConnectCallback_t callback) {
+    if (GetState() != SocketState::OPEN || !IsOpenAndReady())
+        return ConnectAttemptResult::INVALID_STATE;
+
+    // make sure input parameters are not nonsensical
+    if (host.empty() || port == 0)
+        return ConnectAttemptResult::INVALID_PARAMETER;
+
+    // attempt to resolve the given hostname into an endpoint
+    RemoteAddress addr;
+    if (!Resolve(host, port, addr))
+        return ConnectAttemptResult::INVALID_HOSTNAME;
+
+    // the callback is expected to run on the network thread
+    assert(callback);
+    m_network->Post(std::bind(callback, false, addr, shared_from_this(), std::string()));
+
+    return ConnectAttemptResult::OK;
+}
+
+void SocketSimulated::Disconnect() {
+    // Not implemented, like for UDP. Connections are managed on a RemotePeer level instead.
+}
+
+void SocketSimulated::Unbind() {
+    if (m_state.exchange(SocketState::CLOSED) != SocketState::OPEN) return;
+
+    // once this returns, no more datagrams are delivered to this socket
+    m_network->Unbind(m_port);
+    m_port = 0;
+    m_reading = false;
+}
+
+bool SocketSimulated::Bind(const SocketProtocol family, const unsigned short port) {
+    // socket should be inactive and unbound
+    if (GetState() != SocketState::CLOSED) return false;
+
+    m_family = family;
+    const uint16_t bound = m_network->Bind(port, [this](uint16_t sender, const uint8_t* data, size_t length) {
+        OnReceive(sender, data, length);
+    });
+    if (bound == 0) return false;
+
+    m_port = bound;
+    m_state = SocketState::OPEN;
+    return true;
+}
+
+uint16_t SocketSimulated::GetLocalPort() const {
+    return m_port;
+}
+
+size_t SocketSimulated::GetReceiveDrops() {
+    // only the queue of a link stands in for a receive buffer, the rest is lost along the way
+    return m_network->GetReceiveStats(m_port).queueDrops;
+}
+
+bool SocketSimulated::Resolve(const std::string& hostname, uint16_t port, RemoteAddress& output) {
+    const auto protocol = m_family == SocketProtocol::IPv4 ? asio::ip::udp::v4() : asio::ip::udp::v6();
+
+    // perform hostname resolution, so addresses look the same as they would for UDP. only the port is used, though
+    asio::io_context context;
+    asio::error_code ec;
+    asio::ip::udp::resolver resolver(context);
+    asio::ip::udp::resolver::iterator it = resolver.resolve(protocol, hostname, std::to_string(port), ec);
+
+    // socket error, or no results?
+    if (ec || it == asio::ip::udp::resolver::iterator())
+        return false;
+
+    output.endpoint_udp = *it; // assume first entry is ok, for simplicity
+    return true;
+}
+
+void SocketSimulated::BeginWrite(const RemoteAddress& addr, const uint8_t* data, size_t datalen, SocketWriteCallback_t callback) {
+    // like an asio socket that was closed, a closed socket never completes the write
+    if (GetState() != SocketState::OPEN) return;
+
+    m_network->Send(m_port, addr.endpoint_udp.port(), data, datalen);
+
+    assert(callback);
+    callback(false, datalen);
+}
+
+void SocketSimulated::BeginRead(SocketReadCallback_t callback) {
+    if (GetState() != SocketState::OPEN) return;
+
+    // the callback may only be touched by the delivering thread. if the socket is gone by then, never mind
+    std::weak_ptr<SocketSimulated> weak = shared_from_this();
+    m_reading = true;
+    m_network->Post([weak, callback] {
+        if (auto self = weak.lock())
+            self->m_readCallback = callback;
+    });
+}
+
+bool SocketSimulated::IsReadPending() const {
+    return m_reading;
+}
+
+bool SocketSimulated::IsWritePending() const {
+    // writes complete before BeginWrite() returns
+    return false;
+}
+
+Socket::SocketState SocketSimulated::GetState() const {
+    return m_state;
+}
+
+SocketProtocol SocketSimulated::GetProtocol() const {
+    return m_family;
+}
+
+bool SocketSimulated::IsOpenAndReady() const {
+    return m_state == SocketState::OPEN;
+}
+
+void SocketSimulated::OnReceive(uint16_t sender, const uint8_t* data, size_t length) {
+    // a datagram too big for the read buffers is truncated by a real socket, and then rejected by the packet queue
+    if (!m_readCallback || length > m_readpool.GetBlockSize()) return;
+
+    auto buffer = m_readpool.Acquire();
+    std::memcpy(buffer.get(), data, length);
+
+    const auto loopback = m_family == SocketProtocol::IPv4
+        ? asio::ip::address(asio::ip::address_v4::loopback())
+        : asio::ip::address(asio::ip::address_v6::loopback());
+
+    RemoteAddress addr;
+    addr.endpoint_udp = asio::ip::udp::endpoint(loopback, sender);
+    m_readCallback(false, addr, std::move(buffer), length);
+}
@@ -0,0 +1,77 @@
+/*
+ * Wirefox Networking API
+ * (C) Mika Molenkamp, 2019.
+ *
+ * Licensed under the BSD 3-Clause License, see the LICENSE file in the project
+ * root folder for more information.
+ */
+
+#pragma once
+#include "Socket.h"
+#include "SimulatedNetwork.h"
+#include "WirefoxConfig.h"
+#include "WirefoxConfigRefs.h"
+
+namespace wirefox {
+
+    namespace detail {
+
+        /**
+         * \cond WIREFOX_INTERNAL
+         * \brief Represents a Socket that sends its datagrams over a SimulatedNetwork rather than a real one.
+         *
+         * Ports are only meaningful within the network the socket was created for. Remote endpoints are represented as
+         * loopback addresses, so everything above the Socket works as it would with UDP. Writes are handed to the network
+         * right away, so their callback is fired before BeginWrite() returns. Reads are delivered on the network's thread,
+         * or on the thread that advances its clock.
+         *
+         * Links have no MTU. The socket doesn't claim to set the don't-fragment bit either, so path MTU discovery leaves
+         * datagrams at cfg::MTU, and transfers under different link conditions remain comparable.
+         */
+        class SocketSimulated final
+            : public Socket
+            , public std::enable_shared_from_this<SocketSimulated> {
+        protected:
+            explicit SocketSimulated(std::shared_ptr<SimulatedNetwork> network);
+
+        public:
+            /// Constructs a new SocketSimulated instance that sends over the specified network.
+            static std::shared_ptr<Socket> Create(std::shared_ptr<SimulatedNetwork> network);
+
+            ~SocketSimulated();
+
+            ConnectAttemptResult    Connect(const std::string& host, unsigned short port, SocketConnectCallback_t callback) override;
+            void                    Disconnect() override;
+            void                    Unbind() override;
+            bool                    Bind(SocketProtocol family, unsigned short port) override;
+            uint16_t                GetLocalPort() const override;
+            size_t                  GetReceiveDrops() override;
+            bool                    Resolve(const std::string& hostname, uint16_t port, RemoteAddress& output) override;
+            void                    BeginWrite(const RemoteAddress& addr, const uint8_t* data, size_t datalen, SocketWriteCallback_t callback) override;
+            void                    BeginRead(SocketReadCallback_t callback) override;
+            bool                    IsReadPending() const override;
+            bool                    IsWritePending() const override;
+
+            SocketState             GetState() const override;
+            SocketProtocol          GetProtocol() const override;
+
+            bool                    IsOpenAndReady() const override;
+
+        private:
+            void                    OnReceive(uint16_t sender, const uint8_t* data, size_t length);
+
+            std::shared_ptr<SimulatedNetwork> m_network;
+            std::atomic<SocketState> m_state;
+            SocketProtocol          m_family;
+            std::atomic<uint16_t>   m_port;
+            std::atomic_bool        m_reading;
+
+            SocketReadCallback_t    m_readCallback;     // only touched by the thread that delivers datagrams
+            BufferPool              m_readpool;
+        };
+
+        /// \endcond
+
+    }
+
+}
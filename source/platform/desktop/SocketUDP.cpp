@@ -8,25 +8,138 @@
 
 #include "PCH.h"
 #include "SocketUDP.h"
+#include <future>
+
+#ifdef __linux__
+#include <algorithm>
+#include <cstring>
+#include <linux/sock_diag.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+// older C libraries don't know about UDP segmentation offload yet
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+#define WIREFOX_UDP_OFFLOAD
+#endif
 
 using namespace asio::ip;
 using namespace wirefox::detail;
 
-SocketUDP::SocketUDP()
+#ifdef WIREFOX_UDP_OFFLOAD
+namespace {
+
+    // the kernel splits a buffer into at most this many datagrams, and the buffer must fit in a single IP packet
+    constexpr size_t SEGMENTS_MAX = 64;
+    constexpr size_t SEGMENTS_MAX_BYTES = 65507;
+
+    /// Returns how many datagrams, starting at \p first, the kernel can cut out of a single buffer: they must all have
+    /// the same length, except for the last one, which may be shorter.
+    size_t GetSegmentCount(const std::vector<Socket::WriteBuffer>& datagrams, size_t first) {
+        const size_t size = datagrams[first].length;
+        size_t total = size;
+        size_t count = 1;
+
+        while (first + count < datagrams.size() && count < SEGMENTS_MAX) {
+            const size_t next = datagrams[first + count].length;
+            if (next > size || total + next > SEGMENTS_MAX_BYTES) break;
+
+            total += next;
+            count++;
+            if (next < size) break;
+        }
+
+        return count;
+    }
+
+    /// Sends \p count datagrams in one call, and returns the number of bytes sent, or -1 and sets errno on failure.
+    ssize_t SendSegments(int fd, const udp::endpoint& endpoint, const Socket::WriteBuffer* datagrams, size_t count) {
+        iovec iov[SEGMENTS_MAX];
+        for (size_t i = 0; i < count; i++) {
+            iov[i].iov_base = const_cast<uint8_t*>(datagrams[i].data);
+            iov[i].iov_len = datagrams[i].length;
+        }
+
+        msghdr msg = {};
+        msg.msg_name = const_cast<sockaddr*>(endpoint.data());
+        msg.msg_namelen = static_cast<socklen_t>(endpoint.size());
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+
+        // tell the kernel where to cut the buffer up into datagrams
+        alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(uint16_t))] = {};
+        if (count > 1) {
+            const uint16_t size = static_cast<uint16_t>(datagrams[0].length);
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            auto* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = IPPROTO_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(size));
+            std::memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+        }
+
+        return ::sendmsg(fd, &msg, 0);
+    }
+
+    /// Sets the don't-fragment bit on every datagram the socket sends, and returns whether that worked. This ignores
+    /// what the kernel has learned about the path MTU, so it doesn't get in the way of our own path MTU discovery.
+    bool SetDontFragment(int fd, SocketProtocol family) {
+#if defined(IP_MTU_DISCOVER) && defined(IPV6_MTU_DISCOVER)
+        const int probe = IP_PMTUDISC_PROBE;
+        if (family == SocketProtocol::IPv4)
+            return ::setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &probe, sizeof(probe)) == 0;
+
+        // an IPv6 socket may also talk to IPv4 addresses, which have an option of their own
+        const int probe6 = IPV6_PMTUDISC_PROBE;
+        ::setsockopt(fd, IPPROTO_IP, IP_MTU_DISCOVER, &probe, sizeof(probe));
+        return ::setsockopt(fd, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &probe6, sizeof(probe6)) == 0;
+#else
+        (void)fd;
+        (void)family;
+        return false;
+#endif
+    }
+
+}
+#endif
+
+SocketUDP::SocketUDP(std::shared_ptr<asio::io_context> context, bool ownThread)
     : m_state(SocketState::CLOSED)
     , m_family()
-    , m_socket(m_context)
+    , m_reusePort(false)
+    , m_receiveBufferSize(cfg::SOCKET_RECEIVE_BUFFER)
+    , m_sendBufferSize(cfg::SOCKET_SEND_BUFFER)
+    , m_context(std::move(context))
+    , m_ownThread(ownThread)
+    , m_socket(*m_context)
     , m_socketThreadAbort(false)
-    , m_reading(false)
-    , m_sending(false)
-    , m_readbuf{} {}
+    , m_reading(0)
+    , m_sending(0)
+    , m_sendBlocked(0)
+    , m_sendSegmentation(false)
+    , m_receiveCoalescing(false)
+    , m_dontFragment(false)
+    , m_readpool(cfg::PACKETQUEUE_IN_LEN)
+    , m_readsenders(cfg::RECEIVE_POSTED_READS) {}
 
 std::shared_ptr<Socket> SocketUDP::Create() {
     // Use a factory method like this to allow safe usage of std::shared_from_this, which I need because
     // SocketConnectCallback_t should return a shared_ptr<Socket>. It should return this same instance
     // because UDP doesn't generate more sockets like a TCP acceptor does.
     // https://en.cppreference.com/w/cpp/memory/enable_shared_from_this
-    return std::shared_ptr<SocketUDP>(new SocketUDP);
+    return std::shared_ptr<SocketUDP>(new SocketUDP(std::make_shared<asio::io_context>(), true));
+}
+
+std::shared_ptr<Socket> SocketUDP::Create(std::shared_ptr<asio::io_context> context) {
+    assert(context);
+    return std::shared_ptr<SocketUDP>(new SocketUDP(std::move(context), false));
 }
 
 SocketUDP::~SocketUDP() {
@@ -48,7 +161,7 @@ ConnectAttemptResult SocketUDP::Connect(const std::string& host, const unsigned
         return ConnectAttemptResult::INVALID_HOSTNAME;
 
     assert(callback);
-    m_context.post(std::bind(callback, false, addr, shared_from_this(), std::string()));
+    m_context->post(std::bind(callback, false, addr, shared_from_this(), std::string()));
 
     return ConnectAttemptResult::OK;
 }
@@ -58,7 +171,10 @@ void SocketUDP::Disconnect() {
 }
 
 void SocketUDP::Unbind() {
-    if (m_socket.is_open()) {
+    const bool wasOpen = m_socket.is_open();
+    if (wasOpen) {
+        // a read may be restarting on the socket thread, see PostCoalescedRead()
+        WIREFOX_LOCK_GUARD(m_writeLock);
         asio::error_code ec;
         m_socket.shutdown(udp::socket::shutdown_both, ec);
         m_socket.cancel(ec);
@@ -66,9 +182,25 @@ void SocketUDP::Unbind() {
         m_state = SocketState::CLOSED;
     }
 
+    if (!m_ownThread) {
+        // the context keeps running for other sockets, so wait for the handlers that still reference this one. closing
+        // the socket made its reads and writes complete with an error
+        if (wasOpen) {
+            assert(!m_context->get_executor().running_in_this_thread());
+            while (IsReadPending() || IsWritePending())
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+            // a handler may still be running its callback after giving up its count; anything posted after it runs later
+            std::promise<void> done;
+            m_context->post([&done] { done.set_value(); });
+            done.get_future().wait();
+        }
+        return;
+    }
+
     // stop the worker thread
     m_socketThreadAbort = true;
-    m_context.stop();
+    m_context->stop();
     if (m_socketThread.joinable())
         m_socketThread.join();
 }
@@ -85,29 +217,110 @@ bool SocketUDP::Bind(const SocketProtocol family, const unsigned short port) {
     try {
         m_socket.close();
         m_socket.open(protocol);
+#ifdef SO_REUSEPORT
+        if (m_reusePort)
+            m_socket.set_option(asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+#endif
         m_socket.bind(udp::endpoint(protocol, port));
 
         // enable UDP multicasting
         m_socket.set_option(asio::socket_base::broadcast(true));
 
+        // BeginWrite() tries to send right away, and only waits for the socket if that would block
+        m_socket.non_blocking(true);
+
     } catch (const asio::system_error&) {
         return false;
     }
 
-    // start worker thread
-    m_socketThread = std::thread(std::bind(&SocketUDP::ThreadWorker, this));
+    // a buffer the system refuses to resize is not worth failing over, the default still works
+    ApplyBufferSizes();
+
+#ifdef WIREFOX_UDP_OFFLOAD
+    // let the kernel pass datagrams from the same sender up together, and take ours down together. both are optional,
+    // BeginWriteBatch() finds out by itself whether segmenting works for the destination
+    const int enable = 1;
+    m_receiveCoalescing = ::setsockopt(m_socket.native_handle(), IPPROTO_UDP, UDP_GRO, &enable, sizeof(enable)) == 0;
+    m_sendSegmentation = true;
+    if (m_receiveCoalescing)
+        m_coalesced.resize(SEGMENTS_MAX_BYTES);
+
+    // without this, path MTU discovery can't tell whether a big datagram was carried as a whole
+    m_dontFragment = SetDontFragment(m_socket.native_handle(), m_family);
+#endif
+
+    // start worker thread, unless the context is run by someone else
+    if (m_ownThread)
+        m_socketThread = std::thread(std::bind(&SocketUDP::ThreadWorker, this));
     m_state = SocketState::OPEN;
 
     return true;
 }
 
+bool SocketUDP::SetReusePort(bool enabled) {
+#ifdef SO_REUSEPORT
+    if (GetState() != SocketState::CLOSED) return false;
+
+    m_reusePort = enabled;
+    return true;
+#else
+    // e.g. Windows has SO_REUSEADDR, but that lets one socket steal the port rather than share it
+    return !enabled;
+#endif
+}
+
+uint16_t SocketUDP::GetLocalPort() const {
+    asio::error_code ec;
+    const auto endpoint = m_socket.local_endpoint(ec);
+    return ec ? 0 : endpoint.port();
+}
+
+size_t SocketUDP::GetReceiveDrops() {
+#if defined(__linux__) && defined(SO_MEMINFO)
+    // the same counter SO_RXQ_OVFL reports, which asio can't hand us because it doesn't read control messages
+    uint32_t meminfo[SK_MEMINFO_VARS] = {};
+    socklen_t length = sizeof(meminfo);
+    if (::getsockopt(m_socket.native_handle(), SOL_SOCKET, SO_MEMINFO, meminfo, &length) == 0 && length > SK_MEMINFO_DROPS * sizeof(uint32_t))
+        return meminfo[SK_MEMINFO_DROPS];
+#endif
+
+    return 0;
+}
+
+size_t SocketUDP::GetSendBlocked() {
+    return m_sendBlocked.load();
+}
+
+bool SocketUDP::SetBufferSizes(size_t receive, size_t send) {
+    if (receive > 0) m_receiveBufferSize = receive;
+    if (send > 0) m_sendBufferSize = send;
+
+    // if not bound yet, Bind() takes care of it
+    return !m_socket.is_open() || ApplyBufferSizes();
+}
+
+void SocketUDP::GetBufferSizes(size_t& receive, size_t& send) const {
+    asio::error_code ec;
+    asio::socket_base::receive_buffer_size receiveSize;
+    asio::socket_base::send_buffer_size sendSize;
+    m_socket.get_option(receiveSize, ec);
+    m_socket.get_option(sendSize, ec);
+
+    receive = ec ? 0 : static_cast<size_t>(receiveSize.value());
+    send = ec ? 0 : static_cast<size_t>(sendSize.value());
+}
+
+bool SocketUDP::GetDontFragment() const {
+    return m_dontFragment;
+}
+
 bool SocketUDP::Resolve(const std::string& hostname, uint16_t port, RemoteAddress& output) {
     // pick the desired IP version
     const auto protocol = GetAsioProtocol();
 
     // perform hostname resolution
     asio::error_code ec;
-    udp::resolver resolver(m_context);
+    udp::resolver resolver(*m_context);
     udp::resolver::iterator it = resolver.resolve(protocol, hostname, std::to_string(port), ec);
 
     // socket error?
@@ -122,7 +335,30 @@ bool SocketUDP::Resolve(const std::string& hostname, uint16_t port, RemoteAddres
 }
 
 void SocketUDP::BeginWrite(const RemoteAddress& addr, const uint8_t* data, size_t datalen, SocketWriteCallback_t callback) {
-    m_sending.store(true);
+    // writes for different remotes may be dispatched from several worker threads at once
+    WIREFOX_LOCK_GUARD(m_writeLock);
+
+    // once unbound, nothing may be posted that references this socket anymore, see Unbind()
+    if (!m_socket.is_open()) return;
+    m_sending.fetch_add(1);
+
+    // send right away if the kernel has room, like asio would, but note when it doesn't
+    asio::error_code ec;
+    const size_t sent = m_socket.send_to(asio::buffer(data, datalen), addr.endpoint_udp, 0, ec);
+    if (ec != asio::error::would_block) {
+        // a datagram too big to be sent is lost, like one too big for a router on the way; that's not a socket error
+        const bool failed = ec && ec != asio::error::message_size;
+        m_context->post([this, callback, failed, sent]() {
+            m_sending.fetch_sub(1);
+
+            assert(callback);
+            callback(failed, sent);
+        });
+        return;
+    }
+
+    // the send buffer is full, so wait until there's room
+    m_sendBlocked.fetch_add(1);
     m_socket.async_send_to(asio::buffer(data, datalen),
         addr.endpoint_udp,
         [&, callback](const asio::error_code& error, size_t bytes_transferred) -> void {
@@ -131,19 +367,116 @@ void SocketUDP::BeginWrite(const RemoteAddress& addr, const uint8_t* data, size_
                 std::cerr << "ERROR IN ASIO: " << error << " --> " << error.message() << std::endl;
 #endif
 
-            m_sending.store(false);
+            m_sending.fetch_sub(1);
 
             assert(callback);
-            callback(static_cast<bool>(error), bytes_transferred);
+            callback(error && error != asio::error::message_size, bytes_transferred);
         }
     );
 }
 
+void SocketUDP::BeginWriteBatch(const RemoteAddress& addr, const std::vector<WriteBuffer>& datagrams, SocketWriteCallback_t callback) {
+#ifdef WIREFOX_UDP_OFFLOAD
+    if (datagrams.size() > 1 && m_sendSegmentation) {
+        // hand as many datagrams to the kernel at once as it can segment
+        size_t first = 0;
+        size_t sent = 0;
+        int error = 0;
+        {
+            // Unbind() closes the descriptor under this lock, so hold it for as long as sendmsg() uses the descriptor
+            WIREFOX_LOCK_GUARD(m_writeLock);
+
+            // once unbound, nothing may be posted that references this socket anymore, see Unbind()
+            if (!m_socket.is_open()) return;
+            m_sending.fetch_add(1);
+
+            while (first < datagrams.size()) {
+                const size_t count = m_sendSegmentation ? GetSegmentCount(datagrams, first) : 1;
+                const ssize_t result = SendSegments(m_socket.native_handle(), addr.endpoint_udp, &datagrams[first], count);
+                if (result >= 0) {
+                    sent += static_cast<size_t>(result);
+                    first += count;
+                    continue;
+                }
+
+                error = errno;
+                if (error == EINTR) continue;
+
+                // like BeginWrite(), skip over datagrams that are too big to be sent
+                if (error == EMSGSIZE) {
+                    first += count;
+                    continue;
+                }
+
+                // the kernel or the network device can't segment, so send the datagrams one by one from now on
+                if (count > 1 && (error == EINVAL || error == EIO || error == ENOPROTOOPT || error == EOPNOTSUPP)) {
+                    m_sendSegmentation = false;
+                    continue;
+                }
+
+                break;
+            }
+        }
+
+        if (first < datagrams.size() && (error == EAGAIN || error == EWOULDBLOCK)) {
+            // the send buffer is full, so leave the rest to the asio path, which waits for room
+            std::vector<WriteBuffer> rest(datagrams.begin() + first, datagrams.end());
+            Socket::BeginWriteBatch(addr, rest, [sent, callback = std::move(callback)](bool failed, size_t transferred) {
+                callback(failed, sent + transferred);
+            });
+            m_sending.fetch_sub(1);
+            return;
+        }
+
+        const bool failed = first < datagrams.size();
+        m_context->post([this, failed, sent, callback = std::move(callback)]() {
+            m_sending.fetch_sub(1);
+            callback(failed, sent);
+        });
+        return;
+    }
+#endif
+
+    Socket::BeginWriteBatch(addr, datagrams, std::move(callback));
+}
+
 void SocketUDP::BeginRead(SocketReadCallback_t callback) {
-    m_reading.store(true);
-    m_socket.async_receive_from(asio::buffer(m_readbuf, cfg::PACKETQUEUE_IN_LEN),
-        m_readsender, // will be filled in with the sender address of the incoming datagram
-        [&, callback](const asio::error_code& error, size_t bytes_transferred) -> void {
+    assert(callback);
+
+    // like BeginWrite(), do nothing once unbound. the reads count as pending before that is checked, so Unbind() either
+    // waits for them or they are never posted
+    m_reading.store(m_receiveCoalescing ? 1 : m_readsenders.size());
+    if (!m_socket.is_open()) {
+        m_reading.store(0);
+        return;
+    }
+
+    m_readCallback = std::move(callback);
+
+#ifdef WIREFOX_UDP_OFFLOAD
+    // a coalesced read may hold many datagrams, so a single one takes a burst out of the kernel
+    if (m_receiveCoalescing) {
+        m_context->post([this] {
+            PostCoalescedRead();
+        });
+        return;
+    }
+#endif
+
+    // keep several reads posted. once the socket is readable, asio completes as many of them as there are datagrams
+    // waiting before it runs any of the handlers, so a burst is drained from the kernel in one go
+    m_context->post([this] {
+        for (size_t i = 0; i < m_readsenders.size(); i++)
+            PostRead(i);
+    });
+}
+
+void SocketUDP::PostRead(size_t index) {
+    // every read gets a fresh buffer, because Packets from the previous datagram may still be referencing the last one
+    auto buffer = m_readpool.Acquire();
+    m_socket.async_receive_from(asio::buffer(buffer.get(), m_readpool.GetBlockSize()),
+        m_readsenders[index], // will be filled in with the sender address of the incoming datagram
+        [this, index, buffer](const asio::error_code& error, size_t bytes_transferred) -> void {
 #if _DEBUG
             if (error)
                 std::cerr << "ERROR IN ASIO: " << error << " --> " << error.message() << std::endl;
@@ -151,27 +484,122 @@ void SocketUDP::BeginRead(SocketReadCallback_t callback) {
 
             // wrap the UDP endpoint in a RemoteAddress, to help somewhat conceal the ASIO implementation detail
             RemoteAddress addr;
-            addr.endpoint_udp = m_readsender;
+            addr.endpoint_udp = m_readsenders[index];
+
+            // restart this read before processing the datagram, it has a buffer of its own
+            const bool restart = !error && IsOpenAndReady();
+            if (restart)
+                PostRead(index);
 
             // pass the read data to the subscriber (probably PacketQueue)
-            assert(callback);
-            callback(static_cast<bool>(error), addr, m_readbuf, bytes_transferred);
+            m_readCallback(static_cast<bool>(error), addr, buffer, bytes_transferred);
 
-            // automatically and immediately restart the read cycle using the same callback
-            if (!error && IsOpenAndReady())
-                BeginRead(callback);
-            else
-                m_reading.store(false);
+            if (!restart)
+                m_reading.fetch_sub(1);
         }
     );
 }
 
+void SocketUDP::PostCoalescedRead() {
+    m_socket.async_wait(udp::socket::wait_read, [this](const asio::error_code& error) -> void {
+        // drain the kernel's queue, up to as many reads as would otherwise be posted at once
+        bool failed = static_cast<bool>(error);
+        for (size_t i = 0; !failed && i < m_readsenders.size(); i++)
+            if (!ReadCoalesced(failed)) break;
+
+        {
+            // shutting the socket down wakes this wait while Unbind() is still closing it on another thread, and asio
+            // doesn't allow starting the next one at the same time
+            WIREFOX_LOCK_GUARD(m_writeLock);
+            if (!failed && IsOpenAndReady()) {
+                PostCoalescedRead();
+                return;
+            }
+        }
+
+        // like PostRead(), stop reading after an error
+        m_readCallback(true, RemoteAddress(), nullptr, 0);
+        m_reading.fetch_sub(1);
+    });
+}
+
+bool SocketUDP::ReadCoalesced(bool& failed) {
+#ifdef WIREFOX_UDP_OFFLOAD
+    // the first datagram goes into a buffer from the pool, like with PostRead(). any others overflow into m_coalesced
+    auto buffer = m_readpool.Acquire();
+    const size_t blockSize = m_readpool.GetBlockSize();
+    iovec iov[2];
+    iov[0].iov_base = buffer.get();
+    iov[0].iov_len = blockSize;
+    iov[1].iov_base = m_coalesced.data();
+    iov[1].iov_len = m_coalesced.size();
+
+    udp::endpoint sender;
+    alignas(cmsghdr) uint8_t control[CMSG_SPACE(sizeof(int))];
+    msghdr msg = {};
+    msg.msg_name = sender.data();
+    msg.msg_namelen = static_cast<socklen_t>(sender.capacity());
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    const ssize_t result = ::recvmsg(m_socket.native_handle(), &msg, 0);
+    if (result < 0) {
+        failed = errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+        return false;
+    }
+
+    RemoteAddress addr;
+    sender.resize(msg.msg_namelen);
+    addr.endpoint_udp = sender;
+
+    // if the kernel coalesced several datagrams, it tells us how long each of them is (the last may be shorter)
+    const size_t total = static_cast<size_t>(result);
+    size_t segment = total;
+    for (auto* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int size;
+            std::memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+            if (size > 0) segment = static_cast<size_t>(size);
+        }
+    }
+
+    // copy the other datagrams into buffers of their own, before the subscriber gets to the first one: it may decrypt
+    // that in place, overwriting the start of the second
+    m_segments.clear();
+    m_segments.emplace_back(buffer, std::min(segment, blockSize));
+    for (size_t offset = segment; offset < total; offset += segment) {
+        const size_t length = std::min({ segment, total - offset, blockSize });
+        auto copy = m_readpool.Acquire();
+
+        const size_t head = offset < blockSize ? std::min(length, blockSize - offset) : 0;
+        if (head > 0)
+            std::memcpy(copy.get(), buffer.get() + offset, head);
+        if (head < length)
+            std::memcpy(copy.get() + head, m_coalesced.data() + (offset + head - blockSize), length - head);
+
+        m_segments.emplace_back(std::move(copy), length);
+    }
+
+    // pass the read data to the subscriber (probably PacketQueue)
+    for (auto& entry : m_segments)
+        m_readCallback(false, addr, entry.first, entry.second);
+
+    m_segments.clear();
+    return true;
+#else
+    failed = true;
+    return false;
+#endif
+}
+
 bool SocketUDP::IsReadPending() const {
-    return m_reading.load();
+    return m_reading.load() > 0;
 }
 
 bool SocketUDP::IsWritePending() const {
-    return m_sending.load();
+    return m_sending.load() > 0;
 }
 
 Socket::SocketState SocketUDP::GetState() const {
@@ -204,11 +632,41 @@ uint32_t SocketUDP::Ntohl(uint32_t val) {
 
 void SocketUDP::ThreadWorker() {
     while (!m_socketThreadAbort) {
-        if (m_context.stopped())
-            m_context.restart();
+        if (m_context->stopped())
+            m_context->restart();
+
+        m_context->run();
+    }
+}
+
+bool SocketUDP::ApplyBufferSizes() {
+    bool ok = true;
+    asio::error_code ec;
 
-        m_context.run();
+    if (m_receiveBufferSize > 0) {
+        const int size = static_cast<int>(std::min<size_t>(m_receiveBufferSize, std::numeric_limits<int>::max()));
+#ifdef SO_RCVBUFFORCE
+        // a privileged process may exceed the system-wide limit, which is rather low on Linux by default
+        if (::setsockopt(m_socket.native_handle(), SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) != 0)
+#endif
+        {
+            m_socket.set_option(asio::socket_base::receive_buffer_size(size), ec);
+            ok = ok && !ec;
+        }
     }
+
+    if (m_sendBufferSize > 0) {
+        const int size = static_cast<int>(std::min<size_t>(m_sendBufferSize, std::numeric_limits<int>::max()));
+#ifdef SO_SNDBUFFORCE
+        if (::setsockopt(m_socket.native_handle(), SOL_SOCKET, SO_SNDBUFFORCE, &size, sizeof(size)) != 0)
+#endif
+        {
+            m_socket.set_option(asio::socket_base::send_buffer_size(size), ec);
+            ok = ok && !ec;
+        }
+    }
+
+    return ok;
 }
 
 udp SocketUDP::GetAsioProtocol() const {
@@ -23,21 +23,39 @@ namespace wirefox {
             : public Socket
             , public std::enable_shared_from_this<SocketUDP> {
         protected:
-            SocketUDP();
+            SocketUDP(std::shared_ptr<asio::io_context> context, bool ownThread);
 
         public:
             /// Constructs and initializes a new SocketUDP instance. Use this (as \p cfg::DefaultSocket::Create() ) rather than
             /// calling the constructor (or operator new) manually.
             static std::shared_ptr<Socket> Create();
 
+            /**
+             * \brief Constructs a SocketUDP that does its I/O on a shared io_context, rather than on a thread of its own.
+             *
+             * Lets a process host many sockets without a thread for each. The caller must keep running \p context on
+             * exactly one thread for as long as the socket is bound, and must not unbind the socket from that thread.
+             *
+             * \param[in]   context     The io_context that runs this socket's handlers.
+             */
+            static std::shared_ptr<Socket> Create(std::shared_ptr<asio::io_context> context);
+
             ~SocketUDP();
 
             ConnectAttemptResult    Connect(const std::string& host, unsigned short port, SocketConnectCallback_t callback) override;
             void                    Disconnect() override;
             void                    Unbind() override;
             bool                    Bind(SocketProtocol family, unsigned short port) override;
+            bool                    SetReusePort(bool enabled) override;
+            uint16_t                GetLocalPort() const override;
+            size_t                  GetReceiveDrops() override;
+            size_t                  GetSendBlocked() override;
+            bool                    SetBufferSizes(size_t receive, size_t send) override;
+            void                    GetBufferSizes(size_t& receive, size_t& send) const override;
+            bool                    GetDontFragment() const override;
             bool                    Resolve(const std::string& hostname, uint16_t port, RemoteAddress& output) override;
             void                    BeginWrite(const RemoteAddress& addr, const uint8_t* data, size_t datalen, SocketWriteCallback_t callback) override;
+            void                    BeginWriteBatch(const RemoteAddress& addr, const std::vector<WriteBuffer>& datagrams, SocketWriteCallback_t callback) override;
             void                    BeginRead(SocketReadCallback_t callback) override;
             bool                    IsReadPending() const override;
             bool                    IsWritePending() const override;
@@ -54,20 +72,36 @@ namespace wirefox {
 
         private:
             void                    ThreadWorker();
+            void                    PostRead(size_t index);
+            void                    PostCoalescedRead();
+            bool                    ReadCoalesced(bool& failed);
+            bool                    ApplyBufferSizes();
             asio::ip::udp           GetAsioProtocol() const;
 
             SocketState             m_state;
             SocketProtocol          m_family;
+            bool                    m_reusePort;
+            size_t                  m_receiveBufferSize;
+            size_t                  m_sendBufferSize;
 
-            asio::io_context        m_context;
+            std::shared_ptr<asio::io_context> m_context;
+            bool                    m_ownThread;            // whether m_context is ours, and run by m_socketThread
             asio::ip::udp::socket   m_socket;
             std::thread             m_socketThread;
             std::atomic_bool        m_socketThreadAbort;
-            std::atomic_bool        m_reading;
-            std::atomic_bool        m_sending;
-
-            uint8_t                 m_readbuf[cfg::PACKETQUEUE_IN_LEN];
-            asio::ip::udp::endpoint m_readsender;
+            std::atomic<size_t>     m_reading;
+            std::atomic<size_t>     m_sending;
+            std::atomic<size_t>     m_sendBlocked;
+            std::atomic_bool        m_sendSegmentation;     // whether the kernel accepts batches of datagrams in one buffer
+            bool                    m_receiveCoalescing;    // whether the kernel may hand us several datagrams in one buffer
+            bool                    m_dontFragment;         // whether datagrams are sent with the don't-fragment bit set
+            cfg::LockableMutex      m_writeLock;
+
+            SocketReadCallback_t    m_readCallback;
+            BufferPool              m_readpool;
+            std::vector<asio::ip::udp::endpoint> m_readsenders;    // one for each posted read
+            std::vector<uint8_t>    m_coalesced;            // receives what doesn't fit in the first buffer of a coalesced read
+            std::vector<std::pair<BufferPool::Handle, size_t>> m_segments;
         };
 
         /// \endcond
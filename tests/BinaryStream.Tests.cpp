@@ -19,6 +19,32 @@ TEST_CASE("BinaryStream read-only wrapper", "[BinaryStream]") {
     REQUIRE(s.ReadByte() == 'E');
 }
 
+TEST_CASE("BinaryStream yields its buffer", "[BinaryStream]") {
+    wirefox::BinaryStream s;
+    s.WriteInt32(1234);
+
+    // the caller owns a plain heap buffer, which std::unique_ptr<uint8_t[]> frees with delete[]
+    size_t length = 0;
+    std::unique_ptr<uint8_t[]> buffer = s.ReleaseBuffer(&length);
+    REQUIRE(length == sizeof(int32_t));
+    REQUIRE(s.GetBuffer() == nullptr);
+    REQUIRE(s.GetLength() == 0);
+
+    wirefox::BinaryStream copy(buffer.get(), length);
+    REQUIRE(copy.ReadInt32() == 1234);
+}
+
+TEST_CASE("BinaryStream detects reads past the end of a short stream", "[BinaryStream]") {
+    const uint8_t foo[] = {1, 2, 3};
+    wirefox::BinaryStream s(foo, sizeof foo, wirefox::BinaryStream::WrapMode::READONLY);
+    REQUIRE(!s.IsEOF(3));
+    REQUIRE(s.IsEOF(4));
+    REQUIRE(s.IsEOF(100));
+
+    wirefox::BinaryStream empty(0);
+    REQUIRE(empty.IsEOF());
+}
+
 TEST_CASE("BinaryStream concatenation", "[BinaryStream]") {
     wirefox::BinaryStream a, b, c;
     a.WriteInt32(1);
@@ -94,3 +120,17 @@ TEST_CASE("BinaryStream endianness conversion", "[BinaryStream]") {
         REQUIRE(*buffer == 0x3930000000000000);
     }
 }
+
+TEST_CASE("BinaryStream forced seek past the end", "[BinaryStream]") {
+    // the stream may have room beyond its length already, which must not keep it from being extended
+    wirefox::BinaryStream s(64);
+    s.WriteInt32(1);
+
+    s.SeekForce(32);
+    REQUIRE(s.GetPosition() == 32);
+    REQUIRE(s.GetLength() == 32);
+
+    s.SeekForce(8);
+    REQUIRE(s.GetPosition() == 8);
+    REQUIRE(s.GetLength() == 32);
+}
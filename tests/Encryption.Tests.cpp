@@ -0,0 +1,106 @@
+#include <catch2/catch.hpp>
+#include "PCH.h"
+
+#ifdef WIREFOX_ENABLE_ENCRYPTION
+#include "EncryptionLayerSodium.h"
+
+using namespace wirefox::detail;
+
+namespace {
+
+    using Cipher = EncryptionLayerSodium::Cipher;
+
+    /// Completes a key exchange between two layers, restricted to a single cipher. Returns false if it is unavailable.
+    bool ConnectLayers(EncryptionLayerSodium& client, EncryptionLayerSodium& server, Cipher cipher) {
+        const auto mask = static_cast<uint8_t>(cipher);
+        if (!client.NegotiateCipher(mask & server.GetSupportedCiphers())) return false;
+        if (!server.NegotiateCipher(mask & client.GetSupportedCiphers())) return false;
+
+        auto clientKey = client.GetEphemeralPublicKey();
+        auto serverKey = server.GetEphemeralPublicKey();
+        return client.HandleKeyExchange(ConnectionOrigin::SELF, serverKey)
+            && server.HandleKeyExchange(ConnectionOrigin::REMOTE, clientKey);
+    }
+
+    constexpr PeerID SERVER_ID = 1;
+    constexpr PeerID CLIENT_ID = 2;
+
+    /// Sets up a session, and returns the ticket the server issues for it, the way the client keeps it.
+    BinaryStream IssueTicket(unsigned int age) {
+        EncryptionLayerSodium client, server;
+        REQUIRE(ConnectLayers(client, server, Cipher::CHACHA20_POLY1305));
+
+        BinaryStream ticket;
+        server.WriteTicket(SERVER_ID, CLIENT_ID, ticket, age);
+        ticket.SeekToBegin();
+        return client.ReadTicket(ticket);
+    }
+
+    /// Returns the request a reconnecting client sends to present a ticket.
+    BinaryStream MakeResumeRequest(const BinaryStream& ticket) {
+        EncryptionLayerSodium client;
+        BinaryStream request;
+        REQUIRE(client.BeginResume(ticket, request));
+        request.SeekToBegin();
+        return request;
+    }
+
+    /// Checks a request the way a server does before reserving a slot for its sender.
+    bool VerifyResumeRequest(const BinaryStream& request) {
+        BinaryStream instream(request);
+        return EncryptionLayerSodium::VerifyResumeRequest(SERVER_ID, CLIENT_ID, instream);
+    }
+
+    /// Lets a fresh server redeem a request. Returns false if it falls back to a full key exchange.
+    bool HandleResumeRequest(const BinaryStream& request) {
+        EncryptionLayerSodium server;
+        BinaryStream instream(request), reply;
+        return server.HandleResumeRequest(SERVER_ID, CLIENT_ID, instream, reply);
+    }
+
+}
+
+TEST_CASE("Counter nonces reject replayed datagrams", "[Encryption]") {
+    EncryptionLayerSodium client, server;
+    REQUIRE(ConnectLayers(client, server, Cipher::CHACHA20_POLY1305));
+
+    // lay out a datagram the way DatagramBuilder does: headroom, then the plaintext
+    BinaryStream datagram(EncryptionLayerSodium::GetHeadroom() + 64 + EncryptionLayerSodium::GetTailroom());
+    BinaryStream plaintext(0);
+    datagram.WriteZeroes(EncryptionLayerSodium::GetHeadroom() + 64);
+
+    const size_t unused = client.EncryptInPlace(datagram, 0);
+    const BinaryStream ciphertext(datagram.GetBuffer() + unused, datagram.GetLength() - unused);
+    CHECK(unused == EncryptionLayerSodium::GetHeadroom() - sizeof(uint32_t));
+
+    // decryption overwrites the buffer, so hand over a fresh copy of the same datagram every time
+    BinaryStream first(ciphertext), second(ciphertext);
+    CHECK(server.DecryptInPlace(first.GetWritableBuffer(), first.GetLength(), plaintext));
+    CHECK_FALSE(server.DecryptInPlace(second.GetWritableBuffer(), second.GetLength(), plaintext));
+    CHECK_FALSE(server.GetNeedsToBail());
+}
+
+TEST_CASE("Session tickets are refused if tampered with, expired or redeemed before", "[Encryption]") {
+    const auto ticket = IssueTicket(0);
+    REQUIRE_FALSE(ticket.IsEmpty());
+
+    // the ticket leads the request, starting with its nonce
+    auto tampered = MakeResumeRequest(ticket);
+    tampered.GetWritableBuffer()[0] ^= 1;
+    CHECK_FALSE(VerifyResumeRequest(tampered));
+    CHECK_FALSE(HandleResumeRequest(tampered));
+
+    const auto expired = MakeResumeRequest(IssueTicket(cfg::SESSION_TICKET_LIFETIME + 1));
+    CHECK_FALSE(VerifyResumeRequest(expired));
+    CHECK_FALSE(HandleResumeRequest(expired));
+
+    // a ticket is good for one resumption only, no matter who presents it
+    const auto request = MakeResumeRequest(ticket);
+    CHECK(VerifyResumeRequest(request));
+    CHECK(HandleResumeRequest(request));
+    CHECK_FALSE(VerifyResumeRequest(request));
+    CHECK_FALSE(HandleResumeRequest(request));
+    CHECK_FALSE(HandleResumeRequest(MakeResumeRequest(ticket)));
+}
+
+#endif
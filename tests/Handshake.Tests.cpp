@@ -0,0 +1,304 @@
+#include <catch2/catch.hpp>
+#include "PCH.h"
+#include "Peer.h"
+#include "RemotePeer.h"
+#include "DatagramHeader.h"
+#include "PacketHeader.h"
+#include "Handshaker.h"
+
+using namespace wirefox::detail;
+using asio::ip::udp;
+
+namespace {
+
+    constexpr uint16_t SERVER_PORT = 1342;
+
+    /// Wraps a handshake message the way PacketQueue wraps out-of-band packets.
+    BinaryStream WrapHandshakePart(BinaryStream&& part) {
+        const Packet packet(PacketCommand::CONNECT_ATTEMPT, std::move(part));
+        BinaryStream payload;
+        PacketHeader header;
+        header.length = static_cast<uint32_t>(packet.GetDatagramLength());
+        header.Serialize(payload);
+        packet.ToDatagram(payload);
+
+        BinaryStream datagram;
+        DatagramHeader datagramHeader;
+        datagramHeader.flag_data = true;
+        datagramHeader.dataLength = payload.GetLength();
+        datagramHeader.Serialize(datagram);
+        datagram.WriteBytes(payload);
+        return datagram;
+    }
+
+    /// Returns the first datagram a client with the PeerID of \p client sends when it starts connecting to \p server.
+    /// If \p client holds a session ticket for that address, it is used up and presented in the request.
+    BinaryStream MakeConnectRequest(Peer& client, const RemoteAddress& server = RemoteAddress()) {
+        // let a real Handshaker write the request, so it matches whatever the current protocol looks like
+        BinaryStream request;
+        RemotePeer dummy;
+        dummy.addr = server;
+        dummy.Setup(&client, ConnectionOrigin::SELF);
+        dummy.handshake->SetReplyHandler([&request](BinaryStream&& outstream) { request = std::move(outstream); });
+        dummy.handshake->Begin();
+
+        return WrapHandshakePart(std::move(request));
+    }
+
+    /// Returns what a reply to a connection request says: IN_PROGRESS if it hands out a cookie, otherwise the reason for rejection.
+    ConnectResult ReadConnectReply(Peer& client, const uint8_t* buffer, size_t length) {
+        BinaryStream datagram(buffer, length, BinaryStream::WrapMode::READONLY);
+        DatagramHeader datagramHeader;
+        PacketHeader header;
+        if (!datagramHeader.Deserialize(datagram) || !header.Deserialize(datagram))
+            return ConnectResult::INCOMPATIBLE_PROTOCOL;
+
+        // let a real Handshaker interpret it, on a dummy that has just sent a request
+        RemotePeer dummy;
+        dummy.Setup(&client, ConnectionOrigin::SELF);
+        dummy.handshake->SetReplyHandler([](BinaryStream&&) {});
+        dummy.handshake->Begin();
+        dummy.handshake->Handle(Packet::FromDatagram(0, datagram, header.length));
+        return dummy.handshake->IsDone() ? dummy.handshake->GetResult() : ConnectResult::IN_PROGRESS;
+    }
+
+    /// Waits up to \p seconds for a peer to post one of two notifications. Returns the one it posted, or USER_PACKET on timeout.
+    PacketCommand WaitFor(IPeer& peer, PacketCommand a, PacketCommand b, int seconds, PeerID& sender) {
+        const auto timeout = Time::Now() + Time::FromSeconds(seconds);
+        while (!Time::Elapsed(timeout)) {
+            while (auto packet = peer.Receive()) {
+                if (packet->GetCommand() == a || packet->GetCommand() == b) {
+                    sender = packet->GetSender();
+                    return packet->GetCommand();
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return PacketCommand::USER_PACKET;
+    }
+
+    /// Connects a client to the server and hangs up again. Returns false if connecting failed.
+    bool ConnectOnce(IPeer& client) {
+        REQUIRE(client.Connect("127.0.0.1", SERVER_PORT) == ConnectAttemptResult::OK);
+
+        PeerID server;
+        if (WaitFor(client, PacketCommand::NOTIFY_CONNECT_SUCCESS, PacketCommand::NOTIFY_CONNECT_FAILED, 10, server) != PacketCommand::NOTIFY_CONNECT_SUCCESS)
+            return false;
+
+        // hang up properly, so the slot is free for the next client
+        client.Disconnect(server);
+        WaitFor(client, PacketCommand::NOTIFY_DISCONNECTED, PacketCommand::NOTIFY_CONNECTION_LOST, 5, server);
+        return true;
+    }
+
+    /// Connects a fresh client to the server. Returns false if that failed.
+    bool ConnectOnce() {
+        auto client = IPeer::Factory::Create(1);
+        REQUIRE(client->Bind(SocketProtocol::IPv4, 0));
+        return ConnectOnce(*client);
+    }
+
+    /// Sends a connection request from a socket of its own, and returns what the reply says, as ReadConnectReply() does.
+    ConnectResult SendConnectRequest(Peer& client, const BinaryStream& request) {
+        asio::io_context context;
+        udp::socket socket(context, udp::endpoint(asio::ip::make_address_v4("127.0.0.1"), 0));
+        socket.send_to(asio::buffer(request.GetBuffer(), request.GetLength()), udp::endpoint(asio::ip::make_address_v4("127.0.0.1"), SERVER_PORT));
+
+        std::array<uint8_t, 1500> buffer;
+        const auto timeout = Time::Now() + Time::FromSeconds(2);
+        while (!Time::Elapsed(timeout)) {
+            asio::error_code ec;
+            if (socket.available(ec) > 0) {
+                udp::endpoint sender;
+                const size_t length = socket.receive_from(asio::buffer(buffer), sender, 0, ec);
+                if (!ec) return ReadConnectReply(client, buffer.data(), length);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        return ConnectResult::CONNECT_FAILED;
+    }
+
+    /// Counts the slots of a Peer that are reserved for a remote.
+    size_t CountActiveRemotes(Peer& peer) {
+        size_t count = 0;
+        for (size_t i = 1; i <= peer.GetMaximumPeers(); i++)
+            if (peer.GetRemoteByIndex(i).active)
+                count++;
+        return count;
+    }
+
+#ifdef __linux__
+    /// Sends connection requests from many loopback addresses that never answer, like an attacker spoofing its source.
+    class Flood {
+    public:
+        Flood(size_t addresses, size_t perSecond)
+            : m_abort(false) {
+            // every 127.x.y.z address routes to loopback on Linux, which gives plenty of distinct senders
+            for (size_t i = 0; i < addresses; i++) {
+                Peer spoofed(1);
+                m_requests.push_back(MakeConnectRequest(spoofed));
+
+                const auto ip = asio::ip::make_address_v4(0x7F000002 + static_cast<uint32_t>(i));
+                m_sockets.emplace_back(m_context, udp::endpoint(ip, 0));
+            }
+
+            m_thread = std::thread([this, perSecond]() {
+                const udp::endpoint server(asio::ip::make_address_v4("127.0.0.1"), SERVER_PORT);
+                constexpr size_t ticksPerSecond = 100;
+                size_t next = 0;
+
+                while (!m_abort) {
+                    for (size_t i = 0; i < perSecond / ticksPerSecond; i++, next++) {
+                        const auto& request = m_requests[next % m_requests.size()];
+                        asio::error_code ec;
+                        m_sockets[next % m_sockets.size()].send_to(asio::buffer(request.GetBuffer(), request.GetLength()), server, 0, ec);
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1000 / ticksPerSecond));
+                }
+            });
+        }
+
+        ~Flood() {
+            m_abort = true;
+            m_thread.join();
+        }
+
+    private:
+        asio::io_context        m_context;
+        std::vector<udp::socket> m_sockets;
+        std::vector<BinaryStream> m_requests;
+        std::thread             m_thread;
+        std::atomic_bool        m_abort;
+    };
+#endif
+
+}
+
+#ifdef __linux__
+TEST_CASE("Spoofed connection requests don't reserve slots", "[Handshake]") {
+    constexpr size_t attempts = 3;
+    constexpr size_t slots = 8;
+
+    Peer server(slots);
+    server.SetMaximumIncomingPeers(slots);
+    REQUIRE(server.Bind(SocketProtocol::IPv4, SERVER_PORT));
+
+    // far more requests than the server has slots, from senders that never answer its cookie
+    Flood flood(256, 5000);
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    CHECK(CountActiveRemotes(server) == 0);
+
+    for (size_t i = 0; i < attempts; i++) {
+        // all clients share one address, so pace them to stay under the server's per-address rate limit
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        CHECK(ConnectOnce());
+    }
+
+    // only the legitimate clients may ever have been given a slot
+    CHECK(CountActiveRemotes(server) <= attempts);
+}
+
+TEST_CASE("Connection requests are rate limited per address", "[Handshake]") {
+    constexpr size_t requests = 1000;
+
+    Peer server(4);
+    server.SetMaximumIncomingPeers(4);
+    REQUIRE(server.Bind(SocketProtocol::IPv4, SERVER_PORT));
+
+    Peer attacker(1);
+    const auto request = MakeConnectRequest(attacker);
+    asio::io_context context;
+    udp::socket socket(context, udp::endpoint(asio::ip::make_address_v4("127.0.0.2"), 0));
+    const udp::endpoint target(asio::ip::make_address_v4("127.0.0.1"), SERVER_PORT);
+
+    // send everything as fast as possible, reading replies in between so the socket buffer can't overflow
+    size_t cookies = 0, limited = 0, replies = 0;
+    std::array<uint8_t, 1500> buffer;
+    const auto readReplies = [&]() {
+        asio::error_code ec;
+        while (socket.available(ec) > 0) {
+            udp::endpoint sender;
+            const size_t length = socket.receive_from(asio::buffer(buffer), sender, 0, ec);
+            if (ec) break;
+
+            replies++;
+            const auto result = ReadConnectReply(attacker, buffer.data(), length);
+            if (result == ConnectResult::IN_PROGRESS)
+                cookies++;
+            else if (result == ConnectResult::IP_RATE_LIMITED)
+                limited++;
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < requests; i++) {
+        asio::error_code ec;
+        socket.send_to(asio::buffer(request.GetBuffer(), request.GetLength()), target, 0, ec);
+        readReplies();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    const auto timeout = Time::Now() + Time::FromSeconds(2);
+    while (replies < requests && !Time::Elapsed(timeout)) {
+        readReplies();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // past the burst, the source only gets the refill rate's worth of cookies; it's told once, then ignored
+    CHECK(cookies <= cfg::CONNECT_RATE_BURST + cfg::CONNECT_RATE_LIMIT * (1 + static_cast<size_t>(elapsed.count())));
+    CHECK(limited > 0);
+
+    // meanwhile, everyone else can still get in
+    CHECK(ConnectOnce());
+}
+#endif
+
+#ifdef WIREFOX_ENABLE_ENCRYPTION
+TEST_CASE("Replayed or tampered session tickets fall back to the full handshake", "[Handshake]") {
+    Peer server(4);
+    server.SetMaximumIncomingPeers(4);
+    server.SetEncryptionEnabled(true);
+    REQUIRE(server.Bind(SocketProtocol::IPv4, SERVER_PORT));
+
+    Peer client(1);
+    client.SetEncryptionEnabled(true);
+    REQUIRE(client.Bind(SocketProtocol::IPv4, 0));
+
+    // connect the long way first, which hands the client a ticket
+    REQUIRE(client.Connect("127.0.0.1", SERVER_PORT, nullptr) == ConnectAttemptResult::OK);
+    PeerID serverID;
+    REQUIRE(WaitFor(client, PacketCommand::NOTIFY_CONNECT_SUCCESS, PacketCommand::NOTIFY_CONNECT_FAILED, 10, serverID) == PacketCommand::NOTIFY_CONNECT_SUCCESS);
+    const RemoteAddress serverAddr = client.GetRemoteByID(serverID)->addr;
+    client.Disconnect(serverID, Time::FromMilliseconds(200));
+    WaitFor(client, PacketCommand::NOTIFY_DISCONNECTED, PacketCommand::NOTIFY_CONNECTION_LOST, 5, serverID);
+
+    const BinaryStream ticket = client.TakeResumeTicket(serverAddr);
+    REQUIRE_FALSE(ticket.IsEmpty());
+
+    // the client resumes its session, while an eavesdropper keeps a copy of the request that does so
+    client.SetResumeTicket(serverAddr, ticket);
+    const auto replayed = MakeConnectRequest(client, serverAddr);
+    client.SetResumeTicket(serverAddr, ticket);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(ConnectOnce(client));
+
+    // and tries it from an address of its own, where the server treats it like any request without a cookie
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    REQUIRE(CountActiveRemotes(server) == 0);
+    CHECK(SendConnectRequest(client, replayed) == ConnectResult::IN_PROGRESS);
+    CHECK(CountActiveRemotes(server) == 0);
+
+    // the client itself can still get in with a spent or damaged ticket, it just needs the full handshake
+    client.SetResumeTicket(serverAddr, ticket);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(ConnectOnce(client));
+
+    BinaryStream tampered(ticket);
+    tampered.GetWritableBuffer()[tampered.GetLength() - 1] ^= 1;
+    client.SetResumeTicket(serverAddr, tampered);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(ConnectOnce(client));
+}
+#endif
@@ -0,0 +1,52 @@
+#include <catch2/catch.hpp>
+#include <Wirefox.h>
+
+TEST_CASE("Packet copies share payload", "[Packet]") {
+    const uint8_t foo[] = {'E', 'x', 'a', 'm', 'p', 'l', 'e'};
+    wirefox::Packet a(wirefox::PacketCommand::USER_PACKET, foo, sizeof foo);
+    REQUIRE(a.GetBuffer() != foo);
+
+    wirefox::Packet b(a);
+    REQUIRE(b.GetBuffer() == a.GetBuffer());
+    REQUIRE(b.GetLength() == sizeof foo);
+
+    wirefox::Packet c(wirefox::PacketCommand::USER_PACKET, nullptr, 0);
+    c = b;
+    REQUIRE(c.GetBuffer() == a.GetBuffer());
+    REQUIRE(c.GetStream().ReadByte() == 'E');
+}
+
+TEST_CASE("Packet takes ownership of moved BinaryStream", "[Packet]") {
+    wirefox::BinaryStream s;
+    s.WriteInt32(1234);
+    const uint8_t* original = s.GetBuffer();
+
+    wirefox::Packet p(wirefox::PacketCommand::USER_PACKET, std::move(s));
+    REQUIRE(p.GetBuffer() == original);
+    REQUIRE(p.GetLength() == sizeof(uint32_t));
+    REQUIRE(p.GetStream().ReadInt32() == 1234);
+}
+
+TEST_CASE("Packet from datagram references shared buffer", "[Packet]") {
+    bool released = false;
+    std::shared_ptr<const uint8_t> backing(new uint8_t[6] {0xFF, 0xFF, 200, 'a', 'b', 'c'},
+        [&released](const uint8_t* buffer) { released = true; delete[] buffer; });
+
+    wirefox::BinaryStream instream(backing.get(), 6, wirefox::BinaryStream::WrapMode::READONLY);
+    instream.Skip(2);
+    auto p = wirefox::Packet::FromDatagram(0, instream, 4, backing);
+    REQUIRE(p.GetCommand() == wirefox::PacketCommand(200));
+    REQUIRE(p.GetLength() == 3);
+    REQUIRE(p.GetBuffer() == backing.get() + 3);
+    REQUIRE(instream.IsEOF());
+
+    // the buffer must stay alive for as long as any Packet references it
+    backing.reset();
+    wirefox::Packet copy(p);
+    p = wirefox::Packet(wirefox::PacketCommand::USER_PACKET, nullptr, 0);
+    REQUIRE_FALSE(released);
+    REQUIRE(copy.GetStream().ReadByte() == 'a');
+
+    copy = p;
+    REQUIRE(released);
+}
@@ -1,9 +1,207 @@
 #include <catch2/catch.hpp>
 #include <Wirefox.h>
+#include <asio.hpp>
 
 /// Connect target should be easily editable
 static constexpr const char* LOCALHOST = "127.0.0.1";
 
+/**
+ * Connects two peers that use the given socket backend, and sends enough reliable packets from one to the other to
+ * need several reads and writes in flight at once. Each packet carries \p padding extra bytes.
+ *
+ * Returns false, without testing anything, if the backend is not available and the peers use the default socket.
+ */
+static bool CheckBackendConnectivity(wirefox::SocketBackend backend, uint16_t port, size_t padding) {
+    auto a = wirefox::IPeer::Factory::Create(1, backend);
+    auto b = wirefox::IPeer::Factory::Create(1, backend);
+    if (a->GetSocketBackend() == wirefox::SocketBackend::DEFAULT)
+        return false;
+    REQUIRE(a->GetSocketBackend() == backend);
+    REQUIRE(b->GetSocketBackend() == backend);
+
+    REQUIRE(a->Bind(wirefox::SocketProtocol::IPv4, port));
+    REQUIRE(b->Bind(wirefox::SocketProtocol::IPv4, 0));
+    a->SetMaximumIncomingPeers(1);
+    REQUIRE(b->Connect(LOCALHOST, port) == wirefox::ConnectAttemptResult::OK);
+
+    auto timeout = wirefox::Time::Now() + wirefox::Time::FromSeconds(5);
+    while (true) {
+        if (wirefox::Time::Elapsed(timeout)) {
+            FAIL("Connection timed out");
+            return true;
+        }
+
+        auto packet = b->Receive();
+        if (packet) {
+            REQUIRE(packet->GetCommand() == wirefox::PacketCommand::NOTIFY_CONNECT_SUCCESS);
+            REQUIRE(packet->GetSender() == a->GetMyPeerID());
+            break;
+        }
+    }
+
+    constexpr int COUNT = 200;
+    for (int i = 0; i < COUNT; i++) {
+        wirefox::BinaryStream payload;
+        payload.WriteInt32(i);
+        payload.WriteZeroes(padding);
+        wirefox::Packet message(wirefox::PacketCommand::USER_PACKET, std::move(payload));
+        b->Send(message, a->GetMyPeerID(), wirefox::PacketOptions::RELIABLE);
+    }
+
+    std::vector<bool> seen(COUNT, false);
+    int received = 0;
+    timeout = wirefox::Time::Now() + wirefox::Time::FromSeconds(5);
+    while (received < COUNT) {
+        if (wirefox::Time::Elapsed(timeout)) {
+            FAIL("Data timed out");
+            return true;
+        }
+
+        auto packet = a->Receive();
+        if (packet && packet->GetCommand() == wirefox::PacketCommand::USER_PACKET) {
+            wirefox::BinaryStream instream = packet->GetStream();
+            const int index = instream.ReadInt32();
+            REQUIRE(index >= 0);
+            REQUIRE(index < COUNT);
+            REQUIRE(!seen[index]);
+            seen[index] = true;
+            received++;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Forwards datagrams between one client and a server, like a NAT in front of the client. Rebind() moves the server side
+ * of the relay to a new port, like a NAT that has forgotten its mapping for the client.
+ */
+class Relay {
+public:
+    Relay(uint16_t port, uint16_t serverPort)
+        : m_front(m_context, asio::ip::udp::endpoint(asio::ip::make_address_v4(LOCALHOST), port))
+        , m_server(asio::ip::make_address_v4(LOCALHOST), serverPort)
+        , m_rebind(false)
+        , m_abort(false) {
+        m_front.non_blocking(true);
+        OpenBack();
+        m_thread = std::thread([this]() { Run(); });
+    }
+
+    ~Relay() {
+        m_abort = true;
+        m_thread.join();
+    }
+
+    /// From now on, the server sees the client at a new address. Anything the server sends to the old one is lost.
+    void Rebind() {
+        m_rebind = true;
+    }
+
+private:
+    void OpenBack() {
+        m_back = std::make_unique<asio::ip::udp::socket>(m_context, asio::ip::udp::endpoint(asio::ip::make_address_v4(LOCALHOST), 0));
+        m_back->non_blocking(true);
+    }
+
+    void Run() {
+        std::array<uint8_t, 2048> buffer;
+        while (!m_abort) {
+            if (m_rebind.exchange(false))
+                OpenBack();
+
+            asio::error_code ec;
+            asio::ip::udp::endpoint sender;
+            size_t length;
+            bool idle = true;
+
+            while (length = m_front.receive_from(asio::buffer(buffer), sender, 0, ec), !ec) {
+                m_client = sender;
+                m_back->send_to(asio::buffer(buffer.data(), length), m_server, 0, ec);
+                idle = false;
+            }
+            while (length = m_back->receive_from(asio::buffer(buffer), sender, 0, ec), !ec) {
+                m_front.send_to(asio::buffer(buffer.data(), length), m_client, 0, ec);
+                idle = false;
+            }
+
+            if (idle)
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    asio::io_context        m_context;
+    asio::ip::udp::socket   m_front;
+    std::unique_ptr<asio::ip::udp::socket> m_back;
+    asio::ip::udp::endpoint m_client;
+    asio::ip::udp::endpoint m_server;
+    std::thread             m_thread;
+    std::atomic_bool        m_rebind;
+    std::atomic_bool        m_abort;
+};
+
+/**
+ * Sends a reliable packet from one peer to another. Returns false if it didn't arrive within a few seconds, or if the
+ * receiver lost its connection instead.
+ */
+static bool SendAndReceive(wirefox::IPeer& from, wirefox::IPeer& to) {
+    const uint8_t data[] = {1, 2, 3, 4};
+    from.Send(wirefox::Packet(wirefox::PacketCommand::USER_PACKET, data, sizeof data), to.GetMyPeerID(), wirefox::PacketOptions::RELIABLE);
+
+    const auto timeout = wirefox::Time::Now() + wirefox::Time::FromSeconds(5);
+    while (!wirefox::Time::Elapsed(timeout)) {
+        while (auto packet = to.Receive()) {
+            if (packet->GetCommand() == wirefox::PacketCommand::USER_PACKET)
+                return true;
+            if (packet->GetCommand() == wirefox::PacketCommand::NOTIFY_CONNECTION_LOST || packet->GetCommand() == wirefox::PacketCommand::NOTIFY_DISCONNECTED)
+                return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    return false;
+}
+
+/**
+ * Connects a client to a server through a Relay, and exchanges a packet each way. Then rebinds the relay, and returns
+ * whether the server can still reach the client after the client has sent a packet from its new address.
+ */
+static bool CheckReachableAfterRebind(bool encrypted, uint16_t serverPort, uint16_t relayPort) {
+    auto server = wirefox::IPeer::Factory::Create(1);
+    server->SetMaximumIncomingPeers(1);
+    server->SetEncryptionEnabled(encrypted);
+    REQUIRE(server->Bind(wirefox::SocketProtocol::IPv4, serverPort));
+
+    // the client only knows the relay, the server only ever sees the relay's address
+    Relay relay(relayPort, serverPort);
+    auto client = wirefox::IPeer::Factory::Create(1);
+    client->SetEncryptionEnabled(encrypted);
+    REQUIRE(client->Bind(wirefox::SocketProtocol::IPv4, 0));
+    REQUIRE(client->Connect(LOCALHOST, relayPort) == wirefox::ConnectAttemptResult::OK);
+
+    const auto timeout = wirefox::Time::Now() + wirefox::Time::FromSeconds(10);
+    while (true) {
+        if (wirefox::Time::Elapsed(timeout)) {
+            FAIL("Connection timed out");
+            return false;
+        }
+
+        auto packet = client->Receive();
+        if (packet) {
+            REQUIRE(packet->GetCommand() == wirefox::PacketCommand::NOTIFY_CONNECT_SUCCESS);
+            break;
+        }
+    }
+
+    REQUIRE(SendAndReceive(*client, *server));
+    REQUIRE(SendAndReceive(*server, *client));
+
+    // the connection ID in front of the client's datagrams still leads the server to the right remote
+    relay.Rebind();
+    REQUIRE(SendAndReceive(*client, *server));
+    return SendAndReceive(*server, *client);
+}
+
 TEST_CASE("Peer can bind to exact port", "[Peer]") {
     auto p = wirefox::IPeer::Factory::Create();
     bool success = p->Bind(wirefox::SocketProtocol::IPv4, 1337);
@@ -30,6 +228,30 @@ TEST_CASE("Peer cannot double-bind to port", "[Peer]") {
     }
 }
 
+TEST_CASE("Peer applies socket buffer sizes", "[Peer]") {
+    auto a = wirefox::IPeer::Factory::Create();
+    auto b = wirefox::IPeer::Factory::Create();
+    a->SetSocketBufferSizes(1 << 20, 1 << 20);
+    REQUIRE(a->Bind(wirefox::SocketProtocol::IPv4, 0));
+    REQUIRE(b->Bind(wirefox::SocketProtocol::IPv4, 0));
+
+    // the system may cap or round the sizes, but never below its own default
+    size_t receive, send, defaultReceive, defaultSend;
+    a->GetSocketBufferSizes(receive, send);
+    b->GetSocketBufferSizes(defaultReceive, defaultSend);
+    REQUIRE(receive > 0);
+    REQUIRE(send > 0);
+    REQUIRE(receive >= defaultReceive);
+    REQUIRE(send >= defaultSend);
+
+    // zero leaves a size as it is
+    a->SetSocketBufferSizes(0, 0);
+    size_t receiveAfter, sendAfter;
+    a->GetSocketBufferSizes(receiveAfter, sendAfter);
+    REQUIRE(receiveAfter == receive);
+    REQUIRE(sendAfter == send);
+}
+
 TEST_CASE("Peer connectivity", "[Peer]") {
     auto a = wirefox::IPeer::Factory::Create(1);
     auto b = wirefox::IPeer::Factory::Create(1);
@@ -90,3 +312,174 @@ TEST_CASE("Peer connectivity", "[Peer]") {
         }
     }
 }
+
+TEST_CASE("Sharded peer connectivity", "[Peer]") {
+    constexpr size_t CLIENTS = 8;
+
+    auto server = wirefox::IPeer::Factory::CreateSharded(CLIENTS, 4);
+    REQUIRE(server->Bind(wirefox::SocketProtocol::IPv4, 1338));
+    server->SetMaximumIncomingPeers(CLIENTS);
+    REQUIRE(server->GetMaximumIncomingPeers() == CLIENTS);
+    REQUIRE(server->Connect(LOCALHOST, 1337) == wirefox::ConnectAttemptResult::INVALID_STATE);
+
+    std::vector<std::unique_ptr<wirefox::IPeer>> clients;
+    for (size_t i = 0; i < CLIENTS; i++) {
+        clients.push_back(wirefox::IPeer::Factory::Create(1));
+        REQUIRE(clients.back()->Bind(wirefox::SocketProtocol::IPv4, 0));
+        REQUIRE(clients.back()->Connect(LOCALHOST, 1338) == wirefox::ConnectAttemptResult::OK);
+    }
+
+    // every client should reach the server, whichever shard it lands on, and all shards present the same PeerID
+    size_t connected = 0;
+    auto timeout = wirefox::Time::Now() + wirefox::Time::FromSeconds(5);
+    for (auto& client : clients) {
+        while (true) {
+            if (wirefox::Time::Elapsed(timeout)) {
+                FAIL("Connection timed out");
+                return;
+            }
+
+            auto packet = client->Receive();
+            if (packet) {
+                REQUIRE(packet->GetCommand() == wirefox::PacketCommand::NOTIFY_CONNECT_SUCCESS);
+                REQUIRE(packet->GetSender() == server->GetMyPeerID());
+                connected++;
+                break;
+            }
+        }
+
+        wirefox::BinaryStream payload;
+        payload.WriteInt32(12345678);
+        wirefox::Packet message(wirefox::PacketCommand::USER_PACKET, std::move(payload));
+        client->Send(message, server->GetMyPeerID(), wirefox::PacketOptions::RELIABLE);
+    }
+    REQUIRE(connected == CLIENTS);
+
+    // the server receives data from all of them, and can answer each one through the shard that serves it
+    size_t received = 0;
+    timeout = wirefox::Time::Now() + wirefox::Time::FromSeconds(5);
+    while (received < CLIENTS) {
+        if (wirefox::Time::Elapsed(timeout)) {
+            FAIL("Data timed out");
+            return;
+        }
+
+        auto packet = server->Receive();
+        if (packet && packet->GetCommand() == wirefox::PacketCommand::USER_PACKET) {
+            wirefox::BinaryStream instream = packet->GetStream();
+            REQUIRE(instream.ReadInt32() == 12345678);
+            server->Send(*packet, packet->GetSender(), wirefox::PacketOptions::RELIABLE);
+            received++;
+        }
+    }
+
+    std::vector<wirefox::PeerID> peers;
+    server->GetAllConnectedPeers(peers);
+    REQUIRE(peers.size() == CLIENTS);
+
+    for (auto& client : clients) {
+        timeout = wirefox::Time::Now() + wirefox::Time::FromSeconds(5);
+        while (true) {
+            if (wirefox::Time::Elapsed(timeout)) {
+                FAIL("Reply timed out");
+                return;
+            }
+
+            auto packet = client->Receive();
+            if (packet && packet->GetCommand() == wirefox::PacketCommand::USER_PACKET)
+                break;
+        }
+    }
+}
+
+TEST_CASE("Peer connectivity with io_uring backend", "[Peer]") {
+    // the running kernel may not support io_uring, even if the library does
+    if (!CheckBackendConnectivity(wirefox::SocketBackend::IO_URING, 1339, 0))
+        WARN("io_uring is not available, skipping");
+}
+
+TEST_CASE("Peer connectivity with shared memory backend", "[Peer]") {
+    // large packets add up to more than fits in one ring at once, so the receiver has to keep up
+#ifdef WIREFOX_ENABLE_SHARED_MEMORY
+    REQUIRE(CheckBackendConnectivity(wirefox::SocketBackend::SHARED_MEMORY, 1341, 4000));
+#else
+    WARN("The shared memory backend is not available, skipping");
+#endif
+}
+
+TEST_CASE("Peer discovers the path MTU", "[Peer]") {
+    auto a = wirefox::IPeer::Factory::Create(1);
+    auto b = wirefox::IPeer::Factory::Create(1);
+    REQUIRE(a->Bind(wirefox::SocketProtocol::IPv4, 1340));
+    REQUIRE(b->Bind(wirefox::SocketProtocol::IPv4, 0));
+    a->SetMaximumIncomingPeers(1);
+    REQUIRE(b->Connect(LOCALHOST, 1340) == wirefox::ConnectAttemptResult::OK);
+
+    auto timeout = wirefox::Time::Now() + wirefox::Time::FromSeconds(5);
+    while (true) {
+        if (wirefox::Time::Elapsed(timeout)) {
+            FAIL("Connection timed out");
+            return;
+        }
+
+        auto packet = b->Receive();
+        if (packet) {
+            REQUIRE(packet->GetCommand() == wirefox::PacketCommand::NOTIFY_CONNECT_SUCCESS);
+            break;
+        }
+    }
+
+    // packets bigger than a segment are packed together once bigger datagrams are confirmed, and must arrive intact
+    constexpr int COUNT = 20;
+    constexpr size_t LENGTH = 20000;
+    const auto channel = b->MakeChannel(wirefox::ChannelMode::ORDERED);
+    a->MakeChannel(wirefox::ChannelMode::ORDERED);
+    for (int i = 0; i < COUNT; i++) {
+        wirefox::BinaryStream payload;
+        for (size_t j = 0; j < LENGTH; j++)
+            payload.WriteByte(static_cast<uint8_t>(i + j));
+        wirefox::Packet message(wirefox::PacketCommand::USER_PACKET, std::move(payload));
+        b->Send(message, a->GetMyPeerID(), wirefox::PacketOptions::RELIABLE, wirefox::PacketPriority::MEDIUM, channel);
+    }
+
+    int received = 0;
+    timeout = wirefox::Time::Now() + wirefox::Time::FromSeconds(5);
+    while (received < COUNT) {
+        if (wirefox::Time::Elapsed(timeout)) {
+            FAIL("Data timed out");
+            return;
+        }
+
+        auto packet = a->Receive();
+        if (packet && packet->GetCommand() == wirefox::PacketCommand::USER_PACKET) {
+            REQUIRE(packet->GetLength() == LENGTH);
+            wirefox::BinaryStream instream = packet->GetStream();
+            bool intact = true;
+            for (size_t j = 0; j < LENGTH; j++)
+                intact = intact && instream.ReadByte() == static_cast<uint8_t>(received + j);
+            REQUIRE(intact);
+            received++;
+        }
+    }
+
+    const auto* stats = b->GetStats(a->GetMyPeerID());
+    REQUIRE(stats);
+    REQUIRE(stats->Get(wirefox::PeerStatID::PATH_MTU) <= wirefox::cfg::MTU_MAX);
+#ifdef __linux__
+    // the loopback interface carries anything up to 64 KiB, so the search goes straight to the largest size
+    REQUIRE(stats->Get(wirefox::PeerStatID::PATH_MTU) == wirefox::cfg::MTU_MAX);
+#endif
+}
+
+#ifdef WIREFOX_ENABLE_ENCRYPTION
+TEST_CASE("Peer keeps a connection when the client's address changes", "[Peer]") {
+    // the server learns the new address from the first datagram that decrypts, and replies to it from then on
+    REQUIRE(CheckReachableAfterRebind(true, 1343, 1344));
+}
+#endif
+
+TEST_CASE("Peer keeps an unencrypted connection at its original address", "[Peer]") {
+    // without encryption, nothing proves that a datagram from a new address came from the client, rather than from
+    // someone who saw its connection ID and wants to redirect the connection
+    REQUIRE_FALSE(CheckReachableAfterRebind(false, 1345, 1346));
+}